@@ -1,4 +1,7 @@
 ﻿using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
 using System.Threading;
 using System.Threading.Tasks;
 using Microsoft.VisualStudio.TestTools.UnitTesting;
@@ -65,6 +68,94 @@ namespace DanteWrapperLibrary.Tests
             }
         }
 
+        [TestMethod]
+        public async Task SessionTest()
+        {
+            using var session = new RoutingSession(2);
+            session.Initialize();
+
+            using var device1 = session.OpenDevice("DESKTOP-VSC");
+            using var device2 = session.OpenDevice("test device");
+
+            await Task.Delay(TimeSpan.FromSeconds(3));
+
+            Console.WriteLine($"{device1.Name}: {device1.GetRxChannels().Count} rx channels");
+            Console.WriteLine($"{device2.Name}: {device2.GetRxChannels().Count} rx channels");
+        }
+
+        [TestMethod]
+        public async Task DeviceStateCacheTest()
+        {
+            var cache = new DeviceStateCache(Path.Combine(Path.GetTempPath(), "DanteWrapperLibrary.Tests"));
+
+            using (var device = await GetInitializedDeviceAsync("DESKTOP-VSC", TimeSpan.FromSeconds(3), stateCache: cache))
+            {
+                // Stores the live channels
+                Console.WriteLine($"Live: {device.GetRxChannels().Count} rx channels");
+            }
+
+            using var reopened = new RoutingDevice("DESKTOP-VSC", cache);
+            reopened.Initialize();
+
+            var channels = reopened.GetRxChannels();
+            Console.WriteLine($"Cached: {channels.Count} rx channels, stale: {channels.All(info => info.IsStale)}");
+        }
+
+        [TestMethod]
+        public async Task ResolveChannelsTest()
+        {
+            using var session = new RoutingSession(2);
+            session.Initialize();
+
+            using var device1 = session.OpenDevice("DESKTOP-VSC");
+            using var device2 = session.OpenDevice("test device");
+
+            await Task.Delay(TimeSpan.FromSeconds(3));
+
+            var targets = device1.GetTxChannels()
+                .Select(info => $"{info.Name}@{device1.Name}")
+                .Append("NO-SUCH-CHANNEL@test device")
+                .ToArray();
+
+            var resolved = session.ResolveChannels(targets);
+            for (var i = 0; i < targets.Length; i++)
+            {
+                Console.WriteLine($"{targets[i]}: {resolved[i]?.ToString() ?? "unresolved"}");
+            }
+        }
+
+        [TestMethod]
+        public async Task RoutingApplyTest()
+        {
+            using var session = new RoutingSession(2);
+            session.Initialize();
+            session.SetBulkBudget(16);
+
+            using var device1 = session.OpenDevice("DESKTOP-VSC");
+            using var device2 = session.OpenDevice("test device");
+
+            await Task.Delay(TimeSpan.FromSeconds(3));
+
+            var plan = new RoutingPlan();
+            foreach (var device in new[] { device1, device2 })
+            {
+                foreach (var info in device.GetRxChannels())
+                {
+                    plan.Unsubscribe(device.Name, info.Id);
+                }
+            }
+
+            var apply = new RoutingApply(plan.Diff(new[] { device1, device2 }));
+            apply.ProgressChanged += (_, progress) => Console.WriteLine(progress);
+
+            var result = await apply.RunAsync();
+            Console.WriteLine(result);
+            foreach (var device in result.Devices)
+            {
+                Console.WriteLine(device);
+            }
+        }
+
         [TestMethod]
         public async Task GetRxChannelsTest()
         {
@@ -106,7 +197,48 @@ namespace DanteWrapperLibrary.Tests
         {
             using var device = await GetInitializedDeviceAsync("DESKTOP-VSC", TimeSpan.FromSeconds(3));
 
-            device.AddTxLabel(3, "TEST-LABEL");
+            var result = await device.AddTxLabel(3, "TEST-LABEL");
+            Console.WriteLine(result);
+        }
+
+        [TestMethod]
+        public async Task SetTxLabelsTest()
+        {
+            using var device = await GetInitializedDeviceAsync("DESKTOP-VSC", TimeSpan.FromSeconds(3));
+
+            var labels = new (int, IReadOnlyList<string>)[]
+            {
+                (1, new[] { "TEST-LABEL-1A", "TEST-LABEL-1B" }),
+                (2, Array.Empty<string>()),
+            };
+
+            var result = await device.SetTxLabels(labels);
+            Console.WriteLine(result);
+
+            await Task.Delay(TimeSpan.FromSeconds(1));
+
+            // The labels are in place now, so nothing is sent
+            result = await device.SetTxLabels(labels);
+            Console.WriteLine(result);
+        }
+
+        [TestMethod]
+        public async Task ProvisionTxFlowsTest()
+        {
+            using var device = await GetInitializedDeviceAsync("DESKTOP-VSC", TimeSpan.FromSeconds(3));
+
+            var flows = new[]
+            {
+                new TxFlowSpec(101, new[] { 1, 2 }),
+                new TxFlowSpec(102, new[] { 3, 0, 4 }),
+                new TxFlowSpec(103, new[] { 1 }, latencyUs: 2000),
+            };
+
+            var result = await device.ProvisionTxFlows(flows, chunk => Console.WriteLine(chunk));
+            Console.WriteLine(result);
+
+            result = await device.ProvisionTxFlows(flows.Select(flow => TxFlowSpec.Delete(flow.Id)).ToArray());
+            Console.WriteLine(result);
         }
 
         [TestMethod]
@@ -114,7 +246,32 @@ namespace DanteWrapperLibrary.Tests
         {
             using var device = await GetInitializedDeviceAsync("DESKTOP-VSC", TimeSpan.FromSeconds(3));
 
-            device.SetRxChannelName(3, "TEST-CHANNEL-NAME");
+            var result = await device.SetRxChannelName(3, "TEST-CHANNEL-NAME");
+            Console.WriteLine(result);
+        }
+
+        [TestMethod]
+        public async Task PipelinedRequestsTest()
+        {
+            using var device = await GetInitializedDeviceAsync("DESKTOP-VSC", TimeSpan.FromSeconds(3));
+
+            var results = await Task.WhenAll(device.GetRxChannels()
+                .Select(info => device.SetRxChannelName(info.Id, $"TEST-CHANNEL-{info.Id}")));
+            foreach (var result in results)
+            {
+                Console.WriteLine(result);
+            }
+        }
+
+        [TestMethod]
+        public async Task SetRxChannelNamesTest()
+        {
+            using var device = await GetInitializedDeviceAsync("DESKTOP-VSC", TimeSpan.FromSeconds(3));
+
+            var result = await device.SetRxChannelNames(device.GetRxChannels()
+                .Select(info => (info.Id, (string?)$"TEST-CHANNEL-{info.Id}"))
+                .ToArray());
+            Console.WriteLine(result);
         }
 
         [TestMethod]
@@ -122,15 +279,195 @@ namespace DanteWrapperLibrary.Tests
         {
             using var device = await GetInitializedDeviceAsync("DESKTOP-VSC", TimeSpan.FromSeconds(3));
 
-            device.SetSxChannelName(3, "TEST-CHANNEL-NAME");
+            var result = await device.SetSxChannelName(3, "TEST-CHANNEL-NAME@DESKTOP-VSC");
+            Console.WriteLine(result);
+        }
+
+        [TestMethod]
+        public async Task SubscribeRxChannelsTest()
+        {
+            using var device = await GetInitializedDeviceAsync("DESKTOP-VSC", TimeSpan.FromSeconds(3));
+
+            var txChannels = device.GetTxChannels();
+            var result = await device.SubscribeRxChannels(device.GetRxChannels()
+                .Select((info, i) => (info.Id, (string?)txChannels[i % txChannels.Count].Name, (string?)"DESKTOP-VSC"))
+                .ToArray());
+            Console.WriteLine(result);
+            foreach (var chunk in result.Chunks)
+            {
+                Console.WriteLine(chunk);
+            }
+        }
+
+        [TestMethod]
+        public async Task RoutingPlanDiffTest()
+        {
+            using var device = await GetInitializedDeviceAsync("DESKTOP-VSC", TimeSpan.FromSeconds(3));
+
+            var plan = new RoutingPlan();
+            foreach (var info in device.GetRxChannels())
+            {
+                if (string.IsNullOrEmpty(info.Subscription))
+                {
+                    plan.Unsubscribe(device.Name, info.Id);
+                }
+                else
+                {
+                    var parts = info.Subscription.Split('@');
+                    plan.Subscribe(device.Name, info.Id, parts[0], parts[1]);
+                }
+            }
+
+            // The current state needs no changes
+            var diff = plan.Diff(new[] { device });
+            Console.WriteLine(diff);
+            Assert.IsTrue(diff.IsEmpty);
+
+            plan.Unsubscribe(device.Name, 1);
+            plan.Unsubscribe("MISSING-DEVICE", 1);
+            diff = plan.Diff(new[] { device });
+            Console.WriteLine(diff);
+            Assert.AreEqual(1, diff.MissingDevices.Count);
+        }
+
+        [TestMethod]
+        public async Task GetChannelChangesTest()
+        {
+            using var device = await GetInitializedDeviceAsync("DESKTOP-VSC", TimeSpan.FromSeconds(3));
+
+            var changes = device.GetChannelChanges(0);
+            Console.WriteLine($"Generation: {changes.Generation}");
+            // starting from 0 already returns everything
+            Assert.IsFalse(changes.IsFullResync);
+            foreach (var info in changes.RxChannels)
+            {
+                PrintUtilities.ShowProperties(info);
+                Console.WriteLine();
+            }
+            foreach (var info in changes.TxChannels)
+            {
+                PrintUtilities.ShowProperties(info);
+                Console.WriteLine();
+            }
+
+            var next = device.GetChannelChanges(changes.Generation);
+            Console.WriteLine($"Generation: {next.Generation}, IsEmpty: {next.IsEmpty}, IsFullResync: {next.IsFullResync}");
+        }
+
+        [TestMethod]
+        public async Task SetRefreshPolicyTest()
+        {
+            using var device = await GetInitializedDeviceAsync("DESKTOP-VSC");
+            device.SetRefreshPolicy(
+                DeviceComponents.RxChannels,
+                new Dictionary<DeviceComponent, TimeSpan> { [DeviceComponent.RxChannels] = TimeSpan.FromSeconds(1) });
+
+            await Task.Delay(TimeSpan.FromSeconds(3));
+
+            // Tx channels are fetched by the first query and reported fresh afterwards
+            device.GetTxChannels();
+            await Task.Delay(TimeSpan.FromSeconds(1));
+
+            foreach (var info in device.GetTxChannels())
+            {
+                PrintUtilities.ShowProperties(info);
+                Console.WriteLine();
+            }
+        }
+
+        [TestMethod]
+        public async Task RxFlowErrorStatsTest()
+        {
+            using var device = await GetInitializedDeviceAsync("DESKTOP-VSC");
+            device.StartRxFlowErrorStats(TimeSpan.FromMilliseconds(500), 0xFF, 20);
+
+            await Task.Delay(TimeSpan.FromSeconds(3));
+
+            var stats = device.GetRxFlowErrorStats(0);
+            foreach (var sample in stats.Samples)
+            {
+                Console.WriteLine(
+                    $"{sample.Sequence} {sample.FlowName}[{sample.InterfaceIndex}] {sample.Interval.TotalMilliseconds}ms " +
+                    string.Join(" ", sample.Deltas));
+            }
+
+            await Task.Delay(TimeSpan.FromSeconds(1));
+
+            var next = device.GetRxFlowErrorStats(stats.Sequence, skipZero: true);
+            Assert.IsTrue(next.Sequence >= stats.Sequence);
+            Assert.IsTrue(next.Samples.All(sample => sample.Sequence > stats.Sequence));
+        }
+
+        [TestMethod]
+        public async Task MeteringTest()
+        {
+            using var session = new RoutingSession(1);
+            session.Initialize();
+
+            var meters = session.StartMetering(maxDevices: 4, maxChannels: 64);
+            var slot = session.SubscribeMetering("DESKTOP-VSC");
+            Assert.AreEqual(slot, session.SubscribeMetering("DESKTOP-VSC"));
+
+            await Task.Delay(TimeSpan.FromSeconds(3));
+
+            var frame = meters.CreateFrame();
+            for (var tick = 0; tick < 10; tick++)
+            {
+                if (meters.TryReadLatest(slot, frame))
+                {
+                    Console.WriteLine(
+                        $"{frame.Sequence} {meters.GetDeviceName(slot)} status={meters.GetStatus(slot):X}: " +
+                        string.Join(" ", frame.TxPeaks.Take(frame.TxCount).Select(peak => peak.ToString("0.0"))));
+                }
+                await Task.Delay(TimeSpan.FromMilliseconds(100));
+            }
+
+            session.UnsubscribeMetering(slot);
+            Assert.IsFalse(meters.IsSubscribed(slot));
+            session.StopMetering();
+            Assert.ThrowsException<ObjectDisposedException>(() => meters.TryReadLatest(slot, frame));
+        }
+
+        [TestMethod]
+        public async Task MeterBallisticsTest()
+        {
+            using var session = new RoutingSession(1);
+            session.Initialize();
+
+            session.StartMetering(maxDevices: 4, maxChannels: 64);
+            var slot = session.SubscribeMetering("DESKTOP-VSC");
+            var view = session.SetMeterBallistics(new MeterBallistics { Rate = 30, ClipHold = TimeSpan.FromSeconds(2) });
+            Assert.AreEqual(30, view.Rate);
+
+            await Task.Delay(TimeSpan.FromSeconds(3));
+
+            var frame = view.CreateFrame();
+            for (var tick = 0; tick < 10; tick++)
+            {
+                if (view.TryReadLatest(frame))
+                {
+                    Console.WriteLine(
+                        $"{frame.Sequence} {frame.Interval.TotalMilliseconds}ms: " +
+                        string.Join(" ", Enumerable.Range(0, view.MaxChannels).Select(channel =>
+                            $"{frame.GetLevel(slot, MeterDirection.Tx, channel):0.0}/{frame.GetHold(slot, MeterDirection.Tx, channel):0.0}" +
+                            (frame.IsClipLatched(slot, MeterDirection.Tx, channel) ? "!" : ""))));
+                }
+                await Task.Delay(TimeSpan.FromMilliseconds(1000.0 / view.Rate));
+            }
+
+            session.ClearMeterClips();
+            session.SetMeterBallistics(new MeterBallistics { Rate = 0 });
+            session.StopMetering();
+            Assert.ThrowsException<ObjectDisposedException>(() => view.TryReadLatest(frame));
         }
 
         private static async Task<RoutingDevice> GetInitializedDeviceAsync(
             string name,
             TimeSpan? delay = null,
-            CancellationToken cancellationToken = default)
+            CancellationToken cancellationToken = default,
+            DeviceStateCache? stateCache = null)
         {
-            var device = new RoutingDevice(name);
+            var device = new RoutingDevice(name, stateCache);
             device.StepOccurred += (_, args) =>
             {
                 Console.WriteLine($"{name} StepOccurred");
@@ -0,0 +1,58 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+
+namespace DanteWrapperLibrary
+{
+    /// <summary>
+    /// Result of one batch of a bulk request
+    /// </summary>
+    public class BulkChunkResult
+    {
+        /// <summary>
+        /// Index of the first entry of the batch in the submitted list
+        /// </summary>
+        public int FirstEntry { get; }
+
+        public int Count { get; }
+
+        /// <summary>
+        /// aud_error_t of the batch. 0 is success
+        /// </summary>
+        public int Result { get; }
+
+        public bool IsSuccess => Result == 0;
+
+        public BulkChunkResult(int firstEntry, int count, int result)
+        {
+            FirstEntry = firstEntry;
+            Count = count;
+            Result = result;
+        }
+
+        public override string ToString()
+        {
+            return $"Entries {FirstEntry}..{FirstEntry + Count - 1}: {(IsSuccess ? "success" : $"error {Result}")}";
+        }
+    }
+
+    /// <summary>
+    /// Result of a bulk request. <see cref="RoutingResult.Result"/> is the first failure of any batch
+    /// </summary>
+    public class BulkRoutingResult : RoutingResult
+    {
+        /// <summary>
+        /// Batches ordered by their first entry
+        /// </summary>
+        public IReadOnlyList<BulkChunkResult> Chunks { get; }
+
+        public IEnumerable<BulkChunkResult> FailedChunks => Chunks.Where(chunk => !chunk.IsSuccess);
+
+        public BulkRoutingResult(ulong token, int result, IEnumerable<BulkChunkResult> chunks) : base(token, result)
+        {
+            Chunks = (chunks ?? throw new ArgumentNullException(nameof(chunks)))
+                .OrderBy(chunk => chunk.FirstEntry)
+                .ToArray();
+        }
+    }
+}
@@ -0,0 +1,30 @@
+﻿using System.Collections.Generic;
+
+namespace DanteWrapperLibrary
+{
+    public class ChannelChanges
+    {
+        /// <summary>
+        /// Pass this value to the next <see cref="RoutingDevice.GetChannelChanges"/> call
+        /// </summary>
+        public uint Generation { get; }
+
+        /// <summary>
+        /// Channels were removed or could not be tracked. <see cref="RxChannels"/> and
+        /// <see cref="TxChannels"/> hold every channel; replace the cached channels instead of merging
+        /// </summary>
+        public bool IsFullResync { get; }
+        public IList<RxChannelInfo> RxChannels { get; }
+        public IList<TxChannelInfo> TxChannels { get; }
+
+        public bool IsEmpty => !IsFullResync && RxChannels.Count == 0 && TxChannels.Count == 0;
+
+        public ChannelChanges(uint generation, bool isFullResync, IList<RxChannelInfo> rxChannels, IList<TxChannelInfo> txChannels)
+        {
+            Generation = generation;
+            IsFullResync = isFullResync;
+            RxChannels = rxChannels;
+            TxChannels = txChannels;
+        }
+    }
+}
@@ -114,6 +114,10 @@ namespace DanteWrapperLibrary
                 return;
             }
 
+            // A step waits for the next runtime timeout, so wake it up to notice the cancellation
+            TaskWorker.CancellationTokenSource.Cancel();
+            DanteBrowsingApi.Wake(IntPtr);
+
             // Waits to complete the last step
             TaskWorker.Dispose();
 
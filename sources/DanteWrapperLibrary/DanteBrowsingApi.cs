@@ -20,6 +20,11 @@ namespace DanteWrapperLibrary
             ref IntPtr ptr
         );
 
+        [DllImport("dante_browsing_test.dll", EntryPoint = "wake", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Wake(
+            ref IntPtr ptr
+        );
+
         [DllImport("dante_browsing_test.dll", EntryPoint = "process_line", CallingConvention = CallingConvention.Cdecl)]
         private static extern int ProcessLine(
             ref IntPtr ptr,
@@ -73,6 +78,16 @@ namespace DanteWrapperLibrary
             CheckResult(Step(ref ptr));
         }
 
+        /// <summary>
+        /// Makes a blocked step return immediately. Can be called from any thread
+        /// </summary>
+        /// <param name="ptr"></param>
+        /// <returns></returns>
+        internal static void Wake(IntPtr ptr)
+        {
+            CheckResult(Wake(ref ptr));
+        }
+
         /// <summary>
         /// Performs next step
         /// </summary>
@@ -15,22 +15,141 @@ namespace DanteWrapperLibrary
             out IntPtr ptr
         );
 
+        [DllImport("dante_routing_test.dll", EntryPoint = "session_open", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int OpenSession(
+            int argc,
+            string[] argv,
+            int maxDevices,
+            out IntPtr session
+        );
+
+        [DllImport("dante_routing_test.dll", EntryPoint = "session_open_device", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int OpenSessionDevice(
+            ref IntPtr session,
+            int argc,
+            string[] argv,
+            out IntPtr ptr
+        );
+
+        [DllImport("dante_routing_test.dll", EntryPoint = "session_step", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int SessionStep(
+            ref IntPtr session
+        );
+
+        [DllImport("dante_routing_test.dll", EntryPoint = "session_start_loop", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int StartSessionLoop(
+            ref IntPtr session
+        );
+
+        [DllImport("dante_routing_test.dll", EntryPoint = "session_stop_loop", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int StopSessionLoop(
+            ref IntPtr session
+        );
+
+        [DllImport("dante_routing_test.dll", EntryPoint = "session_set_bulk_budget", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int SetSessionBulkBudget(
+            ref IntPtr session,
+            int maxInFlight
+        );
+
+        [DllImport("dante_routing_test.dll", EntryPoint = "session_start_rxflow_error_stats", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int StartSessionRxFlowErrorStats(
+            ref IntPtr session,
+            uint intervalMs,
+            uint fields,
+            uint history
+        );
+
+        [DllImport("dante_routing_test.dll", EntryPoint = "session_start_metering", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int StartSessionMetering(
+            ref IntPtr session,
+            int port,
+            int maxDevices,
+            int maxChannels,
+            int capacity,
+            out IntPtr ring
+        );
+
+        [DllImport("dante_routing_test.dll", EntryPoint = "session_subscribe_metering", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int SubscribeSessionMetering(
+            ref IntPtr session,
+            string device,
+            out int slot
+        );
+
+        [DllImport("dante_routing_test.dll", EntryPoint = "session_unsubscribe_metering", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int UnsubscribeSessionMetering(
+            ref IntPtr session,
+            int slot
+        );
+
+        [DllImport("dante_routing_test.dll", EntryPoint = "session_set_meter_ballistics", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int SetSessionMeterBallistics(
+            ref IntPtr session,
+            ref InternalMeterBallistics ballistics,
+            out IntPtr view
+        );
+
+        [DllImport("dante_routing_test.dll", EntryPoint = "session_clear_meter_clips", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int ClearSessionMeterClips(
+            ref IntPtr session,
+            int slot
+        );
+
+        [DllImport("dante_routing_test.dll", EntryPoint = "session_stop_metering", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int StopSessionMetering(
+            ref IntPtr session
+        );
+
+        [DllImport("dante_routing_test.dll", EntryPoint = "session_resolve_channels", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int ResolveSessionChannels(
+            ref IntPtr session,
+            string[] targets,
+            int count,
+            [Out] ulong[] handles,
+            [Out] int[] channelIds,
+            [Out] int[] isLabel
+        );
+
+        [DllImport("dante_routing_test.dll", EntryPoint = "session_close", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void CloseSession(
+            ref IntPtr session
+        );
+
         [DllImport("dante_routing_test.dll", EntryPoint = "step", CallingConvention = CallingConvention.Cdecl)]
         private static extern int Step(
             ref IntPtr ptr
         );
 
-        internal delegate void DomainEventCallbackDelegate(IntPtr ptr, string text);
-        internal delegate void DeviceEventCallbackDelegate(IntPtr ptr, string name, string text);
+        [DllImport("dante_routing_test.dll", EntryPoint = "wake", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int Wake(
+            ref IntPtr ptr
+        );
+
+        internal delegate void EventCallbackDelegate(IntPtr context);
 
-        [DllImport("dante_routing_test.dll", EntryPoint = "set_domain_event_callback", CallingConvention = CallingConvention.Cdecl)]
-        private static extern void SetDomainEventCallback(
-            DomainEventCallbackDelegate @delegate
+        [DllImport("dante_routing_test.dll", EntryPoint = "set_event_callback", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int SetEventCallback(
+            ref IntPtr ptr,
+            EventCallbackDelegate? @delegate,
+            IntPtr context
         );
 
-        [DllImport("dante_routing_test.dll", EntryPoint = "set_device_event_callback", CallingConvention = CallingConvention.Cdecl)]
-        private static extern void SetDeviceEventCallback(
-            DeviceEventCallbackDelegate @delegate
+        [DllImport("dante_routing_test.dll", EntryPoint = "set_refresh_policy", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int SetRefreshPolicy(
+            ref IntPtr ptr,
+            uint subscribed,
+            [In] uint[] maxAgeMs,
+            int count
+        );
+
+        [DllImport("dante_routing_test.dll", EntryPoint = "drain_events", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int DrainEvents(
+            ref IntPtr ptr,
+            [Out] InternalRoutingEvent[] events,
+            int capacity,
+            out int written,
+            out uint dropped
         );
 
         [DllImport("dante_routing_test.dll", EntryPoint = "process_line", CallingConvention = CallingConvention.Cdecl)]
@@ -41,43 +160,133 @@ namespace DanteWrapperLibrary
             out int count
         );
 
-        [DllImport("dante_routing_test.dll", EntryPoint = "close_device", CallingConvention = CallingConvention.Cdecl)]
-        private static extern void CloseDevice(
-            ref IntPtr ptr
+        [DllImport("dante_routing_test.dll", EntryPoint = "set_rxchannel_name", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int SetRxChannelName(
+            ref IntPtr ptr,
+            int channel,
+            string name,
+            out ulong token
         );
 
-        #endregion
+        [DllImport("dante_routing_test.dll", EntryPoint = "subscribe_rxchannel", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int SubscribeRxChannel(
+            ref IntPtr ptr,
+            int channel,
+            string? subscription,
+            out ulong token
+        );
 
-        #region Events
+        [DllImport("dante_routing_test.dll", EntryPoint = "add_txlabel", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int AddTxLabel(
+            ref IntPtr ptr,
+            int channel,
+            string label,
+            out ulong token
+        );
 
-        public static event EventHandler<string>? DomainEventOccurred;
+        [DllImport("dante_routing_test.dll", EntryPoint = "set_rxchannel_names", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int SetRxChannelNames(
+            ref IntPtr ptr,
+            int[] channels,
+            string?[] names,
+            int count,
+            out ulong token
+        );
 
-        private static void OnDomainEventOccurred(IntPtr ptr, string text)
-        {
-            DomainEventOccurred?.Invoke(ptr, text);
-        }
+        [DllImport("dante_routing_test.dll", EntryPoint = "subscribe_rxchannels", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int SubscribeRxChannels(
+            ref IntPtr ptr,
+            int[] channels,
+            string?[] txChannels,
+            string?[] txDevices,
+            int count,
+            out ulong token
+        );
 
-        public static event EventHandler<(string name, string text)>? DeviceEventOccurred;
+        [DllImport("dante_routing_test.dll", EntryPoint = "diff_subscriptions", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int DiffSubscriptions(
+            ref IntPtr ptr,
+            int[] channels,
+            string?[] txChannels,
+            string?[] txDevices,
+            int count,
+            [Out] int[] changed,
+            out int changedCount
+        );
 
-        private static void OnDeviceEventOccurred(IntPtr ptr, string name, string text)
-        {
-            DeviceEventOccurred?.Invoke(ptr, (name, text));
-        }
+        [DllImport("dante_routing_test.dll", EntryPoint = "set_txlabels", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int SetTxLabels(
+            ref IntPtr ptr,
+            int[] channels,
+            string?[] labels,
+            int count,
+            out int changes,
+            out ulong token
+        );
 
-        #endregion
+        [DllImport("dante_routing_test.dll", EntryPoint = "provision_txflows", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int ProvisionTxFlows(
+            ref IntPtr ptr,
+            [In] InternalTxFlowSpec[] flows,
+            int count,
+            out ulong token
+        );
 
-        #region Methods
+        [DllImport("dante_routing_test.dll", EntryPoint = "get_rxchannels_snapshot", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int GetRxChannelsSnapshot(
+            ref IntPtr ptr,
+            out IntPtr snapshot
+        );
 
-        internal static void InitializeDomainEvents()
-        {
-            SetDomainEventCallback(OnDomainEventOccurred);
-        }
+        [DllImport("dante_routing_test.dll", EntryPoint = "get_txchannels_snapshot", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int GetTxChannelsSnapshot(
+            ref IntPtr ptr,
+            out IntPtr snapshot
+        );
 
-        internal static void InitializeDeviceEvents()
-        {
-            SetDeviceEventCallback(OnDeviceEventOccurred);
-        }
+        [DllImport("dante_routing_test.dll", EntryPoint = "get_txlabels_snapshot", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int GetTxLabelsSnapshot(
+            ref IntPtr ptr,
+            out IntPtr snapshot
+        );
+
+        private delegate int GetSnapshotDelegate(ref IntPtr ptr, out IntPtr snapshot);
 
+        [DllImport("dante_routing_test.dll", EntryPoint = "get_channel_changes", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int GetChannelChanges(
+            ref IntPtr ptr,
+            uint sinceGeneration,
+            out uint generation,
+            out int resync,
+            out IntPtr rxSnapshot,
+            out IntPtr txSnapshot
+        );
+
+        [DllImport("dante_routing_test.dll", EntryPoint = "start_rxflow_error_stats", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int StartRxFlowErrorStats(
+            ref IntPtr ptr,
+            uint intervalMs,
+            uint fields,
+            uint history
+        );
+
+        [DllImport("dante_routing_test.dll", EntryPoint = "get_rxflow_error_stats", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int GetRxFlowErrorStats(
+            ref IntPtr ptr,
+            uint sinceSequence,
+            int skipZero,
+            out uint sequence,
+            out IntPtr snapshot
+        );
+
+        [DllImport("dante_routing_test.dll", EntryPoint = "close_device", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void CloseDevice(
+            ref IntPtr ptr
+        );
+
+        #endregion
+
+        #region Methods
 
         /// <summary>
         /// Checks result and throws exception if it's not equals 0
@@ -106,6 +315,207 @@ namespace DanteWrapperLibrary
             return ptr;
         }
 
+        /// <summary>
+        /// Opens a session able to hold up to <paramref name="maxDevices"/> devices and returns pointer
+        /// </summary>
+        /// <param name="maxDevices"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static IntPtr OpenSession(int maxDevices)
+        {
+            CheckResult(OpenSession(1, new[] { "DanteRoutingWrapper" }, maxDevices, out var session));
+
+            return session;
+        }
+
+        /// <summary>
+        /// Opens device in the session and returns pointer
+        /// </summary>
+        /// <param name="session"></param>
+        /// <param name="name"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static IntPtr OpenSessionDevice(IntPtr session, string name)
+        {
+            CheckResult(OpenSessionDevice(ref session, 2, new[] { "DanteRoutingWrapper", name }, out var ptr));
+
+            return ptr;
+        }
+
+        /// <summary>
+        /// Performs next step for all devices of the session
+        /// </summary>
+        /// <param name="session"></param>
+        /// <returns></returns>
+        internal static void PerformNextSessionStep(IntPtr session)
+        {
+            CheckResult(SessionStep(ref session));
+        }
+
+        /// <summary>
+        /// Starts the native thread that steps all devices of the session.
+        /// <see cref="PerformNextSessionStep"/> must not be used while it runs
+        /// </summary>
+        /// <param name="session"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static void StartSessionLoop(IntPtr session)
+        {
+            CheckResult(StartSessionLoop(ref session));
+        }
+
+        /// <summary>
+        /// Stops the native thread of the session and waits for it
+        /// </summary>
+        /// <param name="session"></param>
+        /// <exception cref="InvalidOperationException">The loop was stopped by an error</exception>
+        /// <returns></returns>
+        internal static void StopSessionLoop(IntPtr session)
+        {
+            CheckResult(StopSessionLoop(ref session));
+        }
+
+        /// <summary>
+        /// Limits the bulk request batches all devices of the session have in flight together
+        /// </summary>
+        /// <param name="session"></param>
+        /// <param name="maxInFlight"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static void SetSessionBulkBudget(IntPtr session, int maxInFlight)
+        {
+            CheckResult(SetSessionBulkBudget(ref session, maxInFlight));
+        }
+
+        /// <summary>
+        /// Starts rx flow error statistics on every device of the session, including the devices opened later
+        /// </summary>
+        /// <param name="session"></param>
+        /// <param name="intervalMs">0 stops polling</param>
+        /// <param name="fields">bit per rx flow error type</param>
+        /// <param name="history">samples kept, 0 for the default</param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static void StartSessionRxFlowErrorStats(IntPtr session, uint intervalMs, uint fields, uint history)
+        {
+            CheckResult(StartSessionRxFlowErrorStats(ref session, intervalMs, fields, history));
+        }
+
+        /// <summary>
+        /// Starts the conmon metering client of the session and returns its ring, owned by the session
+        /// </summary>
+        /// <param name="session"></param>
+        /// <param name="port">0 for the conmon default</param>
+        /// <param name="maxDevices"></param>
+        /// <param name="maxChannels">per direction</param>
+        /// <param name="capacity">frames, 0 for the native default</param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static IntPtr StartSessionMetering(IntPtr session, int port, int maxDevices, int maxChannels, int capacity)
+        {
+            CheckResult(StartSessionMetering(ref session, port, maxDevices, maxChannels, capacity, out var ring));
+
+            return ring;
+        }
+
+        /// <summary>
+        /// Subscribes to the metering of a device and returns its slot in the ring
+        /// </summary>
+        /// <param name="session"></param>
+        /// <param name="device"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static int SubscribeSessionMetering(IntPtr session, string device)
+        {
+            CheckResult(SubscribeSessionMetering(ref session, device, out var slot));
+
+            return slot;
+        }
+
+        /// <summary>
+        /// Unsubscribes from the metering of the device in the given slot
+        /// </summary>
+        /// <param name="session"></param>
+        /// <param name="slot"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static void UnsubscribeSessionMetering(IntPtr session, int slot)
+        {
+            CheckResult(UnsubscribeSessionMetering(ref session, slot));
+        }
+
+        /// <summary>
+        /// Starts or changes the meter ballistics of the session and returns its view, owned by the session
+        /// </summary>
+        /// <param name="session"></param>
+        /// <param name="ballistics"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static IntPtr SetSessionMeterBallistics(IntPtr session, InternalMeterBallistics ballistics)
+        {
+            CheckResult(SetSessionMeterBallistics(ref session, ref ballistics, out var view));
+
+            return view;
+        }
+
+        /// <summary>
+        /// Clears the latched clips of a device slot, or of every slot for -1
+        /// </summary>
+        /// <param name="session"></param>
+        /// <param name="slot"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static void ClearSessionMeterClips(IntPtr session, int slot)
+        {
+            CheckResult(ClearSessionMeterClips(ref session, slot));
+        }
+
+        /// <summary>
+        /// Stops the metering client and frees its ring
+        /// </summary>
+        /// <param name="session"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static void StopSessionMetering(IntPtr session)
+        {
+            CheckResult(StopSessionMetering(ref session));
+        }
+
+        /// <summary>
+        /// Resolves "channel@device" targets against the channel names and labels of the session devices
+        /// </summary>
+        /// <param name="session"></param>
+        /// <param name="targets"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns>device handle per target, 0 if unresolved, with the tx channel id and whether a label matched</returns>
+        internal static (ulong[] handles, int[] channelIds, int[] isLabel) ResolveSessionChannels(IntPtr session, string[] targets)
+        {
+            var handles = new ulong[targets.Length];
+            var channelIds = new int[targets.Length];
+            var isLabel = new int[targets.Length];
+
+            CheckResult(ResolveSessionChannels(ref session, targets, targets.Length, handles, channelIds, isLabel));
+
+            return (handles, channelIds, isLabel);
+        }
+
+        /// <summary>
+        /// Closes session. Devices still open in the session are disconnected
+        /// </summary>
+        /// <param name="session"></param>
+        /// <returns></returns>
+        internal static void CloseSession(IntPtr session)
+        {
+            try
+            {
+                CloseSession(ref session);
+            }
+            finally
+            {
+                Marshal.FreeCoTaskMem(session);
+            }
+        }
+
         /// <summary>
         /// Performs next step
         /// </summary>
@@ -116,6 +526,63 @@ namespace DanteWrapperLibrary
             CheckResult(Step(ref ptr));
         }
 
+        /// <summary>
+        /// Makes a step blocked on the device return immediately. Can be called from any thread
+        /// </summary>
+        /// <param name="ptr"></param>
+        /// <returns></returns>
+        internal static void WakeDevice(IntPtr ptr)
+        {
+            CheckResult(Wake(ref ptr));
+        }
+
+        /// <summary>
+        /// Registers a callback told on the stepping thread when events of this device wait for
+        /// <see cref="DrainEvents(IntPtr, InternalRoutingEvent[], out uint)"/>, once per step that queued any. 
+        /// The delegate must be kept alive until it's unregistered or the device is closed
+        /// </summary>
+        /// <param name="ptr"></param>
+        /// <param name="delegate">null to unregister</param>
+        /// <param name="context">Passed back to the callback as is</param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static void SetEventCallback(IntPtr ptr, EventCallbackDelegate? @delegate, IntPtr context)
+        {
+            CheckResult(SetEventCallback(ref ptr, @delegate, context));
+        }
+
+        /// <summary>
+        /// Sets which components the device keeps up to date and the max age of each component
+        /// </summary>
+        /// <param name="ptr"></param>
+        /// <param name="subscribed"></param>
+        /// <param name="maxAgeMs">indexed by <see cref="DeviceComponent"/>, 0 never expires</param>
+        /// <exception cref="InvalidOperationException"></exception>
+        internal static void SetRefreshPolicy(IntPtr ptr, DeviceComponents subscribed, uint[] maxAgeMs)
+        {
+            if (ptr == IntPtr.Zero)
+            {
+                throw new InvalidOperationException("Device is not initialized");
+            }
+
+            CheckResult(SetRefreshPolicy(ref ptr, (uint)subscribed, maxAgeMs, maxAgeMs.Length));
+        }
+
+        /// <summary>
+        /// Copies pending events of the device into <paramref name="events"/>.
+        /// Must not be called concurrently for the same device
+        /// </summary>
+        /// <param name="ptr"></param>
+        /// <param name="events"></param>
+        /// <param name="dropped">Total number of events lost to a full buffer so far</param>
+        /// <returns>Number of copied events</returns>
+        internal static int DrainEvents(IntPtr ptr, InternalRoutingEvent[] events, out uint dropped)
+        {
+            CheckResult(DrainEvents(ref ptr, events, events.Length, out var written, out dropped));
+
+            return written;
+        }
+
         /// <summary>
         /// Performs next step
         /// </summary>
@@ -167,6 +634,345 @@ namespace DanteWrapperLibrary
             return array;
         }
 
+        /// <summary>
+        /// Sends a rx channel rename request and returns its token
+        /// </summary>
+        /// <param name="ptr"></param>
+        /// <param name="channel"></param>
+        /// <param name="name"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static ulong SetRxChannelName(IntPtr ptr, int channel, string name)
+        {
+            if (ptr == IntPtr.Zero)
+            {
+                throw new InvalidOperationException("Device is not initialized");
+            }
+
+            CheckResult(SetRxChannelName(ref ptr, channel, name, out var token));
+
+            return token;
+        }
+
+        /// <summary>
+        /// Sends a rx channel subscription request and returns its token
+        /// </summary>
+        /// <param name="ptr"></param>
+        /// <param name="channel"></param>
+        /// <param name="subscription">"channel@device", null to unsubscribe</param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static ulong SubscribeRxChannel(IntPtr ptr, int channel, string? subscription)
+        {
+            if (ptr == IntPtr.Zero)
+            {
+                throw new InvalidOperationException("Device is not initialized");
+            }
+
+            CheckResult(SubscribeRxChannel(ref ptr, channel, subscription, out var token));
+
+            return token;
+        }
+
+        /// <summary>
+        /// Sends an add tx label request and returns its token
+        /// </summary>
+        /// <param name="ptr"></param>
+        /// <param name="channel"></param>
+        /// <param name="label"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static ulong AddTxLabel(IntPtr ptr, int channel, string label)
+        {
+            if (ptr == IntPtr.Zero)
+            {
+                throw new InvalidOperationException("Device is not initialized");
+            }
+
+            CheckResult(AddTxLabel(ref ptr, channel, label, out var token));
+
+            return token;
+        }
+
+        /// <summary>
+        /// Sends rx channel renames in pipelined batches and returns one token for all of them
+        /// </summary>
+        /// <param name="ptr"></param>
+        /// <param name="channels"></param>
+        /// <param name="names">null or empty clears the name</param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static ulong SetRxChannelNames(IntPtr ptr, int[] channels, string?[] names)
+        {
+            if (ptr == IntPtr.Zero)
+            {
+                throw new InvalidOperationException("Device is not initialized");
+            }
+
+            CheckResult(SetRxChannelNames(ref ptr, channels, names, channels.Length, out var token));
+
+            return token;
+        }
+
+        /// <summary>
+        /// Subscribes channels[i] to "txChannels[i]@txDevices[i]" in pipelined batches
+        /// </summary>
+        /// <param name="ptr"></param>
+        /// <param name="channels"></param>
+        /// <param name="txChannels">null or empty unsubscribes</param>
+        /// <param name="txDevices">null or empty unsubscribes</param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static ulong SubscribeRxChannels(IntPtr ptr, int[] channels, string?[] txChannels, string?[] txDevices)
+        {
+            if (ptr == IntPtr.Zero)
+            {
+                throw new InvalidOperationException("Device is not initialized");
+            }
+
+            CheckResult(SubscribeRxChannels(ref ptr, channels, txChannels, txDevices, channels.Length, out var token));
+
+            return token;
+        }
+
+        /// <summary>
+        /// Returns the indices of the subscriptions that differ from the current state of the device
+        /// </summary>
+        /// <param name="ptr"></param>
+        /// <param name="channels"></param>
+        /// <param name="txChannels">null or empty means unsubscribed</param>
+        /// <param name="txDevices">null or empty means unsubscribed</param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static int[] DiffSubscriptions(IntPtr ptr, int[] channels, string?[] txChannels, string?[] txDevices)
+        {
+            if (ptr == IntPtr.Zero)
+            {
+                throw new InvalidOperationException("Device is not initialized");
+            }
+
+            var changed = new int[channels.Length];
+            CheckResult(DiffSubscriptions(ref ptr, channels, txChannels, txDevices, channels.Length, changed, out var count));
+            Array.Resize(ref changed, count);
+
+            return changed;
+        }
+
+        /// <summary>
+        /// Sends the tx label changes that give each listed channel exactly its paired labels
+        /// </summary>
+        /// <param name="ptr"></param>
+        /// <param name="channels"></param>
+        /// <param name="labels">null or empty only lists the channel</param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns>0 if the labels were already in place and nothing was sent</returns>
+        internal static ulong SetTxLabels(IntPtr ptr, int[] channels, string?[] labels)
+        {
+            if (ptr == IntPtr.Zero)
+            {
+                throw new InvalidOperationException("Device is not initialized");
+            }
+
+            CheckResult(SetTxLabels(ref ptr, channels, labels, channels.Length, out _, out var token));
+
+            return token;
+        }
+
+        /// <summary>
+        /// Creates, replaces or deletes tx flows, batched where the flow has the device default format
+        /// </summary>
+        /// <param name="ptr"></param>
+        /// <param name="flows"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static ulong ProvisionTxFlows(IntPtr ptr, InternalTxFlowSpec[] flows)
+        {
+            if (ptr == IntPtr.Zero)
+            {
+                throw new InvalidOperationException("Device is not initialized");
+            }
+
+            CheckResult(ProvisionTxFlows(ref ptr, flows, flows.Length, out var token));
+
+            return token;
+        }
+
+        /// <summary>
+        /// Returns a snapshot of rx channels of the device
+        /// </summary>
+        /// <param name="ptr"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static Snapshot<InternalRxChannelRecord> GetRxChannelsSnapshot(IntPtr ptr)
+        {
+            return GetSnapshot<InternalRxChannelRecord>(ptr, GetRxChannelsSnapshot);
+        }
+
+        /// <summary>
+        /// Returns a snapshot of tx channels of the device
+        /// </summary>
+        /// <param name="ptr"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static Snapshot<InternalTxChannelRecord> GetTxChannelsSnapshot(IntPtr ptr)
+        {
+            return GetSnapshot<InternalTxChannelRecord>(ptr, GetTxChannelsSnapshot);
+        }
+
+        /// <summary>
+        /// Returns a snapshot of tx labels of the device
+        /// </summary>
+        /// <param name="ptr"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static Snapshot<InternalTxLabelRecord> GetTxLabelsSnapshot(IntPtr ptr)
+        {
+            return GetSnapshot<InternalTxLabelRecord>(ptr, GetTxLabelsSnapshot);
+        }
+
+        /// <summary>
+        /// Returns snapshots of the channels changed after the given generation.
+        /// Snapshots are null if nothing changed
+        /// </summary>
+        /// <param name="ptr"></param>
+        /// <param name="sinceGeneration"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static (uint generation, bool resync, Snapshot<InternalRxChannelRecord>? rx, Snapshot<InternalTxChannelRecord>? tx) GetChannelChanges(
+            IntPtr ptr,
+            uint sinceGeneration)
+        {
+            if (ptr == IntPtr.Zero)
+            {
+                throw new InvalidOperationException("Device is not initialized");
+            }
+
+            CheckResult(GetChannelChanges(ref ptr, sinceGeneration, out var generation, out var resync, out var rxPtr, out var txPtr));
+            try
+            {
+                return (
+                    generation,
+                    resync != 0,
+                    rxPtr == IntPtr.Zero ? null : Snapshot<InternalRxChannelRecord>.FromPointer(rxPtr),
+                    txPtr == IntPtr.Zero ? null : Snapshot<InternalTxChannelRecord>.FromPointer(txPtr));
+            }
+            finally
+            {
+                Marshal.FreeCoTaskMem(rxPtr);
+                Marshal.FreeCoTaskMem(txPtr);
+            }
+        }
+
+        /// <summary>
+        /// Polls the given rx flow error fields of every rx flow of the device every <paramref name="intervalMs"/>
+        /// </summary>
+        /// <param name="ptr"></param>
+        /// <param name="intervalMs">0 stops polling and drops the samples</param>
+        /// <param name="fields">bit per rx flow error type</param>
+        /// <param name="history">samples kept, 0 for the default</param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static void StartRxFlowErrorStats(IntPtr ptr, uint intervalMs, uint fields, uint history)
+        {
+            if (ptr == IntPtr.Zero)
+            {
+                throw new InvalidOperationException("Device is not initialized");
+            }
+
+            CheckResult(StartRxFlowErrorStats(ref ptr, intervalMs, fields, history));
+        }
+
+        /// <summary>
+        /// Returns the rx flow error samples taken after the given sequence, along with the current sequence
+        /// </summary>
+        /// <param name="ptr"></param>
+        /// <param name="sinceSequence"></param>
+        /// <param name="skipZero">leaves out the flow interfaces without errors in a sample</param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static (uint sequence, Snapshot<InternalRxFlowStatsRecord> samples) GetRxFlowErrorStats(
+            IntPtr ptr,
+            uint sinceSequence,
+            bool skipZero)
+        {
+            if (ptr == IntPtr.Zero)
+            {
+                throw new InvalidOperationException("Device is not initialized");
+            }
+
+            CheckResult(GetRxFlowErrorStats(ref ptr, sinceSequence, skipZero ? 1 : 0, out var sequence, out var snapshotPtr));
+            try
+            {
+                return (sequence, Snapshot<InternalRxFlowStatsRecord>.FromPointer(snapshotPtr));
+            }
+            finally
+            {
+                Marshal.FreeCoTaskMem(snapshotPtr);
+            }
+        }
+
+        /// <summary>
+        /// Calls a snapshot query, copies the blob and frees it with a single call
+        /// </summary>
+        /// <param name="ptr"></param>
+        /// <param name="query"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        /// <summary>
+        /// Returns a copy of the raw snapshot blob of a device component, for <see cref="DeviceStateCache"/>
+        /// </summary>
+        /// <param name="ptr"></param>
+        /// <param name="section"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        internal static byte[] GetSnapshotBlob(IntPtr ptr, DeviceStateSection section)
+        {
+            if (ptr == IntPtr.Zero)
+            {
+                throw new InvalidOperationException("Device is not initialized");
+            }
+
+            var query = section switch
+            {
+                DeviceStateSection.RxChannels => (GetSnapshotDelegate)GetRxChannelsSnapshot,
+                DeviceStateSection.TxChannels => (GetSnapshotDelegate)GetTxChannelsSnapshot,
+                DeviceStateSection.TxLabels => (GetSnapshotDelegate)GetTxLabelsSnapshot,
+                _ => throw new ArgumentOutOfRangeException(nameof(section)),
+            };
+
+            CheckResult(query(ref ptr, out var snapshotPtr));
+            try
+            {
+                var header = Marshal.PtrToStructure<InternalSnapshotHeader>(snapshotPtr);
+                var blob = new byte[header.size];
+                Marshal.Copy(snapshotPtr, blob, 0, blob.Length);
+
+                return blob;
+            }
+            finally
+            {
+                Marshal.FreeCoTaskMem(snapshotPtr);
+            }
+        }
+
+        private static Snapshot<T> GetSnapshot<T>(IntPtr ptr, GetSnapshotDelegate query) where T : struct
+        {
+            if (ptr == IntPtr.Zero)
+            {
+                throw new InvalidOperationException("Device is not initialized");
+            }
+
+            CheckResult(query(ref ptr, out var snapshotPtr));
+            try
+            {
+                return Snapshot<T>.FromPointer(snapshotPtr);
+            }
+            finally
+            {
+                Marshal.FreeCoTaskMem(snapshotPtr);
+            }
+        }
+
         /// <summary>
         /// Closes device
         /// </summary>
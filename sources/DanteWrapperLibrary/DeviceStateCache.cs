@@ -0,0 +1,241 @@
+﻿using System;
+using System.IO;
+using System.IO.MemoryMappedFiles;
+using System.Linq;
+using System.Runtime.InteropServices;
+
+namespace DanteWrapperLibrary
+{
+    internal enum DeviceStateSection
+    {
+        RxChannels = 0,
+        TxChannels,
+        TxLabels,
+        Count,
+    }
+
+    /// <summary>
+    /// Keeps the last complete channel and label snapshots of every device in one memory-mapped file per device,
+    /// so a reopened device shows them, flagged stale, before it has resolved. <br/>
+    /// A file holds a header (magic, version, length, section count, then offset and size per section)
+    /// followed by the native snapshot blobs as they are; they only contain offsets
+    /// </summary>
+    public class DeviceStateCache
+    {
+        #region Properties
+
+        /// <summary>
+        /// "DRSC"
+        /// </summary>
+        private const uint Magic = 0x43535244;
+
+        /// <summary>
+        /// Bump whenever a snapshot record layout changes
+        /// </summary>
+        private const uint Version = 1;
+
+        private const int SectionCount = (int)DeviceStateSection.Count;
+        private const int HeaderSize = 16 + SectionCount * 8;
+
+        public string DirectoryPath { get; }
+
+        private object Lock { get; } = new object();
+
+        #endregion
+
+        #region Constructors
+
+        public DeviceStateCache(string directoryPath)
+        {
+            DirectoryPath = directoryPath ?? throw new ArgumentNullException(nameof(directoryPath));
+
+            Directory.CreateDirectory(directoryPath);
+        }
+
+        #endregion
+
+        #region Methods
+
+        /// <summary>
+        /// Forgets the stored state of a device
+        /// </summary>
+        /// <param name="deviceName"></param>
+        public void Remove(string deviceName)
+        {
+            lock (Lock)
+            {
+                File.Delete(GetPath(deviceName));
+            }
+        }
+
+        /// <summary>
+        /// Returns the stored snapshot blobs of a device, null for sections that are missing or damaged
+        /// </summary>
+        /// <param name="deviceName"></param>
+        /// <returns></returns>
+        internal byte[]?[] Load(string deviceName)
+        {
+            var sections = new byte[]?[SectionCount];
+            var path = GetPath(deviceName);
+
+            lock (Lock)
+            {
+                if (!File.Exists(path))
+                {
+                    return sections;
+                }
+
+                try
+                {
+                    var length = new FileInfo(path).Length;
+                    if (length < HeaderSize)
+                    {
+                        return sections;
+                    }
+
+                    using var file = MemoryMappedFile.CreateFromFile(path, FileMode.Open, null, 0, MemoryMappedFileAccess.Read);
+                    using var view = file.CreateViewAccessor(0, 0, MemoryMappedFileAccess.Read);
+                    if (view.ReadUInt32(0) != Magic ||
+                        view.ReadUInt32(4) != Version ||
+                        view.ReadUInt32(8) != length ||
+                        view.ReadUInt32(12) != SectionCount)
+                    {
+                        return sections;
+                    }
+
+                    for (var i = 0; i < SectionCount; i++)
+                    {
+                        var offset = view.ReadUInt32(16 + i * 8);
+                        var size = view.ReadUInt32(20 + i * 8);
+                        if (size == 0 || offset + (long)size > length || !IsValidSnapshot(view, length, offset, size))
+                        {
+                            continue;
+                        }
+
+                        var blob = new byte[size];
+                        view.ReadArray(offset, blob, 0, blob.Length);
+                        sections[i] = blob;
+                    }
+                }
+                catch (IOException)
+                {
+                }
+                catch (UnauthorizedAccessException)
+                {
+                }
+                catch (Exception)
+                {
+                    // Any other damage to the file is a miss as well
+                    Array.Clear(sections, 0, sections.Length);
+                }
+            }
+
+            return sections;
+        }
+
+        /// <summary>
+        /// Replaces the stored state of a device. The file is written aside and swapped in,
+        /// so a crash leaves either the old or the new state
+        /// </summary>
+        /// <param name="deviceName"></param>
+        /// <param name="sections">snapshot blob per <see cref="DeviceStateSection"/>, null if unknown</param>
+        /// <returns>false if the file could not be written</returns>
+        internal bool Store(string deviceName, byte[]?[] sections)
+        {
+            var path = GetPath(deviceName);
+            var temporaryPath = path + ".tmp";
+            var length = HeaderSize + sections.Sum(section => section?.Length ?? 0);
+
+            lock (Lock)
+            {
+                try
+                {
+                    using (var file = MemoryMappedFile.CreateFromFile(temporaryPath, FileMode.Create, null, length))
+                    using (var view = file.CreateViewAccessor(0, length))
+                    {
+                        view.Write(0, Magic);
+                        view.Write(4, Version);
+                        view.Write(8, (uint)length);
+                        view.Write(12, (uint)SectionCount);
+
+                        var offset = HeaderSize;
+                        for (var i = 0; i < SectionCount; i++)
+                        {
+                            var section = sections[i];
+                            var size = section?.Length ?? 0;
+
+                            view.Write(16 + i * 8, (uint)offset);
+                            view.Write(20 + i * 8, (uint)size);
+                            if (section != null)
+                            {
+                                view.WriteArray(offset, section, 0, size);
+                            }
+                            offset += size;
+                        }
+                    }
+
+                    if (File.Exists(path))
+                    {
+                        File.Replace(temporaryPath, path, null);
+                    }
+                    else
+                    {
+                        File.Move(temporaryPath, path);
+                    }
+
+                    return true;
+                }
+                catch (IOException)
+                {
+                    return false;
+                }
+                catch (UnauthorizedAccessException)
+                {
+                    return false;
+                }
+            }
+        }
+
+        private string GetPath(string deviceName)
+        {
+            // Dante names are case-insensitive
+            var invalid = Path.GetInvalidFileNameChars();
+            var fileName = new string(deviceName
+                .ToLowerInvariant()
+                .Select(c => invalid.Contains(c) ? '_' : c)
+                .ToArray());
+
+            return Path.Combine(DirectoryPath, fileName + ".drstate");
+        }
+
+        /// <summary>
+        /// Checks that the blob at <paramref name="offset"/> holds a snapshot header
+        /// and that every table of it lies within the blob, after the header
+        /// </summary>
+        /// <param name="view"></param>
+        /// <param name="length">length of the file</param>
+        /// <param name="offset"></param>
+        /// <param name="size"></param>
+        /// <returns></returns>
+        private static bool IsValidSnapshot(MemoryMappedViewAccessor view, long length, long offset, uint size)
+        {
+            var headerSize = Marshal.SizeOf<InternalSnapshotHeader>();
+            if (size < headerSize || offset + headerSize > length)
+            {
+                return false;
+            }
+
+            view.Read<InternalSnapshotHeader>(offset, out var header);
+
+            return header.size == size &&
+                header.records_offset >= headerSize &&
+                header.indices_offset >= headerSize &&
+                header.strings_offset >= headerSize &&
+                header.records_offset + (long)header.record_count * header.record_size <= size &&
+                header.indices_offset + (long)header.indices_count * sizeof(uint) <= size &&
+                header.strings_offset + (long)header.strings_size <= size;
+        }
+
+        #endregion
+    }
+}
@@ -0,0 +1,349 @@
+﻿using System;
+using System.Runtime.InteropServices;
+using System.Text;
+using System.Threading;
+
+namespace DanteWrapperLibrary
+{
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct InternalMeterRingHeader
+    {
+        public uint size;
+        public uint capacity;
+        public uint frame_size;
+        public uint frames_offset;
+        public uint devices_offset;
+        public ushort max_devices;
+        public ushort max_channels;
+        public uint head;
+        public uint truncated;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct InternalMeterFrameHeader
+    {
+        public uint sequence;
+        public ushort device;
+        public ushort seqnum;
+        public ushort num_tx;
+        public ushort num_rx;
+        public uint timestamp_ms;
+    }
+
+    /// <summary>
+    /// One metering message of a device, decoded to dBFS. Reused across reads to avoid allocations
+    /// </summary>
+    public class MeterFrame
+    {
+        /// <summary>
+        /// Position of the frame in the ring, increasing with every message of any device
+        /// </summary>
+        public uint Sequence { get; internal set; }
+
+        /// <summary>
+        /// Slot returned by <see cref="RoutingSession.SubscribeMetering"/>
+        /// </summary>
+        public int Device { get; internal set; }
+
+        /// <summary>
+        /// Conmon message sequence number
+        /// </summary>
+        public int MessageSequence { get; internal set; }
+
+        /// <summary>
+        /// Local clock in milliseconds, wraps
+        /// </summary>
+        public uint TimestampMs { get; internal set; }
+
+        public int TxCount { get; internal set; }
+        public int RxCount { get; internal set; }
+
+        /// <summary>
+        /// Peaks of the tx channels, the first <see cref="TxCount"/> are valid
+        /// </summary>
+        public float[] TxPeaks { get; }
+
+        /// <summary>
+        /// Peaks of the rx channels, the first <see cref="RxCount"/> are valid
+        /// </summary>
+        public float[] RxPeaks { get; }
+
+        public MeterFrame(int maxChannels)
+        {
+            TxPeaks = new float[maxChannels];
+            RxPeaks = new float[maxChannels];
+        }
+    }
+
+    /// <summary>
+    /// Native memory of one metering run, shared by its <see cref="MeterRing"/> and <see cref="MeterView"/>. <br/>
+    /// Every read enters it, and the session waits for the readers inside before freeing the memory
+    /// </summary>
+    internal sealed class MeterMemory
+    {
+        private readonly object Gate = new object();
+        private int Readers;
+        private bool Released;
+
+        /// <summary>
+        /// Keeps the memory alive until the returned reader is disposed
+        /// </summary>
+        /// <param name="objectName"></param>
+        /// <exception cref="ObjectDisposedException">metering was stopped</exception>
+        /// <returns></returns>
+        internal Reader Enter(string objectName)
+        {
+            lock (Gate)
+            {
+                if (Released)
+                {
+                    throw new ObjectDisposedException(objectName, "Metering was stopped");
+                }
+                Readers++;
+            }
+
+            return new Reader(this);
+        }
+
+        /// <summary>
+        /// Fails every later read and waits for the current ones. The memory can be freed afterwards
+        /// </summary>
+        internal void Release()
+        {
+            lock (Gate)
+            {
+                Released = true;
+                while (Readers > 0)
+                {
+                    Monitor.Wait(Gate);
+                }
+            }
+        }
+
+        private void Exit()
+        {
+            lock (Gate)
+            {
+                if (--Readers == 0 && Released)
+                {
+                    Monitor.PulseAll(Gate);
+                }
+            }
+        }
+
+        internal readonly struct Reader : IDisposable
+        {
+            private readonly MeterMemory Memory;
+
+            internal Reader(MeterMemory memory)
+            {
+                Memory = memory;
+            }
+
+            public void Dispose()
+            {
+                Memory.Exit();
+            }
+        }
+    }
+
+    /// <summary>
+    /// Native ring of decoded metering messages, read in place. <br/>
+    /// Frames are overwritten oldest first; reads copy a frame and fail if it was overwritten meanwhile.
+    /// After <see cref="RoutingSession.StopMetering"/> or disposing the session every member throws <see cref="ObjectDisposedException"/>
+    /// </summary>
+    public sealed class MeterRing
+    {
+        /// <summary>
+        /// DR_TEST_METER_CLIP_DB, above full scale: the device reported clipping
+        /// </summary>
+        public const float ClipDb = 0.5f;
+
+        /// <summary>
+        /// DR_TEST_METER_MUTE_DB, muted or no signal
+        /// </summary>
+        public const float MuteDb = -127.0f;
+
+        private const int MaxAttempts = 4;
+
+        // dr_test_meter_ring_t, dr_test_meter_device_t and dr_test_meter_frame_t
+        private static readonly int HeadOffset = Marshal.OffsetOf<InternalMeterRingHeader>(nameof(InternalMeterRingHeader.head)).ToInt32();
+        private static readonly int TruncatedOffset = Marshal.OffsetOf<InternalMeterRingHeader>(nameof(InternalMeterRingHeader.truncated)).ToInt32();
+        private static readonly int FrameHeaderSize = Marshal.SizeOf<InternalMeterFrameHeader>();
+        private const int DeviceSize = 40;
+        private const int DeviceStatusOffset = 4;
+        private const int DeviceInUseOffset = 6;
+        private const int DeviceNameOffset = 8;
+        private const int DeviceNameLength = 32;
+
+        private IntPtr Ptr { get; }
+        private MeterMemory Memory { get; }
+        private long FramesOffset { get; }
+        private long DevicesOffset { get; }
+        private int FrameSize { get; }
+
+        public int Capacity { get; }
+        public int MaxDevices { get; }
+        public int MaxChannels { get; }
+
+        /// <summary>
+        /// Frames written so far
+        /// </summary>
+        public uint Head
+        {
+            get
+            {
+                using var reader = Memory.Enter(nameof(MeterRing));
+                return (uint)Marshal.ReadInt32(Ptr, HeadOffset);
+            }
+        }
+
+        /// <summary>
+        /// Messages with more channels than <see cref="MaxChannels"/>, cut to fit
+        /// </summary>
+        public uint Truncated
+        {
+            get
+            {
+                using var reader = Memory.Enter(nameof(MeterRing));
+                return (uint)Marshal.ReadInt32(Ptr, TruncatedOffset);
+            }
+        }
+
+        internal MeterRing(IntPtr ptr, MeterMemory memory)
+        {
+            var header = Marshal.PtrToStructure<InternalMeterRingHeader>(ptr);
+
+            Ptr = ptr;
+            Memory = memory;
+            Capacity = (int)header.capacity;
+            MaxDevices = header.max_devices;
+            MaxChannels = header.max_channels;
+            FrameSize = (int)header.frame_size;
+            FramesOffset = header.frames_offset;
+            DevicesOffset = header.devices_offset;
+        }
+
+        public MeterFrame CreateFrame()
+        {
+            return new MeterFrame(MaxChannels);
+        }
+
+        public bool IsSubscribed(int device)
+        {
+            using var reader = Memory.Enter(nameof(MeterRing));
+            return Marshal.ReadInt16(DevicePtr(device), DeviceInUseOffset) != 0;
+        }
+
+        /// <summary>
+        /// conmon_rxstatus_t of the metering subscription, 0x11..0x13 while metering is received
+        /// </summary>
+        /// <param name="device"></param>
+        /// <returns></returns>
+        public int GetStatus(int device)
+        {
+            using var reader = Memory.Enter(nameof(MeterRing));
+            return (ushort)Marshal.ReadInt16(DevicePtr(device), DeviceStatusOffset);
+        }
+
+        public string GetDeviceName(int device)
+        {
+            var name = new byte[DeviceNameLength];
+            using (Memory.Enter(nameof(MeterRing)))
+            {
+                Marshal.Copy(DevicePtr(device) + DeviceNameOffset, name, 0, name.Length);
+            }
+
+            var end = Array.IndexOf(name, (byte)0);
+            return Encoding.UTF8.GetString(name, 0, end < 0 ? name.Length : end);
+        }
+
+        /// <summary>
+        /// Copies the latest frame of the device into <paramref name="frame"/>
+        /// </summary>
+        /// <param name="device"></param>
+        /// <param name="frame"></param>
+        /// <returns>false if the device has no frame yet, or it kept changing while read</returns>
+        public bool TryReadLatest(int device, MeterFrame frame)
+        {
+            using var reader = Memory.Enter(nameof(MeterRing));
+            var devicePtr = DevicePtr(device);
+            for (var attempt = 0; attempt < MaxAttempts; attempt++)
+            {
+                var sequence = (uint)Marshal.ReadInt32(devicePtr);
+                if (sequence == 0)
+                {
+                    return false;
+                }
+                if (ReadFrame(sequence, frame))
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        /// <summary>
+        /// Copies frame <paramref name="sequence"/> into <paramref name="frame"/>. 
+        /// Frames from <see cref="Head"/> - <see cref="Capacity"/> + 1 up to <see cref="Head"/> can be read
+        /// </summary>
+        /// <param name="sequence"></param>
+        /// <param name="frame"></param>
+        /// <returns>false if the frame was overwritten</returns>
+        public bool TryReadFrame(uint sequence, MeterFrame frame)
+        {
+            using var reader = Memory.Enter(nameof(MeterRing));
+            return ReadFrame(sequence, frame);
+        }
+
+        private bool ReadFrame(uint sequence, MeterFrame frame)
+        {
+            if (sequence == 0)
+            {
+                return false;
+            }
+
+            var framePtr = new IntPtr(Ptr.ToInt64() + FramesOffset + (long)((sequence - 1) & (uint)(Capacity - 1)) * FrameSize);
+            if ((uint)Marshal.ReadInt32(framePtr) != sequence)
+            {
+                return false;
+            }
+
+            // read the contents only after seeing the sequence
+            Thread.MemoryBarrier();
+            var header = Marshal.PtrToStructure<InternalMeterFrameHeader>(framePtr);
+            var txCount = Math.Min((int)header.num_tx, MaxChannels);
+            var rxCount = Math.Min((int)header.num_rx, MaxChannels);
+            var peaksPtr = framePtr + FrameHeaderSize;
+            Marshal.Copy(peaksPtr, frame.TxPeaks, 0, txCount);
+            Marshal.Copy(peaksPtr + MaxChannels * sizeof(float), frame.RxPeaks, 0, rxCount);
+
+            // the copy is consistent if the frame wasn't rewritten meanwhile
+            Thread.MemoryBarrier();
+            if ((uint)Marshal.ReadInt32(framePtr) != sequence)
+            {
+                return false;
+            }
+
+            frame.Sequence = sequence;
+            frame.Device = header.device;
+            frame.MessageSequence = header.seqnum;
+            frame.TimestampMs = header.timestamp_ms;
+            frame.TxCount = txCount;
+            frame.RxCount = rxCount;
+
+            return true;
+        }
+
+        private IntPtr DevicePtr(int device)
+        {
+            if (device < 0 || device >= MaxDevices)
+            {
+                throw new ArgumentOutOfRangeException(nameof(device));
+            }
+
+            return new IntPtr(Ptr.ToInt64() + DevicesOffset + (long)device * DeviceSize);
+        }
+    }
+}
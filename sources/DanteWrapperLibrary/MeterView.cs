@@ -0,0 +1,289 @@
+﻿using System;
+using System.Runtime.InteropServices;
+using System.Threading;
+
+namespace DanteWrapperLibrary
+{
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct InternalMeterBallistics
+    {
+        public uint rate_hz;
+        public float attack_ms;
+        public float release_db_per_s;
+        public float hold_ms;
+        public float hold_decay_db_per_s;
+        public float clip_hold_ms;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct InternalMeterViewHeader
+    {
+        public uint size;
+        public uint frame_size;
+        public uint frames_offset;
+        public ushort max_devices;
+        public ushort max_channels;
+        public uint rate_hz;
+        public uint head;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct InternalMeterViewFrameHeader
+    {
+        public uint sequence;
+        public uint timestamp_ms;
+        public uint interval_ms;
+        public uint reserved;
+    }
+
+    public enum MeterDirection
+    {
+        Tx = 0,
+        Rx = 1,
+    }
+
+    /// <summary>
+    /// How <see cref="RoutingSession.SetMeterBallistics"/> turns metering messages into meter levels
+    /// </summary>
+    public class MeterBallistics
+    {
+        /// <summary>
+        /// Frames published per second, 0 stops publishing
+        /// </summary>
+        public int Rate { get; set; } = 30;
+
+        /// <summary>
+        /// Time constant of a rising level, zero for instant
+        /// </summary>
+        public TimeSpan Attack { get; set; } = TimeSpan.FromMilliseconds(10);
+
+        public float ReleaseDbPerSecond { get; set; } = 20.0f;
+
+        /// <summary>
+        /// How long the hold value keeps a peak before it falls
+        /// </summary>
+        public TimeSpan Hold { get; set; } = TimeSpan.FromSeconds(1);
+
+        public float HoldDecayDbPerSecond { get; set; } = 40.0f;
+
+        /// <summary>
+        /// How long a clip stays latched, zero until <see cref="RoutingSession.ClearMeterClips"/>
+        /// </summary>
+        public TimeSpan ClipHold { get; set; } = TimeSpan.Zero;
+
+        internal InternalMeterBallistics ToInternal()
+        {
+            return new InternalMeterBallistics
+            {
+                rate_hz = (uint)Rate,
+                attack_ms = (float)Attack.TotalMilliseconds,
+                release_db_per_s = ReleaseDbPerSecond,
+                hold_ms = (float)Hold.TotalMilliseconds,
+                hold_decay_db_per_s = HoldDecayDbPerSecond,
+                clip_hold_ms = (float)ClipHold.TotalMilliseconds,
+            };
+        }
+    }
+
+    /// <summary>
+    /// Meter levels of every device slot and channel at one instant, 4 bytes per channel.
+    /// Reused across reads to avoid allocations
+    /// </summary>
+    public class MeterViewFrame
+    {
+        /// <summary>
+        /// DR_TEST_METER_VIEW_MUTE
+        /// </summary>
+        private const byte Mute = 254;
+
+        /// <summary>
+        /// DR_TEST_METER_VIEW_CLIP and DR_TEST_METER_VIEW_CLIP_LATCHED
+        /// </summary>
+        private const byte ClipFlag = 0x01;
+        private const byte ClipLatchedFlag = 0x02;
+
+        private int MaxChannels { get; }
+
+        public uint Sequence { get; internal set; }
+
+        /// <summary>
+        /// Local clock in milliseconds, wraps
+        /// </summary>
+        public uint TimestampMs { get; internal set; }
+
+        public TimeSpan Interval { get; internal set; }
+
+        /// <summary>
+        /// dr_test_meter_view_channel_t per device slot, direction and channel
+        /// </summary>
+        internal byte[] Channels { get; }
+
+        public MeterViewFrame(int maxDevices, int maxChannels)
+        {
+            MaxChannels = maxChannels;
+            Channels = new byte[maxDevices * 2 * maxChannels * 4];
+        }
+
+        /// <summary>
+        /// Level after ballistics in dBFS, <see cref="MeterRing.MuteDb"/> when muted
+        /// </summary>
+        public float GetLevel(int device, MeterDirection direction, int channel)
+        {
+            return ToDb(Channels[Offset(device, direction, channel)]);
+        }
+
+        /// <summary>
+        /// Held peak in dBFS, <see cref="MeterRing.MuteDb"/> when muted
+        /// </summary>
+        public float GetHold(int device, MeterDirection direction, int channel)
+        {
+            return ToDb(Channels[Offset(device, direction, channel) + 1]);
+        }
+
+        /// <summary>
+        /// True if the channel clipped since the previous frame
+        /// </summary>
+        public bool IsClipping(int device, MeterDirection direction, int channel)
+        {
+            return (Channels[Offset(device, direction, channel) + 2] & ClipFlag) != 0;
+        }
+
+        /// <summary>
+        /// True if the channel clipped since its clips were cleared, or within <see cref="MeterBallistics.ClipHold"/>
+        /// </summary>
+        public bool IsClipLatched(int device, MeterDirection direction, int channel)
+        {
+            return (Channels[Offset(device, direction, channel) + 2] & ClipLatchedFlag) != 0;
+        }
+
+        private int Offset(int device, MeterDirection direction, int channel)
+        {
+            if (channel < 0 || channel >= MaxChannels)
+            {
+                throw new ArgumentOutOfRangeException(nameof(channel));
+            }
+
+            return ((device * 2 + (int)direction) * MaxChannels + channel) * 4;
+        }
+
+        private static float ToDb(byte level)
+        {
+            return level >= Mute ? MeterRing.MuteDb : level * -0.5f;
+        }
+    }
+
+    /// <summary>
+    /// Native meter frames published at the ballistics rate, read in place. <br/>
+    /// After <see cref="RoutingSession.StopMetering"/> or disposing the session every member throws <see cref="ObjectDisposedException"/>
+    /// </summary>
+    public sealed class MeterView
+    {
+        /// <summary>
+        /// DR_TEST_METER_VIEW_FRAMES
+        /// </summary>
+        private const int Frames = 3;
+        private const int MaxAttempts = 4;
+
+        private static readonly int HeadOffset = Marshal.OffsetOf<InternalMeterViewHeader>(nameof(InternalMeterViewHeader.head)).ToInt32();
+        private static readonly int RateOffset = Marshal.OffsetOf<InternalMeterViewHeader>(nameof(InternalMeterViewHeader.rate_hz)).ToInt32();
+        private static readonly int FrameHeaderSize = Marshal.SizeOf<InternalMeterViewFrameHeader>();
+
+        private IntPtr Ptr { get; }
+        private MeterMemory Memory { get; }
+        private long FramesOffset { get; }
+        private int FrameSize { get; }
+
+        public int MaxDevices { get; }
+        public int MaxChannels { get; }
+
+        /// <summary>
+        /// Frames per second, 0 while not publishing
+        /// </summary>
+        public int Rate
+        {
+            get
+            {
+                using var reader = Memory.Enter(nameof(MeterView));
+                return Marshal.ReadInt32(Ptr, RateOffset);
+            }
+        }
+
+        /// <summary>
+        /// Frames published so far
+        /// </summary>
+        public uint Head
+        {
+            get
+            {
+                using var reader = Memory.Enter(nameof(MeterView));
+                return ReadHead();
+            }
+        }
+
+        internal MeterView(IntPtr ptr, MeterMemory memory)
+        {
+            var header = Marshal.PtrToStructure<InternalMeterViewHeader>(ptr);
+
+            Ptr = ptr;
+            Memory = memory;
+            FramesOffset = header.frames_offset;
+            FrameSize = (int)header.frame_size;
+            MaxDevices = header.max_devices;
+            MaxChannels = header.max_channels;
+        }
+
+        public MeterViewFrame CreateFrame()
+        {
+            return new MeterViewFrame(MaxDevices, MaxChannels);
+        }
+
+        /// <summary>
+        /// Copies the latest frame into <paramref name="frame"/>, once per UI tick
+        /// </summary>
+        /// <param name="frame"></param>
+        /// <returns>false if nothing was published yet, or frames kept changing while read</returns>
+        public bool TryReadLatest(MeterViewFrame frame)
+        {
+            using var reader = Memory.Enter(nameof(MeterView));
+            for (var attempt = 0; attempt < MaxAttempts; attempt++)
+            {
+                var sequence = ReadHead();
+                if (sequence == 0)
+                {
+                    return false;
+                }
+
+                var framePtr = new IntPtr(Ptr.ToInt64() + FramesOffset + (long)((sequence - 1) % Frames) * FrameSize);
+                if ((uint)Marshal.ReadInt32(framePtr) != sequence)
+                {
+                    continue;
+                }
+
+                // read the contents only after seeing the sequence
+                Thread.MemoryBarrier();
+                var header = Marshal.PtrToStructure<InternalMeterViewFrameHeader>(framePtr);
+                Marshal.Copy(framePtr + FrameHeaderSize, frame.Channels, 0, frame.Channels.Length);
+
+                // the copy is consistent if the frame wasn't rewritten meanwhile
+                Thread.MemoryBarrier();
+                if ((uint)Marshal.ReadInt32(framePtr) != sequence)
+                {
+                    continue;
+                }
+
+                frame.Sequence = sequence;
+                frame.TimestampMs = header.timestamp_ms;
+                frame.Interval = TimeSpan.FromMilliseconds(header.interval_ms);
+
+                return true;
+            }
+
+            return false;
+        }
+
+        private uint ReadHead()
+        {
+            return (uint)Marshal.ReadInt32(Ptr, HeadOffset);
+        }
+    }
+}
@@ -0,0 +1,35 @@
+﻿namespace DanteWrapperLibrary
+{
+    /// <summary>
+    /// A "TxChannel@TxDevice" subscription target resolved by <see cref="RoutingSession.ResolveChannels"/>
+    /// </summary>
+    public class ResolvedChannel
+    {
+        public string Target { get; }
+
+        public string DeviceName { get; }
+
+        /// <summary>
+        /// Tx channel number on <see cref="DeviceName"/>
+        /// </summary>
+        public int ChannelId { get; }
+
+        /// <summary>
+        /// True if the target names a tx label rather than the channel itself
+        /// </summary>
+        public bool IsLabel { get; }
+
+        public ResolvedChannel(string target, string deviceName, int channelId, bool isLabel)
+        {
+            Target = target;
+            DeviceName = deviceName;
+            ChannelId = channelId;
+            IsLabel = isLabel;
+        }
+
+        public override string ToString()
+        {
+            return $"{Target} -> {DeviceName} channel {ChannelId}{(IsLabel ? " (label)" : string.Empty)}";
+        }
+    }
+}
@@ -0,0 +1,181 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Linq;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace DanteWrapperLibrary
+{
+    /// <summary>
+    /// Progress of one device during <see cref="RoutingApply.RunAsync"/>
+    /// </summary>
+    public class RoutingApplyProgress
+    {
+        public RoutingDevice Device { get; }
+
+        public int CompletedEntries { get; }
+
+        public int FailedEntries { get; }
+
+        public int TotalEntries { get; }
+
+        public RoutingApplyProgress(RoutingDevice device, int completedEntries, int failedEntries, int totalEntries)
+        {
+            Device = device;
+            CompletedEntries = completedEntries;
+            FailedEntries = failedEntries;
+            TotalEntries = totalEntries;
+        }
+
+        public override string ToString()
+        {
+            return $"{Device.Name}: {CompletedEntries}/{TotalEntries} ({FailedEntries} failed)";
+        }
+    }
+
+    /// <summary>
+    /// Outcome of one device of <see cref="RoutingApply.RunAsync"/>
+    /// </summary>
+    public class RoutingDeviceApplyResult
+    {
+        public RoutingDevice Device { get; }
+
+        /// <summary>
+        /// Null if the request could not be sent, see <see cref="Exception"/>
+        /// </summary>
+        public BulkRoutingResult? Result { get; }
+
+        public Exception? Exception { get; }
+
+        /// <summary>
+        /// From the start of the apply until the device answered every batch
+        /// </summary>
+        public TimeSpan Latency { get; }
+
+        public bool IsSuccess => Exception == null && Result != null && Result.IsSuccess;
+
+        public RoutingDeviceApplyResult(RoutingDevice device, BulkRoutingResult? result, Exception? exception, TimeSpan latency)
+        {
+            Device = device;
+            Result = result;
+            Exception = exception;
+            Latency = latency;
+        }
+
+        public override string ToString()
+        {
+            var outcome = Exception != null ? Exception.Message : Result?.ToString();
+            return $"{Device.Name}: {outcome} after {Latency.TotalMilliseconds:F0} ms";
+        }
+    }
+
+    public class RoutingApplyResult
+    {
+        public TimeSpan WallTime { get; }
+
+        public IReadOnlyList<RoutingDeviceApplyResult> Devices { get; }
+
+        public bool IsSuccess => Devices.All(device => device.IsSuccess);
+
+        public RoutingDeviceApplyResult? SlowestDevice => Devices
+            .OrderByDescending(device => device.Latency)
+            .FirstOrDefault();
+
+        public RoutingApplyResult(TimeSpan wallTime, IReadOnlyList<RoutingDeviceApplyResult> devices)
+        {
+            WallTime = wallTime;
+            Devices = devices;
+        }
+
+        public override string ToString()
+        {
+            return $"{Devices.Count} devices in {WallTime.TotalMilliseconds:F0} ms, " +
+                $"{Devices.Count(device => !device.IsSuccess)} failed";
+        }
+    }
+
+    /// <summary>
+    /// Sends the batches of a <see cref="RoutingPlanDiff"/> to all its devices at once. <br/>
+    /// Throttling is native: each device stays within the request limit of its environment, 
+    /// devices of a <see cref="RoutingSession"/> also share <see cref="RoutingSession.SetBulkBudget"/>.
+    /// The wall time is bound by the slowest device rather than the sum of all devices
+    /// </summary>
+    public class RoutingApply
+    {
+        #region Properties
+
+        public RoutingPlanDiff Diff { get; }
+
+        #endregion
+
+        #region Events
+
+        /// <summary>
+        /// Raised whenever a batch of a device completes, possibly concurrently
+        /// and on the thread stepping the device. Handlers must not throw
+        /// </summary>
+        public event EventHandler<RoutingApplyProgress>? ProgressChanged;
+
+        private void OnProgressChanged(RoutingApplyProgress value)
+        {
+            ProgressChanged?.Invoke(this, value);
+        }
+
+        #endregion
+
+        #region Constructors
+
+        public RoutingApply(RoutingPlanDiff diff)
+        {
+            Diff = diff ?? throw new ArgumentNullException(nameof(diff));
+        }
+
+        #endregion
+
+        #region Methods
+
+        public async Task<RoutingApplyResult> RunAsync()
+        {
+            var stopwatch = Stopwatch.StartNew();
+
+            var devices = await Task.WhenAll(Diff.Batches
+                .Select(pair => ApplyAsync(pair.Key, pair.Value, stopwatch))
+                .ToArray()).ConfigureAwait(false);
+
+            return new RoutingApplyResult(stopwatch.Elapsed, devices);
+        }
+
+        private async Task<RoutingDeviceApplyResult> ApplyAsync(
+            RoutingDevice device,
+            IReadOnlyList<(int Number, string? TxChannel, string? TxDevice)> batch,
+            Stopwatch stopwatch)
+        {
+            var completed = 0;
+            var failed = 0;
+
+            void OnChunkCompleted(BulkChunkResult chunk)
+            {
+                var failedNow = chunk.IsSuccess
+                    ? Volatile.Read(ref failed)
+                    : Interlocked.Add(ref failed, chunk.Count);
+                var completedNow = Interlocked.Add(ref completed, chunk.Count);
+
+                OnProgressChanged(new RoutingApplyProgress(device, completedNow, failedNow, batch.Count));
+            }
+
+            try
+            {
+                var result = await device.SubscribeRxChannels(batch, OnChunkCompleted).ConfigureAwait(false);
+
+                return new RoutingDeviceApplyResult(device, result, null, stopwatch.Elapsed);
+            }
+            catch (Exception exception)
+            {
+                return new RoutingDeviceApplyResult(device, null, exception, stopwatch.Elapsed);
+            }
+        }
+
+        #endregion
+    }
+}
@@ -1,23 +1,84 @@
 ﻿using System;
 using System.Collections.Generic;
 using System.Linq;
+using System.Runtime.InteropServices;
+using System.Threading.Tasks;
 using DanteWrapperLibrary.Utilities;
 
 namespace DanteWrapperLibrary
 {
+    /// <summary>
+    /// A device connection. Methods can be called from any thread, 
+    /// the native side runs them on the thread stepping the device
+    /// </summary>
     public class RoutingDevice : IDisposable
     {
         #region Properties
 
         public string Name { get; }
 
+        /// <summary>
+        /// The session the device is opened in, or null if it has its own environment
+        /// </summary>
+        public RoutingSession? Session { get; }
+
+        /// <summary>
+        /// Where the last known channels and labels of the device are kept across restarts, or null
+        /// </summary>
+        public DeviceStateCache? StateCache { get; }
+
         private IntPtr IntPtr { get; set; } = IntPtr.Zero;
         private TaskWorker TaskWorker { get; } = new TaskWorker();
+        private GCHandle GCHandle { get; set; }
+        private InternalRoutingEvent[] EventBuffer { get; } = new InternalRoutingEvent[256];
+
+        /// <summary>
+        /// Total number of native events lost because they were not drained in time
+        /// </summary>
+        public uint DroppedEventCount { get; private set; }
+
+        // Requests waiting for their completion event, by token
+        private Dictionary<ulong, TaskCompletionSource<RoutingResult>> PendingRequests { get; } =
+            new Dictionary<ulong, TaskCompletionSource<RoutingResult>>();
+
+        // Completions that arrived while a request was being sent, before its token was registered.
+        // Guarded by PendingRequests, cleared once no send is in flight
+        private Dictionary<ulong, RoutingResult> EarlyResults { get; } =
+            new Dictionary<ulong, RoutingResult>();
+        private int SendsInFlight { get; set; }
+
+        // Batch results of bulk requests, by token, until the request completes. Guarded by PendingRequests
+        private Dictionary<ulong, List<BulkChunkResult>> ChunkResults { get; } =
+            new Dictionary<ulong, List<BulkChunkResult>>();
+
+        // Per batch callbacks of bulk requests, by token. Guarded by PendingRequests
+        private Dictionary<ulong, Action<BulkChunkResult>> ChunkCallbacks { get; } =
+            new Dictionary<ulong, Action<BulkChunkResult>>();
+
+        // Snapshot blobs per DeviceStateSection, loaded from StateCache and replaced by live ones.
+        // Guarded by itself, as are FreshComponents and StateVersion
+        private byte[]?[] StateSections { get; } = new byte[]?[(int)DeviceStateSection.Count];
+
+        // Components the device is active with and has no stale data for, from the last device event
+        private DeviceComponents FreshComponents { get; set; } = DeviceComponents.None;
+
+        // Bumped whenever StateSections change; StoredStateVersion is the one last written to StateCache.
+        // Stores happen outside the StateSections lock and are serialized by StoreLock
+        private ulong StateVersion { get; set; }
+        private ulong StoredStateVersion { get; set; }
+        private object StoreLock { get; } = new object();
+
+        // One delegate for all devices, kept alive for the lifetime of the process
+        private static DanteRoutingApi.EventCallbackDelegate EventCallback { get; } = OnNativeEventsPending;
 
         #endregion
 
         #region Events
 
+        /// <summary>
+        /// Raised after every step of a device with its own environment.
+        /// Devices of a <see cref="RoutingSession"/> are stepped natively and only raise events
+        /// </summary>
         public event EventHandler? StepOccurred;
 
         private void OnStepOccurred()
@@ -25,27 +86,38 @@ namespace DanteWrapperLibrary
             StepOccurred?.Invoke(this, EventArgs.Empty);
         }
 
-        public event EventHandler<string>? EventOccurred;
+        public event EventHandler<RoutingEvent>? EventOccurred;
 
-        private void OnEventOccurred(string value)
+        private void OnEventOccurred(RoutingEvent value)
         {
-            EventOccurred?.Invoke(null, value);
+            EventOccurred?.Invoke(this, value);
         }
 
-        public event EventHandler<string>? DomainEventOccurred;
+        public event EventHandler<RoutingEvent>? DomainEventOccurred;
 
-        private void OnDomainEventOccurred(string value)
+        private void OnDomainEventOccurred(RoutingEvent value)
         {
-            DomainEventOccurred?.Invoke(null, value);
+            DomainEventOccurred?.Invoke(this, value);
         }
 
         #endregion
 
         #region Constructors
 
-        public RoutingDevice(string name)
+        /// <summary>
+        /// The device is opened by <see cref="Initialize"/>
+        /// </summary>
+        /// <param name="name"></param>
+        /// <param name="stateCache">serves the channels and labels of the previous run until the device has them</param>
+        public RoutingDevice(string name, DeviceStateCache? stateCache = null)
         {
             Name = name ?? throw new ArgumentNullException(nameof(name));
+            StateCache = stateCache;
+        }
+
+        internal RoutingDevice(string name, RoutingSession session, DeviceStateCache? stateCache) : this(name, stateCache)
+        {
+            Session = session ?? throw new ArgumentNullException(nameof(session));
         }
 
         #endregion
@@ -59,25 +131,26 @@ namespace DanteWrapperLibrary
                 return;
             }
 
-            IntPtr = DanteRoutingApi.OpenDevice(Name);
+            IntPtr = Session == null
+                ? DanteRoutingApi.OpenDevice(Name)
+                : DanteRoutingApi.OpenSessionDevice(Session.IntPtr, Name);
 
-            DanteRoutingApi.DeviceEventOccurred += (sender, tuple) =>
-            {
-                if (IntPtr != IntPtr.Zero && sender is IntPtr intPtr && intPtr == IntPtr && tuple.name == Name)
-                {
-                    OnEventOccurred(tuple.text);
-                }
-            };
-            DanteRoutingApi.DomainEventOccurred += (sender, text) =>
+            if (StateCache != null)
             {
-                if (IntPtr != IntPtr.Zero && sender is IntPtr intPtr && intPtr == IntPtr)
+                lock (StateSections)
                 {
-                    OnDomainEventOccurred(text);
+                    Array.Copy(StateCache.Load(Name), StateSections, StateSections.Length);
                 }
-            };
+            }
+
+            GCHandle = GCHandle.Alloc(this);
+            DanteRoutingApi.SetEventCallback(IntPtr, EventCallback, GCHandle.ToIntPtr(GCHandle));
 
-            DanteRoutingApi.InitializeDomainEvents();
-            DanteRoutingApi.InitializeDeviceEvents();
+            if (Session != null)
+            {
+                // The session loop steps the shared environment
+                return;
+            }
 
             TaskWorker.Start(cancellationToken =>
             {
@@ -90,62 +163,324 @@ namespace DanteWrapperLibrary
             });
         }
 
+        /// <summary>
+        /// With a <see cref="StateCache"/>, returns the stored channels flagged stale until the device has them
+        /// </summary>
+        /// <returns></returns>
         public IList<RxChannelInfo> GetRxChannels()
         {
-            return DanteRoutingApi.ProcessLineAndGetStructureArray<InternalRxChannelInfo>(IntPtr, "r")
-                .Select(info => new RxChannelInfo(
-                    info.id,
-                    Convert.ToBoolean(info.stale),
-                    info.name,
-                    info.format,
-                    info.latency,
-                    Convert.ToBoolean(info.muted),
-                    info.dbu,
-                    info.sub,
-                    info.status,
-                    info.flow))
-                .ToArray();
+            if (StateCache == null)
+            {
+                return ToRxChannelInfos(DanteRoutingApi.GetRxChannelsSnapshot(IntPtr));
+            }
+
+            var snapshot = GetStateSnapshot<InternalRxChannelRecord>(
+                DeviceStateSection.RxChannels, DeviceComponents.RxChannels, out var isCached);
+
+            return ToRxChannelInfos(snapshot, isCached);
+        }
+
+        /// <summary>
+        /// Completes when the device has answered the request
+        /// </summary>
+        /// <param name="number"></param>
+        /// <param name="name"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        public Task<RoutingResult> SetRxChannelName(int number, string name)
+        {
+            return SendRequest(() => DanteRoutingApi.SetRxChannelName(IntPtr, number, name));
+        }
+
+        /// <summary>
+        /// Renames many rx channels at once. Completes when the device has answered every batch,
+        /// the result is the first failure if any
+        /// </summary>
+        /// <param name="names">channel number and new name, null or empty clears the name</param>
+        /// <exception cref="ArgumentException"></exception>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        public Task<RoutingResult> SetRxChannelNames(IReadOnlyList<(int Number, string? Name)> names)
+        {
+            if (names == null || names.Count == 0)
+            {
+                throw new ArgumentException("At least one channel is required", nameof(names));
+            }
+
+            var channels = names.Select(pair => pair.Number).ToArray();
+            var values = names.Select(pair => pair.Name).ToArray();
+
+            return SendRequest(() => DanteRoutingApi.SetRxChannelNames(IntPtr, channels, values));
         }
 
-        public void SetRxChannelName(int number, string name)
+        /// <summary>
+        /// Subscribes many rx channels at once. Completes when the device has answered every batch,
+        /// with the result of each batch
+        /// </summary>
+        /// <param name="subscriptions">rx channel number and "TxChannel@TxDevice", null or empty unsubscribes</param>
+        /// <param name="chunkCompleted">called for every batch before the task completes, 
+        /// possibly concurrently and on the thread stepping the device. Must not throw</param>
+        /// <exception cref="ArgumentException"></exception>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        public Task<BulkRoutingResult> SubscribeRxChannels(
+            IReadOnlyList<(int Number, string? TxChannel, string? TxDevice)> subscriptions,
+            Action<BulkChunkResult>? chunkCompleted = null)
         {
-            DanteRoutingApi.ProcessLine(IntPtr, $"r {number} \"{name}\"");
+            if (subscriptions == null || subscriptions.Count == 0)
+            {
+                throw new ArgumentException("At least one channel is required", nameof(subscriptions));
+            }
+
+            var channels = subscriptions.Select(tuple => tuple.Number).ToArray();
+            var txChannels = subscriptions.Select(tuple => tuple.TxChannel).ToArray();
+            var txDevices = subscriptions.Select(tuple => tuple.TxDevice).ToArray();
+
+            return ToBulkResult(SendRequest(() =>
+                DanteRoutingApi.SubscribeRxChannels(IntPtr, channels, txChannels, txDevices), chunkCompleted));
+        }
+
+        /// <summary>
+        /// Returns the subscriptions that differ from the current state of the device,
+        /// in their original order. Channels whose state is stale are always included
+        /// </summary>
+        /// <param name="subscriptions">rx channel number and "TxChannel@TxDevice", null or empty means unsubscribed</param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        public IReadOnlyList<(int Number, string? TxChannel, string? TxDevice)> DiffSubscriptions(
+            IReadOnlyList<(int Number, string? TxChannel, string? TxDevice)> subscriptions)
+        {
+            if (subscriptions == null || subscriptions.Count == 0)
+            {
+                return Array.Empty<(int, string?, string?)>();
+            }
+
+            var changed = DanteRoutingApi.DiffSubscriptions(
+                IntPtr,
+                subscriptions.Select(tuple => tuple.Number).ToArray(),
+                subscriptions.Select(tuple => tuple.TxChannel).ToArray(),
+                subscriptions.Select(tuple => tuple.TxDevice).ToArray());
+
+            return changed.Select(i => subscriptions[i]).ToArray();
         }
 
+        /// <summary>
+        /// With a <see cref="StateCache"/>, returns the stored channels flagged stale until the device has them
+        /// </summary>
+        /// <returns></returns>
         public IList<TxChannelInfo> GetTxChannels()
         {
-            return DanteRoutingApi.ProcessLineAndGetStructureArray<InternalTxChannelInfo>(IntPtr, "t")
-                .Select(info => new TxChannelInfo(
-                    info.id,
-                    Convert.ToBoolean(info.stale),
-                    info.name,
-                    info.format,
-                    Convert.ToBoolean(info.enabled),
-                    Convert.ToBoolean(info.muted),
-                    info.dbu))
-                .ToArray();
+            if (StateCache == null)
+            {
+                return ToTxChannelInfos(DanteRoutingApi.GetTxChannelsSnapshot(IntPtr));
+            }
+
+            var snapshot = GetStateSnapshot<InternalTxChannelRecord>(
+                DeviceStateSection.TxChannels, DeviceComponents.TxChannels, out var isCached);
+
+            return ToTxChannelInfos(snapshot, isCached);
         }
 
-        public void SetSxChannelName(int number, string name)
+        /// <summary>
+        /// Returns only the channels that changed after <paramref name="sinceGeneration"/>.
+        /// Pass <see cref="ChannelChanges.Generation"/> of the previous result to the next call,
+        /// 0 returns all channels. When <see cref="ChannelChanges.IsFullResync"/> is set the result
+        /// holds all channels and replaces what earlier results returned.
+        /// </summary>
+        /// <param name="sinceGeneration"></param>
+        /// <returns></returns>
+        public ChannelChanges GetChannelChanges(uint sinceGeneration)
         {
-            DanteRoutingApi.ProcessLine(IntPtr, $"s {number} \"{name}\"");
+            var (generation, resync, rx, tx) = DanteRoutingApi.GetChannelChanges(IntPtr, sinceGeneration);
+
+            return new ChannelChanges(
+                generation,
+                resync,
+                rx == null ? Array.Empty<RxChannelInfo>() : ToRxChannelInfos(rx),
+                tx == null ? Array.Empty<TxChannelInfo>() : ToTxChannelInfos(tx));
         }
 
-        public IList<TxLabelInfo> GetTxLabels()
+        /// <summary>
+        /// Chooses the components kept up to date from the moment the device becomes active. The other
+        /// components are only fetched when first queried, so that query returns stale data and a
+        /// <see cref="RoutingEventKind.DeviceChanged"/> event follows once the update is in. <br/>
+        /// By default every component is subscribed. Call right after opening the device to avoid
+        /// the initial updates of the others
+        /// </summary>
+        /// <param name="subscribed"></param>
+        /// <param name="maxAge">components older than this are fetched again, subscribed ones
+        /// when they expire, the others when queried. Missing components never expire</param>
+        /// <exception cref="ArgumentOutOfRangeException"></exception>
+        /// <exception cref="InvalidOperationException"></exception>
+        public void SetRefreshPolicy(
+            DeviceComponents subscribed,
+            IReadOnlyDictionary<DeviceComponent, TimeSpan>? maxAge = null)
         {
-            return DanteRoutingApi.ProcessLineAndGetStructureArray<InternalTxLabelInfo>(IntPtr, "l")
-                .Select(info =>
+            var maxAgeMs = new uint[(int)DeviceComponent.Properties + 1];
+            if (maxAge != null)
+            {
+                foreach (var pair in maxAge)
                 {
-                    MarshalUtilities.ToManagedStringArray(info.labels, info.label_count, out var labels);
+                    if (pair.Key < 0 || (int)pair.Key >= maxAgeMs.Length)
+                    {
+                        throw new ArgumentOutOfRangeException(nameof(maxAge), pair.Key, "Unknown component");
+                    }
+                    if (pair.Value < TimeSpan.Zero || pair.Value.TotalMilliseconds > uint.MaxValue)
+                    {
+                        throw new ArgumentOutOfRangeException(nameof(maxAge), pair.Value, "Invalid max age");
+                    }
+
+                    maxAgeMs[(int)pair.Key] = (uint)pair.Value.TotalMilliseconds;
+                }
+            }
 
-                    return new TxLabelInfo(info.id, Convert.ToBoolean(info.is_empty), info.name, labels);
-                })
+            DanteRoutingApi.SetRefreshPolicy(IntPtr, subscribed, maxAgeMs);
+        }
+
+        /// <summary>
+        /// Polls the given rx flow error fields of every rx flow, keeping a history of per-interval counts
+        /// readable with <see cref="GetRxFlowErrorStats"/>. Polls clear the fields on the device
+        /// </summary>
+        /// <param name="interval">zero stops polling and drops the samples</param>
+        /// <param name="fields">bit per rx flow error type, only the first 8 types are kept</param>
+        /// <param name="history">samples kept, 0 for the native default</param>
+        /// <exception cref="ArgumentOutOfRangeException"></exception>
+        /// <exception cref="InvalidOperationException"></exception>
+        public void StartRxFlowErrorStats(TimeSpan interval, uint fields, uint history = 0)
+        {
+            if (interval < TimeSpan.Zero || interval.TotalMilliseconds > uint.MaxValue)
+            {
+                throw new ArgumentOutOfRangeException(nameof(interval));
+            }
+
+            DanteRoutingApi.StartRxFlowErrorStats(IntPtr, (uint)interval.TotalMilliseconds, fields, history);
+        }
+
+        /// <summary>
+        /// Returns the rx flow error samples taken after <paramref name="sinceSequence"/>, 0 for the whole history
+        /// </summary>
+        /// <param name="sinceSequence"></param>
+        /// <param name="skipZero">leaves out the samples of flow interfaces without errors</param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        public RxFlowErrorStats GetRxFlowErrorStats(uint sinceSequence, bool skipZero = false)
+        {
+            var (sequence, snapshot) = DanteRoutingApi.GetRxFlowErrorStats(IntPtr, sinceSequence, skipZero);
+
+            var samples = new List<RxFlowErrorSample>(snapshot.Records.Length);
+            foreach (var record in snapshot.Records)
+            {
+                samples.Add(new RxFlowErrorSample(
+                    record.sequence,
+                    record.flow_id,
+                    snapshot.GetString(record.name),
+                    record.interface_index,
+                    TimeSpan.FromMilliseconds(record.interval_ms),
+                    (record.timestamp_seconds, record.timestamp_subseconds),
+                    record.fields,
+                    record.deltas,
+                    record.rates));
+            }
+
+            return new RxFlowErrorStats(sequence, samples);
+        }
+
+        /// <summary>
+        /// Subscribes the rx channel to "channel@device". Completes when the device has answered the request
+        /// </summary>
+        /// <param name="number"></param>
+        /// <param name="name"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        public Task<RoutingResult> SetSxChannelName(int number, string name)
+        {
+            return SendRequest(() => DanteRoutingApi.SubscribeRxChannel(IntPtr, number, name));
+        }
+
+        /// <summary>
+        /// With a <see cref="StateCache"/>, returns the stored labels flagged stale until the device has them
+        /// </summary>
+        /// <returns></returns>
+        public IList<TxLabelInfo> GetTxLabels()
+        {
+            if (StateCache == null)
+            {
+                return ToTxLabelInfos(DanteRoutingApi.GetTxLabelsSnapshot(IntPtr));
+            }
+
+            var snapshot = GetStateSnapshot<InternalTxLabelRecord>(
+                DeviceStateSection.TxLabels, DeviceComponents.TxLabels, out var isCached);
+
+            return ToTxLabelInfos(snapshot, isCached);
+        }
+
+        /// <summary>
+        /// Completes when the device has answered the request
+        /// </summary>
+        /// <param name="number"></param>
+        /// <param name="name"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        public Task<RoutingResult> AddTxLabel(int number, string name)
+        {
+            return SendRequest(() => DanteRoutingApi.AddTxLabel(IntPtr, number, name));
+        }
+
+        /// <summary>
+        /// Gives every listed tx channel exactly the given labels, an empty list removes all of them.
+        /// Channels that are not listed keep their labels. <br/>
+        /// Only labels that differ from the device, also in case, are sent as batches of add, move and remove entries.
+        /// The removals complete before the other entries are sent;
+        /// batch entries refer to these changes, not to <paramref name="channels"/>.
+        /// Completes immediately with an empty result if nothing differs
+        /// </summary>
+        /// <param name="channels">tx channel number and its complete label set</param>
+        /// <exception cref="ArgumentException"></exception>
+        /// <exception cref="InvalidOperationException">Also while the labels of the device are stale</exception>
+        /// <returns></returns>
+        public Task<BulkRoutingResult> SetTxLabels(IReadOnlyList<(int Number, IReadOnlyList<string> Labels)> channels)
+        {
+            if (channels == null || channels.Count == 0)
+            {
+                throw new ArgumentException("At least one channel is required", nameof(channels));
+            }
+
+            var entries = channels
+                .SelectMany(channel => channel.Labels == null || channel.Labels.Count == 0
+                    ? new[] { (channel.Number, (string?)null) }
+                    : channel.Labels.Select(label => (channel.Number, (string?)label)))
                 .ToArray();
+            var numbers = entries.Select(entry => entry.Item1).ToArray();
+            var labels = entries.Select(entry => entry.Item2).ToArray();
+
+            return ToBulkResult(SendRequest(() => DanteRoutingApi.SetTxLabels(IntPtr, numbers, labels)));
         }
 
-        public void AddTxLabel(int number, string name)
+        /// <summary>
+        /// Creates, replaces or deletes many tx flows at once. Flows with the device default latency, fpp
+        /// and encoding, and deletions, are sent in batches; every other flow needs a request of its own,
+        /// which can only create a flow, so an existing flow it replaces is deleted by a batch completing first. <br/>
+        /// Batch entries refer to the flows in the order they are sent: those deletions, <see cref="TxFlowSpec.IsBatched"/> flows,
+        /// then the others, each group in its original order
+        /// </summary>
+        /// <param name="flows"></param>
+        /// <param name="chunkCompleted">called for every batch before the task completes,
+        /// possibly concurrently and on the thread stepping the device. Must not throw</param>
+        /// <exception cref="ArgumentException"></exception>
+        /// <exception cref="InvalidOperationException">Also if a slot refers to an unknown tx channel</exception>
+        /// <returns></returns>
+        public Task<BulkRoutingResult> ProvisionTxFlows(
+            IReadOnlyList<TxFlowSpec> flows,
+            Action<BulkChunkResult>? chunkCompleted = null)
         {
-            DanteRoutingApi.ProcessLine(IntPtr, $"l {number} \"{name}\" +");
+            if (flows == null || flows.Count == 0)
+            {
+                throw new ArgumentException("At least one flow is required", nameof(flows));
+            }
+
+            var specs = flows.Select(flow => flow.ToInternal()).ToArray();
+
+            return ToBulkResult(SendRequest(() => DanteRoutingApi.ProvisionTxFlows(IntPtr, specs), chunkCompleted));
         }
 
         public void Dispose()
@@ -155,6 +490,10 @@ namespace DanteWrapperLibrary
                 return;
             }
 
+            // A step waits for the next runtime timeout, so wake it up to notice the cancellation
+            TaskWorker.CancellationTokenSource.Cancel();
+            DanteRoutingApi.WakeDevice(IntPtr);
+
             // Waits to complete the last step
             TaskWorker.Dispose();
 
@@ -165,14 +504,371 @@ namespace DanteWrapperLibrary
             finally
             {
                 IntPtr = IntPtr.Zero;
+
+                if (GCHandle.IsAllocated)
+                {
+                    GCHandle.Free();
+                }
+
+                lock (PendingRequests)
+                {
+                    foreach (var source in PendingRequests.Values)
+                    {
+                        source.TrySetCanceled();
+                    }
+                    PendingRequests.Clear();
+                    EarlyResults.Clear();
+                    ChunkResults.Clear();
+                    ChunkCallbacks.Clear();
+                }
             }
         }
 
-        #endregion
+        /// <summary>
+        /// The native call runs on the session loop thread, which also delivers completions, 
+        /// so no lock is held across it. A completion that arrives before the token is registered is kept in EarlyResults,
+        /// batch results of a bulk request in ChunkResults
+        /// </summary>
+        /// <param name="send"></param>
+        /// <param name="chunkCompleted">receives the batch results of a bulk request</param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        private Task<RoutingResult> SendRequest(Func<ulong> send, Action<BulkChunkResult>? chunkCompleted = null)
+        {
+            lock (PendingRequests)
+            {
+                SendsInFlight++;
+            }
+
+            ulong token;
+            try
+            {
+                token = send();
+            }
+            catch
+            {
+                EndSend();
+                throw;
+            }
+
+            if (token == 0)
+            {
+                // Nothing was sent, so no completion will follow
+                EndSend();
+                return Task.FromResult(new RoutingResult(0, 0));
+            }
 
-        #region Event Handlers
+            if (chunkCompleted != null)
+            {
+                // Batches completed so far are replayed before the request can complete,
+                // later ones are reported by OnBulkChunkCompleted
+                BulkChunkResult[] early;
+                lock (PendingRequests)
+                {
+                    if (ChunkResults.TryGetValue(token, out var chunks))
+                    {
+                        early = chunks.ToArray();
+                    }
+                    else if (EarlyResults.TryGetValue(token, out var completed) && completed is BulkRoutingResult bulk)
+                    {
+                        early = bulk.Chunks.ToArray();
+                    }
+                    else
+                    {
+                        early = Array.Empty<BulkChunkResult>();
+                    }
+                    ChunkCallbacks[token] = chunkCompleted;
+                }
 
+                foreach (var chunk in early)
+                {
+                    chunkCompleted(chunk);
+                }
+            }
 
+            var source = new TaskCompletionSource<RoutingResult>(TaskCreationOptions.RunContinuationsAsynchronously);
+
+            lock (PendingRequests)
+            {
+                if (EarlyResults.TryGetValue(token, out var result))
+                {
+                    EarlyResults.Remove(token);
+                    ChunkCallbacks.Remove(token);
+                    source.TrySetResult(result);
+                }
+                else
+                {
+                    PendingRequests.Add(token, source);
+                }
+
+                if (--SendsInFlight == 0)
+                {
+                    ForgetUnclaimedResults();
+                }
+            }
+
+            return source.Task;
+        }
+
+        private void EndSend()
+        {
+            lock (PendingRequests)
+            {
+                if (--SendsInFlight == 0)
+                {
+                    ForgetUnclaimedResults();
+                }
+            }
+        }
+
+        /// <summary>
+        /// Drops results kept for tokens no request is waiting for. Called under the lock
+        /// </summary>
+        private void ForgetUnclaimedResults()
+        {
+            EarlyResults.Clear();
+
+            foreach (var token in ChunkResults.Keys.Where(token => !PendingRequests.ContainsKey(token)).ToArray())
+            {
+                ChunkResults.Remove(token);
+            }
+        }
+
+        private void OnRequestCompleted(RoutingEvent value)
+        {
+            TaskCompletionSource<RoutingResult>? source;
+            RoutingResult result;
+            lock (PendingRequests)
+            {
+                if (ChunkResults.TryGetValue(value.Token, out var chunks))
+                {
+                    ChunkResults.Remove(value.Token);
+                    result = new BulkRoutingResult(value.Token, value.Result, chunks);
+                }
+                else
+                {
+                    result = new RoutingResult(value.Token, value.Result);
+                }
+                ChunkCallbacks.Remove(value.Token);
+
+                if (!PendingRequests.TryGetValue(value.Token, out source))
+                {
+                    if (SendsInFlight > 0)
+                    {
+                        EarlyResults[value.Token] = result;
+                    }
+                    return;
+                }
+                PendingRequests.Remove(value.Token);
+            }
+
+            source.TrySetResult(result);
+        }
+
+        private void OnBulkChunkCompleted(RoutingEvent value)
+        {
+            var chunk = new BulkChunkResult(value.ChunkFirstEntry, value.ChunkCount, value.Result);
+            Action<BulkChunkResult>? callback;
+            lock (PendingRequests)
+            {
+                if (SendsInFlight == 0 && !PendingRequests.ContainsKey(value.Token))
+                {
+                    return;
+                }
+
+                if (!ChunkResults.TryGetValue(value.Token, out var chunks))
+                {
+                    chunks = new List<BulkChunkResult>();
+                    ChunkResults.Add(value.Token, chunks);
+                }
+                chunks.Add(chunk);
+                ChunkCallbacks.TryGetValue(value.Token, out callback);
+            }
+
+            callback?.Invoke(chunk);
+        }
+
+        /// <summary>
+        /// Returns the live snapshot of a component once the device is active and the component is not stale,
+        /// storing it when it differs from the stored one. Until then returns the stored snapshot, if there is one
+        /// </summary>
+        /// <param name="section"></param>
+        /// <param name="component"></param>
+        /// <param name="isCached">true if the snapshot is the stored one</param>
+        /// <returns></returns>
+        private Snapshot<T> GetStateSnapshot<T>(DeviceStateSection section, DeviceComponents component, out bool isCached)
+            where T : struct
+        {
+            byte[]?[]? toStore = null;
+            ulong version = 0;
+
+            lock (StateSections)
+            {
+                var stored = StateSections[(int)section];
+                if ((FreshComponents & component) == 0 && stored != null)
+                {
+                    try
+                    {
+                        isCached = true;
+                        return Snapshot<T>.FromBytes(stored);
+                    }
+                    catch (InvalidOperationException)
+                    {
+                        // Written by a build with another record layout
+                        StateSections[(int)section] = null;
+                    }
+                }
+            }
+
+            // The snapshot is taken on the stepping thread, which takes the StateSections lock
+            // for device events, so the lock must not be held while waiting for it
+            isCached = false;
+            var live = DanteRoutingApi.GetSnapshotBlob(IntPtr, section);
+
+            lock (StateSections)
+            {
+                var stored = StateSections[(int)section];
+                if ((FreshComponents & component) != 0 && (stored == null || !stored.SequenceEqual(live)))
+                {
+                    StateSections[(int)section] = live;
+                    toStore = (byte[]?[])StateSections.Clone();
+                    version = ++StateVersion;
+                }
+            }
+
+            if (toStore != null)
+            {
+                StoreStateSections(toStore, version);
+            }
+
+            return Snapshot<T>.FromBytes(live);
+        }
+
+        // Writes the sections unless a newer version was written already
+        private void StoreStateSections(byte[]?[] sections, ulong version)
+        {
+            lock (StoreLock)
+            {
+                if (version <= StoredStateVersion)
+                {
+                    return;
+                }
+
+                StateCache?.Store(Name, sections);
+                StoredStateVersion = version;
+            }
+        }
+
+        private static async Task<BulkRoutingResult> ToBulkResult(Task<RoutingResult> request)
+        {
+            var result = await request.ConfigureAwait(false);
+
+            return result as BulkRoutingResult
+                ?? new BulkRoutingResult(result.Token, result.Result, Array.Empty<BulkChunkResult>());
+        }
+
+        // Called on the stepping thread, the only one draining the events of the device
+        private static void OnNativeEventsPending(IntPtr context)
+        {
+            if (GCHandle.FromIntPtr(context).Target is RoutingDevice device)
+            {
+                device.DrainEvents();
+            }
+        }
+
+        private void DrainEvents()
+        {
+            int count;
+            do
+            {
+                count = DanteRoutingApi.DrainEvents(IntPtr, EventBuffer, out var dropped);
+                DroppedEventCount = dropped;
+
+                for (var i = 0; i < count; i++)
+                {
+                    OnNativeEvent(new RoutingEvent(EventBuffer[i]));
+                }
+            } while (count == EventBuffer.Length);
+        }
+
+        private void OnNativeEvent(RoutingEvent value)
+        {
+            if (value.Kind == RoutingEventKind.DeviceChanged)
+            {
+                lock (StateSections)
+                {
+                    FreshComponents = value.DeviceState == DeviceState.Active
+                        ? ~value.StaleComponents
+                        : DeviceComponents.None;
+                }
+            }
+
+            if (value.Kind == RoutingEventKind.RequestCompleted && value.Token != 0)
+            {
+                OnRequestCompleted(value);
+            }
+            else if (value.Kind == RoutingEventKind.BulkChunkCompleted)
+            {
+                OnBulkChunkCompleted(value);
+            }
+
+            if (value.Kind == RoutingEventKind.DomainChanged)
+            {
+                OnDomainEventOccurred(value);
+            }
+            else
+            {
+                OnEventOccurred(value);
+            }
+        }
+
+        private static IList<RxChannelInfo> ToRxChannelInfos(Snapshot<InternalRxChannelRecord> snapshot, bool isStale = false)
+        {
+            return snapshot.Records
+                .Select(info => new RxChannelInfo(
+                    info.id,
+                    isStale || Convert.ToBoolean(info.stale),
+                    snapshot.GetString(info.name),
+                    snapshot.GetString(info.format),
+                    info.latency,
+                    Convert.ToBoolean(info.muted),
+                    info.dbu,
+                    snapshot.GetString(info.sub),
+                    info.status,
+                    snapshot.GetString(info.flow)))
+                .ToArray();
+        }
+
+        private static IList<TxChannelInfo> ToTxChannelInfos(Snapshot<InternalTxChannelRecord> snapshot, bool isStale = false)
+        {
+            return snapshot.Records
+                .Select(info => new TxChannelInfo(
+                    info.id,
+                    isStale || Convert.ToBoolean(info.stale),
+                    snapshot.GetString(info.name),
+                    snapshot.GetString(info.format),
+                    Convert.ToBoolean(info.enabled),
+                    Convert.ToBoolean(info.muted),
+                    info.dbu))
+                .ToArray();
+        }
+
+        private static IList<TxLabelInfo> ToTxLabelInfos(Snapshot<InternalTxLabelRecord> snapshot, bool isStale = false)
+        {
+            return snapshot.Records
+                .Select(info =>
+                {
+                    var labels = new string[info.labels_count];
+                    for (var i = 0; i < labels.Length; i++)
+                    {
+                        labels[i] = snapshot.GetString(snapshot.Indices[info.first_label + i]);
+                    }
+
+                    return new TxLabelInfo(
+                        info.id, Convert.ToBoolean(info.is_empty), snapshot.GetString(info.name), labels, isStale);
+                })
+                .ToArray();
+        }
 
         #endregion
     }
@@ -0,0 +1,156 @@
+﻿using System;
+using System.Runtime.InteropServices;
+
+namespace DanteWrapperLibrary
+{
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct InternalRoutingEvent
+    {
+        public uint kind;
+        public uint change_flags;
+        public uint stale_components;
+        public int component;
+        public int state;
+        public int result;
+        public uint first;
+        public uint count;
+        public ulong handle;
+        public ulong request_id;
+        public ulong token;
+    }
+
+    public enum RoutingEventKind
+    {
+        DeviceChanged = 1,
+        RequestCompleted = 2,
+        DomainChanged = 3,
+        BulkChunkCompleted = 4,
+    }
+
+    public enum DeviceComponent
+    {
+        None = -1,
+        TxChannels = 0,
+        RxChannels,
+        TxLabels,
+        TxFlows,
+        RxFlows,
+        Properties,
+    }
+
+    [Flags]
+    public enum DeviceComponents : uint
+    {
+        None = 0,
+        TxChannels = 1 << DeviceComponent.TxChannels,
+        RxChannels = 1 << DeviceComponent.RxChannels,
+        TxLabels = 1 << DeviceComponent.TxLabels,
+        TxFlows = 1 << DeviceComponent.TxFlows,
+        RxFlows = 1 << DeviceComponent.RxFlows,
+        Properties = 1 << DeviceComponent.Properties,
+    }
+
+    [Flags]
+    public enum DeviceChangeFlags : uint
+    {
+        None = 0,
+        TxChannels = 1 << 0,
+        RxChannels = 1 << 1,
+        TxLabels = 1 << 2,
+        TxFlows = 1 << 3,
+        RxFlows = 1 << 4,
+        Properties = 1 << 5,
+        Name = 1 << 6,
+        State = 1 << 7,
+        Stale = 1 << 8,
+        Status = 1 << 9,
+        Addresses = 1 << 10,
+        RxFlowErrorFlags = 1 << 11,
+        RxFlowEarlyPackets = 1 << 12,
+        RxFlowLatePackets = 1 << 13,
+        RxFlowDroppedPackets = 1 << 14,
+        RxFlowOutOfOrderPackets = 1 << 15,
+        RxFlowMaxLatency = 1 << 16,
+    }
+
+    public enum DeviceState
+    {
+        Deleting = 0,
+        Error,
+        Resolving,
+        Resolved,
+        Querying,
+        Active,
+    }
+
+    public class RoutingEvent
+    {
+        public RoutingEventKind Kind { get; }
+
+        /// <summary>
+        /// Device change flags for <see cref="RoutingEventKind.DeviceChanged"/>, <br/>
+        /// raw domain handler change flags for <see cref="RoutingEventKind.DomainChanged"/>
+        /// </summary>
+        public uint ChangeFlags { get; }
+        public DeviceChangeFlags DeviceChangeFlags => Kind == RoutingEventKind.DomainChanged
+            ? DeviceChangeFlags.None
+            : (DeviceChangeFlags)ChangeFlags;
+        public DeviceComponents StaleComponents { get; }
+
+        /// <summary>
+        /// Component of a completed update request, otherwise <see cref="DeviceComponent.None"/>
+        /// </summary>
+        public DeviceComponent Component { get; }
+
+        /// <summary>
+        /// First entry and number of entries of a <see cref="RoutingEventKind.BulkChunkCompleted"/> batch
+        /// </summary>
+        public int ChunkFirstEntry { get; }
+        public int ChunkCount { get; }
+
+        /// <summary>
+        /// <see cref="DeviceState"/> for device events, raw domain handler state for domain events
+        /// </summary>
+        public int State { get; }
+        public DeviceState DeviceState => (DeviceState)State;
+
+        /// <summary>
+        /// Request result, or domain handler error. 0 is success
+        /// </summary>
+        public int Result { get; }
+        public IntPtr RequestId { get; }
+
+        /// <summary>
+        /// Token of a completed request, 0 if it wasn't issued through a typed request export
+        /// </summary>
+        public ulong Token { get; }
+
+        internal RoutingEvent(InternalRoutingEvent value)
+        {
+            Kind = (RoutingEventKind)value.kind;
+            ChangeFlags = value.change_flags;
+            StaleComponents = (DeviceComponents)value.stale_components;
+            Component = (DeviceComponent)value.component;
+            State = value.state;
+            ChunkFirstEntry = (int)value.first;
+            ChunkCount = (int)value.count;
+            Result = value.result;
+            RequestId = new IntPtr((long)value.request_id);
+            Token = value.token;
+        }
+
+        public override string ToString()
+        {
+            return Kind switch
+            {
+                RoutingEventKind.DeviceChanged =>
+                    $"{Kind}: {DeviceChangeFlags} (state: {DeviceState}, stale: {StaleComponents})",
+                RoutingEventKind.RequestCompleted =>
+                    $"{Kind}: request 0x{RequestId.ToInt64():x} (token: {Token}, {Component}) with result {Result}",
+                RoutingEventKind.BulkChunkCompleted =>
+                    $"{Kind}: request 0x{RequestId.ToInt64():x} (token: {Token}, entries {ChunkFirstEntry}+{ChunkCount}) with result {Result}",
+                _ => $"{Kind}: flags 0x{ChangeFlags:x} (state: {State}, error: {Result})",
+            };
+        }
+    }
+}
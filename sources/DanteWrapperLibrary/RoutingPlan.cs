@@ -0,0 +1,167 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+
+namespace DanteWrapperLibrary
+{
+    /// <summary>
+    /// Desired subscriptions of rx channels on any number of devices, such as a scene. <br/>
+    /// <see cref="Diff"/> reduces it to the subscribe and unsubscribe operations the devices actually need
+    /// </summary>
+    public class RoutingPlan
+    {
+        #region Properties
+
+        // Planned "TxChannel@TxDevice" by rx channel, by rx device. Null means unsubscribed
+        private Dictionary<string, SortedDictionary<int, (string? TxChannel, string? TxDevice)>> Devices { get; } =
+            new Dictionary<string, SortedDictionary<int, (string? TxChannel, string? TxDevice)>>(StringComparer.OrdinalIgnoreCase);
+
+        public IReadOnlyCollection<string> DeviceNames => Devices.Keys;
+
+        #endregion
+
+        #region Methods
+
+        /// <summary>
+        /// Plans the rx channel to be subscribed to "txChannel@txDevice"
+        /// </summary>
+        /// <param name="rxDevice"></param>
+        /// <param name="rxChannel"></param>
+        /// <param name="txChannel"></param>
+        /// <param name="txDevice"></param>
+        /// <exception cref="ArgumentException"></exception>
+        /// <exception cref="ArgumentOutOfRangeException"></exception>
+        public void Subscribe(string rxDevice, int rxChannel, string txChannel, string txDevice)
+        {
+            if (string.IsNullOrEmpty(txChannel))
+            {
+                throw new ArgumentException("Tx channel is required", nameof(txChannel));
+            }
+            if (string.IsNullOrEmpty(txDevice))
+            {
+                throw new ArgumentException("Tx device is required", nameof(txDevice));
+            }
+
+            Set(rxDevice, rxChannel, (txChannel, txDevice));
+        }
+
+        /// <summary>
+        /// Plans the rx channel to have no subscription
+        /// </summary>
+        /// <param name="rxDevice"></param>
+        /// <param name="rxChannel"></param>
+        /// <exception cref="ArgumentException"></exception>
+        /// <exception cref="ArgumentOutOfRangeException"></exception>
+        public void Unsubscribe(string rxDevice, int rxChannel)
+        {
+            Set(rxDevice, rxChannel, (null, null));
+        }
+
+        /// <summary>
+        /// Returns the planned subscriptions of the device ordered by rx channel, empty if it is not in the plan
+        /// </summary>
+        /// <param name="rxDevice"></param>
+        /// <returns></returns>
+        public IReadOnlyList<(int Number, string? TxChannel, string? TxDevice)> GetSubscriptions(string rxDevice)
+        {
+            if (rxDevice == null || !Devices.TryGetValue(rxDevice, out var channels))
+            {
+                return Array.Empty<(int, string?, string?)>();
+            }
+
+            return channels
+                .Select(pair => (pair.Key, pair.Value.TxChannel, pair.Value.TxDevice))
+                .ToArray();
+        }
+
+        /// <summary>
+        /// Compares the plan with the current state of the devices. 
+        /// Planned devices that are not in <paramref name="devices"/> are reported as missing
+        /// </summary>
+        /// <param name="devices">initialized devices, matched to the plan by name</param>
+        /// <exception cref="ArgumentNullException"></exception>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        public RoutingPlanDiff Diff(IEnumerable<RoutingDevice> devices)
+        {
+            var byName = (devices ?? throw new ArgumentNullException(nameof(devices)))
+                .GroupBy(device => device.Name, StringComparer.OrdinalIgnoreCase)
+                .ToDictionary(group => group.Key, group => group.First(), StringComparer.OrdinalIgnoreCase);
+
+            var batches = new Dictionary<RoutingDevice, IReadOnlyList<(int Number, string? TxChannel, string? TxDevice)>>();
+            var missing = new List<string>();
+
+            foreach (var name in Devices.Keys)
+            {
+                if (!byName.TryGetValue(name, out var device))
+                {
+                    missing.Add(name);
+                    continue;
+                }
+
+                var changed = device.DiffSubscriptions(GetSubscriptions(name));
+                if (changed.Count > 0)
+                {
+                    batches.Add(device, changed);
+                }
+            }
+
+            return new RoutingPlanDiff(batches, missing);
+        }
+
+        private void Set(string rxDevice, int rxChannel, (string? TxChannel, string? TxDevice) value)
+        {
+            if (string.IsNullOrEmpty(rxDevice))
+            {
+                throw new ArgumentException("Rx device is required", nameof(rxDevice));
+            }
+            if (rxChannel < 1)
+            {
+                throw new ArgumentOutOfRangeException(nameof(rxChannel));
+            }
+
+            if (!Devices.TryGetValue(rxDevice, out var channels))
+            {
+                channels = new SortedDictionary<int, (string? TxChannel, string? TxDevice)>();
+                Devices.Add(rxDevice, channels);
+            }
+            channels[rxChannel] = value;
+        }
+
+        #endregion
+    }
+
+    /// <summary>
+    /// Subscription changes needed to reach a <see cref="RoutingPlan"/>, one batch per device. <br/>
+    /// Pass each batch to <see cref="RoutingDevice.SubscribeRxChannels"/>
+    /// </summary>
+    public class RoutingPlanDiff
+    {
+        /// <summary>
+        /// Changed subscriptions by device. Devices already in the planned state are not included
+        /// </summary>
+        public IReadOnlyDictionary<RoutingDevice, IReadOnlyList<(int Number, string? TxChannel, string? TxDevice)>> Batches { get; }
+
+        /// <summary>
+        /// Planned devices that were not passed to <see cref="RoutingPlan.Diff"/>
+        /// </summary>
+        public IReadOnlyList<string> MissingDevices { get; }
+
+        public int Count => Batches.Values.Sum(batch => batch.Count);
+
+        public bool IsEmpty => Batches.Count == 0;
+
+        internal RoutingPlanDiff(
+            IReadOnlyDictionary<RoutingDevice, IReadOnlyList<(int Number, string? TxChannel, string? TxDevice)>> batches,
+            IReadOnlyList<string> missingDevices)
+        {
+            Batches = batches;
+            MissingDevices = missingDevices;
+        }
+
+        public override string ToString()
+        {
+            return $"{Count} changes on {Batches.Count} devices, {MissingDevices.Count} devices missing";
+        }
+    }
+}
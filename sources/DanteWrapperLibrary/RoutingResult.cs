@@ -0,0 +1,28 @@
+﻿namespace DanteWrapperLibrary
+{
+    public class RoutingResult
+    {
+        /// <summary>
+        /// Token returned by the native library when the request was sent
+        /// </summary>
+        public ulong Token { get; }
+
+        /// <summary>
+        /// aud_error_t of the completed request. 0 is success
+        /// </summary>
+        public int Result { get; }
+
+        public bool IsSuccess => Result == 0;
+
+        public RoutingResult(ulong token, int result)
+        {
+            Token = token;
+            Result = result;
+        }
+
+        public override string ToString()
+        {
+            return $"Request {Token}: {(IsSuccess ? "success" : $"error {Result}")}";
+        }
+    }
+}
@@ -0,0 +1,343 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+
+namespace DanteWrapperLibrary
+{
+    /// <summary>
+    /// One Dante environment and DDM connection shared by many <see cref="RoutingDevice"/>. <br/>
+    /// All devices are stepped by one native thread, managed code only receives their events
+    /// </summary>
+    public class RoutingSession : IDisposable
+    {
+        #region Properties
+
+        public int MaxDevices { get; }
+
+        internal IntPtr IntPtr { get; private set; } = IntPtr.Zero;
+
+        /// <summary>
+        /// Ring of decoded metering messages, null until <see cref="StartMetering"/>
+        /// </summary>
+        public MeterRing? Meters { get; private set; }
+
+        /// <summary>
+        /// Meter levels after ballistics, null until <see cref="SetMeterBallistics"/>
+        /// </summary>
+        public MeterView? MeterView { get; private set; }
+
+        private MeterMemory? MeterMemory { get; set; }
+
+        #endregion
+
+        #region Constructors
+
+        public RoutingSession(int maxDevices)
+        {
+            if (maxDevices < 1)
+            {
+                throw new ArgumentOutOfRangeException(nameof(maxDevices));
+            }
+
+            MaxDevices = maxDevices;
+        }
+
+        #endregion
+
+        #region Methods
+
+        public void Initialize()
+        {
+            if (IntPtr != IntPtr.Zero)
+            {
+                return;
+            }
+
+            IntPtr = DanteRoutingApi.OpenSession(MaxDevices);
+
+            DanteRoutingApi.StartSessionLoop(IntPtr);
+        }
+
+        /// <summary>
+        /// Opens a device in this session. Dispose the device before the session
+        /// </summary>
+        /// <param name="name"></param>
+        /// <param name="stateCache">serves the channels and labels of the previous run until the device has them</param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        public RoutingDevice OpenDevice(string name, DeviceStateCache? stateCache = null)
+        {
+            if (IntPtr == IntPtr.Zero)
+            {
+                throw new InvalidOperationException("Session is not initialized");
+            }
+
+            var device = new RoutingDevice(name, this, stateCache);
+            device.Initialize();
+
+            return device;
+        }
+
+        /// <summary>
+        /// Limits how many batches of bulk requests all devices of the session have in flight together. <br/>
+        /// The request limit of the session is never exceeded, and every device with pending bulk requests
+        /// keeps at least one batch in flight
+        /// </summary>
+        /// <param name="maxInFlight"></param>
+        /// <exception cref="ArgumentOutOfRangeException"></exception>
+        /// <exception cref="InvalidOperationException"></exception>
+        public void SetBulkBudget(int maxInFlight)
+        {
+            if (maxInFlight < 1)
+            {
+                throw new ArgumentOutOfRangeException(nameof(maxInFlight));
+            }
+            if (IntPtr == IntPtr.Zero)
+            {
+                throw new InvalidOperationException("Session is not initialized");
+            }
+
+            DanteRoutingApi.SetSessionBulkBudget(IntPtr, maxInFlight);
+        }
+
+        /// <summary>
+        /// Starts rx flow error statistics on every device of the session, including the devices opened later. <br/>
+        /// See <see cref="RoutingDevice.StartRxFlowErrorStats"/>
+        /// </summary>
+        /// <param name="interval">zero stops polling</param>
+        /// <param name="fields">bit per rx flow error type</param>
+        /// <param name="history">samples kept, 0 for the native default</param>
+        /// <exception cref="ArgumentOutOfRangeException"></exception>
+        /// <exception cref="InvalidOperationException"></exception>
+        public void StartRxFlowErrorStats(TimeSpan interval, uint fields, uint history = 0)
+        {
+            if (interval < TimeSpan.Zero || interval.TotalMilliseconds > uint.MaxValue)
+            {
+                throw new ArgumentOutOfRangeException(nameof(interval));
+            }
+            if (IntPtr == IntPtr.Zero)
+            {
+                throw new InvalidOperationException("Session is not initialized");
+            }
+
+            DanteRoutingApi.StartSessionRxFlowErrorStats(IntPtr, (uint)interval.TotalMilliseconds, fields, history);
+        }
+
+        /// <summary>
+        /// Starts receiving conmon metering. Every metering message of a device added with
+        /// <see cref="SubscribeMetering"/> is decoded natively into a frame of <see cref="Meters"/>,
+        /// so managed code only copies the frames it displays
+        /// </summary>
+        /// <param name="maxDevices"></param>
+        /// <param name="maxChannels">tx and rx channels kept per device, more are cut</param>
+        /// <param name="capacity">frames kept for all devices together, 0 for the native default</param>
+        /// <param name="port">conmon metering port, 0 for the default</param>
+        /// <exception cref="ArgumentOutOfRangeException"></exception>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        public MeterRing StartMetering(int maxDevices, int maxChannels, int capacity = 0, int port = 0)
+        {
+            if (maxDevices < 1 || maxDevices > ushort.MaxValue)
+            {
+                throw new ArgumentOutOfRangeException(nameof(maxDevices));
+            }
+            if (maxChannels < 1 || maxChannels > ushort.MaxValue)
+            {
+                throw new ArgumentOutOfRangeException(nameof(maxChannels));
+            }
+            if (capacity < 0)
+            {
+                throw new ArgumentOutOfRangeException(nameof(capacity));
+            }
+            if (port < 0 || port > ushort.MaxValue)
+            {
+                throw new ArgumentOutOfRangeException(nameof(port));
+            }
+            if (IntPtr == IntPtr.Zero)
+            {
+                throw new InvalidOperationException("Session is not initialized");
+            }
+            if (Meters != null)
+            {
+                throw new InvalidOperationException("Metering is already started");
+            }
+
+            var memory = new MeterMemory();
+            Meters = new MeterRing(DanteRoutingApi.StartSessionMetering(IntPtr, port, maxDevices, maxChannels, capacity), memory);
+            MeterMemory = memory;
+
+            return Meters;
+        }
+
+        /// <summary>
+        /// Subscribes to the metering of a device, subscribing again returns the same slot
+        /// </summary>
+        /// <param name="device"></param>
+        /// <exception cref="ArgumentException"></exception>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns>the slot of the device in <see cref="Meters"/></returns>
+        public int SubscribeMetering(string device)
+        {
+            if (string.IsNullOrEmpty(device))
+            {
+                throw new ArgumentException("Device name is required", nameof(device));
+            }
+            if (Meters == null)
+            {
+                throw new InvalidOperationException("Metering is not started");
+            }
+
+            return DanteRoutingApi.SubscribeSessionMetering(IntPtr, device);
+        }
+
+        /// <summary>
+        /// Frees the slot of the device. Frames already in <see cref="Meters"/> may still name it
+        /// </summary>
+        /// <param name="slot"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        public void UnsubscribeMetering(int slot)
+        {
+            if (Meters == null)
+            {
+                throw new InvalidOperationException("Metering is not started");
+            }
+
+            DanteRoutingApi.UnsubscribeSessionMetering(IntPtr, slot);
+        }
+
+        /// <summary>
+        /// Runs metering through attack/release ballistics, peak hold and clip latching natively and
+        /// publishes one compact frame of every device and channel at <see cref="MeterBallistics.Rate"/>,
+        /// so a UI reads one frame per tick from <see cref="MeterView"/>. Call again to change the settings
+        /// </summary>
+        /// <param name="ballistics"></param>
+        /// <exception cref="ArgumentNullException"></exception>
+        /// <exception cref="ArgumentOutOfRangeException"></exception>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        public MeterView SetMeterBallistics(MeterBallistics ballistics)
+        {
+            if (ballistics == null)
+            {
+                throw new ArgumentNullException(nameof(ballistics));
+            }
+            if (ballistics.Rate < 0 || ballistics.Rate > 1000)
+            {
+                throw new ArgumentOutOfRangeException(nameof(ballistics), ballistics.Rate, "Invalid rate");
+            }
+            if (Meters == null || MeterMemory == null)
+            {
+                throw new InvalidOperationException("Metering is not started");
+            }
+
+            var view = DanteRoutingApi.SetSessionMeterBallistics(IntPtr, ballistics.ToInternal());
+            MeterView ??= new MeterView(view, MeterMemory);
+
+            return MeterView;
+        }
+
+        /// <summary>
+        /// Clears the latched clips of a device slot, or of every device
+        /// </summary>
+        /// <param name="slot">null for every device</param>
+        /// <exception cref="InvalidOperationException"></exception>
+        public void ClearMeterClips(int? slot = null)
+        {
+            if (Meters == null)
+            {
+                throw new InvalidOperationException("Metering is not started");
+            }
+
+            DanteRoutingApi.ClearSessionMeterClips(IntPtr, slot ?? -1);
+        }
+
+        /// <summary>
+        /// Stops metering and frees <see cref="Meters"/> and <see cref="MeterView"/>. <br/>
+        /// Waits for reads in progress on other threads; later reads throw <see cref="ObjectDisposedException"/>
+        /// </summary>
+        public void StopMetering()
+        {
+            if (Meters == null)
+            {
+                return;
+            }
+
+            ReleaseMeterMemory();
+            DanteRoutingApi.StopSessionMetering(IntPtr);
+        }
+
+        /// <summary>
+        /// Resolves "TxChannel@TxDevice" subscription targets against the tx channel names and labels
+        /// of every device open in the session, without network traffic. <br/>
+        /// The index follows device changes; a target is null if no open device knows it (yet)
+        /// </summary>
+        /// <param name="targets"></param>
+        /// <exception cref="ArgumentException"></exception>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns>one entry per target, in the same order</returns>
+        public IReadOnlyList<ResolvedChannel?> ResolveChannels(IReadOnlyList<string> targets)
+        {
+            if (targets == null || targets.Count == 0)
+            {
+                throw new ArgumentException("At least one target is required", nameof(targets));
+            }
+            if (IntPtr == IntPtr.Zero)
+            {
+                throw new InvalidOperationException("Session is not initialized");
+            }
+
+            var (handles, channelIds, isLabel) = DanteRoutingApi.ResolveSessionChannels(IntPtr, targets.ToArray());
+
+            var resolved = new ResolvedChannel?[targets.Count];
+            for (var i = 0; i < resolved.Length; i++)
+            {
+                if (handles[i] != 0)
+                {
+                    var target = targets[i];
+                    resolved[i] = new ResolvedChannel(
+                        target, target.Substring(target.IndexOf('@') + 1), channelIds[i], isLabel[i] != 0);
+                }
+            }
+
+            return resolved;
+        }
+
+        public void Dispose()
+        {
+            if (IntPtr == IntPtr.Zero)
+            {
+                return;
+            }
+
+            // Closing the session frees the metering memory
+            ReleaseMeterMemory();
+
+            try
+            {
+                // Waits to complete the last step
+                DanteRoutingApi.StopSessionLoop(IntPtr);
+            }
+            finally
+            {
+                try
+                {
+                    DanteRoutingApi.CloseSession(IntPtr);
+                }
+                finally
+                {
+                    IntPtr = IntPtr.Zero;
+                }
+            }
+        }
+
+        private void ReleaseMeterMemory()
+        {
+            MeterMemory?.Release();
+            MeterMemory = null;
+            Meters = null;
+            MeterView = null;
+        }
+
+        #endregion
+    }
+}
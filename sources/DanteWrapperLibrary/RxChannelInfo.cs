@@ -17,6 +17,23 @@ namespace DanteWrapperLibrary
         public string flow;
     }
 
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct InternalRxChannelRecord
+    {
+        public ushort id;
+        public byte status;
+        public byte reserved;
+        public int stale;
+        public uint name;
+        public uint format;
+        public uint latency;
+        public int muted;
+        public short dbu;
+        public ushort reserved2;
+        public uint sub;
+        public uint flow;
+    }
+
     public enum RxStatus
     {
 		/// <summary>
@@ -0,0 +1,105 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Runtime.InteropServices;
+
+namespace DanteWrapperLibrary
+{
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct InternalRxFlowStatsRecord
+    {
+        /// <summary>
+        /// DR_TEST_RXSTATS_MAX_FIELDS
+        /// </summary>
+        public const int MaxFields = 8;
+
+        public uint sequence;
+        public uint interval_ms;
+        public uint timestamp_seconds;
+        public uint timestamp_subseconds;
+        public ushort flow_id;
+        public ushort interface_index;
+        public uint name;
+        public uint fields;
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = MaxFields)]
+        public uint[] deltas;
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = MaxFields)]
+        public float[] rates;
+    }
+
+    /// <summary>
+    /// Rx flow error fields of one flow interface, counted during one poll interval
+    /// </summary>
+    public class RxFlowErrorSample
+    {
+        public uint Sequence { get; }
+        public int FlowId { get; }
+        public string FlowName { get; }
+        public int InterfaceIndex { get; }
+
+        /// <summary>
+        /// Local time since the previous poll, zero for the first sample
+        /// </summary>
+        public TimeSpan Interval { get; }
+
+        /// <summary>
+        /// Device time of the sample, seconds and subseconds as reported by the device
+        /// </summary>
+        public (uint Seconds, uint Subseconds) Timestamp { get; }
+
+        /// <summary>
+        /// Bit per rx flow error type, set for the types read in this sample
+        /// </summary>
+        public uint Fields { get; }
+
+        /// <summary>
+        /// Count per rx flow error type during the interval
+        /// </summary>
+        public IReadOnlyList<uint> Deltas { get; }
+
+        /// <summary>
+        /// <see cref="Deltas"/> per second
+        /// </summary>
+        public IReadOnlyList<float> Rates { get; }
+
+        public RxFlowErrorSample(
+            uint sequence,
+            int flowId,
+            string flowName,
+            int interfaceIndex,
+            TimeSpan interval,
+            (uint Seconds, uint Subseconds) timestamp,
+            uint fields,
+            IReadOnlyList<uint> deltas,
+            IReadOnlyList<float> rates)
+        {
+            Sequence = sequence;
+            FlowId = flowId;
+            FlowName = flowName;
+            InterfaceIndex = interfaceIndex;
+            Interval = interval;
+            Timestamp = timestamp;
+            Fields = fields;
+            Deltas = deltas;
+            Rates = rates;
+        }
+    }
+
+    public class RxFlowErrorStats
+    {
+        /// <summary>
+        /// Pass this value to the next <see cref="RoutingDevice.GetRxFlowErrorStats"/> call
+        /// </summary>
+        public uint Sequence { get; }
+
+        /// <summary>
+        /// Grouped by flow and interface, oldest sample first
+        /// </summary>
+        public IList<RxFlowErrorSample> Samples { get; }
+
+        public RxFlowErrorStats(uint sequence, IList<RxFlowErrorSample> samples)
+        {
+            Sequence = sequence;
+            Samples = samples;
+        }
+    }
+}
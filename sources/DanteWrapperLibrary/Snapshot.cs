@@ -0,0 +1,125 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Runtime.InteropServices;
+using System.Text;
+
+namespace DanteWrapperLibrary
+{
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct InternalSnapshotHeader
+    {
+        public uint size;
+        public uint record_count;
+        public uint record_size;
+        public uint records_offset;
+        public uint indices_count;
+        public uint indices_offset;
+        public uint strings_size;
+        public uint strings_offset;
+    }
+
+    /// <summary>
+    /// Managed copy of a native snapshot blob: fixed-size records, an index table
+    /// and a string pool addressed by offsets
+    /// </summary>
+    internal sealed class Snapshot<T> where T : struct
+    {
+        /// <summary>
+        /// DR_TEST_SNAPSHOT_NO_STRING
+        /// </summary>
+        private const uint NoString = 0xFFFFFFFF;
+
+        public T[] Records { get; }
+        public uint[] Indices { get; }
+
+        private byte[] Strings { get; }
+        private Dictionary<uint, string> StringCache { get; } = new Dictionary<uint, string>();
+
+        private Snapshot(T[] records, uint[] indices, byte[] strings)
+        {
+            Records = records;
+            Indices = indices;
+            Strings = strings;
+        }
+
+        /// <summary>
+        /// Copies the snapshot out of native memory. The blob is not freed
+        /// </summary>
+        /// <param name="ptr"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        public static Snapshot<T> FromPointer(IntPtr ptr)
+        {
+            var header = Marshal.PtrToStructure<InternalSnapshotHeader>(ptr);
+            if (header.record_size != Marshal.SizeOf<T>())
+            {
+                throw new InvalidOperationException(
+                    $"Snapshot record size {header.record_size} doesn't match {typeof(T).Name}");
+            }
+
+            var records = new T[header.record_count];
+            for (var i = 0; i < records.Length; i++)
+            {
+                records[i] = Marshal.PtrToStructure<T>(ptr + (int)(header.records_offset + i * header.record_size));
+            }
+
+            var indices = new int[header.indices_count];
+            Marshal.Copy(ptr + (int)header.indices_offset, indices, 0, indices.Length);
+
+            var strings = new byte[header.strings_size];
+            Marshal.Copy(ptr + (int)header.strings_offset, strings, 0, strings.Length);
+
+            return new Snapshot<T>(records, Array.ConvertAll(indices, index => (uint)index), strings);
+        }
+
+        /// <summary>
+        /// Copies the snapshot out of a blob in managed memory, as returned by <see cref="DanteRoutingApi.GetSnapshotBlob"/>
+        /// or stored by <see cref="DeviceStateCache"/>
+        /// </summary>
+        /// <param name="blob"></param>
+        /// <exception cref="InvalidOperationException"></exception>
+        /// <returns></returns>
+        public static Snapshot<T> FromBytes(byte[] blob)
+        {
+            var handle = GCHandle.Alloc(blob, GCHandleType.Pinned);
+            try
+            {
+                return FromPointer(handle.AddrOfPinnedObject());
+            }
+            finally
+            {
+                handle.Free();
+            }
+        }
+
+        /// <summary>
+        /// Returns the string at the given pool offset, or an empty string for DR_TEST_SNAPSHOT_NO_STRING.
+        /// Identical offsets return the same instance
+        /// </summary>
+        /// <param name="offset"></param>
+        /// <returns></returns>
+        public string GetString(uint offset)
+        {
+            if (offset == NoString || offset >= Strings.Length)
+            {
+                return string.Empty;
+            }
+
+            if (StringCache.TryGetValue(offset, out var value))
+            {
+                return value;
+            }
+
+            var end = Array.IndexOf(Strings, (byte)0, (int)offset);
+            if (end < 0)
+            {
+                end = Strings.Length;
+            }
+
+            value = Encoding.UTF8.GetString(Strings, (int)offset, end - (int)offset);
+            StringCache[offset] = value;
+
+            return value;
+        }
+    }
+}
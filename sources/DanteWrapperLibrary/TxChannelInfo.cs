@@ -14,6 +14,18 @@ namespace DanteWrapperLibrary
         public short dbu;
     }
 
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct InternalTxChannelRecord
+    {
+        public ushort id;
+        public short dbu;
+        public int stale;
+        public uint name;
+        public uint format;
+        public int enabled;
+        public int muted;
+    }
+
     public class TxChannelInfo
     {
         public int Id { get; }
@@ -0,0 +1,104 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Runtime.InteropServices;
+
+namespace DanteWrapperLibrary
+{
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct InternalTxFlowSpec
+    {
+        public int id;
+        public int num_slots;
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = TxFlowSpec.MaxSlots)]
+        public int[] channels;
+        public uint latency_us;
+        public ushort fpp;
+        public ushort encoding;
+    }
+
+    /// <summary>
+    /// A tx flow to create, replace or delete with <see cref="RoutingDevice.ProvisionTxFlows"/>
+    /// </summary>
+    public class TxFlowSpec
+    {
+        public const int MaxSlots = 16;
+
+        /// <summary>
+        /// Flow id, 0 lets the device choose
+        /// </summary>
+        public int Id { get; }
+
+        /// <summary>
+        /// Tx channel number per slot, 0 for an empty slot. No slots deletes the flow
+        /// </summary>
+        public IReadOnlyList<int> Channels { get; }
+
+        /// <summary>
+        /// 0 for the device default
+        /// </summary>
+        public uint LatencyUs { get; }
+
+        /// <summary>
+        /// Frames per packet, 0 for the device default
+        /// </summary>
+        public ushort Fpp { get; }
+
+        /// <summary>
+        /// 0 for the device default
+        /// </summary>
+        public ushort Encoding { get; }
+
+        public bool IsDelete => Channels.Count == 0;
+
+        /// <summary>
+        /// True if the flow can go into a batch, which only carries the channels of a flow
+        /// </summary>
+        public bool IsBatched => IsDelete || (LatencyUs == 0 && Fpp == 0 && Encoding == 0);
+
+        public TxFlowSpec(int id, IReadOnlyList<int> channels, uint latencyUs = 0, ushort fpp = 0, ushort encoding = 0)
+        {
+            if (id < 0 || id > ushort.MaxValue)
+            {
+                throw new ArgumentOutOfRangeException(nameof(id));
+            }
+            if (channels == null || channels.Count > MaxSlots)
+            {
+                throw new ArgumentOutOfRangeException(nameof(channels));
+            }
+            if (channels.Count == 0 && id == 0)
+            {
+                throw new ArgumentException("Deleting a flow requires its id", nameof(id));
+            }
+
+            Id = id;
+            Channels = channels;
+            LatencyUs = latencyUs;
+            Fpp = fpp;
+            Encoding = encoding;
+        }
+
+        public static TxFlowSpec Delete(int id)
+        {
+            return new TxFlowSpec(id, Array.Empty<int>());
+        }
+
+        internal InternalTxFlowSpec ToInternal()
+        {
+            var channels = new int[MaxSlots];
+            for (var i = 0; i < Channels.Count; i++)
+            {
+                channels[i] = Channels[i];
+            }
+
+            return new InternalTxFlowSpec
+            {
+                id = Id,
+                num_slots = Channels.Count,
+                channels = channels,
+                latency_us = LatencyUs,
+                fpp = Fpp,
+                encoding = Encoding,
+            };
+        }
+    }
+}
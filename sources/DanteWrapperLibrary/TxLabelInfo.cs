@@ -14,6 +14,17 @@ namespace DanteWrapperLibrary
         public IntPtr labels;
     }
 
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct InternalTxLabelRecord
+    {
+        public ushort id;
+        public ushort reserved;
+        public int is_empty;
+        public uint name;
+        public uint first_label;
+        public uint labels_count;
+    }
+
     public class TxLabelInfo
     {
         public int Id { get; }
@@ -21,12 +32,18 @@ namespace DanteWrapperLibrary
         public string Name { get; }
         public IList<string> Labels { get; }
 
-        public TxLabelInfo(int id, bool isEmpty, string name, IList<string> labels)
+        /// <summary>
+        /// True if the labels come from a <see cref="DeviceStateCache"/> and the device has not confirmed them yet
+        /// </summary>
+        public bool IsStale { get; }
+
+        public TxLabelInfo(int id, bool isEmpty, string name, IList<string> labels, bool isStale = false)
         {
             Id = id;
             IsEmpty = isEmpty;
             Name = name;
             Labels = labels;
+            IsStale = isStale;
         }
     }
 }
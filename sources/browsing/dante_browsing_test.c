@@ -86,6 +86,9 @@ typedef struct db_browse_test
 	db_browse_t * browse;
 	aud_bool_t running;
 
+	// wakes step early and, with epoll, tracks the browse sockets
+	dapi_utils_wake_t wake;
+
 	aud_bool_t print_node_changes;
 	aud_bool_t print_network_changes;
 
@@ -589,6 +592,15 @@ void db_test_event_handle_ddh_changes
 #endif
 }
 
+static void
+db_test_sockets_changed
+(
+	const db_browse_t * browse
+) {
+	db_browse_test_t * test = (db_browse_test_t *) db_browse_get_context(browse);
+	dapi_utils_wake_sockets_changed(&test->wake);
+}
+
 //----------------------------------------------------------
 // Main functionality
 //----------------------------------------------------------
@@ -1622,6 +1634,7 @@ __declspec(dllexport) void close
 	{
 		db_browse_delete((*test)->browse);
 	}
+	dapi_utils_wake_cleanup(&(*test)->wake, (*test)->runtime);
 	if ((*test)->dapi)
 	{
 		dapi_delete((*test)->dapi);
@@ -1699,7 +1712,14 @@ __declspec(dllexport) int open
 	assert((*test)->handler);
 	DB_TEST_DEBUG("Created environment\n");
 
-	dante_domain_handler_set_context((*test)->handler, &test);
+	result = dapi_utils_wake_init(&(*test)->wake, (*test)->runtime);
+	if (result != AUD_SUCCESS)
+	{
+		DB_TEST_ERROR("Error creating wake socket: %s\n", aud_error_message(result, (*test)->errbuf));
+		goto cleanup;
+	}
+
+	dante_domain_handler_set_context((*test)->handler, *test);
 
 #if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
 	result = dapi_utils_ddm_connect_blocking(&(*test)->ddm_config, (*test)->handler, (*test)->runtime, &g_running);
@@ -1746,7 +1766,8 @@ __declspec(dllexport) int open
 
 	db_browse_set_node_changed_callback((*test)->browse, db_test_node_changed);
 	db_browse_set_network_changed_callback((*test)->browse, db_test_network_changed);
-	db_browse_set_context((*test)->browse, &test);
+	db_browse_set_sockets_changed_callback((*test)->browse, db_test_sockets_changed);
+	db_browse_set_context((*test)->browse, *test);
 
 	if ((*test)->browse_filter && (*test)->browse_filter[0])
 	{
@@ -1782,7 +1803,17 @@ __declspec(dllexport) int step
 	/*[in/out]*/ db_browse_test_t** test
 )
 {
-	return dapi_utils_step((*test)->runtime, AUD_SOCKET_INVALID, NULL);
+	return dapi_utils_step_wake((*test)->runtime, &(*test)->wake, NULL);
+}
+
+// Makes a step blocked on this handle return immediately. Safe to call from any thread.
+__declspec(dllexport) int wake
+(
+	/*[in/out]*/ db_browse_test_t** test
+)
+{
+	dapi_utils_wake_signal(&(*test)->wake);
+	return AUD_SUCCESS;
 }
 
 __declspec(dllexport) int process_line
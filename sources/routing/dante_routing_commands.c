@@ -0,0 +1,277 @@
+/*
+ * File     : dante_routing_commands.c
+ * Synopsis : Commands submitted from any thread, executed by the thread
+ *            stepping the runtime.
+ *
+ * The routing API is single-threaded, but the .Net wrapper calls into a
+ * handle from arbitrary threads while its loop is blocked in step. Instead of
+ * a lock, calls are pushed onto an intrusive MPSC queue (Vyukov's algorithm)
+ * and run by the loop between two dante_runtime_process_with_sockets.
+ */
+#include "dante_routing_test.h"
+#include <string.h>
+
+#ifdef WIN32
+#define DR_TEST_EXCHANGE_POINTER(P, V) \
+	((dr_test_command_t *) InterlockedExchangePointer((PVOID volatile *) (P), (V)))
+#define DR_TEST_TRY_CLAIM(P) (InterlockedCompareExchange((P), 1, 0) == 0)
+#define DR_TEST_YIELD() SwitchToThread()
+#else
+#include <sched.h>
+#define DR_TEST_EXCHANGE_POINTER(P, V) __atomic_exchange_n((P), (V), __ATOMIC_SEQ_CST)
+#define DR_TEST_TRY_CLAIM(P) __sync_bool_compare_and_swap((P), 0, 1)
+#define DR_TEST_YIELD() sched_yield()
+#endif
+
+void
+dr_test_command_queue_init
+(
+	dr_test_command_queue_t * queue
+) {
+	memset(queue, 0, sizeof(*queue));
+	queue->head = &queue->stub;
+	queue->tail = &queue->stub;
+}
+
+void
+dr_test_command_init
+(
+	dr_test_command_t * command,
+	dr_test_command_fn fn,
+	void * target,
+	void * args
+) {
+	command->next = NULL;
+	command->fn = fn;
+	command->target = target;
+	command->args = args;
+	command->result = AUD_SUCCESS;
+	command->done = AUD_FALSE;
+#ifdef WIN32
+	InitializeSRWLock(&command->lock);
+	InitializeConditionVariable(&command->cond);
+#else
+	pthread_mutex_init(&command->lock, NULL);
+	pthread_cond_init(&command->cond, NULL);
+#endif
+}
+
+void
+dr_test_command_queue_push
+(
+	dr_test_command_queue_t * queue,
+	dr_test_command_t * command
+) {
+	dr_test_command_t * prev;
+
+	command->next = NULL;
+	// full barrier: the command is complete before it becomes reachable
+	prev = DR_TEST_EXCHANGE_POINTER(&queue->head, command);
+	prev->next = command;
+	DR_TEST_MEMORY_BARRIER();
+}
+
+// Returns NULL when empty, or while a producer is between swapping the head
+// and linking its command. That producer wakes the consumer afterwards.
+static dr_test_command_t *
+dr_test_command_queue_pop
+(
+	dr_test_command_queue_t * queue
+) {
+	dr_test_command_t * tail = queue->tail;
+	dr_test_command_t * next = tail->next;
+
+	if (tail == &queue->stub)
+	{
+		if (!next)
+		{
+			return NULL;
+		}
+		queue->tail = next;
+		tail = next;
+		next = next->next;
+	}
+	if (next)
+	{
+		queue->tail = next;
+		DR_TEST_MEMORY_BARRIER();
+		return tail;
+	}
+	if (tail != queue->head)
+	{
+		return NULL;
+	}
+	dr_test_command_queue_push(queue, &queue->stub);
+	next = tail->next;
+	if (next)
+	{
+		queue->tail = next;
+		DR_TEST_MEMORY_BARRIER();
+		return tail;
+	}
+	return NULL;
+}
+
+static void
+dr_test_command_complete
+(
+	dr_test_command_t * command,
+	aud_error_t result
+) {
+	// the submitter may return as soon as 'done' is seen under the lock,
+	// so the command must not be touched after unlocking
+#ifdef WIN32
+	AcquireSRWLockExclusive(&command->lock);
+	command->result = result;
+	command->done = AUD_TRUE;
+	WakeConditionVariable(&command->cond);
+	ReleaseSRWLockExclusive(&command->lock);
+#else
+	pthread_mutex_lock(&command->lock);
+	command->result = result;
+	command->done = AUD_TRUE;
+	pthread_cond_signal(&command->cond);
+	pthread_mutex_unlock(&command->lock);
+#endif
+}
+
+static unsigned int
+dr_test_command_queue_execute
+(
+	dr_test_command_queue_t * queue,
+	unsigned int limit
+) {
+	unsigned int n = 0;
+	dr_test_command_t * command;
+
+	while (n < limit && (command = dr_test_command_queue_pop(queue)) != NULL)
+	{
+		dr_test_command_complete(command, command->fn(command->target, command->args));
+		n++;
+	}
+	return n;
+}
+
+void
+dr_test_command_queue_attach
+(
+	dr_test_command_queue_t * queue
+) {
+	queue->consumer_known = AUD_FALSE;
+	DR_TEST_MEMORY_BARRIER();
+	queue->attached = AUD_TRUE;
+}
+
+// Empties a detached queue unless another thread is already doing so
+static aud_bool_t
+dr_test_command_queue_drain
+(
+	dr_test_command_queue_t * queue
+) {
+	if (!DR_TEST_TRY_CLAIM(&queue->draining))
+	{
+		return AUD_FALSE;
+	}
+	while (dr_test_command_queue_execute(queue, DR_TEST_COMMAND_RUN_LIMIT))
+	{
+	}
+	DR_TEST_MEMORY_BARRIER();
+	queue->draining = 0;
+	return AUD_TRUE;
+}
+
+void
+dr_test_command_queue_detach
+(
+	dr_test_command_queue_t * queue
+) {
+	queue->attached = AUD_FALSE;
+	queue->consumer_known = AUD_FALSE;
+
+	// pairs with the barrier after a push: either the drain below sees the
+	// command or its submitter sees the queue detached and drains it itself
+	DR_TEST_MEMORY_BARRIER();
+	while (!dr_test_command_queue_drain(queue))
+	{
+		DR_TEST_YIELD();
+	}
+}
+
+aud_bool_t
+dr_test_command_queue_is_remote
+(
+	const dr_test_command_queue_t * queue
+) {
+	if (!queue->attached)
+	{
+		return AUD_FALSE;
+	}
+	// commands issued from event callbacks run on the consumer itself
+	return !(queue->consumer_known && DR_TEST_SAME_THREAD(queue->consumer, DR_TEST_CURRENT_THREAD_ID()));
+}
+
+aud_bool_t
+dr_test_command_queue_run
+(
+	dr_test_command_queue_t * queue
+) {
+	if (!queue->consumer_known)
+	{
+		queue->consumer = DR_TEST_CURRENT_THREAD_ID();
+		DR_TEST_MEMORY_BARRIER();
+		queue->consumer_known = AUD_TRUE;
+	}
+	return dr_test_command_queue_execute(queue, DR_TEST_COMMAND_RUN_LIMIT) == DR_TEST_COMMAND_RUN_LIMIT;
+}
+
+aud_error_t
+dr_test_command_wait
+(
+	dr_test_command_queue_t * queue,
+	dr_test_command_t * command
+) {
+#ifdef WIN32
+	AcquireSRWLockExclusive(&command->lock);
+	while (!command->done)
+	{
+		if (queue->attached)
+		{
+			SleepConditionVariableSRW(&command->cond, &command->lock, INFINITE, 0);
+		}
+		else
+		{
+			// the consumer went away after this command was pushed
+			ReleaseSRWLockExclusive(&command->lock);
+			if (!dr_test_command_queue_drain(queue))
+			{
+				DR_TEST_YIELD();
+			}
+			AcquireSRWLockExclusive(&command->lock);
+		}
+	}
+	ReleaseSRWLockExclusive(&command->lock);
+#else
+	pthread_mutex_lock(&command->lock);
+	while (!command->done)
+	{
+		if (queue->attached)
+		{
+			pthread_cond_wait(&command->cond, &command->lock);
+		}
+		else
+		{
+			// the consumer went away after this command was pushed
+			pthread_mutex_unlock(&command->lock);
+			if (!dr_test_command_queue_drain(queue))
+			{
+				DR_TEST_YIELD();
+			}
+			pthread_mutex_lock(&command->lock);
+		}
+	}
+	pthread_mutex_unlock(&command->lock);
+	pthread_cond_destroy(&command->cond);
+	pthread_mutex_destroy(&command->lock);
+#endif
+	return command->result;
+}
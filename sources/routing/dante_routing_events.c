@@ -0,0 +1,53 @@
+/*
+ * File     : dante_routing_events.c
+ * Synopsis : Typed device/domain events for the .Net wrapper.
+ *
+ * Events are fixed-size records in a per-handle single-producer /
+ * single-consumer ring, drained in bulk by managed code instead of
+ * formatting and re-parsing text for every notification.
+ */
+#include "dante_routing_test.h"
+
+void
+dr_test_event_ring_push
+(
+	dr_test_event_ring_t * ring,
+	const dr_test_event_t * event
+) {
+	uint32_t head = ring->head;
+
+	if (head - ring->tail >= DR_TEST_EVENT_RING_CAPACITY)
+	{
+		ring->dropped++;
+		return;
+	}
+	ring->events[head & (DR_TEST_EVENT_RING_CAPACITY - 1)] = *event;
+
+	// publish the record before the new head
+	DR_TEST_MEMORY_BARRIER();
+	ring->head = head + 1;
+}
+
+unsigned int
+dr_test_event_ring_drain
+(
+	dr_test_event_ring_t * ring,
+	dr_test_event_t * events,
+	unsigned int capacity
+) {
+	uint32_t tail = ring->tail;
+	uint32_t available = ring->head - tail;
+	unsigned int i, n = (available < capacity) ? available : capacity;
+
+	// read the records only after observing the head
+	DR_TEST_MEMORY_BARRIER();
+	for (i = 0; i < n; i++)
+	{
+		events[i] = ring->events[(tail + i) & (DR_TEST_EVENT_RING_CAPACITY - 1)];
+	}
+
+	// finish reading before handing the slots back
+	DR_TEST_MEMORY_BARRIER();
+	ring->tail = tail + n;
+	return n;
+}
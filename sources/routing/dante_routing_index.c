@@ -0,0 +1,206 @@
+/*
+ * File     : dante_routing_index.c
+ * Synopsis : Name index resolving "channel@device" subscription targets.
+ *
+ * Every tx channel name and tx label of the devices open in a session is
+ * hashed once, when the device reports a change, so validating a target is
+ * a bucket walk instead of opening the tx device and searching its channels.
+ */
+#include "dante_routing_test.h"
+#include "dapi_utils.h"
+#include <string.h>
+
+static uint32_t
+dr_test_name_hash_add
+(
+	uint32_t h,
+	const char * value
+) {
+	// Dante names compare case-insensitively; the terminator separates device and name
+	do
+	{
+		h ^= (uint8_t) tolower((unsigned char) *value);
+		h *= 16777619u;
+	} while (*value++);
+	return h;
+}
+
+static uint32_t
+dr_test_name_hash
+(
+	const char * device,
+	const char * name
+) {
+	return dr_test_name_hash_add(dr_test_name_hash_add(2166136261u, device), name);
+}
+
+static uint32_t *
+dr_test_name_bucket
+(
+	const dr_test_name_index_t * index,
+	uint32_t hash
+) {
+	return index->buckets + (hash & (index->num_buckets - 1));
+}
+
+// Doubles the entries, and the buckets with them, keeping one bucket per entry
+static aud_error_t
+dr_test_name_index_grow
+(
+	dr_test_name_index_t * index
+) {
+	uint32_t capacity = index->capacity ? index->capacity * 2 : DR_TEST_NAME_INDEX_MIN_CAPACITY;
+	dr_test_name_entry_t * entries;
+	uint32_t * buckets;
+	uint32_t i;
+
+	entries = (dr_test_name_entry_t *) realloc(index->entries, capacity * sizeof(dr_test_name_entry_t));
+	if (!entries)
+	{
+		return AUD_ERR_NOMEMORY;
+	}
+	index->entries = entries;
+	buckets = (uint32_t *) realloc(index->buckets, capacity * sizeof(uint32_t));
+	if (!buckets)
+	{
+		return AUD_ERR_NOMEMORY;
+	}
+	index->buckets = buckets;
+	index->num_buckets = capacity;
+
+	for (i = index->capacity; i < capacity; i++)
+	{
+		entries[i].owner = NULL;
+		entries[i].next = (i + 1 < capacity) ? i + 1 : index->free_head;
+	}
+	index->free_head = index->capacity;
+	index->capacity = capacity;
+
+	for (i = 0; i < capacity; i++)
+	{
+		buckets[i] = DR_TEST_NAME_NONE;
+	}
+	for (i = 0; i < capacity; i++)
+	{
+		if (entries[i].owner)
+		{
+			uint32_t * bucket = dr_test_name_bucket(index, entries[i].hash);
+			entries[i].next = *bucket;
+			*bucket = i;
+		}
+	}
+	return AUD_SUCCESS;
+}
+
+void
+dr_test_name_index_free
+(
+	dr_test_name_index_t * index
+) {
+	free(index->entries);
+	free(index->buckets);
+	memset(index, 0, sizeof(dr_test_name_index_t));
+}
+
+aud_error_t
+dr_test_name_index_add
+(
+	dr_test_name_index_t * index,
+	uint32_t * owned,
+	void * owner,
+	const char * device,
+	const char * name,
+	dante_id_t channel_id,
+	aud_bool_t is_label
+) {
+	dr_test_name_entry_t * entry;
+	uint32_t * bucket;
+	uint32_t slot;
+
+	if (!name || !name[0])
+	{
+		return AUD_SUCCESS;
+	}
+	if (index->num_in_use == index->capacity)
+	{
+		aud_error_t result = dr_test_name_index_grow(index);
+		if (result != AUD_SUCCESS)
+		{
+			return result;
+		}
+	}
+	slot = index->free_head;
+	entry = index->entries + slot;
+	index->free_head = entry->next;
+	index->num_in_use++;
+
+	entry->hash = dr_test_name_hash(device, name);
+	entry->owner = owner;
+	entry->channel_id = channel_id;
+	entry->is_label = is_label;
+	aud_strlcpy(entry->device, device, DANTE_NAME_LENGTH);
+	aud_strlcpy(entry->name, name, DANTE_NAME_LENGTH);
+
+	bucket = dr_test_name_bucket(index, entry->hash);
+	entry->next = *bucket;
+	*bucket = slot;
+	entry->next_owned = *owned;
+	*owned = slot;
+	return AUD_SUCCESS;
+}
+
+void
+dr_test_name_index_remove
+(
+	dr_test_name_index_t * index,
+	uint32_t * owned
+) {
+	while (*owned != DR_TEST_NAME_NONE)
+	{
+		uint32_t slot = *owned;
+		dr_test_name_entry_t * entry = index->entries + slot;
+		uint32_t * link = dr_test_name_bucket(index, entry->hash);
+
+		while (*link != slot)
+		{
+			link = &index->entries[*link].next;
+		}
+		*link = entry->next;
+		*owned = entry->next_owned;
+
+		entry->owner = NULL;
+		entry->next = index->free_head;
+		index->free_head = slot;
+		index->num_in_use--;
+	}
+}
+
+const dr_test_name_entry_t *
+dr_test_name_index_find
+(
+	const dr_test_name_index_t * index,
+	const char * device,
+	const char * name
+) {
+	const dr_test_name_entry_t * label = NULL;
+	uint32_t hash, slot;
+
+	if (!index->num_in_use)
+	{
+		return NULL;
+	}
+	hash = dr_test_name_hash(device, name);
+	for (slot = *dr_test_name_bucket(index, hash); slot != DR_TEST_NAME_NONE; slot = index->entries[slot].next)
+	{
+		const dr_test_name_entry_t * entry = index->entries + slot;
+		if (entry->hash == hash && !STRCASECMP(entry->name, name) && !STRCASECMP(entry->device, device))
+		{
+			if (!entry->is_label)
+			{
+				return entry;
+			}
+			label = entry;
+		}
+	}
+	return label;
+}
@@ -0,0 +1,981 @@
+/*
+ * File     : dante_routing_metering.c
+ * Synopsis : Conmon metering client publishing decoded peaks to a shared ring.
+ *
+ * Every metering message of a subscribed device becomes one frame of float
+ * dBFS levels in a block the .Net wrapper reads in place, so live meters for
+ * thousands of channels cost managed code one copy per frame it displays
+ * rather than a callback and a marshaled array per packet.
+ */
+#include "dante_routing_test.h"
+#include "dapi_utils.h"
+#include "audinate/conmon/conmon_metering.h"
+#include <string.h>
+#include <math.h>
+
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DR_TEST_METER_SSE2 1
+#else
+#define DR_TEST_METER_SSE2 0
+#endif
+
+typedef struct dr_test_meter_slot
+{
+	conmon_instance_id_t instance_id;
+	aud_bool_t has_instance_id;
+	aud_bool_t subscribed;   // request sent since conmon became remote ready
+	aud_bool_t fresh;        // a message arrived since the last view frame
+	aud_utime_t last_message;
+} dr_test_meter_slot_t;
+
+// Ballistics of one channel, in dBFS
+typedef struct dr_test_meter_state
+{
+	float level;
+	float hold;
+	float hold_age_ms;
+	float clip_age_ms;
+	uint8_t flags;           // DR_TEST_METER_VIEW_CLIP*
+} dr_test_meter_state_t;
+
+struct dr_test_metering
+{
+	conmon_client_t * client;
+	aud_bool_t registered;   // rx metering messages are delivered to us
+
+	dr_test_meter_ring_t * ring;
+	dr_test_meter_device_t * devices;  // in the ring
+	uint8_t * frames;                  // in the ring
+	dr_test_meter_slot_t * slots;
+
+	// ballistics, allocated by the first dr_test_metering_set_ballistics;
+	// per channel of every slot, laid out like the peaks of a frame
+	dr_test_meter_ballistics_t ballistics;
+	dr_test_meter_view_t * view;
+	float * input;           // highest peak since the last view frame
+	dr_test_meter_state_t * state;
+	aud_utime_t last_tick;
+	aud_utime_t next_tick;
+};
+
+//----------------------------------------------------------
+// Peak decoding
+//----------------------------------------------------------
+
+static float
+dr_test_meter_peak_to_db
+(
+	uint8_t peak
+) {
+	if (peak == CONMON_METERING_PEAK_CLIP)
+	{
+		return DR_TEST_METER_CLIP_DB;
+	}
+	if (peak > CONMON_METERING_PEAK_MINUS_126_DB)
+	{
+		return DR_TEST_METER_MUTE_DB;
+	}
+	// 1..253 -> 0..-126
+	return (peak - 1) * -0.5f;
+}
+
+#if DR_TEST_METER_SSE2
+// Four peaks, widened to 32 bits, to dBFS with the markers patched in
+static __m128
+dr_test_meter_decode4
+(
+	__m128i peaks
+) {
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 step = _mm_set1_ps(-0.5f);
+	const __m128 last = _mm_set1_ps((float) CONMON_METERING_PEAK_MINUS_126_DB);
+	__m128 p = _mm_cvtepi32_ps(peaks);
+	__m128 db = _mm_mul_ps(_mm_sub_ps(p, one), step);
+	__m128 clip = _mm_cmpeq_ps(p, _mm_setzero_ps());
+	__m128 mute = _mm_cmpgt_ps(p, last);
+
+	db = _mm_andnot_ps(_mm_or_ps(clip, mute), db);
+	db = _mm_or_ps(db, _mm_and_ps(clip, _mm_set1_ps(DR_TEST_METER_CLIP_DB)));
+	return _mm_or_ps(db, _mm_and_ps(mute, _mm_set1_ps(DR_TEST_METER_MUTE_DB)));
+}
+#endif
+
+void
+dr_test_meter_decode_peaks
+(
+	const uint8_t * peaks,
+	float * levels,
+	unsigned int count
+) {
+	unsigned int i = 0;
+
+#if DR_TEST_METER_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i bytes = _mm_loadu_si128((const __m128i *) (peaks + i));
+		__m128i lo = _mm_unpacklo_epi8(bytes, zero);
+		__m128i hi = _mm_unpackhi_epi8(bytes, zero);
+
+		_mm_storeu_ps(levels + i, dr_test_meter_decode4(_mm_unpacklo_epi16(lo, zero)));
+		_mm_storeu_ps(levels + i + 4, dr_test_meter_decode4(_mm_unpackhi_epi16(lo, zero)));
+		_mm_storeu_ps(levels + i + 8, dr_test_meter_decode4(_mm_unpacklo_epi16(hi, zero)));
+		_mm_storeu_ps(levels + i + 12, dr_test_meter_decode4(_mm_unpackhi_epi16(hi, zero)));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		levels[i] = dr_test_meter_peak_to_db(peaks[i]);
+	}
+}
+
+//----------------------------------------------------------
+// Ring
+//----------------------------------------------------------
+
+static uint32_t
+dr_test_meter_align
+(
+	uint32_t size
+) {
+	return (size + 15) & ~15u;
+}
+
+static dr_test_meter_ring_t *
+dr_test_meter_ring_new
+(
+	uint16_t max_devices,
+	uint16_t max_channels,
+	uint32_t capacity
+) {
+	dr_test_meter_ring_t * ring;
+	uint32_t devices_offset = dr_test_meter_align((uint32_t) sizeof(dr_test_meter_ring_t));
+	uint32_t frames_offset = dr_test_meter_align(devices_offset + max_devices * (uint32_t) sizeof(dr_test_meter_device_t));
+	uint32_t frame_size = dr_test_meter_align((uint32_t) (sizeof(dr_test_meter_frame_t) + 2u * max_channels * sizeof(float)));
+	size_t size = (size_t) frames_offset + (size_t) capacity * frame_size;
+
+	if (size > UINT32_MAX)
+	{
+		return NULL;
+	}
+	ring = (dr_test_meter_ring_t *) calloc(1, size);
+	if (!ring)
+	{
+		return NULL;
+	}
+	ring->size = (uint32_t) size;
+	ring->capacity = capacity;
+	ring->frame_size = frame_size;
+	ring->frames_offset = frames_offset;
+	ring->devices_offset = devices_offset;
+	ring->max_devices = max_devices;
+	ring->max_channels = max_channels;
+	return ring;
+}
+
+// Keeps the highest peak of each channel until the next view frame; the
+// first message after a frame replaces the previous peaks
+static void
+dr_test_meter_accumulate
+(
+	float * input,
+	const float * levels,
+	unsigned int count,
+	unsigned int max_channels,
+	aud_bool_t fresh
+) {
+	unsigned int i = 0;
+
+	if (!fresh)
+	{
+		memcpy(input, levels, count * sizeof(float));
+		for (i = count; i < max_channels; i++)
+		{
+			input[i] = DR_TEST_METER_MUTE_DB;
+		}
+		return;
+	}
+#if DR_TEST_METER_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		_mm_storeu_ps(input + i, _mm_max_ps(_mm_loadu_ps(input + i), _mm_loadu_ps(levels + i)));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		if (levels[i] > input[i])
+		{
+			input[i] = levels[i];
+		}
+	}
+}
+
+static void
+dr_test_meter_publish
+(
+	dr_test_metering_t * metering,
+	uint16_t slot,
+	uint16_t seqnum,
+	const conmon_metering_message_peak_t * tx_peaks,
+	uint16_t num_tx,
+	const conmon_metering_message_peak_t * rx_peaks,
+	uint16_t num_rx
+) {
+	dr_test_meter_ring_t * ring = metering->ring;
+	uint32_t n = ring->head + 1;
+	dr_test_meter_frame_t * frame = (dr_test_meter_frame_t *)
+		(metering->frames + (size_t) ((n - 1) & (ring->capacity - 1)) * ring->frame_size);
+	float * levels = (float *) (frame + 1);
+	aud_utime_t now;
+
+	if (num_tx > ring->max_channels || num_rx > ring->max_channels)
+	{
+		ring->truncated++;
+		num_tx = (num_tx > ring->max_channels) ? ring->max_channels : num_tx;
+		num_rx = (num_rx > ring->max_channels) ? ring->max_channels : num_rx;
+	}
+	aud_utime_get(&now);
+
+	// readers of the frame's previous contents see it change before the data does
+	frame->sequence = 0;
+	DR_TEST_MEMORY_BARRIER();
+	frame->device = slot;
+	frame->seqnum = seqnum;
+	frame->num_tx = tx_peaks ? num_tx : 0;
+	frame->num_rx = rx_peaks ? num_rx : 0;
+	frame->timestamp_ms = (uint32_t) ((uint64_t) now.tv_sec * 1000 + now.tv_usec / 1000);
+	if (tx_peaks)
+	{
+		dr_test_meter_decode_peaks(tx_peaks, levels, num_tx);
+	}
+	if (rx_peaks)
+	{
+		dr_test_meter_decode_peaks(rx_peaks, levels + ring->max_channels, num_rx);
+	}
+
+	// publish the frame before pointing at it
+	DR_TEST_MEMORY_BARRIER();
+	frame->sequence = n;
+	metering->devices[slot].last_frame = n;
+	ring->head = n;
+
+	if (metering->input)
+	{
+		float * input = metering->input + (size_t) slot * 2 * ring->max_channels;
+		aud_bool_t fresh = metering->slots[slot].fresh;
+		dr_test_meter_accumulate(input, levels, frame->num_tx, ring->max_channels, fresh);
+		dr_test_meter_accumulate(input + ring->max_channels, levels + ring->max_channels,
+			frame->num_rx, ring->max_channels, fresh);
+		metering->slots[slot].fresh = AUD_TRUE;
+		metering->slots[slot].last_message = now;
+	}
+}
+
+//----------------------------------------------------------
+// Ballistics
+//----------------------------------------------------------
+
+static void
+dr_test_meter_reset_state
+(
+	dr_test_metering_t * metering,
+	uint16_t slot
+) {
+	unsigned int channels = 2u * metering->ring->max_channels;
+	size_t first = (size_t) slot * channels;
+	unsigned int c;
+
+	if (!metering->state)
+	{
+		return;
+	}
+	for (c = 0; c < channels; c++)
+	{
+		dr_test_meter_state_t * state = metering->state + first + c;
+		metering->input[first + c] = DR_TEST_METER_MUTE_DB;
+		state->level = DR_TEST_METER_MUTE_DB;
+		state->hold = DR_TEST_METER_MUTE_DB;
+		state->hold_age_ms = 0.0f;
+		state->clip_age_ms = 0.0f;
+		state->flags = 0;
+	}
+}
+
+static int64_t
+dr_test_meter_us_since
+(
+	const aud_utime_t * now,
+	const aud_utime_t * then
+) {
+	return (int64_t) (now->tv_sec - then->tv_sec) * 1000000 + (now->tv_usec - then->tv_usec);
+}
+
+static void
+dr_test_meter_add_us
+(
+	aud_utime_t * time,
+	int64_t us
+) {
+	time->tv_usec += (long) (us % 1000000);
+	time->tv_sec += (long) (us / 1000000) + time->tv_usec / 1000000;
+	time->tv_usec %= 1000000;
+}
+
+static uint8_t
+dr_test_meter_view_level
+(
+	float db
+) {
+	if (db < -126.0f)
+	{
+		return DR_TEST_METER_VIEW_MUTE;
+	}
+	if (db >= 0.0f)
+	{
+		return 0;
+	}
+	return (uint8_t) (-db * 2.0f + 0.5f);
+}
+
+static void
+dr_test_meter_apply
+(
+	const dr_test_meter_ballistics_t * ballistics,
+	dr_test_meter_state_t * state,
+	float input,
+	float attack,
+	float dt_ms
+) {
+	float dt_s = dt_ms / 1000.0f;
+
+	if (input > state->level)
+	{
+		state->level += (input - state->level) * attack;
+	}
+	else
+	{
+		state->level -= ballistics->release_db_per_s * dt_s;
+		if (state->level < input)
+		{
+			state->level = input;
+		}
+	}
+
+	if (input >= state->hold)
+	{
+		state->hold = input;
+		state->hold_age_ms = 0.0f;
+	}
+	else
+	{
+		state->hold_age_ms += dt_ms;
+		if (state->hold_age_ms > ballistics->hold_ms)
+		{
+			state->hold -= ballistics->hold_decay_db_per_s * dt_s;
+		}
+		if (state->hold < state->level)
+		{
+			state->hold = state->level;
+		}
+	}
+
+	if (input >= DR_TEST_METER_CLIP_DB)
+	{
+		state->flags = DR_TEST_METER_VIEW_CLIP | DR_TEST_METER_VIEW_CLIP_LATCHED;
+		state->clip_age_ms = 0.0f;
+	}
+	else
+	{
+		state->flags &= ~DR_TEST_METER_VIEW_CLIP;
+		if ((state->flags & DR_TEST_METER_VIEW_CLIP_LATCHED) && ballistics->clip_hold_ms > 0.0f)
+		{
+			state->clip_age_ms += dt_ms;
+			if (state->clip_age_ms >= ballistics->clip_hold_ms)
+			{
+				state->flags &= ~DR_TEST_METER_VIEW_CLIP_LATCHED;
+			}
+		}
+	}
+}
+
+aud_error_t
+dr_test_metering_set_ballistics
+(
+	dr_test_metering_t * metering,
+	const dr_test_meter_ballistics_t * ballistics,
+	dr_test_meter_view_t ** view
+) {
+	dr_test_meter_ring_t * ring = metering->ring;
+	size_t channels = (size_t) ring->max_devices * 2 * ring->max_channels;
+	uint16_t i;
+
+	if (ballistics->rate_hz > DR_TEST_METER_MAX_RATE_HZ
+		|| !(ballistics->attack_ms >= 0.0f) || !(ballistics->release_db_per_s >= 0.0f)
+		|| !(ballistics->hold_ms >= 0.0f) || !(ballistics->hold_decay_db_per_s >= 0.0f)
+		|| !(ballistics->clip_hold_ms >= 0.0f))
+	{
+		return AUD_ERR_INVALIDPARAMETER;
+	}
+
+	if (!metering->view)
+	{
+		uint32_t frames_offset = dr_test_meter_align((uint32_t) sizeof(dr_test_meter_view_t));
+		size_t frame_size = dr_test_meter_align((uint32_t) sizeof(dr_test_meter_view_frame_t))
+			+ channels * sizeof(dr_test_meter_view_channel_t);
+		size_t size = frames_offset + DR_TEST_METER_VIEW_FRAMES * frame_size;
+
+		if (size > UINT32_MAX)
+		{
+			return AUD_ERR_NOMEMORY;
+		}
+		metering->view = (dr_test_meter_view_t *) calloc(1, size);
+		metering->input = (float *) calloc(channels, sizeof(float));
+		metering->state = (dr_test_meter_state_t *) calloc(channels, sizeof(dr_test_meter_state_t));
+		if (!metering->view || !metering->input || !metering->state)
+		{
+			free(metering->view);
+			free(metering->input);
+			free(metering->state);
+			metering->view = NULL;
+			metering->input = NULL;
+			metering->state = NULL;
+			return AUD_ERR_NOMEMORY;
+		}
+		metering->view->size = (uint32_t) size;
+		metering->view->frame_size = (uint32_t) frame_size;
+		metering->view->frames_offset = frames_offset;
+		metering->view->max_devices = ring->max_devices;
+		metering->view->max_channels = ring->max_channels;
+		for (i = 0; i < ring->max_devices; i++)
+		{
+			dr_test_meter_reset_state(metering, i);
+			metering->slots[i].fresh = AUD_FALSE;
+		}
+	}
+
+	metering->ballistics = *ballistics;
+	metering->view->rate_hz = ballistics->rate_hz;
+	// the next tick publishes right away
+	memset(&metering->next_tick, 0, sizeof(aud_utime_t));
+	*view = metering->view;
+	return AUD_SUCCESS;
+}
+
+void
+dr_test_metering_clear_clips
+(
+	dr_test_metering_t * metering,
+	int slot
+) {
+	unsigned int channels = 2u * metering->ring->max_channels;
+	size_t c, first = 0, last = (size_t) metering->ring->max_devices * channels;
+
+	if (!metering->state)
+	{
+		return;
+	}
+	if (slot >= 0 && slot < metering->ring->max_devices)
+	{
+		first = (size_t) slot * channels;
+		last = first + channels;
+	}
+	for (c = first; c < last; c++)
+	{
+		metering->state[c].flags &= ~DR_TEST_METER_VIEW_CLIP_LATCHED;
+	}
+}
+
+int64_t
+dr_test_metering_tick
+(
+	dr_test_metering_t * metering,
+	const aud_utime_t * now
+) {
+	const dr_test_meter_ballistics_t * ballistics = &metering->ballistics;
+	dr_test_meter_view_t * view = metering->view;
+	uint32_t channels;
+	int64_t period_us, until_us, dt_us;
+	dr_test_meter_view_frame_t * frame;
+	dr_test_meter_view_channel_t * out;
+	float dt_ms, attack;
+	uint32_t n;
+	uint16_t d;
+
+	if (!view || !ballistics->rate_hz)
+	{
+		return -1;
+	}
+	channels = 2u * view->max_channels;
+	period_us = 1000000 / ballistics->rate_hz;
+	until_us = -dr_test_meter_us_since(now, &metering->next_tick);
+	if (until_us > 0)
+	{
+		return (until_us + 999) / 1000;
+	}
+
+	// frames keep the rate on average, a stall restarts the schedule
+	dr_test_meter_add_us(&metering->next_tick, period_us);
+	if (dr_test_meter_us_since(now, &metering->next_tick) >= 0)
+	{
+		metering->next_tick = *now;
+		dr_test_meter_add_us(&metering->next_tick, period_us);
+	}
+
+	dt_us = dr_test_meter_us_since(now, &metering->last_tick);
+	if (dt_us < 0 || dt_us > DR_TEST_METER_STALE_MS * 1000)
+	{
+		dt_us = DR_TEST_METER_STALE_MS * 1000;
+	}
+	metering->last_tick = *now;
+	dt_ms = dt_us / 1000.0f;
+	attack = (ballistics->attack_ms > 0.0f) ? 1.0f - expf(-dt_ms / ballistics->attack_ms) : 1.0f;
+
+	n = view->head + 1;
+	frame = (dr_test_meter_view_frame_t *) ((uint8_t *) view + view->frames_offset
+		+ (size_t) ((n - 1) % DR_TEST_METER_VIEW_FRAMES) * view->frame_size);
+	out = (dr_test_meter_view_channel_t *) ((uint8_t *) frame + dr_test_meter_align((uint32_t) sizeof(dr_test_meter_view_frame_t)));
+
+	frame->sequence = 0;
+	DR_TEST_MEMORY_BARRIER();
+	frame->timestamp_ms = (uint32_t) ((uint64_t) now->tv_sec * 1000 + now->tv_usec / 1000);
+	frame->interval_ms = (uint32_t) (dt_us / 1000);
+	for (d = 0; d < view->max_devices; d++)
+	{
+		dr_test_meter_slot_t * slot = metering->slots + d;
+		size_t first = (size_t) d * channels;
+		aud_bool_t stale;
+		uint32_t c;
+
+		if (!metering->devices[d].in_use)
+		{
+			memset(out + first, 0, channels * sizeof(dr_test_meter_view_channel_t));
+			continue;
+		}
+		stale = !slot->fresh
+			&& dr_test_meter_us_since(now, &slot->last_message) > DR_TEST_METER_STALE_MS * 1000;
+		for (c = 0; c < channels; c++)
+		{
+			dr_test_meter_state_t * state = metering->state + first + c;
+			dr_test_meter_view_channel_t * channel = out + first + c;
+
+			dr_test_meter_apply(ballistics, state,
+				stale ? DR_TEST_METER_MUTE_DB : metering->input[first + c], attack, dt_ms);
+			channel->level = dr_test_meter_view_level(state->level);
+			channel->hold = dr_test_meter_view_level(state->hold);
+			channel->flags = state->flags;
+			channel->reserved = 0;
+		}
+		// without a new message the last peaks stand in for the next frame
+		slot->fresh = AUD_FALSE;
+	}
+
+	DR_TEST_MEMORY_BARRIER();
+	frame->sequence = n;
+	view->head = n;
+
+	until_us = -dr_test_meter_us_since(now, &metering->next_tick);
+	return (until_us + 999) / 1000;
+}
+
+//----------------------------------------------------------
+// Conmon client
+//----------------------------------------------------------
+
+static void
+dr_test_metering_on_response
+(
+	conmon_client_t * client,
+	conmon_client_request_id_t request_id,
+	aud_error_t result
+) {
+	AUD_UNUSED(client);
+	AUD_UNUSED(request_id);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Metering request failed: %s\n", aud_error_message(result, g_test_errbuf));
+	}
+}
+
+static int
+dr_test_metering_find_name
+(
+	const dr_test_metering_t * metering,
+	const char * name
+) {
+	uint16_t i;
+	for (i = 0; i < metering->ring->max_devices; i++)
+	{
+		if (metering->devices[i].in_use && !STRCASECMP(metering->devices[i].name, name))
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+static int
+dr_test_metering_find_instance
+(
+	dr_test_metering_t * metering,
+	const conmon_instance_id_t * instance_id
+) {
+	const char * name;
+	uint16_t i;
+	int slot;
+
+	for (i = 0; i < metering->ring->max_devices; i++)
+	{
+		if (metering->devices[i].in_use && metering->slots[i].has_instance_id
+			&& !memcmp(&metering->slots[i].instance_id, instance_id, sizeof(conmon_instance_id_t)))
+		{
+			return i;
+		}
+	}
+
+	// first message of the device, remember its instance for the next ones
+	name = conmon_client_device_name_for_instance_id(metering->client, instance_id);
+	slot = name ? dr_test_metering_find_name(metering, name) : -1;
+	if (slot >= 0)
+	{
+		metering->slots[slot].instance_id = *instance_id;
+		metering->slots[slot].has_instance_id = AUD_TRUE;
+	}
+	return slot;
+}
+
+static void
+dr_test_metering_send_subscribe
+(
+	dr_test_metering_t * metering,
+	uint16_t slot
+) {
+	aud_error_t result;
+
+	if (!metering->registered || metering->slots[slot].subscribed)
+	{
+		return;
+	}
+	result = conmon_client_subscribe(metering->client, &dr_test_metering_on_response, NULL,
+		CONMON_CHANNEL_TYPE_METERING, metering->devices[slot].name);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error subscribing to metering of %s: %s\n",
+			metering->devices[slot].name, aud_error_message(result, g_test_errbuf));
+		return;
+	}
+	metering->slots[slot].subscribed = AUD_TRUE;
+}
+
+static void
+dr_test_metering_on_message
+(
+	conmon_client_t * client,
+	conmon_channel_type_t type,
+	conmon_channel_direction_t channel_direction,
+	const conmon_message_head_t * head,
+	const conmon_message_body_t * body
+) {
+	dr_test_metering_t * metering = (dr_test_metering_t *) conmon_client_context(client);
+	conmon_metering_message_version_t version;
+	conmon_instance_id_t instance_id;
+	uint16_t num_tx, num_rx;
+	int slot;
+
+	AUD_UNUSED(type);
+	AUD_UNUSED(channel_direction);
+	if (!conmon_vendor_id_equals(conmon_message_head_get_vendor_id(head), CONMON_VENDOR_ID_AUDINATE)
+		|| conmon_metering_message_parse(body, &version, &num_tx, &num_rx) != AUD_SUCCESS)
+	{
+		return;
+	}
+	conmon_message_head_get_instance_id(head, &instance_id);
+	slot = dr_test_metering_find_instance(metering, &instance_id);
+	if (slot < 0)
+	{
+		return;
+	}
+	dr_test_meter_publish(metering, (uint16_t) slot, (uint16_t) conmon_message_head_get_seqnum(head),
+		conmon_metering_message_get_peaks_const(body, CONMON_CHANNEL_DIRECTION_TX), num_tx,
+		conmon_metering_message_get_peaks_const(body, CONMON_CHANNEL_DIRECTION_RX), num_rx);
+}
+
+static void
+dr_test_metering_on_subscriptions_changed
+(
+	conmon_client_t * client,
+	unsigned int num_changes,
+	const conmon_client_subscription_t * const * changes
+) {
+	dr_test_metering_t * metering = (dr_test_metering_t *) conmon_client_context(client);
+	unsigned int i;
+
+	for (i = 0; i < num_changes; i++)
+	{
+		const conmon_client_subscription_t * sub = changes[i];
+		const conmon_instance_id_t * instance_id;
+		int slot;
+
+		if (!sub || conmon_client_subscription_get_channel_type(sub) != CONMON_CHANNEL_TYPE_METERING)
+		{
+			continue;
+		}
+		slot = dr_test_metering_find_name(metering, conmon_client_subscription_get_device_name(sub));
+		if (slot < 0)
+		{
+			continue;
+		}
+		metering->devices[slot].rxstatus = conmon_client_subscription_get_rxstatus(sub);
+		instance_id = conmon_client_subscription_get_instance_id(sub);
+		if (instance_id)
+		{
+			metering->slots[slot].instance_id = *instance_id;
+			metering->slots[slot].has_instance_id = AUD_TRUE;
+		}
+	}
+}
+
+// (Re)registers for rx metering and subscribes every device whenever
+// conmon becomes ready for remote traffic
+static void
+dr_test_metering_setup_remote
+(
+	dr_test_metering_t * metering
+) {
+	aud_error_t result;
+	uint16_t i;
+
+	if (!conmon_client_is_remote_ready(metering->client))
+	{
+		metering->registered = AUD_FALSE;
+		for (i = 0; i < metering->ring->max_devices; i++)
+		{
+			metering->slots[i].subscribed = AUD_FALSE;
+		}
+		return;
+	}
+	if (!metering->registered)
+	{
+		result = conmon_client_register_monitoring_messages(metering->client,
+			&dr_test_metering_on_response, NULL,
+			CONMON_CHANNEL_TYPE_METERING, CONMON_CHANNEL_DIRECTION_RX,
+			&dr_test_metering_on_message);
+		if (result != AUD_SUCCESS)
+		{
+			DR_TEST_ERROR("Error registering for rx metering messages: %s\n", aud_error_message(result, g_test_errbuf));
+			return;
+		}
+		metering->registered = AUD_TRUE;
+	}
+	for (i = 0; i < metering->ring->max_devices; i++)
+	{
+		if (metering->devices[i].in_use)
+		{
+			dr_test_metering_send_subscribe(metering, i);
+		}
+	}
+}
+
+static void
+dr_test_metering_on_event
+(
+	const conmon_client_event_t * ev
+) {
+	conmon_client_t * client = conmon_client_event_get_client(ev);
+	dr_test_metering_t * metering = (dr_test_metering_t *) conmon_client_context(client);
+
+	if (conmon_client_event_get_flags(ev) & CONMON_CLIENT_EVENT_FLAG__REMOTE_READY_CHANGED)
+	{
+		dr_test_metering_setup_remote(metering);
+	}
+}
+
+aud_error_t
+dr_test_metering_new
+(
+	dapi_t * dapi,
+	uint16_t port,
+	uint16_t max_devices,
+	uint16_t max_channels,
+	uint32_t capacity,
+	dr_test_metering_t ** metering_ptr
+) {
+	dr_test_metering_t * metering;
+	conmon_client_config_t * config;
+	aud_error_t result;
+	uint32_t frames = 1;
+
+	*metering_ptr = NULL;
+	if (!max_devices || !max_channels)
+	{
+		return AUD_ERR_INVALIDPARAMETER;
+	}
+	if (!capacity)
+	{
+		capacity = DR_TEST_METER_DEFAULT_CAPACITY;
+	}
+	while (frames < capacity && frames < 0x80000000u)
+	{
+		frames <<= 1;
+	}
+
+	metering = (dr_test_metering_t *) calloc(1, sizeof(dr_test_metering_t));
+	if (!metering)
+	{
+		return AUD_ERR_NOMEMORY;
+	}
+	metering->ring = dr_test_meter_ring_new(max_devices, max_channels, frames);
+	metering->slots = (dr_test_meter_slot_t *) calloc(max_devices, sizeof(dr_test_meter_slot_t));
+	if (!metering->ring || !metering->slots)
+	{
+		dr_test_metering_delete(metering);
+		return AUD_ERR_NOMEMORY;
+	}
+	metering->devices = (dr_test_meter_device_t *) ((uint8_t *) metering->ring + metering->ring->devices_offset);
+	metering->frames = (uint8_t *) metering->ring + metering->ring->frames_offset;
+
+	config = conmon_client_config_new("dante_routing_metering");
+	if (!config)
+	{
+		dr_test_metering_delete(metering);
+		return AUD_ERR_NOMEMORY;
+	}
+	conmon_client_config_set_metering_channel_enabled(config, AUD_TRUE);
+	if (port)
+	{
+		conmon_client_config_set_metering_channel_port(config, port);
+	}
+	result = conmon_client_new_dapi(dapi, config, &metering->client);
+	conmon_client_config_delete(config);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error creating metering client: %s\n", aud_error_message(result, g_test_errbuf));
+		dr_test_metering_delete(metering);
+		return result;
+	}
+	if (!conmon_client_is_metering_channel_active(metering->client))
+	{
+		DR_TEST_ERROR("Metering channel configuration failed\n");
+		dr_test_metering_delete(metering);
+		return AUD_ERR_SYSTEM;
+	}
+
+	conmon_client_set_context(metering->client, metering);
+	conmon_client_set_subscriptions_changed_callback(metering->client, &dr_test_metering_on_subscriptions_changed);
+	conmon_client_set_event_callback(metering->client, &dr_test_metering_on_event);
+	result = conmon_client_auto_connect(metering->client);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error connecting metering client: %s\n", aud_error_message(result, g_test_errbuf));
+		dr_test_metering_delete(metering);
+		return result;
+	}
+	dr_test_metering_setup_remote(metering);
+
+	*metering_ptr = metering;
+	return AUD_SUCCESS;
+}
+
+void
+dr_test_metering_delete
+(
+	dr_test_metering_t * metering
+) {
+	if (!metering)
+	{
+		return;
+	}
+	if (metering->client)
+	{
+		conmon_client_delete(metering->client);
+	}
+	free(metering->slots);
+	free(metering->input);
+	free(metering->state);
+	free(metering->view);
+	free(metering->ring);
+	free(metering);
+}
+
+dr_test_meter_ring_t *
+dr_test_metering_ring
+(
+	dr_test_metering_t * metering
+) {
+	return metering->ring;
+}
+
+aud_error_t
+dr_test_metering_subscribe
+(
+	dr_test_metering_t * metering,
+	const char * device,
+	uint16_t * slot
+) {
+	dr_test_meter_device_t * entry;
+	int found;
+	uint16_t i;
+
+	if (!device || !device[0] || strlen(device) >= DANTE_NAME_LENGTH)
+	{
+		return AUD_ERR_INVALIDPARAMETER;
+	}
+	found = dr_test_metering_find_name(metering, device);
+	if (found >= 0)
+	{
+		*slot = (uint16_t) found;
+		return AUD_SUCCESS;
+	}
+	i = 0;
+	while (i < metering->ring->max_devices && metering->devices[i].in_use)
+	{
+		i++;
+	}
+	if (i == metering->ring->max_devices)
+	{
+		return AUD_ERR_NOMEMORY;
+	}
+
+	memset(metering->slots + i, 0, sizeof(dr_test_meter_slot_t));
+	dr_test_meter_reset_state(metering, i);
+	entry = metering->devices + i;
+	entry->last_frame = 0;
+	entry->rxstatus = CONMON_RXSTATUS_NONE;
+	aud_strlcpy(entry->name, device, DANTE_NAME_LENGTH);
+	// the name is complete before readers see the slot in use
+	DR_TEST_MEMORY_BARRIER();
+	entry->in_use = 1;
+
+	dr_test_metering_send_subscribe(metering, i);
+	*slot = i;
+	return AUD_SUCCESS;
+}
+
+aud_error_t
+dr_test_metering_unsubscribe
+(
+	dr_test_metering_t * metering,
+	uint16_t slot
+) {
+	dr_test_meter_device_t * entry;
+
+	if (slot >= metering->ring->max_devices || !metering->devices[slot].in_use)
+	{
+		return AUD_ERR_INVALIDPARAMETER;
+	}
+	entry = metering->devices + slot;
+	if (metering->slots[slot].subscribed)
+	{
+		aud_error_t result = conmon_client_unsubscribe(metering->client, &dr_test_metering_on_response, NULL,
+			CONMON_CHANNEL_TYPE_METERING, entry->name);
+		if (result != AUD_SUCCESS)
+		{
+			DR_TEST_ERROR("Error unsubscribing from metering of %s: %s\n",
+				entry->name, aud_error_message(result, g_test_errbuf));
+		}
+	}
+	entry->in_use = 0;
+	entry->rxstatus = CONMON_RXSTATUS_NONE;
+	memset(metering->slots + slot, 0, sizeof(dr_test_meter_slot_t));
+	return AUD_SUCCESS;
+}
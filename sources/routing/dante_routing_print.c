@@ -427,33 +427,130 @@ dr_test_print_device_info
 }
 
 void
-dr_test_print_device_txchannels
+dr_test_get_txchannel_info
+(
+	dr_txchannel_t * txc,
+	/*[out]*/ tx_channel_info_t * info,
+	/*[out]*/ dr_test_channel_text_t * text
+) {
+	memset(info, 0, sizeof(tx_channel_info_t));
+	info->id = dr_txchannel_get_id(txc);
+	info->stale = dr_txchannel_is_stale(txc);
+	text->format[0] = '\0';
+	text->flow[0] = '\0';
+	if (info->stale)
+	{
+		return;
+	}
+
+	if (DR_TEST_PRINT_LEGACY_FORMATS)
+	{
+		dante_samplerate_t samplerate = dr_txchannel_get_sample_rate(txc);
+		uint16_t e, num_encodings = dr_txchannel_num_encodings(txc);
+		dante_encoding_t encodings[DR_TEST_MAX_ENCODINGS];
+		for (e = 0; e < num_encodings && e < DR_TEST_MAX_ENCODINGS; e++)
+		{
+			encodings[e] = dr_txchannel_encoding_at_index(txc, e);
+		}
+		dr_test_print_legacy_channel_formats(samplerate, num_encodings, encodings, text->format, sizeof(text->format));
+	}
+	else
+	{
+		dr_test_print_formats(dr_txchannel_get_formats(txc), text->format, sizeof(text->format));
+	}
+
+	info->name = dr_txchannel_get_canonical_name(txc);
+	info->format = text->format;
+	info->enabled = dr_txchannel_is_enabled(txc);
+	info->muted = dr_txchannel_is_muted(txc);
+	info->dbu = dr_txchannel_get_signal_reflevel(txc);
+}
+
+void
+dr_test_get_rxchannel_info
 (
 	dr_device_t * device,
-	/*[out]*/ char*** array,
-	/*[out]*/ int* count
+	dr_rxchannel_t * rxc,
+	/*[out]*/ rx_channel_info_t * info,
+	/*[out]*/ dr_test_channel_text_t * text
 ) {
-	/*
-	uint16_t ii;
-	set_output_array_length(sizeof(tx_channel_info_t), 3, array, count);
-	for (ii = 0; ii < 3; ii++)
+	memset(info, 0, sizeof(rx_channel_info_t));
+	info->id = dr_rxchannel_get_id(rxc);
+	info->stale = dr_rxchannel_is_stale(rxc);
+	text->format[0] = '\0';
+	text->flow[0] = '\0';
+	if (info->stale)
 	{
-		tx_channel_info_t info;
-		memset(&info, 0, sizeof(tx_channel_info_t));
-		info.id = ii;
-		info.stale = ii;
-		info.name = "test name";
-		info.format = "test format";
-		info.enabled = ii;
-		info.muted = ii;
-		info.dbu = ii;
+		return;
+	}
+
+	if (DR_TEST_PRINT_LEGACY_FORMATS)
+	{
+		dante_samplerate_t samplerate = dr_rxchannel_get_sample_rate(rxc);
+		uint16_t e, num_encodings = dr_rxchannel_num_encodings(rxc);
+		dante_encoding_t encodings[DR_TEST_MAX_ENCODINGS];
+		for (e = 0; e < num_encodings && e < DR_TEST_MAX_ENCODINGS; e++)
+		{
+			encodings[e] = dr_rxchannel_encoding_at_index(rxc, e);
+		}
+		dr_test_print_legacy_channel_formats(samplerate, num_encodings, encodings, text->format, sizeof(text->format));
+	}
+	else
+	{
+		dr_test_print_formats(dr_rxchannel_get_formats(rxc), text->format, sizeof(text->format));
+	}
 
-		copy_to_output_array(ii, &info, sizeof(tx_channel_info_t), array);
+	if (dr_device_is_component_stale(device, DR_DEVICE_COMPONENT_RXFLOWS))
+	{
+		SNPRINTF(text->flow, sizeof(text->flow), "?");
 	}
-	return;
-	*/
+	else
+	{
+		dr_rxflow_t * flow = NULL;
+		dante_id_t flow_id;
+		aud_error_t result = dr_device_rxflow_with_channel(device, rxc, &flow);
+		if (result == AUD_SUCCESS)
+		{
+			result = dr_rxflow_get_id(flow, &flow_id);
+			if (result == AUD_SUCCESS)
+			{
+				SNPRINTF(text->flow, sizeof(text->flow), "%d", flow_id);
+			}
+			else
+			{
+				SNPRINTF(text->flow, sizeof(text->flow), "?");
+			}
+			dr_rxflow_release(&flow);
+		}
+		else if (result == AUD_ERR_NOTFOUND)
+		{
+			SNPRINTF(text->flow, sizeof(text->flow), "-");
+		}
+		else
+		{
+			SNPRINTF(text->flow, sizeof(text->flow), "?");
+		}
+	}
+
+	info->name = dr_rxchannel_get_name(rxc);
+	info->format = text->format;
+	info->latency = dr_rxchannel_get_subscription_latency_us(rxc);
+	info->muted = dr_rxchannel_is_muted(rxc);
+	info->dbu = dr_rxchannel_get_signal_reflevel(rxc);
+	info->sub = dr_rxchannel_get_subscription(rxc);
+	info->status = dr_rxchannel_get_status(rxc);
+	info->flow = text->flow;
+}
 
+void
+dr_test_print_device_txchannels
+(
+	dr_device_t * device,
+	/*[out]*/ char*** array,
+	/*[out]*/ int* count
+) {
 	unsigned int i, n = dr_device_num_txchannels(device);
+	dr_test_channel_text_t text;
 
 	enum
 	{
@@ -484,16 +581,11 @@ dr_test_print_device_txchannels
 	for (i = 0; i < n; i++)
 	{
 		tx_channel_info_t info;
-		memset(&info, 0, sizeof(tx_channel_info_t));
-
-		dr_txchannel_t * txc = dr_device_txchannel_at_index(device, i);
-		dante_id_t id = dr_txchannel_get_id(txc);
-		info.id = id;
-		info.stale = dr_txchannel_is_stale(txc);
+		dr_test_get_txchannel_info(dr_device_txchannel_at_index(device, i), &info, &text);
 		if (info.stale)
 		{
 			DR_TEST_PRINT("  %*d %*s %*s %*s %*s %*s",
-				-ID_FIELD_WIDTH,      id,
+				-ID_FIELD_WIDTH,      info.id,
 				-NAME_FIELD_WIDTH,    "?",
 				-FORMAT_FIELD_WIDTH,  "?",
 				-ENABLED_FIELD_WIDTH, "?",
@@ -503,43 +595,14 @@ dr_test_print_device_txchannels
 		}
 		else
 		{
-
-			const char * name = dr_txchannel_get_canonical_name(txc);
-			char format[512];
-			aud_bool_t enabled = dr_txchannel_is_enabled(txc);
-			aud_bool_t muted = dr_txchannel_is_muted(txc);
-			dante_dbu_t dbu = dr_txchannel_get_signal_reflevel(txc);
-
-			if (DR_TEST_PRINT_LEGACY_FORMATS)
-			{
-				dante_samplerate_t samplerate = dr_txchannel_get_sample_rate(txc);
-				uint16_t e, num_encodings = dr_txchannel_num_encodings(txc);
-				dante_encoding_t encodings[DR_TEST_MAX_ENCODINGS];
-				for (e = 0; e < num_encodings && e < DR_TEST_MAX_ENCODINGS; e++)
-				{
-					encodings[e] = dr_txchannel_encoding_at_index(txc, e);
-				}
-				dr_test_print_legacy_channel_formats(samplerate, num_encodings, encodings, format, sizeof(format));
-			}
-			else
-			{
-				dr_test_print_formats(dr_txchannel_get_formats(txc), format, sizeof(format));
-			}
-			
 			DR_TEST_PRINT("  %*d %*s %*s %*s %*s %+*d",
-				-ID_FIELD_WIDTH,      id,
-				-NAME_FIELD_WIDTH,    name,
-				-FORMAT_FIELD_WIDTH,  format,
-				-ENABLED_FIELD_WIDTH, (enabled ? "true" : "false"),
-				-MUTED_FIELD_WIDTH,   (muted ? "true" : "false"),
-				-DBU_FIELD_WIDTH,     (dbu == DANTE_DBU_UNSET ? 0 : (int)dbu)
+				-ID_FIELD_WIDTH,      info.id,
+				-NAME_FIELD_WIDTH,    info.name,
+				-FORMAT_FIELD_WIDTH,  info.format,
+				-ENABLED_FIELD_WIDTH, (info.enabled ? "true" : "false"),
+				-MUTED_FIELD_WIDTH,   (info.muted ? "true" : "false"),
+				-DBU_FIELD_WIDTH,     (info.dbu == DANTE_DBU_UNSET ? 0 : (int)info.dbu)
 			);
-
-			info.name = name;
-			info.format = format;
-			info.enabled = enabled;
-			info.muted = muted;
-			info.dbu = dbu;
 		}
 
 		copy_to_output_array(i, &info, sizeof(tx_channel_info_t), array);
@@ -553,30 +616,8 @@ dr_test_print_device_rxchannels
 	/*[out]*/ char*** array,
 	/*[out]*/ int* count
 ) {
-	/*
-	uint16_t ii;
-	set_output_array_length(sizeof(rx_channel_info_t), 3, array, count);
-	for (ii = 0; ii < 3; ii++)
-	{
-		rx_channel_info_t info;
-		memset(&info, 0, sizeof(rx_channel_info_t));
-		info.id = ii;
-		info.stale = ii;
-		info.name = "test name";
-		info.format = "test format";
-		info.latency = 321;
-		info.muted = ii;
-		info.dbu = ii;
-		info.sub = "test sub";
-		info.status = (dante_rxstatus_t)ii;
-		info.flow = "test flow";
-
-		copy_to_output_array(ii, &info, sizeof(rx_channel_info_t), array);
-	}
-	return;
-	*/
-
 	unsigned int i, n = dr_device_num_rxchannels(device);
+	dr_test_channel_text_t text;
 
 	enum
 	{
@@ -613,16 +654,11 @@ dr_test_print_device_rxchannels
 	for (i = 0; i < n; i++)
 	{
 		rx_channel_info_t info;
-		memset(&info, 0, sizeof(rx_channel_info_t));
-
-		dr_rxchannel_t * rxc = dr_device_rxchannel_at_index(device, i);
-		dante_id_t id = dr_rxchannel_get_id(rxc);
-		info.id = id;
-		info.stale = dr_rxchannel_is_stale(rxc);
+		dr_test_get_rxchannel_info(device, dr_device_rxchannel_at_index(device, i), &info, &text);
 		if (info.stale)
 		{
 			DR_TEST_PRINT("  %*d %*s %*s %*s %*s %*s %*s %*s %*s",
-				-ID_FIELD_WIDTH,           id,
+				-ID_FIELD_WIDTH,           info.id,
 				-NAME_FIELD_WIDTH,         "?",
 				-FORMAT_FIELD_WIDTH,       "?",
 				-LATENCY_FIELD_WIDTH,      "?",
@@ -635,97 +671,27 @@ dr_test_print_device_rxchannels
 		}
 		else
 		{
-			const char * name = dr_rxchannel_get_name(rxc);
-			char format_buf[512];
-			dante_latency_us_t latency = dr_rxchannel_get_subscription_latency_us(rxc); 
 			char latency_buf[32];
-			aud_bool_t muted = dr_rxchannel_is_muted(rxc);
-			const char * sub = dr_rxchannel_get_subscription(rxc);
-			dante_rxstatus_t status = dr_rxchannel_get_status(rxc);
-			dante_dbu_t dbu = dr_rxchannel_get_signal_reflevel(rxc);
-			char flow_buf[32];
-
-			if (DR_TEST_PRINT_LEGACY_FORMATS)
+			if (info.sub)
 			{
-				dante_samplerate_t samplerate = dr_rxchannel_get_sample_rate(rxc);
-				uint16_t e, num_encodings = dr_rxchannel_num_encodings(rxc);
-				dante_encoding_t encodings[DR_TEST_MAX_ENCODINGS];
-				for (e = 0; e < num_encodings && e < DR_TEST_MAX_ENCODINGS; e++)
-				{
-					encodings[e] = dr_rxchannel_encoding_at_index(rxc, e);
-				}
-				dr_test_print_legacy_channel_formats(samplerate, num_encodings, encodings, format_buf, sizeof(format_buf));
-			}
-			else
-			{
-				dr_test_print_formats(dr_rxchannel_get_formats(rxc), format_buf, sizeof(format_buf));
-			}
-			if (sub)
-			{
-				SNPRINTF(latency_buf, 32, "%d", latency);
+				SNPRINTF(latency_buf, 32, "%d", info.latency);
 			}
 			else
 			{
 				SNPRINTF(latency_buf, 32, "-");
 			}
 
-			if (dr_device_is_component_stale(device, DR_DEVICE_COMPONENT_RXFLOWS))
-			{
-				SNPRINTF(flow_buf, 32, "?");
-			}
-			else
-			{
-				dr_rxflow_t * flow = NULL;
-				dante_id_t flow_id;
-				aud_error_t result = dr_device_rxflow_with_channel(device, rxc, &flow);
-				if (result == AUD_SUCCESS)
-				{
-					result = dr_rxflow_get_id(flow, &flow_id);
-					if (result == AUD_SUCCESS)
-					{
-						SNPRINTF(flow_buf, 32, "%d", flow_id);
-					}
-					else
-					{
-						DR_TEST_ERROR("Error getting flow for channel '%s': %s\n",
-							name, dr_error_message(result, g_test_errbuf));
-						SNPRINTF(flow_buf, 32, "?");
-					}
-					dr_rxflow_release(&flow);
-				}
-				else if (result == AUD_ERR_NOTFOUND)
-				{
-					SNPRINTF(flow_buf, 32, "-");
-				}
-				else
-				{
-					DR_TEST_ERROR("Error getting flow for channel '%s': %s\n",
-						name, dr_error_message(result, g_test_errbuf));
-					SNPRINTF(flow_buf, 32, "?");
-				}
-			}
-			
-
 			DR_TEST_PRINT("  %*d %*s %*s %*s %*s %+*d %*s %*s %*s",
-				-ID_FIELD_WIDTH,           id,
-				-NAME_FIELD_WIDTH,         name,
-				-FORMAT_FIELD_WIDTH,       format_buf,
+				-ID_FIELD_WIDTH,           info.id,
+				-NAME_FIELD_WIDTH,         info.name,
+				-FORMAT_FIELD_WIDTH,       info.format,
 				-LATENCY_FIELD_WIDTH,      latency_buf,
-				-MUTED_FIELD_WIDTH,        (muted ? "true" : "false"),
-				-DBU_FIELD_WIDTH,          (dbu == DANTE_DBU_UNSET ? 0 : (int)dbu),
-				-SUBSCRIPTION_FIELD_WIDTH, (sub ? sub : "-"),
-				-STATUS_FIELD_WIDTH,       ((status != DANTE_RXSTATUS_NONE) ? dante_rxstatus_to_string(status) : "-"),
-				-FLOW_FIELD_WIDTH,         flow_buf
+				-MUTED_FIELD_WIDTH,        (info.muted ? "true" : "false"),
+				-DBU_FIELD_WIDTH,          (info.dbu == DANTE_DBU_UNSET ? 0 : (int)info.dbu),
+				-SUBSCRIPTION_FIELD_WIDTH, (info.sub ? info.sub : "-"),
+				-STATUS_FIELD_WIDTH,       ((info.status != DANTE_RXSTATUS_NONE) ? dante_rxstatus_to_string(info.status) : "-"),
+				-FLOW_FIELD_WIDTH,         info.flow
 			);
-
-			info.name = name;
-			info.format = format_buf;
-			info.latency = latency;
-			info.muted = muted;
-			info.dbu = dbu;
-			info.sub = sub;
-			info.status = status;
-			info.flow = flow_buf;
 		}
 
 		copy_to_output_array(i, &info, sizeof(rx_channel_info_t), array);
@@ -0,0 +1,262 @@
+/*
+ * File     : dante_routing_rxstats.c
+ * Synopsis : Time series of rx flow error fields, see get_rxflow_error_stats.
+ *
+ * The collector reads and clears the error fields of all flows of a device on
+ * a schedule, so bursts of late or dropped packets show up as samples instead
+ * of having to be scraped from dr_test_print_device_rxflow_errors output.
+ */
+#include "dante_routing_test.h"
+#include <string.h>
+
+static uint32_t
+dr_test_rxstats_slots
+(
+	const dr_test_rxstats_t * stats
+) {
+	// the sample being gathered never overwrites one that can be read
+	return stats->history + 1;
+}
+
+static uint32_t
+dr_test_rxstats_stride
+(
+	const dr_test_rxstats_t * stats
+) {
+	return (uint32_t) stats->num_interfaces * stats->max_rxflows * DR_TEST_RXSTATS_MAX_FIELDS;
+}
+
+static void
+dr_test_rxstats_free_rings
+(
+	dr_test_rxstats_t * stats
+) {
+	free(stats->samples);
+	free(stats->deltas);
+	stats->samples = NULL;
+	stats->deltas = NULL;
+	stats->num_interfaces = 0;
+	stats->max_rxflows = 0;
+}
+
+void
+dr_test_rxstats_free
+(
+	dr_test_rxstats_t * stats
+) {
+	dr_test_rxstats_free_rings(stats);
+	memset(stats, 0, sizeof(dr_test_rxstats_t));
+}
+
+void
+dr_test_rxstats_configure
+(
+	dr_test_rxstats_t * stats,
+	uint32_t interval_ms,
+	uint32_t fields,
+	uint32_t history
+) {
+	if (!interval_ms)
+	{
+		dr_test_rxstats_free(stats);
+		return;
+	}
+	if (!history)
+	{
+		history = DR_TEST_RXSTATS_DEFAULT_HISTORY;
+	}
+	if (history != stats->history)
+	{
+		dr_test_rxstats_free_rings(stats);
+		stats->history = history;
+	}
+	stats->interval_ms = interval_ms;
+	stats->fields = fields;
+}
+
+aud_error_t
+dr_test_rxstats_resize
+(
+	dr_test_rxstats_t * stats,
+	uint16_t num_interfaces,
+	uint16_t max_rxflows
+) {
+	uint32_t slots = dr_test_rxstats_slots(stats);
+
+	if (stats->samples && stats->num_interfaces == num_interfaces && stats->max_rxflows == max_rxflows)
+	{
+		return AUD_SUCCESS;
+	}
+	dr_test_rxstats_free_rings(stats);
+	if (!num_interfaces || !max_rxflows)
+	{
+		return AUD_ERR_INVALIDSTATE;
+	}
+
+	// zeroed samples carry sequence 0, which no complete sample has
+	stats->samples = (dr_test_rxstats_sample_t *) calloc(slots, sizeof(dr_test_rxstats_sample_t));
+	stats->deltas = (uint32_t *) calloc((size_t) slots * num_interfaces * max_rxflows * DR_TEST_RXSTATS_MAX_FIELDS, sizeof(uint32_t));
+	if (!stats->samples || !stats->deltas)
+	{
+		dr_test_rxstats_free_rings(stats);
+		return AUD_ERR_NOMEMORY;
+	}
+	stats->num_interfaces = num_interfaces;
+	stats->max_rxflows = max_rxflows;
+	return AUD_SUCCESS;
+}
+
+void
+dr_test_rxstats_begin_poll
+(
+	dr_test_rxstats_t * stats,
+	const aud_utime_t * now,
+	uint32_t fields
+) {
+	uint32_t slot = (stats->sequence + 1) % dr_test_rxstats_slots(stats);
+	uint32_t stride = dr_test_rxstats_stride(stats);
+	dr_test_rxstats_sample_t * sample = stats->samples + slot;
+
+	memset(sample, 0, sizeof(dr_test_rxstats_sample_t));
+	memset(stats->deltas + (size_t) slot * stride, 0, stride * sizeof(uint32_t));
+	if (stats->last_poll.tv_sec || stats->last_poll.tv_usec)
+	{
+		sample->interval_ms = (uint32_t) ((now->tv_sec - stats->last_poll.tv_sec) * 1000
+			+ (now->tv_usec - stats->last_poll.tv_usec) / 1000);
+	}
+	stats->last_poll = *now;
+	stats->pending = fields;
+}
+
+void
+dr_test_rxstats_end_field
+(
+	dr_test_rxstats_t * stats,
+	dante_rxflow_error_type_t field,
+	const uint32_t * values,
+	const dante_rxflow_error_timestamp_t * timestamp
+) {
+	uint32_t bit = 1u << field;
+	uint32_t slot, stride, k, n;
+	dr_test_rxstats_sample_t * sample;
+	uint32_t * deltas;
+
+	if (!(stats->pending & bit))
+	{
+		return;
+	}
+	stats->pending &= ~bit;
+	if (!stats->samples)
+	{
+		// stopped or resized while the request was in flight
+		return;
+	}
+
+	slot = (stats->sequence + 1) % dr_test_rxstats_slots(stats);
+	stride = dr_test_rxstats_stride(stats);
+	sample = stats->samples + slot;
+	if (values)
+	{
+		if (!sample->fields && timestamp)
+		{
+			sample->timestamp_seconds = timestamp->seconds;
+			sample->timestamp_subseconds = timestamp->subseconds;
+		}
+		deltas = stats->deltas + (size_t) slot * stride;
+		n = (uint32_t) stats->num_interfaces * stats->max_rxflows;
+		for (k = 0; k < n; k++)
+		{
+			deltas[k * DR_TEST_RXSTATS_MAX_FIELDS + field] = values[k];
+		}
+		sample->fields |= bit;
+	}
+	if (!stats->pending && sample->fields)
+	{
+		sample->sequence = ++stats->sequence;
+	}
+}
+
+aud_error_t
+dr_test_snapshot_rxstats
+(
+	dr_test_snapshot_builder_t * builder,
+	const dr_test_rxstats_t * stats,
+	dr_device_t * device,
+	uint32_t since,
+	aud_bool_t skip_zero,
+	void ** snapshot
+) {
+	aud_error_t result = AUD_SUCCESS;
+	uint32_t slots = dr_test_rxstats_slots(stats);
+	uint32_t stride = dr_test_rxstats_stride(stats);
+	uint32_t first = since + 1;
+	uint16_t f, i;
+
+	if (stats->sequence >= stats->history && first <= stats->sequence - stats->history)
+	{
+		first = stats->sequence - stats->history + 1;
+	}
+
+	dr_test_snapshot_begin(builder, sizeof(rxflow_stats_record_t));
+	for (f = 0; stats->samples && f < stats->max_rxflows && result == AUD_SUCCESS; f++)
+	{
+		dr_rxflow_t * flow;
+		char * flow_name;
+		uint32_t name = DR_TEST_SNAPSHOT_NO_STRING;
+
+		if (dr_device_rxflow_with_id(device, (dante_id_t) (f + 1), &flow) != AUD_SUCCESS)
+		{
+			continue;
+		}
+		if (dr_rxflow_get_name(flow, &flow_name) == AUD_SUCCESS)
+		{
+			result = dr_test_snapshot_add_string(builder, flow_name, &name);
+		}
+		for (i = 0; i < stats->num_interfaces && result == AUD_SUCCESS; i++)
+		{
+			uint32_t s;
+			for (s = first; s <= stats->sequence && result == AUD_SUCCESS; s++)
+			{
+				const dr_test_rxstats_sample_t * sample = stats->samples + (s % slots);
+				const uint32_t * deltas;
+				rxflow_stats_record_t record;
+				aud_bool_t nonzero = AUD_FALSE;
+				uint32_t k;
+
+				if (sample->sequence != s)
+				{
+					continue;
+				}
+				deltas = stats->deltas + (size_t) (s % slots) * stride
+					+ ((uint32_t) i * stats->max_rxflows + f) * DR_TEST_RXSTATS_MAX_FIELDS;
+
+				memset(&record, 0, sizeof(record));
+				record.sequence = s;
+				record.interval_ms = sample->interval_ms;
+				record.timestamp_seconds = sample->timestamp_seconds;
+				record.timestamp_subseconds = sample->timestamp_subseconds;
+				record.flow_id = (dante_id_t) (f + 1);
+				record.interface_index = i;
+				record.name = name;
+				record.fields = sample->fields;
+				for (k = 0; k < DR_TEST_RXSTATS_MAX_FIELDS; k++)
+				{
+					record.deltas[k] = deltas[k];
+					record.rates[k] = sample->interval_ms ? deltas[k] * 1000.0f / sample->interval_ms : 0.0f;
+					nonzero |= (deltas[k] != 0);
+				}
+				if (skip_zero && !nonzero)
+				{
+					continue;
+				}
+				result = dr_test_snapshot_add_record(builder, &record);
+			}
+		}
+	}
+	if (result != AUD_SUCCESS)
+	{
+		*snapshot = NULL;
+		return result;
+	}
+	return dr_test_snapshot_finish(builder, snapshot);
+}
@@ -0,0 +1,744 @@
+/*
+ * File     : dante_routing_snapshot.c
+ * Synopsis : Single-allocation channel and label tables for the .Net wrapper.
+ *
+ * Each snapshot is one contiguous blob (see dante_routing_test.h) so the
+ * managed side reads it with a handful of copies and frees it with a
+ * single call, instead of one allocation per row and per string.
+ */
+#include "dante_routing_test.h"
+
+#ifdef WIN32
+#pragma warning(push)
+#pragma warning(disable: 4127 4996)
+#endif
+
+#define DR_TEST_SNAPSHOT_MIN_CAPACITY 64
+
+static aud_error_t
+dr_test_snapshot_reserve
+(
+	void ** buf,
+	uint32_t * cap,
+	uint32_t needed,
+	uint32_t element_size
+) {
+	uint32_t new_cap;
+	void * new_buf;
+
+	if (needed <= *cap)
+	{
+		return AUD_SUCCESS;
+	}
+	new_cap = *cap ? *cap : DR_TEST_SNAPSHOT_MIN_CAPACITY;
+	while (new_cap < needed)
+	{
+		new_cap *= 2;
+	}
+	new_buf = realloc(*buf, (size_t) new_cap * element_size);
+	if (!new_buf)
+	{
+		return AUD_ERR_NOMEMORY;
+	}
+	*buf = new_buf;
+	*cap = new_cap;
+	return AUD_SUCCESS;
+}
+
+// FNV-1a
+static uint32_t
+dr_test_snapshot_hash
+(
+	const char * value,
+	size_t len
+) {
+	uint32_t h = 2166136261u;
+	size_t i;
+	for (i = 0; i < len; i++)
+	{
+		h ^= (uint8_t) value[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static aud_error_t
+dr_test_snapshot_rehash
+(
+	dr_test_snapshot_builder_t * builder,
+	uint32_t new_cap
+) {
+	uint32_t * hash = (uint32_t *) calloc(new_cap, sizeof(uint32_t));
+	uint32_t i;
+
+	if (!hash)
+	{
+		return AUD_ERR_NOMEMORY;
+	}
+	for (i = 0; i < builder->hash_cap; i++)
+	{
+		uint32_t entry = builder->hash[i];
+		if (entry)
+		{
+			const char * s = builder->strings + entry - 1;
+			uint32_t slot = dr_test_snapshot_hash(s, strlen(s)) & (new_cap - 1);
+			while (hash[slot])
+			{
+				slot = (slot + 1) & (new_cap - 1);
+			}
+			hash[slot] = entry;
+		}
+	}
+	free(builder->hash);
+	builder->hash = hash;
+	builder->hash_cap = new_cap;
+	return AUD_SUCCESS;
+}
+
+void
+dr_test_snapshot_builder_free
+(
+	dr_test_snapshot_builder_t * builder
+) {
+	free(builder->records);
+	free(builder->indices);
+	free(builder->strings);
+	free(builder->hash);
+	memset(builder, 0, sizeof(dr_test_snapshot_builder_t));
+}
+
+void
+dr_test_snapshot_begin
+(
+	dr_test_snapshot_builder_t * builder,
+	uint32_t record_size
+) {
+	builder->record_size = record_size;
+	builder->record_count = 0;
+	builder->records_len = 0;
+	builder->indices_len = 0;
+	builder->strings_len = 0;
+	builder->hash_len = 0;
+	if (builder->hash)
+	{
+		memset(builder->hash, 0, builder->hash_cap * sizeof(uint32_t));
+	}
+}
+
+aud_error_t
+dr_test_snapshot_add_string
+(
+	dr_test_snapshot_builder_t * builder,
+	const char * value,
+	uint32_t * offset
+) {
+	aud_error_t result;
+	size_t len;
+	uint32_t slot;
+
+	if (!value)
+	{
+		*offset = DR_TEST_SNAPSHOT_NO_STRING;
+		return AUD_SUCCESS;
+	}
+
+	// keep the load factor at or below one half
+	if ((builder->hash_len + 1) * 2 > builder->hash_cap)
+	{
+		result = dr_test_snapshot_rehash(builder,
+			builder->hash_cap ? builder->hash_cap * 2 : DR_TEST_SNAPSHOT_MIN_CAPACITY);
+		if (result != AUD_SUCCESS)
+		{
+			return result;
+		}
+	}
+
+	len = strlen(value);
+	slot = dr_test_snapshot_hash(value, len) & (builder->hash_cap - 1);
+	while (builder->hash[slot])
+	{
+		const char * existing = builder->strings + builder->hash[slot] - 1;
+		if (!strcmp(existing, value))
+		{
+			*offset = builder->hash[slot] - 1;
+			return AUD_SUCCESS;
+		}
+		slot = (slot + 1) & (builder->hash_cap - 1);
+	}
+
+	result = dr_test_snapshot_reserve((void **) &builder->strings, &builder->strings_cap,
+		builder->strings_len + (uint32_t) len + 1, sizeof(char));
+	if (result != AUD_SUCCESS)
+	{
+		return result;
+	}
+	memcpy(builder->strings + builder->strings_len, value, len + 1);
+	*offset = builder->strings_len;
+	builder->strings_len += (uint32_t) len + 1;
+	builder->hash[slot] = *offset + 1;
+	builder->hash_len++;
+	return AUD_SUCCESS;
+}
+
+aud_error_t
+dr_test_snapshot_add_index
+(
+	dr_test_snapshot_builder_t * builder,
+	uint32_t value
+) {
+	aud_error_t result = dr_test_snapshot_reserve((void **) &builder->indices, &builder->indices_cap,
+		builder->indices_len + 1, sizeof(uint32_t));
+	if (result != AUD_SUCCESS)
+	{
+		return result;
+	}
+	builder->indices[builder->indices_len++] = value;
+	return AUD_SUCCESS;
+}
+
+aud_error_t
+dr_test_snapshot_add_record
+(
+	dr_test_snapshot_builder_t * builder,
+	const void * record
+) {
+	aud_error_t result = dr_test_snapshot_reserve((void **) &builder->records, &builder->records_cap,
+		builder->records_len + builder->record_size, sizeof(uint8_t));
+	if (result != AUD_SUCCESS)
+	{
+		return result;
+	}
+	memcpy(builder->records + builder->records_len, record, builder->record_size);
+	builder->records_len += builder->record_size;
+	builder->record_count++;
+	return AUD_SUCCESS;
+}
+
+aud_error_t
+dr_test_snapshot_finish
+(
+	dr_test_snapshot_builder_t * builder,
+	void ** snapshot
+) {
+	dr_test_snapshot_header_t header;
+	uint8_t * blob;
+
+	header.record_count = builder->record_count;
+	header.record_size = builder->record_size;
+	header.records_offset = sizeof(dr_test_snapshot_header_t);
+	header.indices_count = builder->indices_len;
+	header.indices_offset = header.records_offset + builder->records_len;
+	header.strings_size = builder->strings_len;
+	header.strings_offset = header.indices_offset + builder->indices_len * sizeof(uint32_t);
+	header.size = header.strings_offset + builder->strings_len;
+
+	blob = (uint8_t *) CoTaskMemAlloc(header.size);
+	if (!blob)
+	{
+		*snapshot = NULL;
+		return AUD_ERR_NOMEMORY;
+	}
+	memcpy(blob, &header, sizeof(header));
+	if (builder->records_len)
+	{
+		memcpy(blob + header.records_offset, builder->records, builder->records_len);
+	}
+	if (builder->indices_len)
+	{
+		memcpy(blob + header.indices_offset, builder->indices, builder->indices_len * sizeof(uint32_t));
+	}
+	if (builder->strings_len)
+	{
+		memcpy(blob + header.strings_offset, builder->strings, builder->strings_len);
+	}
+	*snapshot = blob;
+	return AUD_SUCCESS;
+}
+
+aud_error_t
+dr_test_snapshot_rxchannels
+(
+	dr_test_snapshot_builder_t * builder,
+	dr_device_t * device,
+	const uint32_t * generations,
+	uint32_t since,
+	void ** snapshot
+) {
+	aud_error_t result = AUD_SUCCESS;
+	unsigned int i, n = dr_device_num_rxchannels(device);
+	dr_test_channel_text_t text;
+
+	dr_test_snapshot_begin(builder, sizeof(rx_channel_record_t));
+	for (i = 0; i < n && result == AUD_SUCCESS; i++)
+	{
+		rx_channel_info_t info;
+		rx_channel_record_t record;
+
+		if (generations && generations[i] <= since)
+		{
+			continue;
+		}
+		dr_test_get_rxchannel_info(device, dr_device_rxchannel_at_index(device, i), &info, &text);
+
+		memset(&record, 0, sizeof(record));
+		record.id = info.id;
+		record.status = info.status;
+		record.stale = info.stale;
+		record.latency = info.latency;
+		record.muted = info.muted;
+		record.dbu = info.dbu;
+		record.name = record.format = record.sub = record.flow = DR_TEST_SNAPSHOT_NO_STRING;
+		if (!info.stale)
+		{
+			result = dr_test_snapshot_add_string(builder, info.name, &record.name);
+			if (result == AUD_SUCCESS)
+				result = dr_test_snapshot_add_string(builder, info.format, &record.format);
+			if (result == AUD_SUCCESS)
+				result = dr_test_snapshot_add_string(builder, info.sub, &record.sub);
+			if (result == AUD_SUCCESS)
+				result = dr_test_snapshot_add_string(builder, info.flow, &record.flow);
+		}
+		if (result == AUD_SUCCESS)
+		{
+			result = dr_test_snapshot_add_record(builder, &record);
+		}
+	}
+	if (result != AUD_SUCCESS)
+	{
+		*snapshot = NULL;
+		return result;
+	}
+	return dr_test_snapshot_finish(builder, snapshot);
+}
+
+aud_error_t
+dr_test_snapshot_txchannels
+(
+	dr_test_snapshot_builder_t * builder,
+	dr_device_t * device,
+	const uint32_t * generations,
+	uint32_t since,
+	void ** snapshot
+) {
+	aud_error_t result = AUD_SUCCESS;
+	unsigned int i, n = dr_device_num_txchannels(device);
+	dr_test_channel_text_t text;
+
+	dr_test_snapshot_begin(builder, sizeof(tx_channel_record_t));
+	for (i = 0; i < n && result == AUD_SUCCESS; i++)
+	{
+		tx_channel_info_t info;
+		tx_channel_record_t record;
+
+		if (generations && generations[i] <= since)
+		{
+			continue;
+		}
+		dr_test_get_txchannel_info(dr_device_txchannel_at_index(device, i), &info, &text);
+
+		memset(&record, 0, sizeof(record));
+		record.id = info.id;
+		record.dbu = info.dbu;
+		record.stale = info.stale;
+		record.enabled = info.enabled;
+		record.muted = info.muted;
+		record.name = record.format = DR_TEST_SNAPSHOT_NO_STRING;
+		if (!info.stale)
+		{
+			result = dr_test_snapshot_add_string(builder, info.name, &record.name);
+			if (result == AUD_SUCCESS)
+				result = dr_test_snapshot_add_string(builder, info.format, &record.format);
+		}
+		if (result == AUD_SUCCESS)
+		{
+			result = dr_test_snapshot_add_record(builder, &record);
+		}
+	}
+	if (result != AUD_SUCCESS)
+	{
+		*snapshot = NULL;
+		return result;
+	}
+	return dr_test_snapshot_finish(builder, snapshot);
+}
+
+aud_error_t
+dr_test_snapshot_txlabels
+(
+	dr_test_snapshot_builder_t * builder,
+	dr_device_t * device,
+	void ** snapshot
+) {
+	aud_error_t result = AUD_SUCCESS;
+	unsigned int i, n = dr_device_num_txchannels(device);
+	dr_txlabel_t labels[DR_TEST_MAX_TXLABELS];
+
+	dr_test_snapshot_begin(builder, sizeof(tx_label_record_t));
+	for (i = 0; i < n && result == AUD_SUCCESS; i++)
+	{
+		dr_txchannel_t * txc = dr_device_txchannel_at_index(device, i);
+		tx_label_record_t record;
+
+		memset(&record, 0, sizeof(record));
+		record.name = DR_TEST_SNAPSHOT_NO_STRING;
+		record.first_label = builder->indices_len;
+		record.id = dr_txchannel_get_id(txc);
+		if (!record.id)
+		{
+			record.is_empty = AUD_TRUE;
+		}
+		else
+		{
+			uint16_t l, num_txlabels = DR_TEST_MAX_TXLABELS;
+			if (dr_txchannel_get_txlabels(txc, &num_txlabels, labels) != AUD_SUCCESS)
+			{
+				record.is_empty = AUD_TRUE;
+			}
+			else
+			{
+				if (num_txlabels > DR_TEST_MAX_TXLABELS)
+				{
+					num_txlabels = DR_TEST_MAX_TXLABELS;
+				}
+				result = dr_test_snapshot_add_string(builder, dr_txchannel_get_canonical_name(txc), &record.name);
+				for (l = 0; l < num_txlabels && result == AUD_SUCCESS; l++)
+				{
+					uint32_t offset;
+					result = dr_test_snapshot_add_string(builder, labels[l].name, &offset);
+					if (result == AUD_SUCCESS)
+						result = dr_test_snapshot_add_index(builder, offset);
+				}
+				record.labels_count = num_txlabels;
+			}
+		}
+		if (result == AUD_SUCCESS)
+		{
+			result = dr_test_snapshot_add_record(builder, &record);
+		}
+	}
+	if (result != AUD_SUCCESS)
+	{
+		*snapshot = NULL;
+		return result;
+	}
+	return dr_test_snapshot_finish(builder, snapshot);
+}
+
+//----------------------------------------------------------
+// Channel change tracking
+//----------------------------------------------------------
+
+static uint32_t
+dr_test_fingerprint_add
+(
+	uint32_t h,
+	const void * value,
+	size_t len
+) {
+	const uint8_t * bytes = (const uint8_t *) value;
+	size_t i;
+	for (i = 0; i < len; i++)
+	{
+		h ^= bytes[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static void
+dr_test_channel_fields_add
+(
+	dr_test_channel_fields_t * fields,
+	uint32_t * h,
+	const void * value,
+	size_t len
+) {
+	*h = dr_test_fingerprint_add(*h, value, len);
+	if (fields->error == AUD_SUCCESS)
+	{
+		fields->error = dr_test_snapshot_reserve((void **) &fields->bytes, &fields->cap,
+			fields->len + (uint32_t) len, 1);
+	}
+	if (fields->error == AUD_SUCCESS)
+	{
+		memcpy(fields->bytes + fields->len, value, len);
+		fields->len += (uint32_t) len;
+	}
+}
+
+// strings are added including the terminator so "a","bc" != "ab","c";
+// NULL differs from ""
+static void
+dr_test_channel_fields_add_string
+(
+	dr_test_channel_fields_t * fields,
+	uint32_t * h,
+	const char * value
+) {
+	if (!value)
+	{
+		dr_test_channel_fields_add(fields, h, "\xff", 1);
+		return;
+	}
+	dr_test_channel_fields_add(fields, h, value, strlen(value) + 1);
+}
+
+static uint32_t
+dr_test_rxchannel_fields
+(
+	dr_test_channel_fields_t * fields,
+	const rx_channel_info_t * info
+) {
+	uint32_t h = 2166136261u;
+	dr_test_channel_fields_add(fields, &h, &info->stale, sizeof(info->stale));
+	dr_test_channel_fields_add(fields, &h, &info->latency, sizeof(info->latency));
+	dr_test_channel_fields_add(fields, &h, &info->muted, sizeof(info->muted));
+	dr_test_channel_fields_add(fields, &h, &info->dbu, sizeof(info->dbu));
+	dr_test_channel_fields_add(fields, &h, &info->status, sizeof(info->status));
+	dr_test_channel_fields_add_string(fields, &h, info->name);
+	dr_test_channel_fields_add_string(fields, &h, info->format);
+	dr_test_channel_fields_add_string(fields, &h, info->sub);
+	dr_test_channel_fields_add_string(fields, &h, info->flow);
+	return h;
+}
+
+static uint32_t
+dr_test_txchannel_fields
+(
+	dr_test_channel_fields_t * fields,
+	const tx_channel_info_t * info
+) {
+	uint32_t h = 2166136261u;
+	dr_test_channel_fields_add(fields, &h, &info->stale, sizeof(info->stale));
+	dr_test_channel_fields_add(fields, &h, &info->enabled, sizeof(info->enabled));
+	dr_test_channel_fields_add(fields, &h, &info->muted, sizeof(info->muted));
+	dr_test_channel_fields_add(fields, &h, &info->dbu, sizeof(info->dbu));
+	dr_test_channel_fields_add_string(fields, &h, info->name);
+	dr_test_channel_fields_add_string(fields, &h, info->format);
+	return h;
+}
+
+static void
+dr_test_channel_fields_free
+(
+	dr_test_channel_fields_t * fields
+) {
+	free(fields->bytes);
+	free(fields->offsets);
+	memset(fields, 0, sizeof(dr_test_channel_fields_t));
+}
+
+// Resizes the tracking arrays; when the channel count changes every channel
+// is reported as changed, and fewer channels also require a resync.
+static aud_error_t
+dr_test_channel_changes_resize
+(
+	dr_test_channel_changes_t * changes,
+	unsigned int n,
+	uint32_t generation
+) {
+	unsigned int i;
+	uint32_t * fingerprints;
+	uint32_t * generations;
+
+	if (n == changes->n)
+	{
+		return AUD_SUCCESS;
+	}
+	fingerprints = (uint32_t *) realloc(changes->fingerprints, (n ? n : 1) * sizeof(uint32_t));
+	if (!fingerprints)
+	{
+		return AUD_ERR_NOMEMORY;
+	}
+	changes->fingerprints = fingerprints;
+	generations = (uint32_t *) realloc(changes->generations, (n ? n : 1) * sizeof(uint32_t));
+	if (!generations)
+	{
+		return AUD_ERR_NOMEMORY;
+	}
+	changes->generations = generations;
+	if (n < changes->n)
+	{
+		changes->resync = generation;
+	}
+	for (i = 0; i < n; i++)
+	{
+		changes->fingerprints[i] = 0;
+		changes->generations[i] = generation;
+	}
+	changes->n = n;
+	return AUD_SUCCESS;
+}
+
+void
+dr_test_channel_changes_free
+(
+	dr_test_channel_changes_t * changes
+) {
+	free(changes->fingerprints);
+	free(changes->generations);
+	dr_test_channel_fields_free(&changes->fields);
+	dr_test_channel_fields_free(&changes->next);
+	memset(changes, 0, sizeof(dr_test_channel_changes_t));
+}
+
+// Prepares a pass over 'n' channels
+static aud_error_t
+dr_test_channel_changes_begin
+(
+	dr_test_channel_changes_t * changes,
+	unsigned int n,
+	uint32_t generation
+) {
+	dr_test_channel_fields_t * next = &changes->next;
+	aud_error_t result = dr_test_channel_changes_resize(changes, n, generation);
+
+	if (result == AUD_SUCCESS)
+	{
+		result = dr_test_snapshot_reserve((void **) &next->offsets, &next->offsets_cap, n + 1, sizeof(uint32_t));
+	}
+	next->n = n;
+	next->len = 0;
+	next->error = result;
+	if (result == AUD_SUCCESS)
+	{
+		next->offsets[0] = 0;
+	}
+	return result;
+}
+
+// Stamps channel 'i', whose fields were just added to changes->next, if it
+// differs from the last pass
+static aud_bool_t
+dr_test_channel_changes_update
+(
+	dr_test_channel_changes_t * changes,
+	unsigned int i,
+	uint32_t fingerprint,
+	uint32_t generation
+) {
+	const dr_test_channel_fields_t * last = &changes->fields;
+	dr_test_channel_fields_t * next = &changes->next;
+	uint32_t len;
+
+	if (next->error != AUD_SUCCESS)
+	{
+		return AUD_FALSE;
+	}
+	next->offsets[i + 1] = next->len;
+	len = next->offsets[i + 1] - next->offsets[i];
+	if (fingerprint == changes->fingerprints[i] && i < last->n
+		&& len == last->offsets[i + 1] - last->offsets[i]
+		&& !memcmp(next->bytes + next->offsets[i], last->bytes + last->offsets[i], len))
+	{
+		return AUD_FALSE;
+	}
+	changes->fingerprints[i] = fingerprint;
+	changes->generations[i] = generation;
+	return AUD_TRUE;
+}
+
+// Keeps the fields of a complete pass for the next one. After a failure the
+// channels are forgotten and the consumer is told to resync.
+static aud_bool_t
+dr_test_channel_changes_end
+(
+	dr_test_channel_changes_t * changes,
+	aud_bool_t changed,
+	uint32_t generation
+) {
+	dr_test_channel_fields_t last;
+
+	if (changes->next.error != AUD_SUCCESS)
+	{
+		dr_test_channel_changes_free(changes);
+		changes->resync = generation;
+		return AUD_TRUE;
+	}
+	last = changes->fields;
+	changes->fields = changes->next;
+	changes->next = last;
+	return changed;
+}
+
+aud_bool_t
+dr_test_track_rxchannels
+(
+	dr_test_channel_changes_t * changes,
+	dr_device_t * device,
+	uint32_t generation
+) {
+	unsigned int i, n = dr_device_num_rxchannels(device);
+	aud_bool_t changed = (n != changes->n);
+	dr_test_channel_text_t text;
+
+	dr_test_channel_changes_begin(changes, n, generation);
+	for (i = 0; i < n && changes->next.error == AUD_SUCCESS; i++)
+	{
+		rx_channel_info_t info;
+		uint32_t fingerprint;
+
+		dr_test_get_rxchannel_info(device, dr_device_rxchannel_at_index(device, i), &info, &text);
+		fingerprint = dr_test_rxchannel_fields(&changes->next, &info);
+		changed |= dr_test_channel_changes_update(changes, i, fingerprint, generation);
+	}
+	return dr_test_channel_changes_end(changes, changed, generation);
+}
+
+aud_bool_t
+dr_test_track_txchannels
+(
+	dr_test_channel_changes_t * changes,
+	dr_device_t * device,
+	uint32_t generation
+) {
+	unsigned int i, n = dr_device_num_txchannels(device);
+	aud_bool_t changed = (n != changes->n);
+	dr_test_channel_text_t text;
+
+	dr_test_channel_changes_begin(changes, n, generation);
+	for (i = 0; i < n && changes->next.error == AUD_SUCCESS; i++)
+	{
+		tx_channel_info_t info;
+		uint32_t fingerprint;
+
+		dr_test_get_txchannel_info(dr_device_txchannel_at_index(device, i), &info, &text);
+		fingerprint = dr_test_txchannel_fields(&changes->next, &info);
+		changed |= dr_test_channel_changes_update(changes, i, fingerprint, generation);
+	}
+	return dr_test_channel_changes_end(changes, changed, generation);
+}
+
+void
+dr_test_channel_changes_touch
+(
+	dr_test_channel_changes_t * changes,
+	uint32_t generation
+) {
+	unsigned int i;
+	for (i = 0; i < changes->n; i++)
+	{
+		changes->generations[i] = generation;
+	}
+}
+
+aud_bool_t
+dr_test_channel_changes_since
+(
+	const dr_test_channel_changes_t * changes,
+	uint32_t since
+) {
+	unsigned int i;
+	for (i = 0; i < changes->n; i++)
+	{
+		if (changes->generations[i] > since)
+		{
+			return AUD_TRUE;
+		}
+	}
+	return AUD_FALSE;
+}
+
+#ifdef WIN32
+#pragma warning(pop)
+#endif
@@ -20,20 +20,19 @@
 #endif
 
 #define DR_TEST_REQUEST_DESCRIPTION_LENGTH 64
-#define DR_TEST_MAX_REQUESTS 128
+// used when the devices object reports no request limit
+#define DR_TEST_DEFAULT_REQUEST_LIMIT 128
+#define DR_TEST_REQUEST_NONE 0xFFFFFFFFu
 
+// entries per batch request, for the file commands and bulk operations
 #define DR_TEST_MAX_BATCH 32
-typedef struct
-{
-	uint16_t n;
-	union
-	{
-		dr_batch_subscription_t subscriptions[DR_TEST_MAX_BATCH];
-		dr_batch_rxlabel_t rxlabels[DR_TEST_MAX_BATCH];
-	} _;
-} dr_test_batch_t;
-
-static dr_test_batch_t g_batch = {0};
+// request slots a bulk operation leaves to single requests and component updates
+#define DR_TEST_BULK_RESERVED_REQUESTS 8
+// how long RunDll waits for the device by default, the old fixed number of one second steps
+#define DR_TEST_READY_TIMEOUT_MS 15000
+#define DR_TEST_ALL_COMPONENTS ((1u << DR_DEVICE_COMPONENT_COUNT) - 1)
+// how soon a step returns for timed work that is overdue, e.g. for lack of requests
+#define DR_TEST_OVERDUE_RETRY_MS 100
 
 static aud_bool_t g_test_running = AUD_TRUE;
 
@@ -82,6 +81,15 @@ typedef struct dr_test_options
 	aud_interface_identifier_t local_interfaces[DR_TEST_MAX_INTERFACES];
 
 	aud_bool_t automatic_update_on_state_change;
+
+	// components updated on entering the active state and whenever they outlive
+	// their max age (0: never expires); the others only when queried
+	uint32_t subscribed_components;
+	uint32_t max_age_ms[DR_DEVICE_COMPONENT_COUNT];
+
+	// for RunDll: how long to wait for the device, and for which components
+	unsigned int ready_timeout_ms;
+	uint32_t ready_components;
 #if DAPI_HAS_CONFIGURABLE_MDNS_SERVER_PORT == 1
 	uint16_t mdns_server_port;
 #endif
@@ -97,13 +105,93 @@ typedef struct dr_test_request
 {
 	dante_request_id_t id;
 	char description[DR_TEST_REQUEST_DESCRIPTION_LENGTH];
+	int32_t component; // for component updates, otherwise DR_TEST_EVENT_NO_COMPONENT
+	aud_utime_t issued;
+	uint64_t token; // reported back with the completion event
+	struct dr_test_bulk * bulk; // set for the chunks of a bulk operation
+	unsigned int bulk_first;    // entry the chunk starts at
+	int32_t rxstats_field;      // for statistics polls, otherwise DR_TEST_RXSTATS_NO_FIELD
+
+	aud_bool_t in_use;
+	aud_bool_t indexed;  // 'id' is in the hash
+	unsigned int next;   // next free slot, or next slot in the same hash bucket
+	unsigned int next_pending;
 } dr_test_request_t;
 
+// Requests are handed out before the routing API writes their id, so newly
+// allocated slots sit on a short pending list and are hashed by id lazily,
+// on the next allocation or lookup.
+typedef struct dr_test_request_table
+{
+	unsigned int capacity;
+	dr_test_request_t * slots;
+	unsigned int free_head;
+	unsigned int pending_head;
+	unsigned int num_in_use;
+
+	unsigned int num_buckets; // power of two
+	unsigned int * buckets;   // first slot per bucket, DR_TEST_REQUEST_NONE if empty
+} dr_test_request_table_t;
+
+typedef enum dr_test_bulk_kind
+{
+	DR_TEST_BULK_RXLABELS,
+	DR_TEST_BULK_SUBSCRIPTIONS,
+	DR_TEST_BULK_TXLABELS,
+	DR_TEST_BULK_TXFLOWS
+} dr_test_bulk_kind_t;
+
+// A large batch operation split into DR_TEST_MAX_BATCH sized requests, several
+// of them in flight at once. Entries a batch cannot carry come last and are
+// sent one per request. Leading entries, if any, have chunks of their own that
+// complete before any later chunk is sent. The entries are owned by the operation because
+// the routing API reads them until each request completes.
+// Every chunk reports a DR_TEST_EVENT_BULK_CHUNK_COMPLETED event, then the
+// operation a DR_TEST_EVENT_REQUEST_COMPLETED event with its first failure.
+typedef struct dr_test_bulk
+{
+	struct dr_test_bulk * next;
+	dr_test_bulk_kind_t kind;
+	uint64_t token; // reported with the completion of the whole operation
+
+	unsigned int num_entries;
+	unsigned int num_single; // trailing entries a batch cannot carry, sent one per request
+	unsigned int num_leading; // leading entries that must complete before the rest is sent
+	unsigned int num_chunks;
+	unsigned int next_chunk; // first chunk not sent yet
+	unsigned int in_flight;
+	unsigned int completed;
+	aud_error_t result;      // first failure, if any
+
+	union
+	{
+		dr_batch_rxlabel_t * rxlabels;
+		dr_batch_subscription_t * subscriptions;
+		dr_batch_txlabel_t * txlabels;
+		struct
+		{
+			dr_batch_txflow_t * batched; // the leading entries
+			dr_test_txflow_spec_t * single;
+		} txflows;
+	} _;
+} dr_test_bulk_t;
+
+typedef struct dr_test_session dr_test_session_t;
+
+#ifdef WIN32
+typedef HANDLE dr_test_thread_t;
+#else
+typedef pthread_t dr_test_thread_t;
+#endif
 
 typedef struct
 {
 	dr_test_options_t options;
 
+	// set when the device was opened with session_open_device, which then
+	// owns dapi, runtime, handler and devices below
+	dr_test_session_t * session;
+
 	dapi_t * dapi;
 	aud_env_t * env;
 	dante_runtime_t * runtime;
@@ -111,6 +199,9 @@ typedef struct
 
 	dr_devices_t * devices;
 
+	// wakes step when commands are issued from other threads; unused for session devices
+	dapi_utils_wake_t wake;
+
 	dr_device_t * device;
 
 	uint16_t nintf;
@@ -125,14 +216,98 @@ typedef struct
 	uint16_t txlabels_buflen;
 	dr_txlabel_t * txlabels_buf;
 
-	dr_test_request_t requests[DR_TEST_MAX_REQUESTS];
+	// backing strings for get_rxchannels / get_txchannels, valid until the next query
+	unsigned int channel_text_len;
+	dr_test_channel_text_t * channel_text;
+
+	// scratch space for get_*_snapshot
+	dr_test_snapshot_builder_t snapshot_builder;
+
+	// channel change tracking for get_channel_changes
+	uint32_t generation;
+	dr_test_channel_changes_t rx_changes;
+	dr_test_channel_changes_t tx_changes;
+
+	dr_test_request_table_t requests;
+	uint64_t last_request_token;
+
+	// prints request and bulk completions; set by the console, left off by the DLL exports
+	aud_bool_t print_requests;
+
+	// components with an update in flight, and when the last update of each completed
+	uint32_t updating_components;
+	aud_utime_t updated[DR_DEVICE_COMPONENT_COUNT];
+
+	// rx flow error time series, see start_rxflow_error_stats
+	dr_test_rxstats_t rxstats;
+
+	// bulk operations with chunks left to send or complete
+	dr_test_bulk_t * bulks;
+
+	// head of this device's entries in the session's name index
+	uint32_t indexed_names;
+
+	// calls from other threads, run by the thread in step; session devices use the session's
+	dr_test_command_queue_t commands;
+
+	// typed events, queued for drain_events; event_callback is told once per step that queued any
+	DR_TEST_EVENT_CALLBACK event_callback;
+	void * event_context;
+	uint32_t signalled_head;
+	dr_test_event_ring_t events;
 
 } dr_test_t;
 
+// One dapi environment and device factory shared by many dr_test_t
+struct dr_test_session
+{
+	dr_test_options_t options;
+
+	dapi_t * dapi;
+	aud_env_t * env;
+	dante_runtime_t * runtime;
+	dante_domain_handler_t * handler;
+
+	dr_devices_t * devices;
+
+	dapi_utils_wake_t wake;
+	dr_test_command_queue_t commands;
+
+	// every device draws from the request limit of 'devices'; bulk chunks of
+	// all devices together stay within 'bulk_budget', which is configurable
+	unsigned int request_limit;
+	unsigned int requests_in_use;
+	unsigned int bulk_budget;
+	unsigned int bulk_in_flight;
+	unsigned int next_pump; // device offered free slots first, rotated on every pump
+
+	// tx channel names and labels of every device, see session_resolve_channels
+	dr_test_name_index_t names;
+
+	// rx flow error statistics of every device, see session_start_rxflow_error_stats
+	uint32_t rxstats_interval_ms;
+	uint32_t rxstats_fields;
+	uint32_t rxstats_history;
+
+	// conmon metering of any devices, see session_start_metering
+	dr_test_metering_t * metering;
+
+	unsigned int max_tests;
+	unsigned int num_tests;
+	dr_test_t ** tests;
+
+	// native event loop started with session_start_loop, stepping the
+	// shared runtime (and so every device of the session) from one thread
+	aud_bool_t loop_started;
+	volatile aud_bool_t loop_running;
+	volatile aud_error_t loop_result;
+	dr_test_thread_t loop_thread;
+};
+
 
 // Static buffers: save  stack memory by sharing these buffers
-aud_errbuf_t g_test_errbuf;
-char g_input_buf[BUFSIZ];
+DR_TEST_THREAD_LOCAL aud_errbuf_t g_test_errbuf;
+DR_TEST_THREAD_LOCAL char g_input_buf[BUFSIZ];
 
 // callback functions
 static dr_device_changed_fn dr_test_on_device_changed;
@@ -144,3684 +319,7247 @@ static ddh_change_event_fn dr_test_event_handle_ddh_changes;
 static aud_error_t
 dr_test_open(dr_test_t * test);
 
-// Wrapper callbacks
-typedef void (CALLBACK* ON_DOMAIN_EVENT_CALLBACK)(void* test, const char* text);
-typedef void (CALLBACK* ON_DEVICE_EVENT_CALLBACK)(void* test, const char* name, const char* text);
-
-ON_DOMAIN_EVENT_CALLBACK domain_event_callback;
-ON_DEVICE_EVENT_CALLBACK device_event_callback;
-
 
 //----------------------------------------------------------
 // Request management
 //----------------------------------------------------------
 
-static dr_test_request_t *
-dr_test_allocate_request
+static void
+dr_test_on_sockets_changed
 (
-	dr_test_t * test,
-	const char * description
+	const dr_devices_t * devices
 ) {
-	unsigned int i;
-	for (i = 0; i < DR_TEST_MAX_REQUESTS; i++)
-	{
-		if (test->requests[i].id == DANTE_NULL_REQUEST_ID)
-		{
-			aud_strlcpy(test->requests[i].description, description ? description : "", DR_TEST_REQUEST_DESCRIPTION_LENGTH);
-			return test->requests + i;
-		}
-	}
-	DR_TEST_ERROR("error allocating request '%s': no more requests\n", description);
-	return NULL;
+	dr_test_t * test = (dr_test_t *) dr_devices_get_context(devices);
+	dapi_utils_wake_sockets_changed(&test->wake);
 }
 
 static void
-dr_test_request_release
+dr_test_session_on_sockets_changed
 (
-	dr_test_request_t * request
+	const dr_devices_t * devices
 ) {
-	request->id = DANTE_NULL_REQUEST_ID;
-	request->description[0] = '\0';
+	dr_test_session_t * session = (dr_test_session_t *) dr_devices_get_context(devices);
+	dapi_utils_wake_sockets_changed(&session->wake);
 }
 
-void
-dr_test_on_response
+// Interrupts the step currently blocked on this handle's runtime, so a
+// request issued from another thread goes out without waiting for the timeout
+static void
+dr_test_wake
 (
-	dr_device_t * device,
-	dante_request_id_t request_id,
-	aud_error_t result
+	dr_test_t * test
 ) {
-	char line[4096];
-	memset(line, 0, 1);
+	dapi_utils_wake_signal(test->session ? &test->session->wake : &test->wake);
+}
 
-	unsigned int i;
-	dr_test_t * test = (dr_test_t *)  dr_device_get_context(device);
+// Runs 'fn' on the thread stepping the queue's runtime and returns its result.
+// Without a consumer, or when called from the consumer itself (e.g. from an
+// event callback), 'fn' runs directly.
+static aud_error_t
+dr_test_submit_to
+(
+	dr_test_command_queue_t * queue,
+	dapi_utils_wake_t * wake,
+	dr_test_command_fn fn,
+	void * target,
+	void * args
+) {
+	dr_test_command_t command;
+	aud_error_t result;
 
-	for (i = 0; i < DR_TEST_MAX_REQUESTS; i++)
+	if (!dr_test_command_queue_is_remote(queue))
 	{
-		if (test->requests[i].id == request_id)
-		{
-			DR_TEST_PRINT("\nEVENT: completed request %p (%s) with result %s\n", 
-				request_id, test->requests[i].description, dr_error_message(result, g_test_errbuf));
-			snprintf(line + strlen(line), 4096, "\nEVENT: completed request %p (%s) with result %s\n",
-				request_id, test->requests[i].description, dr_error_message(result, g_test_errbuf));
-			dr_test_request_release(test->requests+i);
-			return;
-		}
+		result = fn(target, args);
+		dapi_utils_wake_signal(wake);
+		return result;
 	}
-	DR_TEST_ERROR("\nEVENT: completed unknown request %p\n", request_id);
+	dr_test_command_init(&command, fn, target, args);
+	dr_test_command_queue_push(queue, &command);
+	dapi_utils_wake_signal(wake);
+	return dr_test_command_wait(queue, &command);
+}
 
-	(*device_event_callback)(test, dr_device_get_name(device), line);
+static aud_error_t
+dr_test_submit
+(
+	dr_test_t * test,
+	dr_test_command_fn fn,
+	void * args
+) {
+	if (test->session)
+	{
+		return dr_test_submit_to(&test->session->commands, &test->session->wake, fn, test, args);
+	}
+	return dr_test_submit_to(&test->commands, &test->wake, fn, test, args);
 }
 
+static aud_error_t
+dr_test_requests_init
+(
+	dr_test_request_table_t * table,
+	unsigned int capacity
+) {
+	unsigned int i;
+
+	if (!capacity)
+	{
+		capacity = DR_TEST_DEFAULT_REQUEST_LIMIT;
+	}
+	memset(table, 0, sizeof(dr_test_request_table_t));
+	table->num_buckets = 1;
+	while (table->num_buckets < capacity)
+	{
+		table->num_buckets <<= 1;
+	}
+	table->slots = (dr_test_request_t *) calloc(capacity, sizeof(dr_test_request_t));
+	table->buckets = (unsigned int *) malloc(table->num_buckets * sizeof(unsigned int));
+	if (!table->slots || !table->buckets)
+	{
+		free(table->slots);
+		free(table->buckets);
+		memset(table, 0, sizeof(dr_test_request_table_t));
+		return AUD_ERR_NOMEMORY;
+	}
+	for (i = 0; i < table->num_buckets; i++)
+	{
+		table->buckets[i] = DR_TEST_REQUEST_NONE;
+	}
+	for (i = 0; i < capacity; i++)
+	{
+		table->slots[i].next = (i + 1 < capacity) ? i + 1 : DR_TEST_REQUEST_NONE;
+		table->slots[i].component = DR_TEST_EVENT_NO_COMPONENT;
+	}
+	table->capacity = capacity;
+	table->free_head = 0;
+	table->pending_head = DR_TEST_REQUEST_NONE;
+	return AUD_SUCCESS;
+}
 
 static void
-dr_test_cancel
+dr_test_requests_free
 (
-	dr_test_t * test
-)
-{
-	// This code example cancels all outstanding requests, returning their
-	// resources to the pool.
+	dr_test_request_table_t * table
+) {
+	free(table->slots);
+	free(table->buckets);
+	memset(table, 0, sizeof(dr_test_request_table_t));
+}
 
-	unsigned int i;
-	for (i = 0; i < DR_TEST_MAX_REQUESTS; i++)
+static unsigned int
+dr_test_request_bucket
+(
+	const dr_test_request_table_t * table,
+	dante_request_id_t id
+) {
+	uintptr_t h = (uintptr_t) id;
+	h ^= h >> 16;
+	return (unsigned int) ((h * 2654435761u) & (table->num_buckets - 1));
+}
+
+// Hash every pending slot whose id has been written by the routing API
+static void
+dr_test_requests_index_pending
+(
+	dr_test_request_table_t * table
+) {
+	unsigned int * link = &table->pending_head;
+	while (*link != DR_TEST_REQUEST_NONE)
 	{
-		if (test->requests[i].id != DANTE_NULL_REQUEST_ID)
+		dr_test_request_t * request = table->slots + *link;
+		if (request->id != DANTE_NULL_REQUEST_ID)
 		{
-			if (test->requests[i].description[0])
-			{
-				DR_TEST_PRINT("Cancelling #%u: %s\n", i, test->requests[i].description);
-			}
-			else
-			{
-				DR_TEST_PRINT("Cancelling #%u\n", i);
-			}
-			dr_device_cancel_request(test->device, test->requests[i].id);
-			dr_test_request_release(test->requests + i);
+			unsigned int slot = *link;
+			unsigned int bucket = dr_test_request_bucket(table, request->id);
+			*link = request->next_pending;
+			request->next = table->buckets[bucket];
+			table->buckets[bucket] = slot;
+			request->indexed = AUD_TRUE;
+		}
+		else
+		{
+			link = &request->next_pending;
 		}
 	}
 }
 
-
-//----------------------------------------------------------
-// State management and basic functionality
-//----------------------------------------------------------
-
-#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
-static aud_error_t
-dr_test_set_current_domain_by_uuid
+static dr_test_request_t *
+dr_test_request_with_id
 (
-	dr_test_t * test,
-	dante_domain_uuid_t uuid
+	dr_test_request_table_t * table,
+	dante_request_id_t id
 ) {
-	dante_domain_handler_t * handler = dapi_get_domain_handler(test->dapi);
-	
-	aud_error_t result = dante_domain_handler_set_current_domain_by_uuid(handler, uuid);
-	if (result != AUD_SUCCESS)
+	unsigned int slot;
+
+	if (!table->capacity)
 	{
-		DR_TEST_ERROR("Error setting active_domain: %s\n",
-			dr_error_message(result, g_test_errbuf));
-		return result;
+		return NULL;
 	}
-	dapi_utils_print_domain_handler_info(test->handler);
-	return AUD_SUCCESS;
+	dr_test_requests_index_pending(table);
+	for (slot = table->buckets[dr_test_request_bucket(table, id)]; slot != DR_TEST_REQUEST_NONE; slot = table->slots[slot].next)
+	{
+		if (table->slots[slot].id == id)
+		{
+			return table->slots + slot;
+		}
+	}
+	return NULL;
 }
 
-static aud_error_t
-dr_test_set_current_domain_by_name
+static dr_test_request_t *
+dr_test_allocate_request
 (
 	dr_test_t * test,
-	const char * name
+	const char * description
 ) {
-	dante_domain_handler_t * handler = dapi_get_domain_handler(test->dapi);
-	
-	aud_error_t result = dante_domain_handler_set_current_domain_by_name(handler, name);
-	if (result != AUD_SUCCESS)
+	dr_test_request_table_t * table = &test->requests;
+	dr_test_request_t * request;
+	unsigned int slot;
+
+	dr_test_requests_index_pending(table);
+	slot = table->free_head;
+	if (slot == DR_TEST_REQUEST_NONE || !table->capacity
+		|| (test->session && test->session->requests_in_use >= test->session->request_limit))
 	{
-		DR_TEST_ERROR("Error setting active_domain: %s\n",
-			dr_error_message(result, g_test_errbuf));
-		return result;
+		DR_TEST_ERROR("error allocating request '%s': no more requests\n", description);
+		return NULL;
 	}
-	dapi_utils_print_domain_handler_info(test->handler);
-	return AUD_SUCCESS;
+	request = table->slots + slot;
+	table->free_head = request->next;
+	table->num_in_use++;
+	if (test->session)
+	{
+		test->session->requests_in_use++;
+	}
+
+	request->id = DANTE_NULL_REQUEST_ID;
+	aud_strlcpy(request->description, description ? description : "", DR_TEST_REQUEST_DESCRIPTION_LENGTH);
+	request->component = DR_TEST_EVENT_NO_COMPONENT;
+	request->rxstats_field = DR_TEST_RXSTATS_NO_FIELD;
+	aud_utime_get(&request->issued);
+	request->token = ++test->last_request_token;
+	request->bulk = NULL;
+	request->in_use = AUD_TRUE;
+	request->indexed = AUD_FALSE;
+	request->next = DR_TEST_REQUEST_NONE;
+	request->next_pending = table->pending_head;
+	table->pending_head = slot;
+	return request;
 }
-#endif
 
-void send_changes_to_callback(const ddh_changes_t* changes)
-{
-	char line[4096];
-	char buf[256];
-	ddh_change_flags_t change_flags = ddh_changes_get_change_flags(changes);
-	dante_domain_handler_t* handler = ddh_changes_get_domain_handler(changes);
+static void
+dr_test_request_release
+(
+	dr_test_t * test,
+	dr_test_request_t * request
+) {
+	dr_test_request_table_t * table = &test->requests;
+	unsigned int slot = (unsigned int) (request - table->slots);
+	unsigned int * link;
 
-	snprintf(line, 4096, "Domain Hander Event:\n");
-	snprintf(line + strlen(line), 4096, "  Flags: %s\n", ddh_change_flags_to_string(change_flags, buf, sizeof(buf)));
-	if (change_flags & DDH_CHANGE_FLAG_ERROR)
-	{
-		aud_error_t result = ddh_changes_get_error_code(changes);
-		snprintf(line + strlen(line), 4096, "  Error=%s\n", aud_error_get_name(result));
-	}
-	if (change_flags & DDH_CHANGE_FLAG_STATE)
+	if (!request->in_use)
 	{
-		ddh_state_t state = dante_domain_handler_get_state(handler);
-		snprintf(line + strlen(line), 4096, "  Domain Handler State: %s\n", ddh_state_to_string(state));
+		return;
 	}
-	if (change_flags & DDH_CHANGE_FLAG_CURRENT_DOMAIN)
+	if (request->indexed)
 	{
-		dante_domain_info_t current = dante_domain_handler_get_current_domain(handler);
-		snprintf(line + strlen(line), 4096, "  Current domain: %s\n", dapi_utils_domain_info_to_string(&current, buf, sizeof(buf)));
+		link = &table->buckets[dr_test_request_bucket(table, request->id)];
+		while (*link != slot)
+		{
+			link = &table->slots[*link].next;
+		}
+		*link = request->next;
 	}
-
-#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
-	if (change_flags & DDH_CHANGE_FLAG_AVAILABLE_DOMAINS)
+	else
 	{
-		snprintf(line + strlen(line), 4096, "  Available domains:\n");
-		unsigned int d, nd = dante_domain_handler_num_available_domains(handler);
-		for (d = 0; d < nd; d++)
+		link = &table->pending_head;
+		while (*link != slot)
 		{
-			dante_domain_info_t available = dante_domain_handler_available_domain_at_index(handler, d);
-			snprintf(line + strlen(line), 4096, "    %s\n", dapi_utils_domain_info_to_string(&available, buf, sizeof(buf)));
+			link = &table->slots[*link].next_pending;
 		}
+		*link = request->next_pending;
 	}
-#elif DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__EMBEDDED
-	if (((change_flags & DDH_CHANGE_FLAG_CURRENT_DOMAIN) == 0) && (change_flags & DDH_CHANGE_FLAG_REMOTE_CONTROL_POLICY))
+
+	if (request->component != DR_TEST_EVENT_NO_COMPONENT)
 	{
-		snprintf(line + strlen(line), 4096, "  Remote policy: %s\n", dante_access_policy_to_string(dante_domain_handler_get_remote_control_policy(handler)));
+		test->updating_components &= ~(1u << request->component);
 	}
-	if (change_flags & DDH_CHANGE_FLAG_LOCAL_CONTROL_POLICY)
+	if (request->rxstats_field != DR_TEST_RXSTATS_NO_FIELD)
 	{
-		snprintf(line + strlen(line), 4096, "  Local policy: %s\n", dante_access_policy_to_string(dante_domain_handler_get_local_control_policy(handler)));
+		// cancelled or failed to send, the sample goes without this field
+		dr_test_rxstats_end_field(&test->rxstats, (dante_rxflow_error_type_t) request->rxstats_field, NULL, NULL);
+	}
+	request->id = DANTE_NULL_REQUEST_ID;
+	request->description[0] = '\0';
+	request->component = DR_TEST_EVENT_NO_COMPONENT;
+	request->rxstats_field = DR_TEST_RXSTATS_NO_FIELD;
+	request->token = 0;
+	request->bulk = NULL;
+	request->in_use = AUD_FALSE;
+	request->indexed = AUD_FALSE;
+	request->next = table->free_head;
+	table->free_head = slot;
+	table->num_in_use--;
+	if (test->session)
+	{
+		test->session->requests_in_use--;
 	}
-#endif
-	snprintf(line + strlen(line), 4096, "\n");
-
-	void* test = dante_domain_handler_get_context(handler);
-	(*domain_event_callback)(test, line);
 }
 
-void dr_test_event_handle_ddh_changes
+static uint32_t
+dr_test_request_elapsed_us
 (
-	const ddh_changes_t * changes
- ) {
-	send_changes_to_callback(changes);
-	dapi_utils_print_domain_changes(changes);
-
-#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
-	aud_error_t result;
-	dante_domain_handler_t * handler = ddh_changes_get_domain_handler(changes);
-	ddh_change_flags_t change_flags = ddh_changes_get_change_flags(changes);
-	dr_test_t * test = dante_domain_handler_get_context(handler);
+	const dr_test_request_t * request
+) {
+	aud_utime_t now;
+	aud_utime_get(&now);
+	return (uint32_t) ((now.tv_sec - request->issued.tv_sec) * 1000000 + (now.tv_usec - request->issued.tv_usec));
+}
 
+//----------------------------------------------------------
+// Typed events
+//----------------------------------------------------------
 
-	if (change_flags & DDH_CHANGE_FLAG_AVAILABLE_DOMAINS && test->options.ddm_config.domain[0])
+static uint32_t
+dr_test_stale_components
+(
+	dr_device_t * device
+) {
+	uint32_t stale = 0;
+	dr_device_component_t c;
+	for (c = 0; c < DR_DEVICE_COMPONENT_COUNT; c++)
 	{
-		dante_domain_info_t info = dante_domain_handler_get_current_domain(handler);
-		if (strcmp(info.name, test->options.ddm_config.domain))
+		if (dr_device_is_component_stale(device, c))
 		{
-			result = dapi_utils_update_ddh_current_domain(handler, test->options.ddm_config.domain);
-			if (result != AUD_SUCCESS)
-			{
-				return;
-			}
-			info = dante_domain_handler_get_current_domain(handler);
-			//open the device if not yet opened.
-			if (!test->device && !strcmp(info.name, test->options.ddm_config.domain))
-			{
-				dr_test_open(test);
-			}
+			stale |= (1 << c);
 		}
 	}
-#endif
+	return stale;
 }
 
-static aud_error_t
-dr_test_query_capabilities
+// Tells the owner that events are waiting, once for all events queued since
+// the last call, so they are drained in bulk rather than passed one at a time
+static void
+dr_test_signal_events
 (
 	dr_test_t * test
 ) {
-	aud_error_t result;
-	dr_test_request_t * request = dr_test_allocate_request(test, "QueryCapabilities");
-	if (!request)
-	{
-		return AUD_ERR_NOBUFS;
-	}
+	uint32_t head = test->events.head;
 
-	result = dr_device_query_capabilities(test->device, &dr_test_on_response, &request->id);
-	if (result != AUD_SUCCESS)
+	if (test->event_callback && head != test->signalled_head)
 	{
-		DR_TEST_ERROR("Error sending query capabilities: %s\n",
-			dr_error_message(result, g_test_errbuf));
-		dr_test_request_release(request);
-		return result;
+		test->signalled_head = head;
+		test->event_callback(test->event_context);
 	}
-	return result;
 }
 
 static void
-dr_test_mark_stale
+dr_test_push_device_event
 (
 	dr_test_t * test,
-	dr_device_component_t component,
-	dante_id_t subcomponent
-) {
-	if (component == DR_DEVICE_COMPONENT_COUNT)
-	{
-		DR_TEST_DEBUG("Invalidating ALL components\n");
-		for (component = 0; component < DR_DEVICE_COMPONENT_COUNT; component++)
-		{
-			dr_device_mark_component_stale(test->device, component);
-		}
-	}
-	else if (subcomponent == 0)
+	dr_device_t * device,
+	dr_device_change_flags_t change_flags
+) {
+	dr_test_event_t event;
+	memset(&event, 0, sizeof(event));
+	event.kind = DR_TEST_EVENT_DEVICE_CHANGED;
+	event.change_flags = change_flags;
+	event.stale_components = dr_test_stale_components(device);
+	event.component = DR_TEST_EVENT_NO_COMPONENT;
+	event.state = dr_device_get_state(device);
+	event.handle = (uint64_t) (uintptr_t) test;
+	dr_test_event_ring_push(&test->events, &event);
+}
+
+static void
+dr_test_push_response_event
+(
+	dr_test_t * test,
+	dr_device_t * device,
+	dante_request_id_t request_id,
+	int32_t component,
+	uint64_t token,
+	aud_error_t result
+) {
+	dr_test_event_t event;
+	memset(&event, 0, sizeof(event));
+	event.kind = DR_TEST_EVENT_REQUEST_COMPLETED;
+	event.component = component;
+	if (device)
+	{
+		event.stale_components = dr_test_stale_components(device);
+		event.state = dr_device_get_state(device);
+	}
+	event.result = result;
+	event.handle = (uint64_t) (uintptr_t) test;
+	event.request_id = (uint64_t) (uintptr_t) request_id;
+	event.token = token;
+	dr_test_event_ring_push(&test->events, &event);
+}
+
+static void
+dr_test_push_domain_event
+(
+	dr_test_t * test,
+	const ddh_changes_t * changes
+) {
+	dante_domain_handler_t * handler = ddh_changes_get_domain_handler(changes);
+	dr_test_event_t event;
+
+	if (!test)
 	{
-		DR_TEST_DEBUG("Invalidating component %s\n", dr_device_component_to_string(component));
-		dr_device_mark_component_stale(test->device, component);
+		return;
 	}
-	else
+	memset(&event, 0, sizeof(event));
+	event.kind = DR_TEST_EVENT_DOMAIN_CHANGED;
+	event.change_flags = ddh_changes_get_change_flags(changes);
+	event.component = DR_TEST_EVENT_NO_COMPONENT;
+	event.state = dante_domain_handler_get_state(handler);
+	if (event.change_flags & DDH_CHANGE_FLAG_ERROR)
 	{
-		if (component == DR_DEVICE_COMPONENT_TXCHANNELS)
-		{
-			if (subcomponent <= test->ntx)
-			{
-				DR_TEST_DEBUG("Invalidating txchannel %u\n", subcomponent);
-				dr_txchannel_mark_stale(test->tx[subcomponent-1]);
-			}
-			else
-			{
-				DR_TEST_ERROR("Invalid txchannel %u\n", subcomponent);
-			}
-		}
-		else if (component == DR_DEVICE_COMPONENT_RXCHANNELS)
-		{
-			if (subcomponent <= test->nrx)
-			{
-				DR_TEST_DEBUG("Invalidating rxchannel %u\n", subcomponent);
-				dr_rxchannel_mark_stale(test->rx[subcomponent-1]);
-			}
-			else
-			{
-				DR_TEST_ERROR("Invalid rxchannel %u\n", subcomponent);
-			}
-		}
-		else if (component == DR_DEVICE_COMPONENT_TXLABELS)
-		{
-			aud_error_t result = dr_device_mark_txlabel_stale(test->device, subcomponent);
-			if (result == AUD_SUCCESS)
-			{
-				DR_TEST_DEBUG("Invalidating txlabel %u\n", subcomponent);
-			}
-			else
-			{
-				DR_TEST_ERROR("Error invalidating txlabel %u: %s\n", subcomponent, aud_error_message(result, g_test_errbuf));
-			}
-		}
-		else
-		{
-			DR_TEST_DEBUG("Per-subcomponent stale marking not supported for component  %s\n", dr_device_component_to_string(component));
-		}
+		event.result = ddh_changes_get_error_code(changes);
 	}
+	event.handle = (uint64_t) (uintptr_t) test;
+	dr_test_event_ring_push(&test->events, &event);
 }
 
-static aud_error_t
-dr_test_update
+//----------------------------------------------------------
+// Bulk operations
+//----------------------------------------------------------
+
+static void
+dr_test_bulk_free
 (
-	dr_test_t * test
+	dr_test_bulk_t * bulk
 ) {
-	aud_error_t result;
-	dr_device_component_t c;
-	for (c = 0; c < DR_DEVICE_COMPONENT_COUNT; c++)
+	switch (bulk->kind)
+	{
+	case DR_TEST_BULK_RXLABELS:
+		free(bulk->_.rxlabels);
+		break;
+	case DR_TEST_BULK_SUBSCRIPTIONS:
+		free(bulk->_.subscriptions);
+		break;
+	case DR_TEST_BULK_TXLABELS:
+		free(bulk->_.txlabels);
+		break;
+	case DR_TEST_BULK_TXFLOWS:
+		free(bulk->_.txflows.batched);
+		free(bulk->_.txflows.single);
+		break;
+	}
+	free(bulk);
+}
+
+// Chunks of the leading entries, which no chunk shares with later entries
+static unsigned int
+dr_test_bulk_leading_chunks
+(
+	const dr_test_bulk_t * bulk
+) {
+	return (bulk->num_leading + DR_TEST_MAX_BATCH - 1) / DR_TEST_MAX_BATCH;
+}
+
+static unsigned int
+dr_test_bulk_batched_chunks
+(
+	const dr_test_bulk_t * bulk
+) {
+	unsigned int rest = bulk->num_entries - bulk->num_single - bulk->num_leading;
+
+	return dr_test_bulk_leading_chunks(bulk) + (rest + DR_TEST_MAX_BATCH - 1) / DR_TEST_MAX_BATCH;
+}
+
+static unsigned int
+dr_test_bulk_chunk_first
+(
+	const dr_test_bulk_t * bulk,
+	unsigned int chunk
+) {
+	unsigned int leading_chunks = dr_test_bulk_leading_chunks(bulk);
+	unsigned int batched_chunks = dr_test_bulk_batched_chunks(bulk);
+
+	if (chunk < leading_chunks)
 	{
-		dr_test_request_t * request;
-		if (!dr_device_is_component_stale(test->device, c))
-		{
-			continue;
-		}
-		DR_TEST_DEBUG("Updating stale component %s\n", dr_device_component_to_string(c));
+		return chunk * DR_TEST_MAX_BATCH;
+	}
+	return (chunk < batched_chunks) ? bulk->num_leading + (chunk - leading_chunks) * DR_TEST_MAX_BATCH :
+		bulk->num_entries - bulk->num_single + chunk - batched_chunks;
+}
 
-		request = dr_test_allocate_request(test, NULL);
-		if (!request)
-		{
-			return AUD_ERR_NOBUFS;
-		}
-		SNPRINTF(request->description, DR_TEST_REQUEST_DESCRIPTION_LENGTH, "Update %s", dr_device_component_to_string(c));
+static uint16_t
+dr_test_bulk_chunk_size
+(
+	const dr_test_bulk_t * bulk,
+	unsigned int first
+) {
+	unsigned int batched = bulk->num_entries - bulk->num_single;
+	unsigned int end = (first < bulk->num_leading) ? bulk->num_leading : batched;
 
-		result = dr_device_update_component(test->device, &dr_test_on_response, &request->id, c);
-		if (result != AUD_SUCCESS)
-		{
-			DR_TEST_ERROR("Error sending update %s: %s\n",
-				dr_device_component_to_string(c), dr_error_message(result, g_test_errbuf));
-			dr_test_request_release(request);
-			return result;
-		}
+	if (first >= batched)
+	{
+		return 1;
 	}
-	return AUD_SUCCESS;
+	return (uint16_t) ((end - first < DR_TEST_MAX_BATCH) ? end - first : DR_TEST_MAX_BATCH);
 }
 
+// Creates the flow of 'spec' through a flow config, for the settings the
+// batch command cannot carry. A config only creates flows, so a flow it
+// replaces was deleted by a leading batch entry.
 static aud_error_t
-dr_test_update_rxflow_errors
+dr_test_bulk_commit_txflow
 (
-	dr_test_t * test, 
-	dante_rxflow_error_type_t field_type,
-	aud_bool_t clear
+	dr_test_t * test,
+	const dr_test_txflow_spec_t * spec,
+	dante_request_id_t * request_id
 ) {
+	dr_txflow_config_t * config = NULL;
 	aud_error_t result;
-	dr_test_request_t * request;
-	if (field_type == DANTE_NUM_RXFLOW_ERROR_TYPES)
+	uint16_t i;
+
+	result = dr_txflow_config_new(test->device, (uint16_t) spec->id, (uint16_t) spec->num_slots, &config);
+	if (result != AUD_SUCCESS)
 	{
-		DR_TEST_DEBUG("Updating rxflow error flags\n");
-		request = dr_test_allocate_request(test, NULL);
-		if (!request)
-		{
-			return AUD_ERR_NOBUFS;
-		}
-		SNPRINTF(request->description, DR_TEST_REQUEST_DESCRIPTION_LENGTH, "Update rxflow error flags");
-		result = dr_device_update_rxflow_error_flags(test->device, &dr_test_on_response, &request->id, clear);
+		return result;
 	}
-	else
+	result = dr_txflow_config_set_latency_us(config, spec->latency_us);
+	if (result == AUD_SUCCESS)
 	{
-		DR_TEST_DEBUG("Updating rxflow error field %s\n", dante_rxflow_error_type_to_string(field_type));
-			request = dr_test_allocate_request(test, NULL);
-		if (!request)
+		result = dr_txflow_config_set_fpp(config, spec->fpp);
+	}
+	if (result == AUD_SUCCESS && spec->encoding)
+	{
+		result = dr_txflow_config_set_encoding(config, spec->encoding);
+	}
+	for (i = 0; result == AUD_SUCCESS && i < spec->num_slots; i++)
+	{
+		if (spec->channels[i])
 		{
-			return AUD_ERR_NOBUFS;
+			dr_txchannel_t * tx = dr_device_txchannel_with_id(test->device, (dante_id_t) spec->channels[i]);
+			result = tx ? dr_txflow_config_add_channel(config, tx, i) : AUD_ERR_INVALIDPARAMETER;
 		}
-		SNPRINTF(request->description, DR_TEST_REQUEST_DESCRIPTION_LENGTH, "Update rx flow %s", dante_rxflow_error_type_to_string(field_type));
-		result = dr_device_update_rxflow_error_fields(test->device, &dr_test_on_response, &request->id, field_type, clear);
 	}
 	if (result != AUD_SUCCESS)
 	{
-		DR_TEST_ERROR("Error update rxflow errors : %s\n",
-			dr_error_message(result, g_test_errbuf));
-		dr_test_request_release(request);
+		dr_txflow_config_discard(config);
 		return result;
 	}
-	return AUD_SUCCESS;
+	return dr_txflow_config_commit(config, dr_test_on_response, request_id);
 }
 
-static void
-dr_test_on_device_state_changed
+static aud_error_t
+dr_test_bulk_send_chunk
 (
-	dr_test_t * test
+	dr_test_t * test,
+	dr_test_bulk_t * bulk,
+	dr_test_request_t * request
 ) {
-	switch (dr_device_get_state(test->device))
-	{
-	case DR_DEVICE_STATE_RESOLVED:
-		// query capabilities
-		if (test->options.automatic_update_on_state_change)
-		{
-			DR_TEST_PRINT("device resolved, querying capabilities\n");
-			dr_test_query_capabilities(test);
-		}
-		return;
-
-	case DR_DEVICE_STATE_ACTIVE:
-		{
-			// update information
-			dr_device_get_txchannels(test->device, &test->ntx, &test->tx);
-			dr_device_get_rxchannels(test->device, &test->nrx, &test->rx);
-
-			// update all components when we enter the active state, unless we have a strange status
-			if (test->options.automatic_update_on_state_change)
-			{
-				dr_device_status_flags_t status_flags;
-				aud_error_t result = dr_device_get_status_flags(test->device, &status_flags);
-				if (result != AUD_SUCCESS)
-				{
-					DR_TEST_ERROR("Error getting status flags: %s\n", dr_error_message(result, g_test_errbuf));
-					return;
-				}
-				if (status_flags)
-				{
-					DR_TEST_PRINT("device active, status=0x%08x, not updating\n", status_flags);
-					return;
-				}
-				DR_TEST_PRINT("device active, updating\n");
-				dr_test_update(test);
-			}
-			return;
-		}
-	case DR_DEVICE_STATE_ERROR:
+	unsigned int first = dr_test_bulk_chunk_first(bulk, bulk->next_chunk);
+	uint16_t n = dr_test_bulk_chunk_size(bulk, first);
+
+	request->bulk_first = first;
+	switch (bulk->kind)
+	{
+	case DR_TEST_BULK_RXLABELS:
+		return dr_device_batch_rxlabel(test->device, dr_test_on_response, &request->id, n, bulk->_.rxlabels + first);
+	case DR_TEST_BULK_SUBSCRIPTIONS:
+		return dr_device_batch_subscribe(test->device, dr_test_on_response, &request->id, n, bulk->_.subscriptions + first);
+	case DR_TEST_BULK_TXLABELS:
+		return dr_device_batch_txlabel(test->device, dr_test_on_response, &request->id, n, bulk->_.txlabels + first);
+	case DR_TEST_BULK_TXFLOWS:
+		if (first < bulk->num_entries - bulk->num_single)
 		{
-			aud_error_t error_state_error = dr_device_get_error_state_error(test->device);
-			const char * error_state_action = dr_device_get_error_state_action(test->device);
-	
-			DR_TEST_PRINT("device has entered the ERROR state: error=%s, action='%s'\n",
-				dr_error_message(error_state_error, g_test_errbuf), (error_state_action ? error_state_action : ""));
-			return;
+			return dr_device_batch_txflow(test->device, dr_test_on_response, &request->id, n, bulk->_.txflows.batched + first);
 		}
-	default:
-		// nothing to do
-		DR_TEST_PRINT("device state is now '%s'\n", dr_device_state_to_string(dr_device_get_state(test->device)));
+		return dr_test_bulk_commit_txflow(test,
+			bulk->_.txflows.single + first - (bulk->num_entries - bulk->num_single), &request->id);
 	}
+	return AUD_ERR_INVALIDPARAMETER;
 }
 
-
+// Counts the chunk starting at entry 'first' and reports its result
 static void
-dr_test_on_device_addresses_changed
+dr_test_bulk_chunk_done
 (
-	dr_test_t * test
+	dr_test_t * test,
+	dr_test_bulk_t * bulk,
+	unsigned int first,
+	dante_request_id_t request_id,
+	aud_error_t result
 ) {
-	unsigned int i, na = 2;
-	dante_ipv4_address_t addresses[2];
-	dr_device_get_addresses(test->device, &na, addresses);
+	dr_test_event_t event;
 
-	DR_TEST_PRINT("Addresses are now: ");
-	for (i = 0; i < na; i++)
+	bulk->completed++;
+	if (result != AUD_SUCCESS && bulk->result == AUD_SUCCESS)
 	{
-		uint8_t * host = (uint8_t *) &(addresses[i].host);
-		DR_TEST_PRINT("%c%u.%u.%u.%u:%u", 
-			(i ? ',' : '['),
-			host[0], host[1], host[2], host[3], addresses[i].port);
+		bulk->result = result;
 	}
-	DR_TEST_PRINT("]\n");
+
+	memset(&event, 0, sizeof(event));
+	event.kind = DR_TEST_EVENT_BULK_CHUNK_COMPLETED;
+	event.component = DR_TEST_EVENT_NO_COMPONENT;
+	event.first = first;
+	event.count = dr_test_bulk_chunk_size(bulk, first);
+	event.result = result;
+	event.handle = (uint64_t) (uintptr_t) test;
+	event.request_id = (uint64_t) (uintptr_t) request_id;
+	event.token = bulk->token;
+	dr_test_event_ring_push(&test->events, &event);
 }
 
-//----------------------------------------------------------
-// Connect
-//----------------------------------------------------------
+// AUD_TRUE if 'free' slots leave enough in reserve. An operation with
+// nothing in flight may use the reserve, so it cannot stall.
+static aud_bool_t
+dr_test_bulk_slots_available
+(
+	const dr_test_bulk_t * bulk,
+	unsigned int free
+) {
+	return free && (!bulk->in_flight || free > DR_TEST_BULK_RESERVED_REQUESTS);
+}
 
-static aud_error_t
-dr_test_open
+// Sends the next chunk if request slots beyond the reserve are free, both in
+// the device's table and, for session devices, in the shared request limit and
+// bulk budget. Returns AUD_TRUE if a chunk was sent or failed to send.
+static aud_bool_t
+dr_test_bulk_send_next
 (
-	dr_test_t * test
+	dr_test_t * test,
+	dr_test_bulk_t * bulk
 ) {
-	dr_test_options_t * options = &test->options;
+	dr_test_request_table_t * table = &test->requests;
+	dr_test_session_t * session = test->session;
+	dr_test_request_t * request;
 	aud_error_t result;
-	dr_device_open_t * config = NULL;
-	unsigned i;
 
-	if (test->device)
+	if (bulk->next_chunk == bulk->num_chunks
+		|| !dr_test_bulk_slots_available(bulk, table->capacity - table->num_in_use))
 	{
-		result = AUD_ERR_ALREADY;
-		goto l__error;
+		return AUD_FALSE;
 	}
-
-
-	if (options->device_name[0])
+	if (bulk->next_chunk == dr_test_bulk_leading_chunks(bulk) && bulk->completed < bulk->next_chunk)
 	{
-		config = dr_device_open_config_new(options->device_name);
-		if (! config)
-		{
-			result = AUD_ERR_NOMEMORY;
-			goto l__error;
-		}
-	
-		dante_domain_uuid_t uuid = dr_devices_get_domain_uuid(test->devices);
-		if (IS_ADHOC_DOMAIN_UUID(uuid)) // We only need interfaces for devices when in the ADHOC domain
-		{
-			if (options->num_local_interfaces)
-			{
-				DR_TEST_PRINT("Opening connection to remote device %s using %d interfaces\n", 
-					options->device_name, options->num_local_interfaces);
-
-				//result = dr_device_open_remote_on_interfaces(test->devices, 
-				//	options->device_name, options->num_local_interface_indexes, options->local_interface_indexes, &test->device);
-
-				for (i = 0; i < options->num_local_interfaces; i++)
-				{
-					if (options->local_interfaces[i].flags == AUD_INTERFACE_IDENTIFIER_FLAG_NAME)
-					{
-						dr_device_open_config_enable_interface_by_name(
-							config, i, options->local_interfaces[i].name
-						);
-					}
-					else if (options->local_interfaces[i].flags == AUD_INTERFACE_IDENTIFIER_FLAG_INDEX)
-					{
-						dr_device_open_config_enable_interface_by_index(
-							config, i, options->local_interfaces[i].index
-						);
-					}
-				}
-			}
-			else
-			{
-				DR_TEST_PRINT("Opening connection to remote device %s\n", options->device_name);
-				//result = dr_device_open_remote(test->devices, options->device_name, &test->device);
-			}
-		}
-		result = dr_device_open_with_config(test->devices, config, &test->device);
-
-		dr_device_open_config_free(config);
-		config = NULL;
-	}
-	else if (options->num_addresses)
-	{
-		config = dr_device_open_config_new(NULL);
-		if (! config)
-		{
-			result = AUD_ERR_NOMEMORY;
-			goto l__error;
-		}
-
-		DR_TEST_PRINT("Opening connection using %d explicit addresses\n", 
-			options->num_addresses);
-		//result = dr_device_open_addresses(test->devices, 
-		//	options->num_addresses, options->addresses, &test->device);
-
-		for (i = 0; i < options->num_addresses; i++)
-		{
-			if (options->addresses[i])
-			{
-				dr_device_open_config_enable_address(
-					config, i, options->addresses[i], 0
-				);
-			}
-		}
-		result = dr_device_open_with_config(test->devices, config, &test->device);
-
-		dr_device_open_config_free(config);
-		config = NULL;
+		// the leading entries are not all done yet
+		return AUD_FALSE;
 	}
-	else if (options->domain_device_addr)
+	if (session
+		&& (!dr_test_bulk_slots_available(bulk, session->request_limit - session->requests_in_use)
+			|| (bulk->in_flight && session->bulk_in_flight >= session->bulk_budget)))
 	{
-		result = dr_device_open_domain_id(test->devices, options->domain_device_addr, &test->device);
+		return AUD_FALSE;
 	}
-	else
+	request = dr_test_allocate_request(test, "BulkChunk");
+	if (!request)
 	{
-		if (options->local_port)
-		{
-			DR_TEST_PRINT("Opening connection to local device on port %d\n", options->local_port);
-			result = dr_device_open_local_on_port(test->devices, options->local_port, &test->device);
-		}
-		else
-		{
-			DR_TEST_PRINT("Opening connection to local device\n");
-			result = dr_device_open_local(test->devices, &test->device);
-		}
+		return AUD_FALSE;
 	}
+	result = dr_test_bulk_send_chunk(test, bulk, request);
+	bulk->next_chunk++;
 	if (result != AUD_SUCCESS)
 	{
-	l__error:
-		DR_TEST_ERROR("Error creating device: %s\n",
+		DR_TEST_ERROR("Error sending bulk chunk %u/%u: %s\n", bulk->next_chunk, bulk->num_chunks,
 			dr_error_message(result, g_test_errbuf));
-		return result;
+		dr_test_bulk_chunk_done(test, bulk, request->bulk_first, DANTE_NULL_REQUEST_ID, result);
+		dr_test_request_release(test, request);
+		return AUD_TRUE;
 	}
-
-	dr_device_set_context(test->device, test);
-	dr_device_set_changed_callback(test->device, dr_test_on_device_changed);
-
-	// if we are connecting locally we may need to trigger the next state transition,
-	// if not this is a no-op
-	dr_test_on_device_state_changed(test);
-
-	return AUD_SUCCESS;
+	request->bulk = bulk;
+	bulk->in_flight++;
+	if (session)
+	{
+		session->bulk_in_flight++;
+	}
+	return AUD_TRUE;
 }
 
-static aud_error_t
-dr_test_close
+// A chunk sent by dr_test_bulk_send_next completed or was cancelled
+static void
+dr_test_bulk_chunk_returned
 (
-	dr_test_t * test
+	dr_test_t * test,
+	dr_test_bulk_t * bulk
 ) {
-	if (test->device)
+	bulk->in_flight--;
+	if (test->session)
 	{
-		dr_device_close(test->device);
-		test->device = NULL;
-		test->nintf = 0;
-		test->ntx = 0;
-		test->nrx = 0;
-		test->max_txflow_slots = 0;
-		test->max_rxflow_slots = 0;
-		test->tx = NULL;
-		test->rx = NULL;
+		test->session->bulk_in_flight--;
 	}
-	return AUD_SUCCESS;
 }
 
-
-//----------------------------------------------------------
-// Utilities
-//----------------------------------------------------------
-
-typedef enum dr_test_read_port_option
-{
-	DR_TEST_READ_NO_PORT,
-	DR_TEST_READ_OPTIONAL_PORT,
-	DR_TEST_READ_REQUIRES_PORT,
-} dr_test_read_port_option_t;
-
-#if 0
-/*
-	Prompt for and read an IPv4 address
-
-	If port is optional, then addr->port must be initialised to the default on the way in.
- */
-static int
-dr_test_read_address
+static void
+dr_test_bulk_finish
 (
-	dante_ipv4_address_t * addr,
-	dr_test_read_port_option_t has_port,
-	const char * desc
-)
-{
-	unsigned int ip1, ip2, ip3, ip4, port;
-	int matches;
-
-	if (has_port == DR_TEST_READ_NO_PORT)
-	{
-		DR_TEST_PRINT("Enter %s address (A.B.C.D):\n", desc);
-	}
-	else
+	dr_test_t * test,
+	dr_test_bulk_t * bulk
+) {
+	dr_test_bulk_t ** link = &test->bulks;
+	while (*link != bulk)
 	{
-		DR_TEST_PRINT("Enter %s address. Legal values are:\n", desc);
-		DR_TEST_PRINT("  A.B.C.D:PORT to specify an address and port\n");
-		DR_TEST_PRINT("  A.B.C.D to specify an address and use the default port\n");
+		link = &(*link)->next;
 	}
-	if (! fgets(g_input_buf, BUFSIZ, stdin))
-		return -1;
+	*link = bulk->next;
 
-	matches = sscanf(g_input_buf, "%u.%u.%u.%u:%u", &ip1, &ip2, &ip3, &ip4, &port);
-	if (matches < 4)
+	if (test->print_requests)
 	{
-		return -1;
+		DR_TEST_PRINT("\nEVENT: completed bulk operation (%u entries in %u requests) with result %s\n",
+			bulk->num_entries, bulk->num_chunks, dr_error_message(bulk->result, g_test_errbuf));
 	}
+	dr_test_push_response_event(test, test->device, DANTE_NULL_REQUEST_ID,
+		DR_TEST_EVENT_NO_COMPONENT, bulk->token, bulk->result);
+	dr_test_bulk_free(bulk);
+}
 
-	if (ip1 > 0xff || ip2 > 0xff || ip3 > 0xff || ip4 > 0xff)
-		return -1;
-
-	addr->host = htonl((ip1 << 24) | (ip2 << 16) | (ip3 << 8) | ip4);
-	if (matches == 5)
-	{
-		if (has_port == DR_TEST_READ_NO_PORT)
-		{
-			return -1;
-		}
-		else if (port > 0xFFFF)
-		{
-			return -1;
-		}
-		addr->port = (uint16_t) port;
-		return 0;
-	}
-	else
+// Completes the operations of 'test' whose chunks have all completed
+static void
+dr_test_bulk_finish_completed
+(
+	dr_test_t * test
+) {
+	dr_test_bulk_t * bulk = test->bulks;
+	while (bulk)
 	{
-		if (has_port == DR_TEST_READ_REQUIRES_PORT)
+		dr_test_bulk_t * next = bulk->next;
+		if (bulk->completed == bulk->num_chunks)
 		{
-			return -1;
+			dr_test_bulk_finish(test, bulk);
 		}
-		return 0;
+		bulk = next;
 	}
 }
-#endif
-
-
-//----------------------------------------------------------
-// Device-level configuration and settings
-//----------------------------------------------------------
 
+// Session devices share the request limit, so free slots go round robin to
+// one chunk per device at a time, starting with a different device each
+// time. Every device makes progress and no device holds the whole budget.
 static void
-dr_test_ping
+dr_test_session_pump_bulks
 (
-	dr_test_t * test
+	dr_test_session_t * session
 ) {
-	aud_error_t result;
-	dr_test_request_t * request;
-
-	DR_TEST_DEBUG("ACTION: Ping device\n");
+	aud_bool_t progress = AUD_TRUE;
+	unsigned int i, n = session->num_tests;
 
-	request = dr_test_allocate_request(test, "Ping");
-	if (!request)
+	if (!n)
 	{
 		return;
 	}
-	result = dr_device_ping(test->device, dr_test_on_response, &request->id);
-	if (result != AUD_SUCCESS)
+	while (progress)
 	{
-		DR_TEST_ERROR("Error sending ping: %s\n",
-			dr_error_message(result, g_test_errbuf));
-		dr_test_request_release(request);
-		return;
+		progress = AUD_FALSE;
+		for (i = 0; i < n; i++)
+		{
+			dr_test_t * test = session->tests[(session->next_pump + i) % n];
+			dr_test_bulk_t * bulk;
+			for (bulk = test->bulks; bulk; bulk = bulk->next)
+			{
+				if (dr_test_bulk_send_next(test, bulk))
+				{
+					progress = AUD_TRUE;
+					break;
+				}
+			}
+		}
+	}
+	session->next_pump = (session->next_pump + 1) % n;
+	for (i = 0; i < session->num_tests; i++)
+	{
+		dr_test_bulk_finish_completed(session->tests[i]);
 	}
 }
 
+// Gives request slots freed by any completion to the waiting operations,
+// oldest first, or across all devices of the session
 static void
-dr_test_store_config
+dr_test_bulk_pump_all
 (
 	dr_test_t * test
 ) {
-	aud_error_t result;
-	dr_test_request_t * request;
-
-	DR_TEST_DEBUG("ACTION: store config\n");
+	dr_test_bulk_t * bulk;
 
-	request = dr_test_allocate_request(test, "StoreConfig");
-	if (!request)
+	if (test->session)
 	{
+		dr_test_session_pump_bulks(test->session);
 		return;
 	}
-
-	result = dr_device_store_config(test->device, dr_test_on_response, &request->id);
-	if (result != AUD_SUCCESS)
+	for (bulk = test->bulks; bulk; bulk = bulk->next)
 	{
-		DR_TEST_ERROR("Error sending store config: %s\n",
-			dr_error_message(result, g_test_errbuf));
-		return;
+		while (dr_test_bulk_send_next(test, bulk))
+		{
+		}
 	}
+	dr_test_bulk_finish_completed(test);
 }
 
-static void
-dr_test_clear_config(dr_test_t * test)
-{
-	aud_error_t result;
-	dr_test_request_t * request;
-
-	DR_TEST_DEBUG("ACTION: Clear config\n");
+// Takes ownership of 'bulk', whose entries are set, and returns its token
+static uint64_t
+dr_test_bulk_start
+(
+	dr_test_t * test,
+	dr_test_bulk_t * bulk
+) {
+	dr_test_bulk_t ** link = &test->bulks;
+	uint64_t token = ++test->last_request_token;
 
-	request = dr_test_allocate_request(test, "ClearConfig");
-	if (!request)
+	bulk->num_chunks = dr_test_bulk_batched_chunks(bulk) + bulk->num_single;
+	bulk->token = token;
+	while (*link)
 	{
-		return;
+		link = &(*link)->next;
 	}
+	*link = bulk;
 
-	result = dr_device_clear_config(test->device, dr_test_on_response, &request->id);
-	if (result != AUD_SUCCESS)
+	if (test->print_requests)
 	{
-		DR_TEST_ERROR("Error sending clear config: %s\n",
-			dr_error_message(result, g_test_errbuf));
-		return;
+		DR_TEST_PRINT("Sending %u entries in %u requests\n", bulk->num_entries, bulk->num_chunks);
 	}
+	dr_test_bulk_pump_all(test);
+	return token;
 }
 
-static aud_error_t
-dr_test_rename
+// Cancels the requests of every operation and completes it with 'result'.
+// Called before the device is closed or its other requests are cancelled.
+static void
+dr_test_bulk_abort_all
 (
 	dr_test_t * test,
-	const char * new_name,
-	aud_bool_t close
+	aud_error_t result
 ) {
-	aud_error_t result;
-
-	DR_TEST_DEBUG("ACTION: rename\n");
+	unsigned int i;
 
-	if (new_name && !dante_name_is_valid_device_name(new_name))
+	for (i = 0; i < test->requests.capacity; i++)
 	{
-		DR_TEST_ERROR("Error: '%s' is not a valid dante device name\n", new_name);
-		return AUD_ERR_INVALIDDATA;
+		dr_test_request_t * request = test->requests.slots + i;
+		if (request->in_use && request->bulk)
+		{
+			if (test->device && request->id != DANTE_NULL_REQUEST_ID)
+			{
+				dr_device_cancel_request(test->device, request->id);
+			}
+			dr_test_bulk_chunk_returned(test, request->bulk);
+			dr_test_bulk_chunk_done(test, request->bulk, request->bulk_first, request->id, result);
+			dr_test_request_release(test, request);
+		}
 	}
-	if (close)
+	while (test->bulks)
 	{
-		result = dr_device_close_rename(test->device, new_name);
-		if (result != AUD_SUCCESS)
+		dr_test_bulk_t * bulk = test->bulks;
+		for (; bulk->next_chunk < bulk->num_chunks; bulk->next_chunk++)
 		{
-			DR_TEST_ERROR("Error renaming device to '%s': %s\n",
-				(new_name ? new_name : ""), dr_error_message(result, g_test_errbuf));
-			return result;
+			dr_test_bulk_chunk_done(test, bulk, dr_test_bulk_chunk_first(bulk, bulk->next_chunk),
+				DANTE_NULL_REQUEST_ID, result);
 		}
-		DR_TEST_PRINT("Device renamed, handle closed, exiting\n");
-		test->device = NULL;
+		dr_test_bulk_finish(test, bulk);
 	}
-	else
+	if (test->session)
 	{
-		dr_test_request_t * request = dr_test_allocate_request(test, "RenameDevice");
-		if (!request)
+		// the released slots may be what other devices are waiting for
+		dr_test_session_pump_bulks(test->session);
+	}
+}
+
+void
+dr_test_on_response
+(
+	dr_device_t * device,
+	dante_request_id_t request_id,
+	aud_error_t result
+) {
+	dr_test_t * test = (dr_test_t *)  dr_device_get_context(device);
+	dr_test_request_t * request = dr_test_request_with_id(&test->requests, request_id);
+
+	if (request)
+	{
+		dr_test_bulk_t * bulk = request->bulk;
+
+		// bulk chunks and statistics polls are reported by their operation, if at all
+		if (test->print_requests && !bulk && request->rxstats_field == DR_TEST_RXSTATS_NO_FIELD)
 		{
-			return AUD_ERR_NOBUFS;
+			DR_TEST_PRINT("\nEVENT: completed request %p (%s) with result %s after %uus\n",
+				request_id, request->description, dr_error_message(result, g_test_errbuf),
+				dr_test_request_elapsed_us(request));
 		}
-		result = dr_device_rename(test->device, dr_test_on_response, &request->id, new_name);
-	
-		if (result != AUD_SUCCESS)
+		if (bulk)
 		{
-			DR_TEST_ERROR("Error renaming device to '%s': %s\n",
-				(new_name ? new_name : ""), dr_error_message(result, g_test_errbuf));
-			return result;
+			dr_test_bulk_chunk_returned(test, bulk);
+			dr_test_bulk_chunk_done(test, bulk, request->bulk_first, request_id, result);
+		}
+		else if (request->rxstats_field != DR_TEST_RXSTATS_NO_FIELD)
+		{
+			// statistics polls are internal and raise no event
+			dante_rxflow_error_type_t field = (dante_rxflow_error_type_t) request->rxstats_field;
+			dante_rxflow_error_timestamp_t timestamp;
+			uint32_t * values = NULL;
+			if (result != AUD_SUCCESS
+				|| dr_device_get_rxflow_error_fields(device, field, &values, &timestamp) != AUD_SUCCESS)
+			{
+				values = NULL;
+			}
+			dr_test_rxstats_end_field(&test->rxstats, field, values, &timestamp);
+		}
+		else
+		{
+			if (request->component != DR_TEST_EVENT_NO_COMPONENT)
+			{
+				// failed updates count too, so a max age also paces the retries
+				aud_utime_get(&test->updated[request->component]);
+			}
+			dr_test_push_response_event(test, device, request_id, request->component, request->token, result);
 		}
+		dr_test_request_release(test, request);
+		dr_test_bulk_pump_all(test);
+		return;
 	}
-	return AUD_SUCCESS;
+	DR_TEST_ERROR("\nEVENT: completed unknown request %p\n", request_id);
+	dr_test_push_response_event(test, device, request_id, DR_TEST_EVENT_NO_COMPONENT, 0, result);
 }
 
-typedef enum
-{
-	DR_TEST_PERFORMANCE_TX,
-	DR_TEST_PERFORMANCE_RX,
-	DR_TEST_PERFORMANCE_UNICAST
-} dr_test_performance_t;
-
-const char * DR_TEST_PERFORMANCE_NAMES[] =
-{
-	"tx",
-	"rx",
-	"unicast"
-};
 
 static void
-dr_test_set_performance
+dr_test_cancel
 (
-	dr_test_t * test,
-	dr_test_performance_t performance,
-	dante_latency_us_t latency_us,
-	dante_fpp_t fpp
-) {
-	aud_error_t result;
-	dr_test_request_t * request;
+	dr_test_t * test
+)
+{
+	// This code example cancels all outstanding requests, returning their
+	// resources to the pool.
 
-	DR_TEST_DEBUG("Setting %s performance\n", DR_TEST_PERFORMANCE_NAMES[performance]);
+	unsigned int i;
 
-	request = dr_test_allocate_request(test, DR_TEST_PERFORMANCE_NAMES[performance]);
-	if (!request)
-	{
-		return;
-	}
-	
-	if (performance == DR_TEST_PERFORMANCE_TX)
-	{
-		result = dr_device_set_tx_performance_us(test->device,
-			latency_us, fpp, dr_test_on_response, & request->id);
-	}
-	else if (performance == DR_TEST_PERFORMANCE_RX)
-	{
-		result = dr_device_set_rx_performance_us(test->device, 
-			latency_us, fpp, dr_test_on_response, & request->id);
-	}
-	else
+	// bulk chunks first, so their operations account for them
+	dr_test_bulk_abort_all(test, AUD_ERR_INTERRUPTED);
+	for (i = 0; i < test->requests.capacity; i++)
 	{
-		result = dr_device_set_unicast_performance_us(test->device,
-			latency_us, fpp, dr_test_on_response, & request->id);
+		dr_test_request_t * request = test->requests.slots + i;
+		if (request->in_use && request->id != DANTE_NULL_REQUEST_ID)
+		{
+			if (request->description[0])
+			{
+				DR_TEST_PRINT("Cancelling #%u: %s\n", i, request->description);
+			}
+			else
+			{
+				DR_TEST_PRINT("Cancelling #%u\n", i);
+			}
+			dr_device_cancel_request(test->device, request->id);
+			dr_test_request_release(test, request);
+		}
 	}
+}
+
+
+//----------------------------------------------------------
+// State management and basic functionality
+//----------------------------------------------------------
 
+#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
+static aud_error_t
+dr_test_set_current_domain_by_uuid
+(
+	dr_test_t * test,
+	dante_domain_uuid_t uuid
+) {
+	dante_domain_handler_t * handler = dapi_get_domain_handler(test->dapi);
+	
+	aud_error_t result = dante_domain_handler_set_current_domain_by_uuid(handler, uuid);
 	if (result != AUD_SUCCESS)
 	{
-		DR_TEST_ERROR("Error setting %s performance properties: %s\n",
-			DR_TEST_PERFORMANCE_NAMES[performance], dr_error_message(result, g_test_errbuf));
-		dr_test_request_release(request);
-		return;
+		DR_TEST_ERROR("Error setting active_domain: %s\n",
+			dr_error_message(result, g_test_errbuf));
+		return result;
 	}
+	dapi_utils_print_domain_handler_info(test->handler);
+	return AUD_SUCCESS;
 }
 
-static void
-dr_test_set_lockdown
+static aud_error_t
+dr_test_set_current_domain_by_name
 (
 	dr_test_t * test,
-	aud_bool_t lockdown
+	const char * name
 ) {
-	aud_error_t result;
-	dr_test_request_t * request;
-
-	DR_TEST_DEBUG("ACTION: Set lockdown\n");
-
-	request = dr_test_allocate_request(test, "SetLockdown");
-	if (!request)
-	{
-		return;
-	}
+	dante_domain_handler_t * handler = dapi_get_domain_handler(test->dapi);
 	
-	result = dr_device_set_lockdown(test->device,
-		lockdown, dr_test_on_response, & request->id);
+	aud_error_t result = dante_domain_handler_set_current_domain_by_name(handler, name);
 	if (result != AUD_SUCCESS)
 	{
-		DR_TEST_ERROR("Error setting device lockdown: %s\n",
+		DR_TEST_ERROR("Error setting active_domain: %s\n",
 			dr_error_message(result, g_test_errbuf));
-		dr_test_request_release(request);
-		return;
+		return result;
 	}
+	dapi_utils_print_domain_handler_info(test->handler);
+	return AUD_SUCCESS;
 }
+#endif
+
+void dr_test_event_handle_ddh_changes
+(
+	const ddh_changes_t * changes
+ ) {
+	dr_test_push_domain_event(dante_domain_handler_get_context(ddh_changes_get_domain_handler(changes)), changes);
+	dapi_utils_print_domain_changes(changes);
+
+#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
+	aud_error_t result;
+	dante_domain_handler_t * handler = ddh_changes_get_domain_handler(changes);
+	ddh_change_flags_t change_flags = ddh_changes_get_change_flags(changes);
+	dr_test_t * test = dante_domain_handler_get_context(handler);
 
 
+	if (change_flags & DDH_CHANGE_FLAG_AVAILABLE_DOMAINS && test->options.ddm_config.domain[0])
+	{
+		dante_domain_info_t info = dante_domain_handler_get_current_domain(handler);
+		if (strcmp(info.name, test->options.ddm_config.domain))
+		{
+			result = dapi_utils_update_ddh_current_domain(handler, test->options.ddm_config.domain);
+			if (result != AUD_SUCCESS)
+			{
+				return;
+			}
+			info = dante_domain_handler_get_current_domain(handler);
+			//open the device if not yet opened.
+			if (!test->device && !strcmp(info.name, test->options.ddm_config.domain))
+			{
+				dr_test_open(test);
+			}
+		}
+	}
+#endif
+}
+
 static void
-dr_test_set_network_loopback
+dr_test_session_handle_ddh_changes
 (
-	dr_test_t * test,
-	aud_bool_t enabled
+	const ddh_changes_t * changes
 ) {
-	aud_error_t result;
-	dr_test_request_t * request;
-
-	DR_TEST_DEBUG("ACTION: Set Network Loopback\n");
+	dante_domain_handler_t * handler = ddh_changes_get_domain_handler(changes);
+	dr_test_session_t * session = (dr_test_session_t *) dante_domain_handler_get_context(handler);
+	unsigned int i;
 
-	request = dr_test_allocate_request(test, "SetNetworkLoopback");
-	if (!request)
+	for (i = 0; i < session->num_tests; i++)
 	{
-		return;
+		dr_test_push_domain_event(session->tests[i], changes);
 	}
-	
-	result = dr_device_set_network_loopback(test->device, enabled, dr_test_on_response, & request->id);
-	if (result != AUD_SUCCESS)
+	dapi_utils_print_domain_changes(changes);
+
+#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
+	if (ddh_changes_get_change_flags(changes) & DDH_CHANGE_FLAG_AVAILABLE_DOMAINS && session->options.ddm_config.domain[0])
 	{
-		DR_TEST_ERROR("Error %s network loopback (request): %s\n",
-			(enabled ? "enabling" : "disabling"), dr_error_message(result, g_test_errbuf));
-		dr_test_request_release(request);
-		return;
+		dante_domain_info_t info = dante_domain_handler_get_current_domain(handler);
+		if (strcmp(info.name, session->options.ddm_config.domain))
+		{
+			if (dapi_utils_update_ddh_current_domain(handler, session->options.ddm_config.domain) != AUD_SUCCESS)
+			{
+				return;
+			}
+			info = dante_domain_handler_get_current_domain(handler);
+			if (strcmp(info.name, session->options.ddm_config.domain))
+			{
+				return;
+			}
+			// open the devices that were waiting for the domain
+			for (i = 0; i < session->num_tests; i++)
+			{
+				if (!session->tests[i]->device)
+				{
+					dr_test_open(session->tests[i]);
+				}
+			}
+		}
 	}
+#endif
 }
 
-static void
-dr_test_set_aes67_prefix
+static aud_error_t
+dr_test_query_capabilities
 (
-	dr_test_t * test,
-	uint32_t aes67_prefix
+	dr_test_t * test
 ) {
 	aud_error_t result;
-	dr_test_request_t * request;
-
-	DR_TEST_DEBUG("ACTION: Set AES67 prefix\n");
-
-	request = dr_test_allocate_request(test, "SetAES67Prefix");
+	dr_test_request_t * request = dr_test_allocate_request(test, "QueryCapabilities");
 	if (!request)
 	{
-		return;
+		return AUD_ERR_NOBUFS;
 	}
 
-	result = dr_device_set_aes67_mcast_prefix(test->device, dr_test_on_response, &request->id, aes67_prefix);
+	result = dr_device_query_capabilities(test->device, &dr_test_on_response, &request->id);
 	if (result != AUD_SUCCESS)
 	{
-		DR_TEST_ERROR("Error %s AES67 prefix (request): %s\n",
-			(aes67_prefix ? "enabling" : "disabling"), dr_error_message(result, g_test_errbuf));
-		dr_test_request_release(request);
-		return;
+		DR_TEST_ERROR("Error sending query capabilities: %s\n",
+			dr_error_message(result, g_test_errbuf));
+		dr_test_request_release(test, request);
+		return result;
 	}
+	return result;
 }
 
-//----------------------------------------------------------
-// Channel actions
-//----------------------------------------------------------
-
 static void
-dr_test_batch_rxchannel_subscribe
+dr_test_mark_stale
 (
 	dr_test_t * test,
-	const char * filename
+	dr_device_component_t component,
+	dante_id_t subcomponent
 ) {
-	aud_error_t result;
-	dr_test_request_t * request;
-
-	FILE * fp;
-
-	DR_TEST_DEBUG("ACTION: Batch Subscribe\n");
-
-	if (!filename || !filename[0])
+	if (component == DR_DEVICE_COMPONENT_COUNT)
 	{
-		DR_TEST_ERROR("Invalid filename\n");
-		return;
+		DR_TEST_DEBUG("Invalidating ALL components\n");
+		for (component = 0; component < DR_DEVICE_COMPONENT_COUNT; component++)
+		{
+			dr_device_mark_component_stale(test->device, component);
+		}
 	}
-
-	fp = fopen(filename, "r");
-	if (!fp)
+	else if (subcomponent == 0)
 	{
-		DR_TEST_ERROR("Error opening filename '%s'\n", filename);
-		return;
+		DR_TEST_DEBUG("Invalidating component %s\n", dr_device_component_to_string(component));
+		dr_device_mark_component_stale(test->device, component);
 	}
-	g_batch.n = 0;
-	while (!feof(fp) && g_batch.n < DR_TEST_MAX_BATCH)
+	else
 	{
-		char line[128], channel[128], device[128], c;
-		unsigned int id;
-		if (!fgets(line, sizeof(line), fp))
-		{
-			break;
-		}
-		if (sscanf(line, "%u \"%[^\"\r\n@]@%[^\"\r\n]%c", &id, channel, device, &c) == 4 && c == '"')
+		if (component == DR_DEVICE_COMPONENT_TXCHANNELS)
 		{
-			g_batch._.subscriptions[g_batch.n].rxchannel_id = (dante_id_t) id;
-			aud_strlcpy(g_batch._.subscriptions[g_batch.n].channel, channel, DANTE_NAME_LENGTH);
-			aud_strlcpy(g_batch._.subscriptions[g_batch.n].device, device, DANTE_NAME_LENGTH);
-			g_batch.n++;
+			if (subcomponent <= test->ntx)
+			{
+				DR_TEST_DEBUG("Invalidating txchannel %u\n", subcomponent);
+				dr_txchannel_mark_stale(test->tx[subcomponent-1]);
+			}
+			else
+			{
+				DR_TEST_ERROR("Invalid txchannel %u\n", subcomponent);
+			}
 		}
-		else if (sscanf(line, "%u %s", &id, channel) == 2)
+		else if (component == DR_DEVICE_COMPONENT_RXCHANNELS)
 		{
-			DR_TEST_ERROR("Invalid line in file \"%s\": \"%s\"\n", filename, line);
-			fclose(fp);
-			return;
+			if (subcomponent <= test->nrx)
+			{
+				DR_TEST_DEBUG("Invalidating rxchannel %u\n", subcomponent);
+				dr_rxchannel_mark_stale(test->rx[subcomponent-1]);
+			}
+			else
+			{
+				DR_TEST_ERROR("Invalid rxchannel %u\n", subcomponent);
+			}
 		}
-		else if (sscanf(line, "%u", &id) == 1)
+		else if (component == DR_DEVICE_COMPONENT_TXLABELS)
 		{
-			g_batch._.subscriptions[g_batch.n].rxchannel_id = (dante_id_t) id;
-			g_batch._.subscriptions[g_batch.n].channel[0] = '\0';
-			g_batch._.subscriptions[g_batch.n].device[0] = '\0';
-			g_batch.n++;
+			aud_error_t result = dr_device_mark_txlabel_stale(test->device, subcomponent);
+			if (result == AUD_SUCCESS)
+			{
+				DR_TEST_DEBUG("Invalidating txlabel %u\n", subcomponent);
+			}
+			else
+			{
+				DR_TEST_ERROR("Error invalidating txlabel %u: %s\n", subcomponent, aud_error_message(result, g_test_errbuf));
+			}
 		}
 		else
 		{
-			DR_TEST_ERROR("Invalid line in file \"%s\": \"%s\"\n", filename, line);
-			fclose(fp);
-			return;
+			DR_TEST_DEBUG("Per-subcomponent stale marking not supported for component  %s\n", dr_device_component_to_string(component));
 		}
 	}
-	fclose(fp);
-	if (!g_batch.n)
-	{
-		DR_TEST_ERROR("No valid configuration in file \"%s\"\n", filename);
-		return;
-	}
+}
 
-	request = dr_test_allocate_request(test, "BatchSubscribe");
-	if (!request)
+static int64_t
+dr_test_utime_ms_since
+(
+	const aud_utime_t * now,
+	const aud_utime_t * then
+) {
+	return (int64_t) (now->tv_sec - then->tv_sec) * 1000 + (now->tv_usec - then->tv_usec) / 1000;
+}
+
+static aud_bool_t
+dr_test_component_expired
+(
+	const dr_test_t * test,
+	dr_device_component_t c,
+	const aud_utime_t * now
+) {
+	uint32_t max_age_ms = test->options.max_age_ms[c];
+	const aud_utime_t * updated = test->updated + c;
+	if (!max_age_ms)
 	{
-		return;
+		return AUD_FALSE;
 	}
-
-	DR_TEST_PRINT("Setting %d RX subscriptions\n", g_batch.n);
-	result = dr_device_batch_subscribe(test->device, dr_test_on_response, &request->id, g_batch.n, g_batch._.subscriptions);
-	if (result != AUD_SUCCESS)
+	// never updated here: the age is unknown
+	if (!updated->tv_sec && !updated->tv_usec)
 	{
-		DR_TEST_ERROR("Error sending batch rx channel subscription message: %s\n",
-			dr_error_message(result, g_test_errbuf));
-		dr_test_request_release(request);
-		return;
+		return AUD_TRUE;
 	}
-
+	return dr_test_utime_ms_since(now, updated) >= (int64_t) max_age_ms;
 }
 
-static void
-dr_test_rxchannel_subscribe
+// Sends an update for each of 'components' that is stale or has outlived its
+// max age, unless an update for it is already in flight.
+static aud_error_t
+dr_test_update
 (
 	dr_test_t * test,
-	unsigned int channel,
-	char * name
+	uint32_t components
 ) {
 	aud_error_t result;
-	
-	dr_test_request_t * request;
-
-	DR_TEST_DEBUG("ACTION: Subscribe\n");
-
-	if (channel < 1 || channel > test->nrx)
-	{
-		DR_TEST_ERROR("Invalid RX channel (must be in range 1..%u)\n", test->nrx);
-		return;
-	}
-	
-	request = dr_test_allocate_request(test, "Subscribe");
-	if (!request)
-	{
-		return;
-	}
+	dr_device_component_t c;
+	aud_utime_t now;
 
-	if (name != NULL)
+	aud_utime_get(&now);
+	for (c = 0; c < DR_DEVICE_COMPONENT_COUNT; c++)
 	{
-		char * c = name;
-		char * r = strchr(name, '@');
-		if (r == NULL)
+		dr_test_request_t * request;
+		if (!(components & (1u << c)) || (test->updating_components & (1u << c)))
 		{
-			DR_TEST_ERROR("Invalid subscription name (NAME must be in the form \"channel@device\")\n");
-			dr_test_request_release(request);
-			return;
+			continue;
 		}
-		*r = '\0';
-		r++;
-		result = dr_rxchannel_subscribe(test->rx[channel-1], dr_test_on_response, &request->id, r, c);
-		if (result != AUD_SUCCESS)
+		if (!dr_device_is_component_stale(test->device, c) && !dr_test_component_expired(test, c, &now))
 		{
-			DR_TEST_ERROR("Error sending subscribe message: %s\n",
-				dr_error_message(result, g_test_errbuf));
-			dr_test_request_release(request);
-			return;
+			continue;
 		}
-	}
-	else
-	{
-		result = dr_rxchannel_subscribe(test->rx[channel-1], dr_test_on_response, &request->id, NULL, NULL);
+		DR_TEST_DEBUG("Updating stale component %s\n", dr_device_component_to_string(c));
+
+		request = dr_test_allocate_request(test, NULL);
+		if (!request)
+		{
+			return AUD_ERR_NOBUFS;
+		}
+		SNPRINTF(request->description, DR_TEST_REQUEST_DESCRIPTION_LENGTH, "Update %s", dr_device_component_to_string(c));
+		request->component = c;
+
+		result = dr_device_update_component(test->device, &dr_test_on_response, &request->id, c);
 		if (result != AUD_SUCCESS)
 		{
-			DR_TEST_ERROR("Error sending unsubscribe message: %s\n",
-				dr_error_message(result, g_test_errbuf));
-			dr_test_request_release(request);
-			return;
+			DR_TEST_ERROR("Error sending update %s: %s\n",
+				dr_device_component_to_string(c), dr_error_message(result, g_test_errbuf));
+			dr_test_request_release(test, request);
+			return result;
 		}
+		test->updating_components |= (1u << c);
 	}
+	return AUD_SUCCESS;
 }
 
+// Fetches components on demand, when they are queried: the data returned now
+// may be stale, a device changed event follows once the update is in.
 static void
-dr_test_txchannel_set_enabled
+dr_test_refresh
 (
 	dr_test_t * test,
-	unsigned int channel,
-	aud_bool_t enabled
+	uint32_t components
 ) {
-	aud_error_t result;
-	dr_test_request_t * request;
+	if (test->device && dr_device_get_state(test->device) == DR_DEVICE_STATE_ACTIVE)
+	{
+		dr_test_update(test, components);
+	}
+}
 
-	DR_TEST_DEBUG("ACTION: Set TxChannel Enabled\n");
+static aud_bool_t
+dr_test_refreshes_expired
+(
+	const dr_test_t * test
+) {
+	return test->device && test->options.automatic_update_on_state_change
+		&& dr_device_get_state(test->device) == DR_DEVICE_STATE_ACTIVE;
+}
 
-	if (channel < 1 || channel > test->ntx)
+static void
+dr_test_refresh_expired
+(
+	dr_test_t * test,
+	const aud_utime_t * now
+) {
+	uint32_t expired = 0;
+	dr_device_component_t c;
+
+	if (!dr_test_refreshes_expired(test))
 	{
-		DR_TEST_PRINT("Invalid TX channel (must be in range 1..%u)\n", test->ntx);
 		return;
 	}
-
-	request = dr_test_allocate_request(test, "SetTxChannelEnabled");
-	if (!request)
+	for (c = 0; c < DR_DEVICE_COMPONENT_COUNT; c++)
 	{
-		return;
+		if ((test->options.subscribed_components & (1u << c)) && dr_test_component_expired(test, c, now))
+		{
+			expired |= (1u << c);
+		}
 	}
-
-	DR_TEST_PRINT("Setting TX channel %u to be %s\n", channel, (enabled ? "enabled" : "disabled"));
-	result = dr_txchannel_set_enabled(test->tx[channel-1], dr_test_on_response, &request->id, enabled);
-	if (result != AUD_SUCCESS)
+	if (expired & ~test->updating_components)
 	{
-		DR_TEST_ERROR("Error sending set enabled message: %s\n",
-			dr_error_message(result, g_test_errbuf));
-		dr_test_request_release(request);
-		return;
+		dr_test_update(test, expired);
 	}
 }
 
+// Starts the next poll of the rx flow error fields once the interval has
+// passed and the previous poll is complete. Each field is read and cleared
+// by a request of its own.
 static void
-dr_test_txchannel_set_signal_reflevel
+dr_test_rxstats_poll
 (
 	dr_test_t * test,
-	unsigned int channel,
-	dante_dbu_t dbu
+	const aud_utime_t * now
 ) {
+	dr_test_rxstats_t * stats = &test->rxstats;
+	dante_rxflow_error_type_t field;
+	uint32_t fields;
+	uint16_t max_rxflows;
 	aud_error_t result;
-	dr_test_request_t * request;
-
-	DR_TEST_DEBUG("ACTION: Set TxChannel SignalRefLevel\n");
 
-	if (channel > test->ntx)
+	if (!stats->interval_ms || stats->pending || !test->device
+		|| dr_device_get_state(test->device) != DR_DEVICE_STATE_ACTIVE
+		|| dr_test_utime_ms_since(now, &stats->next_poll) < 0)
 	{
-		DR_TEST_PRINT("Invalid TX channel (must be in range 1..%u)\n", test->ntx);
 		return;
 	}
-
-	request = dr_test_allocate_request(test, "SetTxChannelSignalRefLevel");
-	if (!request)
+	stats->next_poll.tv_sec = now->tv_sec + stats->interval_ms / 1000;
+	stats->next_poll.tv_usec = now->tv_usec + (stats->interval_ms % 1000) * 1000;
+	if (stats->next_poll.tv_usec >= 1000000)
 	{
-		return;
+		stats->next_poll.tv_sec++;
+		stats->next_poll.tv_usec -= 1000000;
 	}
 
-	DR_TEST_PRINT("Setting TX channel %u signal reference level to ", channel);
-	if (dbu == DANTE_DBU_UNSET)
-	{
-		DR_TEST_PRINT("unset");
-	}
-	else
-	{
-		DR_TEST_PRINT("%+d dBu\n", (int) dbu);
-	}
-	if (channel == 0)
-	{
-		result = dr_device_set_txchannel_signal_reflevel(test->device, dr_test_on_response, &request->id, dbu);
-	}
-	else
+	fields = stats->fields & dr_device_available_rxflow_error_fields(test->device)
+		& ((1u << DR_TEST_RXSTATS_MAX_FIELDS) - 1);
+	if (!fields || dr_device_max_rxflows(test->device, &max_rxflows) != AUD_SUCCESS)
 	{
-		result = dr_txchannel_set_signal_reflevel(test->tx[channel-1], dr_test_on_response, &request->id, dbu);
+		return;
 	}
+	result = dr_test_rxstats_resize(stats, dr_device_num_interfaces(test->device), max_rxflows);
 	if (result != AUD_SUCCESS)
 	{
-		DR_TEST_ERROR("Error sending set signal reference level message: %s\n",
-			dr_error_message(result, g_test_errbuf));
-		dr_test_request_release(request);
+		DR_TEST_ERROR("Error allocating rx flow statistics: %s\n", dr_error_message(result, g_test_errbuf));
 		return;
 	}
+
+	dr_test_rxstats_begin_poll(stats, now, fields);
+	for (field = 0; field < DR_TEST_RXSTATS_MAX_FIELDS; field++)
+	{
+		dr_test_request_t * request;
+		if (!(fields & (1u << field)))
+		{
+			continue;
+		}
+		request = dr_test_allocate_request(test, NULL);
+		if (!request)
+		{
+			dr_test_rxstats_end_field(stats, field, NULL, NULL);
+			continue;
+		}
+		SNPRINTF(request->description, DR_TEST_REQUEST_DESCRIPTION_LENGTH, "Poll rx flow %s", dante_rxflow_error_type_to_string(field));
+		request->rxstats_field = field;
+		result = dr_device_update_rxflow_error_fields(test->device, &dr_test_on_response, &request->id, field, AUD_TRUE);
+		if (result != AUD_SUCCESS)
+		{
+			DR_TEST_ERROR("Error polling rx flow %s: %s\n",
+				dante_rxflow_error_type_to_string(field), dr_error_message(result, g_test_errbuf));
+			dr_test_request_release(test, request);
+		}
+	}
 }
 
+// Work due after a step: expired components and statistics polls
 static void
-dr_test_txchannel_clear_signal_reflevel
+dr_test_run_timers
 (
-	dr_test_t * test,
-	unsigned int channel
-)
-{
-	dr_test_txchannel_set_signal_reflevel(test, channel, DANTE_DBU_UNSET);
+	dr_test_t * test
+) {
+	aud_utime_t now;
+	aud_utime_get(&now);
+	dr_test_refresh_expired(test, &now);
+	dr_test_rxstats_poll(test, &now);
 }
 
 static void
-dr_test_add_txlabel
+dr_test_lower_timeout
 (
-	dr_test_t * test,
-	unsigned int channel,
-	char * name
+	aud_utime_t * timeout,
+	int64_t ms
 ) {
-	aud_error_t result;
-	dr_test_request_t * request;
-
-	DR_TEST_DEBUG("ACTION: Add Tx Label\n");
-
-	if (channel < 1 || channel > test->ntx)
+	// overdue work failed to start, retry at a modest pace instead of spinning
+	if (ms <= 0)
 	{
-		DR_TEST_ERROR("Invalid TX channel (must be in range 1..%u)\n", test->ntx);
-		return;
+		ms = DR_TEST_OVERDUE_RETRY_MS;
 	}
-
-	if (!dante_name_is_valid_channel_or_label_name(name))
+	if (ms < (int64_t) timeout->tv_sec * 1000 + timeout->tv_usec / 1000)
 	{
-		DR_TEST_ERROR("Invalid TX label '%s'\n", name);
-		return;
+		timeout->tv_sec = (long) (ms / 1000);
+		timeout->tv_usec = (long) (ms % 1000) * 1000;
 	}
+}
 
-	request = dr_test_allocate_request(test, "AddTxLabel");
-	if (!request)
-	{
-		return;
-	}
-
-	DR_TEST_DEBUG("Adding label \"%s\" to tx channel %u\n", name, channel);
-	result = dr_txchannel_add_txlabel(test->tx[channel-1],
-		dr_test_on_response, &request->id, name, DR_MOVEFLAG_MOVE_EXISTING);
-	if (result != AUD_SUCCESS)
-	{
-		DR_TEST_ERROR("Error sending add label \"%s\" message to tx channel %u: %s\n",
-			name, channel, dr_error_message(result, g_test_errbuf));
-		dr_test_request_release(request);
-		return;
-	}
-}
-
+// Lowers 'timeout' so the step returns when dr_test_run_timers has work
 static void
-dr_test_remove_txlabel_from_channel
+dr_test_next_timer
 (
-	dr_test_t * test,
-	dante_id_t channel,
-	char * name
+	const dr_test_t * test,
+	const aud_utime_t * now,
+	aud_utime_t * timeout
 ) {
-	aud_error_t result;
-	dr_test_request_t * request;
-
-	DR_TEST_DEBUG("ACTION: Remove Tx Label From Channel\n");
-
-	if (channel < 1 || channel > test->ntx)
-	{
-		DR_TEST_ERROR("Invalid TX channel (must be in range 1..%u)\n", test->ntx);
-		return;
-	}
+	const dr_test_rxstats_t * stats = &test->rxstats;
+	dr_device_component_t c;
 
-	request = dr_test_allocate_request(test, "RemoveTxLabelFromChannel");
-	if (!request)
+	if (dr_test_refreshes_expired(test))
 	{
-		return;
+		for (c = 0; c < DR_DEVICE_COMPONENT_COUNT; c++)
+		{
+			uint32_t max_age_ms = test->options.max_age_ms[c];
+			if (max_age_ms && (test->options.subscribed_components & (1u << c))
+				&& !(test->updating_components & (1u << c)))
+			{
+				dr_test_lower_timeout(timeout, max_age_ms - dr_test_utime_ms_since(now, test->updated + c));
+			}
+		}
 	}
-
-	DR_TEST_DEBUG("Removing label \"%s\" from tx channel %u\n", name, channel);
-	result = dr_txchannel_remove_txlabel(test->tx[channel-1],
-		dr_test_on_response, &request->id, name);
-	if (result != AUD_SUCCESS)
+	if (stats->interval_ms && !stats->pending && test->device
+		&& dr_device_get_state(test->device) == DR_DEVICE_STATE_ACTIVE)
 	{
-		DR_TEST_ERROR("Error sending remove label \"%s\" message to tx channel %u: %s\n",
-			name, channel, dr_error_message(result, g_test_errbuf));
-		dr_test_request_release(request);
-		return;
+		dr_test_lower_timeout(timeout, -dr_test_utime_ms_since(now, &stats->next_poll));
 	}
 }
 
-
-static void
-dr_test_remove_txlabel
+static aud_error_t
+dr_test_update_rxflow_errors
 (
-	dr_test_t * test,
-	dante_id_t label_id
+	dr_test_t * test, 
+	dante_rxflow_error_type_t field_type,
+	aud_bool_t clear
 ) {
 	aud_error_t result;
 	dr_test_request_t * request;
-
-	DR_TEST_DEBUG("ACTION: Remove Tx Label\n");
-
-	if (dr_device_txlabel_with_id(test->device, label_id, NULL) == AUD_ERR_RANGE)
+	if (field_type == DANTE_NUM_RXFLOW_ERROR_TYPES)
 	{
-		DR_TEST_ERROR("Invalid TX label\n");
-		return;
+		DR_TEST_DEBUG("Updating rxflow error flags\n");
+		request = dr_test_allocate_request(test, NULL);
+		if (!request)
+		{
+			return AUD_ERR_NOBUFS;
+		}
+		SNPRINTF(request->description, DR_TEST_REQUEST_DESCRIPTION_LENGTH, "Update rxflow error flags");
+		result = dr_device_update_rxflow_error_flags(test->device, &dr_test_on_response, &request->id, clear);
 	}
-
-	request = dr_test_allocate_request(test, "RemoveTxLabel");
-	if (!request)
+	else
 	{
-		return;
+		DR_TEST_DEBUG("Updating rxflow error field %s\n", dante_rxflow_error_type_to_string(field_type));
+			request = dr_test_allocate_request(test, NULL);
+		if (!request)
+		{
+			return AUD_ERR_NOBUFS;
+		}
+		SNPRINTF(request->description, DR_TEST_REQUEST_DESCRIPTION_LENGTH, "Update rx flow %s", dante_rxflow_error_type_to_string(field_type));
+		result = dr_device_update_rxflow_error_fields(test->device, &dr_test_on_response, &request->id, field_type, clear);
 	}
-
-	DR_TEST_DEBUG("Removing TX label %u\n", label_id);
-	result = dr_device_remove_txlabel_with_id(test->device,
-		dr_test_on_response, &request->id, label_id
-	);
 	if (result != AUD_SUCCESS)
 	{
-		DR_TEST_ERROR("Error sending remove label %u message: %s\n",
-			label_id, dr_error_message(result, g_test_errbuf)
-		);
-		dr_test_request_release(request);
-		return;
+		DR_TEST_ERROR("Error update rxflow errors : %s\n",
+			dr_error_message(result, g_test_errbuf));
+		dr_test_request_release(test, request);
+		return result;
 	}
+	return AUD_SUCCESS;
 }
 
-
 static void
-dr_test_txchannel_set_muted
+dr_test_on_device_state_changed
 (
-	dr_test_t * test,
-	unsigned int channel,
-	aud_bool_t muted
+	dr_test_t * test
 ) {
-	aud_error_t result;
-	dr_test_request_t * request;
-
-	DR_TEST_DEBUG("ACTION: Set Tx Channel Muted\n");
-
-	if (channel < 1 || channel > test->ntx)
+	switch (dr_device_get_state(test->device))
 	{
-		DR_TEST_PRINT("Invalid TX channel (must be in range 1..%u)\n", test->ntx);
+	case DR_DEVICE_STATE_RESOLVED:
+		// query capabilities
+		if (test->options.automatic_update_on_state_change)
+		{
+			DR_TEST_PRINT("device resolved, querying capabilities\n");
+			dr_test_query_capabilities(test);
+		}
 		return;
-	}
 
-	request = dr_test_allocate_request(test, "SetTxChannelMuted");
-	if (!request)
-	{
-		return;
-	}
+	case DR_DEVICE_STATE_ACTIVE:
+		{
+			// update information
+			dr_device_get_txchannels(test->device, &test->ntx, &test->tx);
+			dr_device_get_rxchannels(test->device, &test->nrx, &test->rx);
 
-	DR_TEST_PRINT("Setting TX channel %u to be %s\n", channel, (muted ? "muted" : "unmuted"));
-	result = dr_txchannel_set_muted(test->tx[channel-1], dr_test_on_response, &request->id, muted);
-	if (result != AUD_SUCCESS)
-	{
-		DR_TEST_ERROR("Error sending %s message: %s\n",
-			(muted ? "mute" : "unmute"), dr_error_message(result, g_test_errbuf));
-		dr_test_request_release(request);
-		return;
+			// update all components when we enter the active state, unless we have a strange status
+			if (test->options.automatic_update_on_state_change)
+			{
+				dr_device_status_flags_t status_flags;
+				aud_error_t result = dr_device_get_status_flags(test->device, &status_flags);
+				if (result != AUD_SUCCESS)
+				{
+					DR_TEST_ERROR("Error getting status flags: %s\n", dr_error_message(result, g_test_errbuf));
+					return;
+				}
+				if (status_flags)
+				{
+					DR_TEST_PRINT("device active, status=0x%08x, not updating\n", status_flags);
+					return;
+				}
+				DR_TEST_PRINT("device active, updating\n");
+				dr_test_update(test, test->options.subscribed_components);
+			}
+			return;
+		}
+	case DR_DEVICE_STATE_ERROR:
+		{
+			aud_error_t error_state_error = dr_device_get_error_state_error(test->device);
+			const char * error_state_action = dr_device_get_error_state_action(test->device);
+	
+			DR_TEST_PRINT("device has entered the ERROR state: error=%s, action='%s'\n",
+				dr_error_message(error_state_error, g_test_errbuf), (error_state_action ? error_state_action : ""));
+			return;
+		}
+	default:
+		// nothing to do
+		DR_TEST_PRINT("device state is now '%s'\n", dr_device_state_to_string(dr_device_get_state(test->device)));
 	}
 }
 
+
 static void
-dr_test_rxchannel_set_muted
+dr_test_on_device_addresses_changed
 (
-	dr_test_t * test,
-	unsigned int channel,
-	aud_bool_t muted
+	dr_test_t * test
 ) {
-	aud_error_t result;
-	dr_test_request_t * request;
-
-	DR_TEST_DEBUG("ACTION: Set Rx Channel Muted\n");
-
-	if (channel < 1 || channel > test->nrx)
-	{
-		DR_TEST_PRINT("Invalid RX channel (must be in range 1..%u)\n", test->nrx);
-		return;
-	}
-
-	request = dr_test_allocate_request(test, "SetRxChannelMuted");
-	if (!request)
-	{
-		return;
-	}
+	unsigned int i, na = 2;
+	dante_ipv4_address_t addresses[2];
+	dr_device_get_addresses(test->device, &na, addresses);
 
-	DR_TEST_PRINT("Setting RX channel %u to be %s\n", channel, (muted ? "muted" : "unmuted"));
-	result = dr_rxchannel_set_muted(test->rx[channel-1], dr_test_on_response, &request->id, muted);
-	if (result != AUD_SUCCESS)
+	DR_TEST_PRINT("Addresses are now: ");
+	for (i = 0; i < na; i++)
 	{
-		DR_TEST_ERROR("Error sending %s message: %s\n",
-			(muted ? "mute" : "unmute"), dr_error_message(result, g_test_errbuf));
-		dr_test_request_release(request);
-		return;
+		uint8_t * host = (uint8_t *) &(addresses[i].host);
+		DR_TEST_PRINT("%c%u.%u.%u.%u:%u", 
+			(i ? ',' : '['),
+			host[0], host[1], host[2], host[3], addresses[i].port);
 	}
+	DR_TEST_PRINT("]\n");
 }
 
+//----------------------------------------------------------
+// Connect
+//----------------------------------------------------------
 
-static void
-dr_test_rxchannel_set_name
+static aud_error_t
+dr_test_open
 (
-	dr_test_t * test,
-	unsigned int channel,
-	const char * name
+	dr_test_t * test
 ) {
+	dr_test_options_t * options = &test->options;
 	aud_error_t result;
-	dr_test_request_t * request;
-
-	DR_TEST_DEBUG("ACTION: Set Rx Channel Name\n");
+	dr_device_open_t * config = NULL;
+	unsigned i;
 
-	if (channel < 1 || channel > test->nrx)
+	if (test->device)
 	{
-		DR_TEST_ERROR("Invalid RX channel (must be in range 1..%u)\n", test->nrx);
-		return;
+		result = AUD_ERR_ALREADY;
+		goto l__error;
 	}
 
-	if (name && !dante_name_is_valid_channel_or_label_name(name))
-	{
-		DR_TEST_ERROR("Invalid channel name '%s'\n", name);
-		return;
-	}
 
-	request = dr_test_allocate_request(test, "SetRxChannelName");
-	if (!request)
+	if (options->device_name[0])
 	{
-		return;
-	}
+		config = dr_device_open_config_new(options->device_name);
+		if (! config)
+		{
+			result = AUD_ERR_NOMEMORY;
+			goto l__error;
+		}
+	
+		dante_domain_uuid_t uuid = dr_devices_get_domain_uuid(test->devices);
+		if (IS_ADHOC_DOMAIN_UUID(uuid)) // We only need interfaces for devices when in the ADHOC domain
+		{
+			if (options->num_local_interfaces)
+			{
+				DR_TEST_PRINT("Opening connection to remote device %s using %d interfaces\n", 
+					options->device_name, options->num_local_interfaces);
 
-	DR_TEST_PRINT("Setting RX channel %u name to \"%s\"\n", channel, name);
-	result = dr_rxchannel_set_name(test->rx[channel-1], dr_test_on_response, &request->id, name);
-	if (result != AUD_SUCCESS)
-	{
-		DR_TEST_ERROR("Error sending rx channel rename message: %s\n",
-			dr_error_message(result, g_test_errbuf));
-		dr_test_request_release(request);
-		return;
+				//result = dr_device_open_remote_on_interfaces(test->devices, 
+				//	options->device_name, options->num_local_interface_indexes, options->local_interface_indexes, &test->device);
+
+				for (i = 0; i < options->num_local_interfaces; i++)
+				{
+					if (options->local_interfaces[i].flags == AUD_INTERFACE_IDENTIFIER_FLAG_NAME)
+					{
+						dr_device_open_config_enable_interface_by_name(
+							config, i, options->local_interfaces[i].name
+						);
+					}
+					else if (options->local_interfaces[i].flags == AUD_INTERFACE_IDENTIFIER_FLAG_INDEX)
+					{
+						dr_device_open_config_enable_interface_by_index(
+							config, i, options->local_interfaces[i].index
+						);
+					}
+				}
+			}
+			else
+			{
+				DR_TEST_PRINT("Opening connection to remote device %s\n", options->device_name);
+				//result = dr_device_open_remote(test->devices, options->device_name, &test->device);
+			}
+		}
+		result = dr_device_open_with_config(test->devices, config, &test->device);
+
+		dr_device_open_config_free(config);
+		config = NULL;
+	}
+	else if (options->num_addresses)
+	{
+		config = dr_device_open_config_new(NULL);
+		if (! config)
+		{
+			result = AUD_ERR_NOMEMORY;
+			goto l__error;
+		}
+
+		DR_TEST_PRINT("Opening connection using %d explicit addresses\n", 
+			options->num_addresses);
+		//result = dr_device_open_addresses(test->devices, 
+		//	options->num_addresses, options->addresses, &test->device);
+
+		for (i = 0; i < options->num_addresses; i++)
+		{
+			if (options->addresses[i])
+			{
+				dr_device_open_config_enable_address(
+					config, i, options->addresses[i], 0
+				);
+			}
+		}
+		result = dr_device_open_with_config(test->devices, config, &test->device);
+
+		dr_device_open_config_free(config);
+		config = NULL;
+	}
+	else if (options->domain_device_addr)
+	{
+		result = dr_device_open_domain_id(test->devices, options->domain_device_addr, &test->device);
+	}
+	else
+	{
+		if (options->local_port)
+		{
+			DR_TEST_PRINT("Opening connection to local device on port %d\n", options->local_port);
+			result = dr_device_open_local_on_port(test->devices, options->local_port, &test->device);
+		}
+		else
+		{
+			DR_TEST_PRINT("Opening connection to local device\n");
+			result = dr_device_open_local(test->devices, &test->device);
+		}
+	}
+	if (result != AUD_SUCCESS)
+	{
+	l__error:
+		DR_TEST_ERROR("Error creating device: %s\n",
+			dr_error_message(result, g_test_errbuf));
+		return result;
 	}
+
+	dr_device_set_context(test->device, test);
+	dr_device_set_changed_callback(test->device, dr_test_on_device_changed);
+
+	// if we are connecting locally we may need to trigger the next state transition,
+	// if not this is a no-op
+	dr_test_on_device_state_changed(test);
+
+	return AUD_SUCCESS;
 }
 
-static void
-dr_test_batch_rxchannel_set_name
+static aud_error_t
+dr_test_close
 (
-	dr_test_t * test,
-	const char * filename
+	dr_test_t * test
 ) {
-	aud_error_t result;
-	dr_test_request_t * request;
+	dr_test_bulk_abort_all(test, AUD_ERR_INTERRUPTED);
+	if (test->device)
+	{
+		dr_device_close(test->device);
+		test->device = NULL;
+		test->nintf = 0;
+		test->ntx = 0;
+		test->nrx = 0;
+		test->max_txflow_slots = 0;
+		test->max_rxflow_slots = 0;
+		test->tx = NULL;
+		test->rx = NULL;
+	}
+	return AUD_SUCCESS;
+}
 
-	FILE * fp;
 
-	DR_TEST_DEBUG("ACTION: Batch Set Rx Channel Names\n");
+//----------------------------------------------------------
+// Utilities
+//----------------------------------------------------------
 
-	if (!filename || !filename[0])
+typedef enum dr_test_read_port_option
+{
+	DR_TEST_READ_NO_PORT,
+	DR_TEST_READ_OPTIONAL_PORT,
+	DR_TEST_READ_REQUIRES_PORT,
+} dr_test_read_port_option_t;
+
+#if 0
+/*
+	Prompt for and read an IPv4 address
+
+	If port is optional, then addr->port must be initialised to the default on the way in.
+ */
+static int
+dr_test_read_address
+(
+	dante_ipv4_address_t * addr,
+	dr_test_read_port_option_t has_port,
+	const char * desc
+)
+{
+	unsigned int ip1, ip2, ip3, ip4, port;
+	int matches;
+
+	if (has_port == DR_TEST_READ_NO_PORT)
 	{
-		DR_TEST_ERROR("Invalid filename\n");
-		return;
+		DR_TEST_PRINT("Enter %s address (A.B.C.D):\n", desc);
+	}
+	else
+	{
+		DR_TEST_PRINT("Enter %s address. Legal values are:\n", desc);
+		DR_TEST_PRINT("  A.B.C.D:PORT to specify an address and port\n");
+		DR_TEST_PRINT("  A.B.C.D to specify an address and use the default port\n");
 	}
+	if (! fgets(g_input_buf, BUFSIZ, stdin))
+		return -1;
 
-	fp = fopen(filename, "r");
-	if (!fp)
+	matches = sscanf(g_input_buf, "%u.%u.%u.%u:%u", &ip1, &ip2, &ip3, &ip4, &port);
+	if (matches < 4)
 	{
-		DR_TEST_ERROR("Error opening filename '%s'\n", filename);
-		return;
+		return -1;
 	}
-	g_batch.n = 0;
-	while (!feof(fp) && g_batch.n < DR_TEST_MAX_BATCH)
+
+	if (ip1 > 0xff || ip2 > 0xff || ip3 > 0xff || ip4 > 0xff)
+		return -1;
+
+	addr->host = htonl((ip1 << 24) | (ip2 << 16) | (ip3 << 8) | ip4);
+	if (matches == 5)
 	{
-		char line[128], name[128];
-		unsigned int c;
-		if (!fgets(line, sizeof(line), fp))
-		{
-			break;
-		}
-		if (sscanf(line, "%u %s", &c, name) == 2)
-		{
-			g_batch._.rxlabels[g_batch.n].rxchannel_id = (dante_id_t) c;
-			aud_strlcpy(g_batch._.rxlabels[g_batch.n].label, name, DANTE_NAME_LENGTH);
-			g_batch.n++;
-		}
-		else if (sscanf(line, "%u", &c) == 1)
+		if (has_port == DR_TEST_READ_NO_PORT)
 		{
-			g_batch._.rxlabels[g_batch.n].rxchannel_id = (dante_id_t) c;
-			g_batch._.rxlabels[g_batch.n].label[0] = '\0';
-			g_batch.n++;
+			return -1;
 		}
-		else
+		else if (port > 0xFFFF)
 		{
-			DR_TEST_ERROR("Invalid line in file \"%s\": \"%s\"\n", filename, line);
-			fclose(fp);
-			return;
+			return -1;
 		}
+		addr->port = (uint16_t) port;
+		return 0;
 	}
-	fclose(fp);
-	if (!g_batch.n)
+	else
 	{
-		DR_TEST_ERROR("No valid configuration in file \"%s\"\n", filename);
-		return;
+		if (has_port == DR_TEST_READ_REQUIRES_PORT)
+		{
+			return -1;
+		}
+		return 0;
 	}
+}
+#endif
+
+
+//----------------------------------------------------------
+// Device-level configuration and settings
+//----------------------------------------------------------
+
+static void
+dr_test_ping
+(
+	dr_test_t * test
+) {
+	aud_error_t result;
+	dr_test_request_t * request;
+
+	DR_TEST_DEBUG("ACTION: Ping device\n");
 
-	request = dr_test_allocate_request(test, "BatchSetRxChannelName");
+	request = dr_test_allocate_request(test, "Ping");
 	if (!request)
 	{
 		return;
 	}
-
-	DR_TEST_PRINT("Setting %d RX channel names\n", g_batch.n);
-	result = dr_device_batch_rxlabel(test->device, dr_test_on_response, &request->id, g_batch.n, g_batch._.rxlabels);
+	result = dr_device_ping(test->device, dr_test_on_response, &request->id);
 	if (result != AUD_SUCCESS)
 	{
-		DR_TEST_ERROR("Error sending batch rx channel rename message: %s\n",
+		DR_TEST_ERROR("Error sending ping: %s\n",
 			dr_error_message(result, g_test_errbuf));
-		dr_test_request_release(request);
+		dr_test_request_release(test, request);
 		return;
 	}
 }
 
-//----------------------------------------------------------
-// Transmit Flows
-//----------------------------------------------------------
-
 static void
-dr_test_add_txflow
+dr_test_store_config
 (
-	dr_test_t * test,
-	dante_id_t flow_id,
-	uint16_t num_slots,
-	dante_latency_us_t latency_us,
-	dante_fpp_t fpp
+	dr_test_t * test
 ) {
-	dante_name_t name;
-	uint16_t i;
-	dr_txflow_config_t * config = NULL;
 	aud_error_t result;
 	dr_test_request_t * request;
 
-	DR_TEST_DEBUG("ACTION: Add Tx Flow\n");
-
-	DR_TEST_PRINT("Enter flow name (or simply 'enter' to use default name): ");
-	fgets(g_input_buf, BUFSIZ, stdin);
-	if (sscanf(g_input_buf, "%s", name) < 1)
-	{
-		name[0] = '\0';
-	}
+	DR_TEST_DEBUG("ACTION: store config\n");
 
-	result = dr_txflow_config_new(test->device, flow_id, num_slots, &config);
-	if (result != AUD_SUCCESS)
+	request = dr_test_allocate_request(test, "StoreConfig");
+	if (!request)
 	{
-		DR_TEST_ERROR("Error creating txflow config: %s\n", dr_error_message(result, g_test_errbuf));
 		return;
 	}
 
-	result = dr_txflow_config_set_name(config, name);
+	result = dr_device_store_config(test->device, dr_test_on_response, &request->id);
 	if (result != AUD_SUCCESS)
 	{
-		DR_TEST_ERROR("Error setting txflow config name: %s\n", dr_error_message(result, g_test_errbuf));
-		dr_txflow_config_discard(config);
+		DR_TEST_ERROR("Error sending store config: %s\n",
+			dr_error_message(result, g_test_errbuf));
 		return;
 	}
+}
 
-	result = dr_txflow_config_set_latency_us(config, latency_us);
-	if (result != AUD_SUCCESS)
+static void
+dr_test_clear_config(dr_test_t * test)
+{
+	aud_error_t result;
+	dr_test_request_t * request;
+
+	DR_TEST_DEBUG("ACTION: Clear config\n");
+
+	request = dr_test_allocate_request(test, "ClearConfig");
+	if (!request)
 	{
-		DR_TEST_ERROR("Error setting txflow config latency: %s\n", dr_error_message(result, g_test_errbuf));
-		dr_txflow_config_discard(config);
 		return;
 	}
 
-	result = dr_txflow_config_set_fpp(config, fpp);
+	result = dr_device_clear_config(test->device, dr_test_on_response, &request->id);
 	if (result != AUD_SUCCESS)
 	{
-		DR_TEST_ERROR("Error setting txflow config fpp: %s\n", dr_error_message(result, g_test_errbuf));
-		dr_txflow_config_discard(config);
+		DR_TEST_ERROR("Error sending clear config: %s\n",
+			dr_error_message(result, g_test_errbuf));
 		return;
 	}
+}
 
-	
-	// Slots
-	DR_TEST_PRINT("Enter 1-based tx channel index to add to slots (or simply 'enter' to have an empty slot):\n");
-	for (i = 0; i < num_slots; i++)
+static aud_error_t
+dr_test_rename
+(
+	dr_test_t * test,
+	const char * new_name,
+	aud_bool_t close
+) {
+	aud_error_t result;
+
+	DR_TEST_DEBUG("ACTION: rename\n");
+
+	if (new_name && !dante_name_is_valid_device_name(new_name))
 	{
-		unsigned int id;
-		DR_TEST_PRINT("slot %d (of %d): ", i, num_slots);
-		fgets(g_input_buf, BUFSIZ, stdin);
-		if (sscanf(g_input_buf, "%u", &id) == 1)
-		{
-			dr_txchannel_t * tx = dr_device_txchannel_with_id(test->device, (dante_id_t) id);
-			if (tx)
-			{
-				result = dr_txflow_config_add_channel(config, tx, i);
-				if (result != AUD_SUCCESS)
-				{
-					DR_TEST_ERROR("Error setting txflow config slot: %s\n",
-						dr_error_message(result, g_test_errbuf));
-					dr_txflow_config_discard(config);
-					return;
-				}
-			}
-		}
+		DR_TEST_ERROR("Error: '%s' is not a valid dante device name\n", new_name);
+		return AUD_ERR_INVALIDDATA;
 	}
-
-	request = dr_test_allocate_request(test, "AddTxFlow");
-	if (!request)
+	if (close)
 	{
-		return;
+		result = dr_device_close_rename(test->device, new_name);
+		if (result != AUD_SUCCESS)
+		{
+			DR_TEST_ERROR("Error renaming device to '%s': %s\n",
+				(new_name ? new_name : ""), dr_error_message(result, g_test_errbuf));
+			return result;
+		}
+		DR_TEST_PRINT("Device renamed, handle closed, exiting\n");
+		test->device = NULL;
 	}
-
-	result = dr_txflow_config_commit(config, dr_test_on_response, &request->id);
-	if (result != AUD_SUCCESS)
+	else
 	{
-		DR_TEST_ERROR("Error sending txflow create request: %s\n",
-			dr_error_message(result, g_test_errbuf));
-		dr_test_request_release(request);
-		return;
+		dr_test_request_t * request = dr_test_allocate_request(test, "RenameDevice");
+		if (!request)
+		{
+			return AUD_ERR_NOBUFS;
+		}
+		result = dr_device_rename(test->device, dr_test_on_response, &request->id, new_name);
+	
+		if (result != AUD_SUCCESS)
+		{
+			DR_TEST_ERROR("Error renaming device to '%s': %s\n",
+				(new_name ? new_name : ""), dr_error_message(result, g_test_errbuf));
+			return result;
+		}
 	}
+	return AUD_SUCCESS;
 }
 
+typedef enum
+{
+	DR_TEST_PERFORMANCE_TX,
+	DR_TEST_PERFORMANCE_RX,
+	DR_TEST_PERFORMANCE_UNICAST
+} dr_test_performance_t;
+
+const char * DR_TEST_PERFORMANCE_NAMES[] =
+{
+	"tx",
+	"rx",
+	"unicast"
+};
+
 static void
-dr_test_replace_txflow_channels
+dr_test_set_performance
 (
 	dr_test_t * test,
-	dante_id_t id
+	dr_test_performance_t performance,
+	dante_latency_us_t latency_us,
+	dante_fpp_t fpp
 ) {
-	uint16_t s, num_slots;
-	dr_txflow_t * flow = NULL;
-	dr_txflow_config_t * config = NULL;
 	aud_error_t result;
 	dr_test_request_t * request;
 
-	DR_TEST_DEBUG("ACTION: Replace Tx Flow Channels\n");
+	DR_TEST_DEBUG("Setting %s performance\n", DR_TEST_PERFORMANCE_NAMES[performance]);
 
-	result = dr_device_txflow_with_id(test->device, id, &flow);
-	if (result != AUD_SUCCESS)
+	request = dr_test_allocate_request(test, DR_TEST_PERFORMANCE_NAMES[performance]);
+	if (!request)
 	{
-		DR_TEST_ERROR("Error getting txflow at index %d: %s\n",
-			id, dr_error_message(result, g_test_errbuf));
 		return;
 	}
-	result = dr_txflow_replace_channels(flow, &config);
-	if (result != AUD_SUCCESS)
+	
+	if (performance == DR_TEST_PERFORMANCE_TX)
 	{
-		DR_TEST_ERROR("Error creating txflow modify config: %s\n",
-			dr_error_message(result, g_test_errbuf));
-		dr_txflow_release(&flow);
-		return;
+		result = dr_device_set_tx_performance_us(test->device,
+			latency_us, fpp, dr_test_on_response, & request->id);
 	}
-	dr_txflow_release(&flow);
-	num_slots = dr_txflow_config_num_slots(config);
-
-	DR_TEST_PRINT("Enter 1-based tx channel id to add to slots (or simply 'enter' to have an empty slot):\n");
-	for (s = 0; s < num_slots; s++)
+	else if (performance == DR_TEST_PERFORMANCE_RX)
 	{
-		unsigned int  channel_id;
-		DR_TEST_PRINT("Slot %d/%d: ", s, num_slots);
-		fgets(g_input_buf, BUFSIZ, stdin);
-		if (sscanf(g_input_buf, "%u", &channel_id) == 1)
-		{
-			dr_txchannel_t * tx = dr_device_txchannel_with_id(test->device, (dante_id_t) channel_id);
-			if (tx)
-			{
-				result = dr_txflow_config_add_channel(config, tx, s);
-				if (result != AUD_SUCCESS)
-				{
-					DR_TEST_ERROR("Error setting txflow config slot: %s\n",
-						dr_error_message(result, g_test_errbuf));
-					dr_txflow_config_discard(config);
-					return;
-				}
-			}
-		}
+		result = dr_device_set_rx_performance_us(test->device, 
+			latency_us, fpp, dr_test_on_response, & request->id);
 	}
-
-	request = dr_test_allocate_request(test, "ReplaceTxFlowChannels");
-	if (!request)
+	else
 	{
-		return;
+		result = dr_device_set_unicast_performance_us(test->device,
+			latency_us, fpp, dr_test_on_response, & request->id);
 	}
 
-	result = dr_txflow_config_commit(config, dr_test_on_response, &request->id);
 	if (result != AUD_SUCCESS)
 	{
-		DR_TEST_ERROR("Error sending modify txflow request: %s\n",
-			dr_error_message(result, g_test_errbuf));
-		dr_test_request_release(request);
+		DR_TEST_ERROR("Error setting %s performance properties: %s\n",
+			DR_TEST_PERFORMANCE_NAMES[performance], dr_error_message(result, g_test_errbuf));
+		dr_test_request_release(test, request);
 		return;
 	}
 }
 
 static void
-dr_test_delete_txflow
+dr_test_set_lockdown
 (
 	dr_test_t * test,
-	dante_id_t id
+	aud_bool_t lockdown
 ) {
-	dr_txflow_t * flow = NULL;
 	aud_error_t result;
 	dr_test_request_t * request;
 
-	DR_TEST_DEBUG("ACTION: Delete Tx Flow\n");
-
+	DR_TEST_DEBUG("ACTION: Set lockdown\n");
 
-	result = dr_device_txflow_with_id(test->device, id, &flow);
+	request = dr_test_allocate_request(test, "SetLockdown");
+	if (!request)
+	{
+		return;
+	}
+	
+	result = dr_device_set_lockdown(test->device,
+		lockdown, dr_test_on_response, & request->id);
 	if (result != AUD_SUCCESS)
 	{
-		DR_TEST_ERROR("Error getting txflow %d: %s\n",
-			id, dr_error_message(result, g_test_errbuf));
+		DR_TEST_ERROR("Error setting device lockdown: %s\n",
+			dr_error_message(result, g_test_errbuf));
+		dr_test_request_release(test, request);
 		return;
 	}
+}
 
-	request = dr_test_allocate_request(test, "DeleteTxFlow");
+
+static void
+dr_test_set_network_loopback
+(
+	dr_test_t * test,
+	aud_bool_t enabled
+) {
+	aud_error_t result;
+	dr_test_request_t * request;
+
+	DR_TEST_DEBUG("ACTION: Set Network Loopback\n");
+
+	request = dr_test_allocate_request(test, "SetNetworkLoopback");
 	if (!request)
 	{
 		return;
 	}
-	result = dr_txflow_delete(&flow, dr_test_on_response, &request->id);
+	
+	result = dr_device_set_network_loopback(test->device, enabled, dr_test_on_response, & request->id);
 	if (result != AUD_SUCCESS)
 	{
-		DR_TEST_ERROR("Error sending delete txflow request for flow %d: %s\n",
-			id, dr_error_message(result, g_test_errbuf));
-		dr_txflow_release(&flow);
-		dr_test_request_release(request);
+		DR_TEST_ERROR("Error %s network loopback (request): %s\n",
+			(enabled ? "enabling" : "disabling"), dr_error_message(result, g_test_errbuf));
+		dr_test_request_release(test, request);
 		return;
 	}
 }
 
 static void
-dr_test_add_aes67_txflow_multicast
+dr_test_set_aes67_prefix
 (
 	dr_test_t * test,
-	dante_id_t flow_id,
-	uint16_t num_slots
+	uint32_t aes67_prefix
 ) {
-	dante_name_t name;
-	uint16_t i;
-	dr_txflow_config_t * config = NULL;
 	aud_error_t result;
 	dr_test_request_t * request;
 
-	DR_TEST_DEBUG("ACTION: Add Tx Flow\n");
+	DR_TEST_DEBUG("ACTION: Set AES67 prefix\n");
 
-	DR_TEST_PRINT("Enter flow name (or simply 'enter' to use default name): ");
-	fgets(g_input_buf, BUFSIZ, stdin);
-	if (sscanf(g_input_buf, "%s", name) < 1)
+	request = dr_test_allocate_request(test, "SetAES67Prefix");
+	if (!request)
 	{
-		name[0] = '\0';
+		return;
 	}
 
-	result = dr_txflow_config_new_aes67_multicast(test->device, flow_id, num_slots, &config);
+	result = dr_device_set_aes67_mcast_prefix(test->device, dr_test_on_response, &request->id, aes67_prefix);
 	if (result != AUD_SUCCESS)
 	{
-		DR_TEST_ERROR("Error creating txflow config: %s\n", dr_error_message(result, g_test_errbuf));
+		DR_TEST_ERROR("Error %s AES67 prefix (request): %s\n",
+			(aes67_prefix ? "enabling" : "disabling"), dr_error_message(result, g_test_errbuf));
+		dr_test_request_release(test, request);
 		return;
 	}
+}
 
-	result = dr_txflow_config_set_name(config, name);
-	if (result != AUD_SUCCESS)
+//----------------------------------------------------------
+// Channel actions
+//----------------------------------------------------------
+
+// Starts a bulk subscription of 'n' rx channels, taking ownership of 'subscriptions'
+static aud_error_t
+dr_test_bulk_rxchannel_subscribe
+(
+	dr_test_t * test,
+	dr_batch_subscription_t * subscriptions,
+	unsigned int n,
+	uint64_t * token
+) {
+	dr_test_bulk_t * bulk;
+
+	if (!test->device)
 	{
-		DR_TEST_ERROR("Error setting txflow config name: %s\n", dr_error_message(result, g_test_errbuf));
-		dr_txflow_config_discard(config);
-		return;
+		free(subscriptions);
+		return AUD_ERR_INVALIDSTATE;
 	}
-
-	// Slots
-	DR_TEST_PRINT("Enter 1-based tx channel index to add to slots (or simply 'enter' to have an empty slot):\n");
-	for (i = 0; i < num_slots; i++)
+	bulk = (dr_test_bulk_t *) calloc(1, sizeof(dr_test_bulk_t));
+	if (!bulk)
 	{
-		unsigned int id;
-		DR_TEST_PRINT("slot %d (of %d): ", i, num_slots);
-		fgets(g_input_buf, BUFSIZ, stdin);
-		if (sscanf(g_input_buf, "%u", &id) == 1)
-		{
-			dr_txchannel_t * tx = dr_device_txchannel_with_id(test->device, (dante_id_t) id);
-			if (tx)
-			{
-				result = dr_txflow_config_add_channel(config, tx, i);
-				if (result != AUD_SUCCESS)
-				{
-					DR_TEST_ERROR("Error setting txflow config slot: %s\n",
-						dr_error_message(result, g_test_errbuf));
-					dr_txflow_config_discard(config);
-					return;
-				}
-			}
-		}
-	}
-
-	request = dr_test_allocate_request(test, "AddTxFlow");
-	if (!request)
-	{
-		return;
+		free(subscriptions);
+		return AUD_ERR_NOMEMORY;
 	}
+	bulk->kind = DR_TEST_BULK_SUBSCRIPTIONS;
+	bulk->num_entries = n;
+	bulk->_.subscriptions = subscriptions;
 
-	result = dr_txflow_config_commit(config, dr_test_on_response, &request->id);
-	if (result != AUD_SUCCESS)
-	{
-		DR_TEST_ERROR("Error sending txflow create request: %s\n",
-			dr_error_message(result, g_test_errbuf));
-		dr_test_request_release(request);
-		return;
-	}
+	DR_TEST_PRINT("Setting %u RX subscriptions\n", n);
+	*token = dr_test_bulk_start(test, bulk);
+	return AUD_SUCCESS;
 }
 
-//----------------------------------------------------------
-// Rx Flows 
-//----------------------------------------------------------
-
-static void 
-dr_test_read_multicast_associations
+// AUD_TRUE unless rx channel 'id' is known to be subscribed to exactly
+// "channel@device", or known to be unsubscribed when either is NULL or empty.
+// Stale or unknown channels always differ.
+static aud_bool_t
+dr_test_rxchannel_subscription_differs
 (
 	dr_test_t * test,
-	dr_rxflow_config_t * config
+	unsigned int id,
+	const char * channel,
+	const char * device
 ) {
-	aud_error_t result;
-	unsigned int i, n = dr_device_max_rxflow_slots(test->device);
-
-	DR_TEST_PRINT("Multicast template flow associations are configured by choosing transmit channels and\n");
-	DR_TEST_PRINT("Selecting one or more receive channels to be subscribed to each of those channels.\n");
-	DR_TEST_PRINT("A maximum of of %d subscriptions are allowed for this device.\n", n);
+	dr_rxchannel_t * rxc;
+	const char * current_channel;
+	const char * current_device;
 
-	for (i = 0; i < n; i++)
+	if (!test->rx || id < 1 || id > test->nrx)
 	{
-		dante_name_t subscribed_channel;
-		unsigned int rxchannel_id;
-		DR_TEST_PRINT("  Enter transmit channel name, slot %u of %u (ENTER to finish):",
-			(i+1), n);
-		fgets(g_input_buf, BUFSIZ, stdin);
-
-		subscribed_channel[0] = '\0';
-		sscanf(g_input_buf, "%[^\r\n]", subscribed_channel);
-		if (subscribed_channel[0] == '\0')
-		{
-			break;
-		}
-
-		// parse ids
-		do 
-		{
-			dr_rxchannel_t * rxc = NULL;
-			DR_TEST_PRINT("    Receive channel id (ENTER to finish): ");
-			fgets(g_input_buf, BUFSIZ, stdin);
-			if (sscanf(g_input_buf, "%u", &rxchannel_id) != 1)
-			{
-				break;
-			}
-			if (rxchannel_id == 0 || rxchannel_id > test->nrx)
-			{
-				DR_TEST_PRINT("Invalid rx channel id %u\n", rxchannel_id);
-				continue;
-			}
-			rxc = test->rx[rxchannel_id-1];
-			result = dr_rxflow_config_add_associated_channel(config, rxc, subscribed_channel);
-			if (result != AUD_SUCCESS)
-			{
-				DR_TEST_PRINT("Error adding template association channel %d subscribed to %s@%s: %s\n",
-					rxchannel_id, subscribed_channel, dr_rxflow_config_get_tx_device_name(config),
-					dr_error_message(result, g_test_errbuf));
-				continue;
-			}
-		} while (rxchannel_id);
+		return AUD_TRUE;
+	}
+	rxc = test->rx[id-1];
+	if (dr_rxchannel_is_stale(rxc))
+	{
+		return AUD_TRUE;
+	}
+	current_channel = dr_rxchannel_get_subscription_channel(rxc);
+	current_device = dr_rxchannel_get_subscription_device(rxc);
+	if (!channel || !channel[0] || !device || !device[0])
+	{
+		return current_channel != NULL;
 	}
+	if (!current_channel || !current_device)
+	{
+		return AUD_TRUE;
+	}
+	// Dante names are case insensitive
+	return STRCASECMP(current_channel, channel) || STRCASECMP(current_device, device);
 }
 
-static void 
-dr_test_add_rxflow_multicast
+static void
+dr_test_batch_rxchannel_subscribe
 (
 	dr_test_t * test,
-	unsigned int flow_id
+	const char * filename
 ) {
-	dante_name_t tx_device_name;
-	dante_name_t tx_flow_name;
 	aud_error_t result;
-	dr_test_request_t * request;
-	dr_rxflow_config_t * config = NULL;
+	dr_batch_subscription_t * subscriptions = NULL;
+	unsigned int n = 0, max = 0;
+	uint64_t token;
 
-	DR_TEST_DEBUG("ACTION: Add Multicast Rx Flow Template\n");
+	FILE * fp;
 
-	DR_TEST_PRINT("Enter the multicast transmit flow and device name in the form \"flow@device\": ");
-	fgets(g_input_buf, BUFSIZ, stdin);
-	if (sscanf(g_input_buf, "\"%[^@]@%[^\r\n\"]\"", tx_flow_name, tx_device_name) != 2)
+	DR_TEST_DEBUG("ACTION: Batch Subscribe\n");
+
+	if (!filename || !filename[0])
 	{
-		printf("Invalid flow name.");
+		DR_TEST_ERROR("Invalid filename\n");
 		return;
 	}
 
-	result = dr_rxflow_config_new_multicast(test->device,
-		(dante_id_t) flow_id, tx_device_name, tx_flow_name,
-		&config);
-	if (result != AUD_SUCCESS)
+	fp = fopen(filename, "r");
+	if (!fp)
 	{
-		DR_TEST_ERROR("Error creating multicast config object: %s\n", dr_error_message(result, g_test_errbuf));
+		DR_TEST_ERROR("Error opening filename '%s'\n", filename);
 		return;
 	}
-
-	dr_test_read_multicast_associations(test, config);
-
-	request = dr_test_allocate_request(test, "AddMulticastRxFlowTemplate");
-	if (!request)
+	while (!feof(fp))
+	{
+		char line[128], channel[128], device[128], c;
+		unsigned int id;
+		if (!fgets(line, sizeof(line), fp))
+		{
+			break;
+		}
+		if (n == max)
+		{
+			dr_batch_subscription_t * grown;
+			max = max ? max * 2 : DR_TEST_MAX_BATCH;
+			grown = (dr_batch_subscription_t *) realloc(subscriptions, max * sizeof(dr_batch_subscription_t));
+			if (!grown)
+			{
+				DR_TEST_ERROR("Error reading file \"%s\": out of memory\n", filename);
+				free(subscriptions);
+				fclose(fp);
+				return;
+			}
+			subscriptions = grown;
+		}
+		if (sscanf(line, "%u \"%[^\"\r\n@]@%[^\"\r\n]%c", &id, channel, device, &c) == 4 && c == '"')
+		{
+			subscriptions[n].rxchannel_id = (dante_id_t) id;
+			aud_strlcpy(subscriptions[n].channel, channel, DANTE_NAME_LENGTH);
+			aud_strlcpy(subscriptions[n].device, device, DANTE_NAME_LENGTH);
+			n++;
+		}
+		else if (sscanf(line, "%u %s", &id, channel) == 2)
+		{
+			DR_TEST_ERROR("Invalid line in file \"%s\": \"%s\"\n", filename, line);
+			free(subscriptions);
+			fclose(fp);
+			return;
+		}
+		else if (sscanf(line, "%u", &id) == 1)
+		{
+			subscriptions[n].rxchannel_id = (dante_id_t) id;
+			subscriptions[n].channel[0] = '\0';
+			subscriptions[n].device[0] = '\0';
+			n++;
+		}
+		else
+		{
+			DR_TEST_ERROR("Invalid line in file \"%s\": \"%s\"\n", filename, line);
+			free(subscriptions);
+			fclose(fp);
+			return;
+		}
+	}
+	fclose(fp);
+	if (!n)
 	{
+		DR_TEST_ERROR("No valid configuration in file \"%s\"\n", filename);
+		free(subscriptions);
 		return;
 	}
-	result = dr_rxflow_config_commit(config, dr_test_on_response, &request->id);
+
+	result = dr_test_bulk_rxchannel_subscribe(test, subscriptions, n, &token);
 	if (result != AUD_SUCCESS)
 	{
-		DR_TEST_ERROR("Error sending multicast template create request: %s\n", dr_error_message(result, g_test_errbuf));
-		dr_test_request_release(request);
-		return;
+		DR_TEST_ERROR("Error sending batch rx channel subscription message: %s\n",
+			dr_error_message(result, g_test_errbuf));
 	}
 }
 
-
-static void
-dr_test_read_unicast_associations
+static aud_error_t
+dr_test_rxchannel_subscribe
 (
 	dr_test_t * test,
-	dr_rxflow_config_t * config
+	unsigned int channel,
+	char * name,
+	uint64_t * token
 ) {
 	aud_error_t result;
-	uint16_t i, num_slots = dr_rxflow_config_num_slots(config);
+	
+	dr_test_request_t * request;
 
-	DR_TEST_PRINT("Unicast template flow associations are configured by choosing a receive channel and\n");
-	DR_TEST_PRINT("setting the transmit channel to which it will subscribe.\n");
-	DR_TEST_PRINT("A maximum of of %d subscriptions are allowed for this device.\n", num_slots);
+	DR_TEST_DEBUG("ACTION: Subscribe\n");
+
+	if (channel < 1 || channel > test->nrx)
+	{
+		DR_TEST_ERROR("Invalid RX channel (must be in range 1..%u)\n", test->nrx);
+		return AUD_ERR_INVALIDPARAMETER;
+	}
 	
-	for (i = 0; i < num_slots;)
+	request = dr_test_allocate_request(test, "Subscribe");
+	if (!request)
 	{
-		dante_name_t subscribed_channel;
-		unsigned int rxchannel_id;
-		dr_rxchannel_t * rxc = NULL;
-		
-		DR_TEST_PRINT("Next receive channel id (hit ENTER to finish):");
-		fgets(g_input_buf, BUFSIZ, stdin);
-		if (sscanf(g_input_buf, "%u", &rxchannel_id) != 1)
-		{
-			break;
-		}
-		if (rxchannel_id == 0 || rxchannel_id > test->nrx)
+		return AUD_ERR_NOBUFS;
+	}
+
+	if (name != NULL)
+	{
+		char * c = name;
+		char * r = strchr(name, '@');
+		if (r == NULL)
 		{
-			DR_TEST_PRINT("Invalid rx channel id %u\n", rxchannel_id);
-			continue;
+			DR_TEST_ERROR("Invalid subscription name (NAME must be in the form \"channel@device\")\n");
+			dr_test_request_release(test, request);
+			return AUD_ERR_INVALIDPARAMETER;
 		}
-		rxc = test->rx[rxchannel_id-1];
-
-		DR_TEST_PRINT("Transmit channel for rxchannel %u:", rxchannel_id);
-		fgets(g_input_buf, BUFSIZ, stdin);
-		sscanf(g_input_buf, "%[^\"\r\n]", subscribed_channel);
-		if (subscribed_channel[0] == '\0')
+		*r = '\0';
+		r++;
+		result = dr_rxchannel_subscribe(test->rx[channel-1], dr_test_on_response, &request->id, r, c);
+		if (result != AUD_SUCCESS)
 		{
-			DR_TEST_PRINT("Invalid transmit channel name\n");
-			continue;
+			DR_TEST_ERROR("Error sending subscribe message: %s\n",
+				dr_error_message(result, g_test_errbuf));
+			dr_test_request_release(test, request);
+			return result;
 		}
-
-		result = dr_rxflow_config_add_associated_channel(config, rxc, subscribed_channel);
+	}
+	else
+	{
+		result = dr_rxchannel_subscribe(test->rx[channel-1], dr_test_on_response, &request->id, NULL, NULL);
 		if (result != AUD_SUCCESS)
 		{
-			DR_TEST_PRINT("Error adding template association channel %d subscribed to %s@%s: %s\n",
-				rxchannel_id, subscribed_channel, dr_rxflow_config_get_tx_device_name(config),
+			DR_TEST_ERROR("Error sending unsubscribe message: %s\n",
 				dr_error_message(result, g_test_errbuf));
-			continue;
+			dr_test_request_release(test, request);
+			return result;
 		}
-
-		// all good, add to counter...
-		i++;
 	}
+	if (token)
+	{
+		*token = request->token;
+	}
+	return AUD_SUCCESS;
 }
 
-static void 
-dr_test_add_rxflow_unicast
+static void
+dr_test_txchannel_set_enabled
 (
 	dr_test_t * test,
-	dante_id_t flow_id,
-	uint16_t num_slots
+	unsigned int channel,
+	aud_bool_t enabled
 ) {
-	char tx_device_name[BUFSIZ];
 	aud_error_t result;
 	dr_test_request_t * request;
-	dr_rxflow_config_t * config = NULL;
 
-	DR_TEST_DEBUG("ACTION: Add Unicast Rx Flow Template\n");
+	DR_TEST_DEBUG("ACTION: Set TxChannel Enabled\n");
 
-	DR_TEST_PRINT("Enter the transmit device name for the unicast template:");
-	fgets(g_input_buf, BUFSIZ, stdin);
-	if (sscanf(g_input_buf, "%[^\"\r\n]", tx_device_name) != 1)
+	if (channel < 1 || channel > test->ntx)
 	{
-		printf("Invalid device name.");
+		DR_TEST_PRINT("Invalid TX channel (must be in range 1..%u)\n", test->ntx);
 		return;
 	}
 
-	result = dr_rxflow_config_new_unicast(test->device,
-		(dante_id_t) flow_id, tx_device_name, num_slots,
-		&config);
-	if (result != AUD_SUCCESS)
-	{
-		DR_TEST_ERROR("Error creating unicast config object: %s\n", dr_error_message(result, g_test_errbuf));
-		return;
-	}
-
-	dr_test_read_unicast_associations(test, config);
-
-	request = dr_test_allocate_request(test, "AddUnicastRxFlowTemplate");
+	request = dr_test_allocate_request(test, "SetTxChannelEnabled");
 	if (!request)
 	{
 		return;
 	}
 
-	result = dr_rxflow_config_commit(config, dr_test_on_response, &request->id);
+	DR_TEST_PRINT("Setting TX channel %u to be %s\n", channel, (enabled ? "enabled" : "disabled"));
+	result = dr_txchannel_set_enabled(test->tx[channel-1], dr_test_on_response, &request->id, enabled);
 	if (result != AUD_SUCCESS)
 	{
-		DR_TEST_ERROR("Error sending multicast template create request: %s\n", dr_error_message(result, g_test_errbuf));
-		dr_test_request_release(request);
+		DR_TEST_ERROR("Error sending set enabled message: %s\n",
+			dr_error_message(result, g_test_errbuf));
+		dr_test_request_release(test, request);
 		return;
 	}
 }
 
-static void 
-dr_test_replace_rxflow_associations
+static void
+dr_test_txchannel_set_signal_reflevel
 (
 	dr_test_t * test,
-	dante_id_t flow_id
+	unsigned int channel,
+	dante_dbu_t dbu
 ) {
-	dr_rxflow_t * flow = NULL;
-	dr_rxflow_config_t * config = NULL;
 	aud_error_t result;
 	dr_test_request_t * request;
 
-	DR_TEST_DEBUG("ACTION: Replace Rx Flow Associations\n");
-	
-	result = dr_device_rxflow_with_id(test->device, flow_id, &flow);
-	if (result != AUD_SUCCESS)
+	DR_TEST_DEBUG("ACTION: Set TxChannel SignalRefLevel\n");
+
+	if (channel > test->ntx)
 	{
-		DR_TEST_ERROR("Error getting flow with id %d: %s\n",
-			flow_id, dr_error_message(result, g_test_errbuf));
+		DR_TEST_PRINT("Invalid TX channel (must be in range 1..%u)\n", test->ntx);
 		return;
 	}
 
-	result = dr_rxflow_replace_associations(flow, &config);
+	request = dr_test_allocate_request(test, "SetTxChannelSignalRefLevel");
+	if (!request)
+	{
+		return;
+	}
+
+	DR_TEST_PRINT("Setting TX channel %u signal reference level to ", channel);
+	if (dbu == DANTE_DBU_UNSET)
+	{
+		DR_TEST_PRINT("unset");
+	}
+	else
+	{
+		DR_TEST_PRINT("%+d dBu\n", (int) dbu);
+	}
+	if (channel == 0)
+	{
+		result = dr_device_set_txchannel_signal_reflevel(test->device, dr_test_on_response, &request->id, dbu);
+	}
+	else
+	{
+		result = dr_txchannel_set_signal_reflevel(test->tx[channel-1], dr_test_on_response, &request->id, dbu);
+	}
 	if (result != AUD_SUCCESS)
 	{
-		DR_TEST_ERROR("Error getting config for flow with id %d: %s\n",
-			flow_id, dr_error_message(result, g_test_errbuf));
+		DR_TEST_ERROR("Error sending set signal reference level message: %s\n",
+			dr_error_message(result, g_test_errbuf));
+		dr_test_request_release(test, request);
 		return;
 	}
+}
 
-	if (dr_rxflow_config_is_multicast_template(config))
+static void
+dr_test_txchannel_clear_signal_reflevel
+(
+	dr_test_t * test,
+	unsigned int channel
+)
+{
+	dr_test_txchannel_set_signal_reflevel(test, channel, DANTE_DBU_UNSET);
+}
+
+static aud_error_t
+dr_test_add_txlabel
+(
+	dr_test_t * test,
+	unsigned int channel,
+	char * name,
+	uint64_t * token
+) {
+	aud_error_t result;
+	dr_test_request_t * request;
+
+	DR_TEST_DEBUG("ACTION: Add Tx Label\n");
+
+	if (channel < 1 || channel > test->ntx)
 	{
-		dr_test_read_multicast_associations(test, config);
+		DR_TEST_ERROR("Invalid TX channel (must be in range 1..%u)\n", test->ntx);
+		return AUD_ERR_INVALIDPARAMETER;
 	}
-	else if (dr_rxflow_config_is_unicast_template(config))
+
+	if (!dante_name_is_valid_channel_or_label_name(name))
 	{
-		dr_test_read_unicast_associations(test, config);
+		DR_TEST_ERROR("Invalid TX label '%s'\n", name);
+		return AUD_ERR_INVALIDPARAMETER;
 	}
 
-	request = dr_test_allocate_request(test, "ReplaceRxFlowAssociations");
+	request = dr_test_allocate_request(test, "AddTxLabel");
 	if (!request)
 	{
-		return;
+		return AUD_ERR_NOBUFS;
 	}
 
-	result = dr_rxflow_config_commit(config, dr_test_on_response, &request->id);
+	DR_TEST_DEBUG("Adding label \"%s\" to tx channel %u\n", name, channel);
+	result = dr_txchannel_add_txlabel(test->tx[channel-1],
+		dr_test_on_response, &request->id, name, DR_MOVEFLAG_MOVE_EXISTING);
 	if (result != AUD_SUCCESS)
 	{
-		DR_TEST_ERROR("Error sending update template associations request: %s\n", dr_error_message(result, g_test_errbuf));
-		dr_test_request_release(request);
-		return;
+		DR_TEST_ERROR("Error sending add label \"%s\" message to tx channel %u: %s\n",
+			name, channel, dr_error_message(result, g_test_errbuf));
+		dr_test_request_release(test, request);
+		return result;
+	}
+	if (token)
+	{
+		*token = request->token;
 	}
+	return AUD_SUCCESS;
 }
 
 static void
-dr_test_delete_rxflow
+dr_test_remove_txlabel_from_channel
 (
 	dr_test_t * test,
-	dante_id_t flow_id
+	dante_id_t channel,
+	char * name
 ) {
 	aud_error_t result;
 	dr_test_request_t * request;
-	dr_rxflow_t * flow;
 
-	DR_TEST_DEBUG("ACTION: Delete Rx Flow\n");
+	DR_TEST_DEBUG("ACTION: Remove Tx Label From Channel\n");
 
-	result = dr_device_rxflow_with_id(test->device, flow_id, &flow);
-	if (result != AUD_SUCCESS)
+	if (channel < 1 || channel > test->ntx)
 	{
-		DR_TEST_ERROR("Error getting flow with id %d: %s\n",
-			flow_id, dr_error_message(result, g_test_errbuf));
+		DR_TEST_ERROR("Invalid TX channel (must be in range 1..%u)\n", test->ntx);
 		return;
 	}
 
-	request = dr_test_allocate_request(test, "DeleteRxFlow");
+	request = dr_test_allocate_request(test, "RemoveTxLabelFromChannel");
 	if (!request)
 	{
 		return;
 	}
 
-	result = dr_rxflow_delete(&flow, dr_test_on_response, &request->id);
+	DR_TEST_DEBUG("Removing label \"%s\" from tx channel %u\n", name, channel);
+	result = dr_txchannel_remove_txlabel(test->tx[channel-1],
+		dr_test_on_response, &request->id, name);
 	if (result != AUD_SUCCESS)
 	{
-		DR_TEST_ERROR("Error sending flow delete request: %s\n", dr_error_message(result, g_test_errbuf));
-		dr_test_request_release(request);
+		DR_TEST_ERROR("Error sending remove label \"%s\" message to tx channel %u: %s\n",
+			name, channel, dr_error_message(result, g_test_errbuf));
+		dr_test_request_release(test, request);
 		return;
 	}
 }
 
-/*
-static void 
-dr_test_set_one_rxflow_interface_mode
+
+static void
+dr_test_remove_txlabel
 (
 	dr_test_t * test,
-	dr_rxflow_error_field_t field,
-	dante_id_t flow_id,
-	unsigned int intf,
-	unsigned int window_interval_us
+	dante_id_t label_id
 ) {
 	aud_error_t result;
 	dr_test_request_t * request;
 
-	DR_TEST_DEBUG("ACTION: Set One RxFlow Interface Mode\n");
+	DR_TEST_DEBUG("ACTION: Remove Tx Label\n");
 
-	request = dr_test_allocate_request(test, "SetOneRxFlowInterfaceMode");
+	if (dr_device_txlabel_with_id(test->device, label_id, NULL) == AUD_ERR_RANGE)
+	{
+		DR_TEST_ERROR("Invalid TX label\n");
+		return;
+	}
+
+	request = dr_test_allocate_request(test, "RemoveTxLabel");
 	if (!request)
 	{
 		return;
 	}
 
-	result = dr_device_set_one_flow_interface_mode(test->device, dr_test_on_response, &request->id, field, flow_id, intf, window_interval_us);
+	DR_TEST_DEBUG("Removing TX label %u\n", label_id);
+	result = dr_device_remove_txlabel_with_id(test->device,
+		dr_test_on_response, &request->id, label_id
+	);
 	if (result != AUD_SUCCESS)
 	{
-		DR_TEST_ERROR("Error sending set one rxflow interface mode request: %s\n", dr_error_message(result, g_test_errbuf));
-		dr_test_request_release(request);
+		DR_TEST_ERROR("Error sending remove label %u message: %s\n",
+			label_id, dr_error_message(result, g_test_errbuf)
+		);
+		dr_test_request_release(test, request);
 		return;
 	}
 }
-*/
 
-//----------------------------------------------------------
-// Asynchronous event handlers
-//----------------------------------------------------------
 
-static void 
-dr_test_on_device_changed
+// One label of a desired or current tx label set
+typedef struct dr_test_txlabel_entry
+{
+	dante_id_t channel;
+	dante_id_t id;        // current labels only
+	const char * name;
+} dr_test_txlabel_entry_t;
+
+static int
+dr_test_txlabel_entry_compare
 (
-	dr_device_t * device,
-	dr_device_change_flags_t change_flags
+	const void * a,
+	const void * b
 ) {
-	dr_test_t * test = (dr_test_t *) dr_device_get_context(device);
-	dr_device_change_index_t i;
-
-	(void) device;
-
-	char line[4096];
+	// Dante names are case insensitive
+	return STRCASECMP(((const dr_test_txlabel_entry_t *) a)->name, ((const dr_test_txlabel_entry_t *) b)->name);
+}
 
-	DR_TEST_DEBUG("\nEVENT: device changed:");
-	snprintf(line, 4096, "\nEVENT: device changed:");
-	for (i = 0; i < DR_DEVICE_CHANGE_INDEX_COUNT; i++)
+// Reads every tx label of the device into test->txlabels_buf
+static aud_error_t
+dr_test_read_txlabels
+(
+	dr_test_t * test,
+	uint16_t * num_labels
+) {
+	for (;;)
 	{
-		if (change_flags & (1 << i))
+		uint16_t len = test->txlabels_buflen;
+		aud_error_t result = dr_device_get_txlabels(test->device, &len, test->txlabels_buf);
+		dr_txlabel_t * grown;
+
+		if (result != AUD_SUCCESS)
 		{
-			DR_TEST_DEBUG(" %s", dr_device_change_index_to_string(i));
-			snprintf(line + strlen(line), 4096, " %s", dr_device_change_index_to_string(i));
-			if (i == DR_DEVICE_CHANGE_INDEX_STATE)
-			{
-				dr_device_state_t state = dr_device_get_state(device);
-				DR_TEST_DEBUG(" (%s)", dr_device_state_to_string(state));
-				snprintf(line + strlen(line), 4096, " (%s)", dr_device_state_to_string(state));
-			}
-			else if (i == DR_DEVICE_CHANGE_INDEX_STALE)
-			{
-				unsigned int c;
-				DR_TEST_DEBUG("=");
-				snprintf(line + strlen(line), 4096, " =");
-				for (c = 0; c < DR_DEVICE_COMPONENT_COUNT; c++)
-				{
-					if (dr_device_is_component_stale(test->device, c))
-					{
-						DR_TEST_DEBUG(" %s", dr_device_component_to_string(c));
-						snprintf(line + strlen(line), 4096, " %s", dr_device_component_to_string(c));
-					}
-				}
-			}
+			return result;
+		}
+		if (len <= test->txlabels_buflen)
+		{
+			*num_labels = len;
+			return AUD_SUCCESS;
+		}
+		grown = (dr_txlabel_t *) realloc(test->txlabels_buf, len * sizeof(dr_txlabel_t));
+		if (!grown)
+		{
+			return AUD_ERR_NOMEMORY;
 		}
+		test->txlabels_buf = grown;
+		test->txlabels_buflen = len;
 	}
-	DR_TEST_DEBUG("\n");
+}
 
-	if (change_flags & DR_DEVICE_CHANGE_FLAG_STATE)
+// Computes the batch entries that give every channel in 'channels' exactly
+// the non-empty labels paired with it, leaving other channels alone. Both
+// sets are sorted by name and merged: a label on the wrong channel is moved by
+// id, one differing only in case renamed by id, a missing one added, one no
+// longer wanted on a listed channel removed, and one already in place is not
+// sent. The '*num_removals' removals come first, so they can complete before
+// any addition is sent. '*entries' is allocated for the caller.
+static aud_error_t
+dr_test_diff_txlabels
+(
+	dr_test_t * test,
+	const int * channels,
+	const char ** labels,
+	unsigned int count,
+	dr_batch_txlabel_t ** entries,
+	unsigned int * num_entries,
+	unsigned int * num_removals
+) {
+	aud_error_t result;
+	dr_test_txlabel_entry_t * desired = NULL, * current = NULL;
+	aud_bool_t * listed = NULL;
+	dr_batch_txlabel_t * out = NULL;
+	unsigned int i, j, n, nd = 0, nc = 0, removed = 0, changed = 0;
+	uint16_t num_labels;
+
+	*entries = NULL;
+	*num_entries = 0;
+	*num_removals = 0;
+	if (dr_device_is_component_stale(test->device, DR_DEVICE_COMPONENT_TXLABELS))
 	{
-		dr_test_on_device_state_changed(test);
+		return AUD_ERR_INVALIDSTATE;
 	}
-
-	if (change_flags & DR_DEVICE_CHANGE_FLAG_ADDRESSES)
+	result = dr_test_read_txlabels(test, &num_labels);
+	if (result != AUD_SUCCESS)
 	{
-		dr_test_on_device_addresses_changed(test);
+		return result;
 	}
 
-	printf("Active Requests: %d/%d\n", 
-		dr_devices_num_requests_pending(test->devices),
-		dr_devices_get_request_limit(test->devices));
-	snprintf(line + strlen(line), 4096, "Active Requests: %d/%d\n",
-		dr_devices_num_requests_pending(test->devices),
-		dr_devices_get_request_limit(test->devices));
-
-	(*device_event_callback)(test, dr_device_get_name(device), line);
-}
-
-//----------------------------------------------------------
-// Application-level functionality
-//----------------------------------------------------------
-
-static void
-dr_test_help(char filter)
-{
-	DR_TEST_PRINT("Usage:\n\n");
-	if (!filter)
+	desired = (dr_test_txlabel_entry_t *) malloc((count + 1) * sizeof(dr_test_txlabel_entry_t));
+	current = (dr_test_txlabel_entry_t *) malloc((num_labels + 1) * sizeof(dr_test_txlabel_entry_t));
+	listed = (aud_bool_t *) calloc(test->ntx + 1, sizeof(aud_bool_t));
+	// at most one entry per desired and one per current label
+	out = (dr_batch_txlabel_t *) malloc((count + num_labels + 1) * sizeof(dr_batch_txlabel_t));
+	if (!desired || !current || !listed || !out)
 	{
-		DR_TEST_PRINT("?            prints a help message\n");
-		DR_TEST_PRINT("q            Quit\n");
-		DR_TEST_PRINT("\n");
+		result = AUD_ERR_NOMEMORY;
+		goto cleanup;
 	}
-	if (!filter || filter == 'b')
+
+	for (i = 0; i < count; i++)
 	{
-		DR_TEST_PRINT("b N B        Set tx signal reference level for channel N to B dbu\n");
-		DR_TEST_PRINT("b N -        Clear tx signal reference level for channel N\n");
-		DR_TEST_PRINT("b 0 B        Set tx signal reference level for all channels to B dbu\n");
-		DR_TEST_PRINT("b 0 -        Clear tx signal reference level for all channels N\n");
-		DR_TEST_PRINT("\n");
-	}
-	if (!filter || filter == 'C')
-	{
-		DR_TEST_PRINT("C close current connection\n");
-	}
-	if (!filter || filter == 'c')
-	{
-		DR_TEST_PRINT("c +          Write the current device configuration\n");
-		DR_TEST_PRINT("c -          Clear the current device configuration\n");
-		DR_TEST_PRINT("\n");
+		if (channels[i] < 1 || channels[i] > test->ntx)
+		{
+			DR_TEST_ERROR("Invalid TX channel %d (must be in range 1..%u)\n", channels[i], test->ntx);
+			result = AUD_ERR_INVALIDPARAMETER;
+			goto cleanup;
+		}
+		listed[channels[i]] = AUD_TRUE;
+		if (!labels[i] || !labels[i][0])
+		{
+			continue;
+		}
+		if (!dante_name_is_valid_channel_or_label_name(labels[i]))
+		{
+			DR_TEST_ERROR("Invalid TX label '%s'\n", labels[i]);
+			result = AUD_ERR_INVALIDPARAMETER;
+			goto cleanup;
+		}
+		desired[nd].channel = (dante_id_t) channels[i];
+		desired[nd].id = 0;
+		desired[nd].name = labels[i];
+		nd++;
 	}
-	if (!filter || filter == 'D')
+	for (i = 0; i < num_labels; i++)
 	{
-		DR_TEST_PRINT("D .          Switch to the ADHOC domain\n");
-		DR_TEST_PRINT("D N          Switch to domain N\n");
-		DR_TEST_PRINT("D 0          Switch to domain NONE\n");
-		DR_TEST_PRINT("D            List domains\n");
+		current[nc].channel = dr_txchannel_get_id(test->txlabels_buf[i].tx);
+		current[nc].id = test->txlabels_buf[i].id;
+		current[nc].name = test->txlabels_buf[i].name;
+		nc++;
 	}
-	if (!filter || filter == 'd')
+	qsort(desired, nd, sizeof(dr_test_txlabel_entry_t), dr_test_txlabel_entry_compare);
+	qsort(current, nc, sizeof(dr_test_txlabel_entry_t), dr_test_txlabel_entry_compare);
+
+	// a label belongs to one channel; repeats for the same channel are dropped
+	for (i = 0, j = 0; i < nd; i++)
 	{
-		DR_TEST_PRINT("d t L F      Set device tx multicast performance properties to L microseconds and F frames per packet\n");
-		DR_TEST_PRINT("d r L F      Set device rx multicast performance properties to L microseconds and F frames per packet\n");
-		DR_TEST_PRINT("d u L F      Set device unicast performance properties to L microseconds and F frames per packet\n");
-		DR_TEST_PRINT("d A P        Set AES67 Multicast Prefix (e.g. d A 0xef450000, must start with 239.x.x.x)\n");
-		DR_TEST_PRINT("d p          'Ping' the device (sends a no-op routing message and waits for a response)\n");
-		DR_TEST_PRINT("d !          Mark properties component as stale\n");
-		DR_TEST_PRINT("d            Display device information (properties,capabilities,status)\n");
-		DR_TEST_PRINT("\n");
+		if (j && !dr_test_txlabel_entry_compare(desired + j - 1, desired + i))
+		{
+			if (desired[j - 1].channel != desired[i].channel)
+			{
+				DR_TEST_ERROR("TX label '%s' requested for channels %u and %u\n",
+					desired[i].name, desired[j - 1].channel, desired[i].channel);
+				result = AUD_ERR_INVALIDPARAMETER;
+				goto cleanup;
+			}
+			continue;
+		}
+		desired[j++] = desired[i];
 	}
-	if (!filter || filter == 'e')
+	nd = j;
+
+	// removals are collected from the front of 'out', changes from the back
+	n = count + num_labels;
+	for (i = 0, j = 0; i < nd || j < nc; )
 	{
-		DR_TEST_PRINT("e N +        Enable tx channel N\n");
-		DR_TEST_PRINT("e N -        Disable tx channel N\n");
-		DR_TEST_PRINT("\n");
+		int order = (i == nd) ? 1 : (j == nc) ? -1 : dr_test_txlabel_entry_compare(desired + i, current + j);
+		if (order == 0)
+		{
+			// names match case insensitively, a change of case alone is still sent
+			if (desired[i].channel != current[j].channel || strcmp(desired[i].name, current[j].name))
+			{
+				dr_batch_txlabel_t * e = out + n - ++changed;
+				e->txlabel_id = current[j].id;
+				e->txchannel_id = desired[i].channel;
+				aud_strlcpy(e->label, desired[i].name, DANTE_NAME_LENGTH);
+			}
+			i++;
+			j++;
+		}
+		else if (order < 0)
+		{
+			dr_batch_txlabel_t * e = out + n - ++changed;
+			e->txlabel_id = 0;
+			e->txchannel_id = desired[i].channel;
+			aud_strlcpy(e->label, desired[i].name, DANTE_NAME_LENGTH);
+			i++;
+		}
+		else
+		{
+			if (current[j].channel <= test->ntx && listed[current[j].channel])
+			{
+				dr_batch_txlabel_t * e = out + removed++;
+				e->txlabel_id = current[j].id;
+				e->txchannel_id = 0;
+				e->label[0] = '\0';
+			}
+			j++;
+		}
 	}
-	if (!filter || filter == 'f')
+	if (changed)
 	{
-		DR_TEST_PRINT("f + N S L F  Create new transmit flow with id N, S slots, latency L microseconds and F frames per packet\n");
-		DR_TEST_PRINT("f + S        Create new transmit flow with S slots\n");
-		DR_TEST_PRINT("f + A N S    Create new AES67 transmit flow with id N, S slots\n");
-		DR_TEST_PRINT("f N          Modify transmit flow N\n");
-		DR_TEST_PRINT("f - N        Delete transmit flow N\n");
-		DR_TEST_PRINT("f !          Mark transmit flow component as being stale\n");
-		DR_TEST_PRINT("f            Display all transmit flows\n");
-		DR_TEST_PRINT("\n");
+		memmove(out + removed, out + n - changed, changed * sizeof(dr_batch_txlabel_t));
 	}
-	if (!filter || filter == 'g')
+	*num_entries = removed + changed;
+	*num_removals = removed;
+	if (*num_entries)
 	{
-		DR_TEST_PRINT("g m N        Create a new multicast receive template on flow id N\n");
-		DR_TEST_PRINT("g u N S      Create a new unicast receive template on flow id N with S slots\n");
-		DR_TEST_PRINT("g * N        Replace channel associations for template with flow id N\n");
-		DR_TEST_PRINT("g - N        Delete template with flow id N\n");
-		DR_TEST_PRINT("g !          Mark receive flow component as being stale\n");
-		DR_TEST_PRINT("g            Display all receive flows\n");
-		DR_TEST_PRINT("\n");
+		*entries = out;
+		out = NULL;
 	}
-	if (!filter || filter == 'l')
+	DR_TEST_PRINT("TX labels: %u to remove, %u to add or move, %u unchanged\n",
+		removed, changed, nd - changed);
+	result = AUD_SUCCESS;
+
+cleanup:
+	free(desired);
+	free(current);
+	free(listed);
+	free(out);
+	return result;
+}
+
+// Starts a bulk tx label update of 'n' entries, taking ownership of 'labels'.
+// The first 'num_removals' entries are sent, and must complete, before the others.
+static aud_error_t
+dr_test_bulk_txlabels
+(
+	dr_test_t * test,
+	dr_batch_txlabel_t * labels,
+	unsigned int n,
+	unsigned int num_removals,
+	uint64_t * token
+) {
+	dr_test_bulk_t * bulk = (dr_test_bulk_t *) calloc(1, sizeof(dr_test_bulk_t));
+	if (!bulk)
 	{
-		DR_TEST_PRINT("l N \"NAME\" + Add label NAME to tx channel N\n");
-		DR_TEST_PRINT("l N \"NAME\" - Remove label NAME from tx channel N\n");
-		DR_TEST_PRINT("l N          List labels for tx channel N\n");
-		DR_TEST_PRINT("l !          Mark tx labels component as stale\n");
-		DR_TEST_PRINT("l            List labels for all tx channels\n");
-		DR_TEST_PRINT("\n");
+		free(labels);
+		return AUD_ERR_NOMEMORY;
 	}
-	if (!filter || filter == 'L')
+	bulk->kind = DR_TEST_BULK_TXLABELS;
+	bulk->num_entries = n;
+	bulk->num_leading = num_removals;
+	bulk->_.txlabels = labels;
+
+	DR_TEST_PRINT("Setting %u TX labels\n", n);
+	*token = dr_test_bulk_start(test, bulk);
+	return AUD_SUCCESS;
+}
+
+static void
+dr_test_txchannel_set_muted
+(
+	dr_test_t * test,
+	unsigned int channel,
+	aud_bool_t muted
+) {
+	aud_error_t result;
+	dr_test_request_t * request;
+
+	DR_TEST_DEBUG("ACTION: Set Tx Channel Muted\n");
+
+	if (channel < 1 || channel > test->ntx)
 	{
-		DR_TEST_PRINT("L N -        Remove label N\n");
-		DR_TEST_PRINT("L N          Display label N\n");
-		DR_TEST_PRINT("L !          Mark tx labels component as stale\n");
-		DR_TEST_PRINT("L            List all labels\n");
-		DR_TEST_PRINT("\n");
+		DR_TEST_PRINT("Invalid TX channel (must be in range 1..%u)\n", test->ntx);
+		return;
 	}
-	if (!filter || filter == 'n')
+
+	request = dr_test_allocate_request(test, "SetTxChannelMuted");
+	if (!request)
 	{
-		DR_TEST_PRINT("n NAME       Rename the device to NAME (closes the device handle)\n");
-		DR_TEST_PRINT("n + NAME     Rename the device to NAME (does not close the device handle)\n");
-		DR_TEST_PRINT("n -          Rename the device to its default name (closes the device handle)\n");
-		DR_TEST_PRINT("n            Print the device's name\n");
-		DR_TEST_PRINT("\n");
+		return;
 	}
-	if (!filter || filter == 'O')
+
+	DR_TEST_PRINT("Setting TX channel %u to be %s\n", channel, (muted ? "muted" : "unmuted"));
+	result = dr_txchannel_set_muted(test->tx[channel-1], dr_test_on_response, &request->id, muted);
+	if (result != AUD_SUCCESS)
 	{
-		DR_TEST_PRINT("O \"NAME\"     Open connection to device NAME\n");
-		DR_TEST_PRINT("O 0xXXXXXXXX Open connection to device with the given domain routing ID\n");
-		DR_TEST_PRINT("O A.B.C.D    Open connection to device at the given IP address\n");
-		DR_TEST_PRINT("O            Open connection to the local device\n");
+		DR_TEST_ERROR("Error sending %s message: %s\n",
+			(muted ? "mute" : "unmute"), dr_error_message(result, g_test_errbuf));
+		dr_test_request_release(test, request);
+		return;
 	}
-	if (!filter || filter == 'o')
+}
+
+static void
+dr_test_rxchannel_set_muted
+(
+	dr_test_t * test,
+	unsigned int channel,
+	aud_bool_t muted
+) {
+	aud_error_t result;
+	dr_test_request_t * request;
+
+	DR_TEST_DEBUG("ACTION: Set Rx Channel Muted\n");
+
+	if (channel < 1 || channel > test->nrx)
 	{
-		DR_TEST_PRINT("o +          Enable network loopback\n");
-		DR_TEST_PRINT("o -          Disable network loopback\n");
-		DR_TEST_PRINT("\n");
+		DR_TEST_PRINT("Invalid RX channel (must be in range 1..%u)\n", test->nrx);
+		return;
 	}
-	if (!filter || filter == 'R')
+
+	request = dr_test_allocate_request(test, "SetRxChannelMuted");
+	if (!request)
 	{
-		DR_TEST_PRINT("R FILE       Batch rename N rx channels from file FILE, where each line of the file is \"N NAME\" or just \"N\"\n");
-		DR_TEST_PRINT("\n");
+		return;
 	}
-	if (!filter || filter == 'r')
+
+	DR_TEST_PRINT("Setting RX channel %u to be %s\n", channel, (muted ? "muted" : "unmuted"));
+	result = dr_rxchannel_set_muted(test->rx[channel-1], dr_test_on_response, &request->id, muted);
+	if (result != AUD_SUCCESS)
 	{
-		DR_TEST_PRINT("r !          Mark rx channel component as stale\n");
-		DR_TEST_PRINT("r N m +      Mute rx channel N\n");
-		DR_TEST_PRINT("r N m -      Unute rx channel N\n");
-		DR_TEST_PRINT("r N \"NAME\"   Renamed rx channel N\n");
-		DR_TEST_PRINT("r            Display rx channel information\n");
-		DR_TEST_PRINT("\n");
+		DR_TEST_ERROR("Error sending %s message: %s\n",
+			(muted ? "mute" : "unmute"), dr_error_message(result, g_test_errbuf));
+		dr_test_request_release(test, request);
+		return;
 	}
-	if (!filter || filter == 'S')
+}
+
+
+static aud_error_t
+dr_test_rxchannel_set_name
+(
+	dr_test_t * test,
+	unsigned int channel,
+	const char * name,
+	uint64_t * token
+) {
+	aud_error_t result;
+	dr_test_request_t * request;
+
+	DR_TEST_DEBUG("ACTION: Set Rx Channel Name\n");
+
+	if (channel < 1 || channel > test->nrx)
 	{
-		DR_TEST_PRINT("S FILE       Batch subscribe N rx channels from file FILE, where each line of the file is \"N NAME\" or just \"N\"\n");
-		DR_TEST_PRINT("\n");
+		DR_TEST_ERROR("Invalid RX channel (must be in range 1..%u)\n", test->nrx);
+		return AUD_ERR_INVALIDPARAMETER;
 	}
-	if (!filter || filter == 's')
+
+	if (name && !dante_name_is_valid_channel_or_label_name(name))
 	{
-		DR_TEST_PRINT("s N \"NAME\"   Subscribe rx channel N to network channel NAME\n");
-		DR_TEST_PRINT("s N          Unsubscribe rx channel N\n");
-		DR_TEST_PRINT("\n");
+		DR_TEST_ERROR("Invalid channel name '%s'\n", name);
+		return AUD_ERR_INVALIDPARAMETER;
 	}
-	if (!filter || filter == 't')
+
+	request = dr_test_allocate_request(test, "SetRxChannelName");
+	if (!request)
 	{
-		DR_TEST_PRINT("t !          Mark tx channel component as stale\n");
-		DR_TEST_PRINT("t N m +      Mute tx channel N\n");
-		DR_TEST_PRINT("t N m -      Unute tx channel N\n");
-		DR_TEST_PRINT("t            Display tx channel information\n");
-		DR_TEST_PRINT("\n");
+		return AUD_ERR_NOBUFS;
 	}
-	if (!filter || filter == 'u')
+
+	DR_TEST_PRINT("Setting RX channel %u name to \"%s\"\n", channel, name);
+	result = dr_rxchannel_set_name(test->rx[channel-1], dr_test_on_response, &request->id, name);
+	if (result != AUD_SUCCESS)
 	{
-		DR_TEST_PRINT("u q          Query (or re-query) capabilities\n");
-		DR_TEST_PRINT("u !          Invalidate and update all components\n");
-		DR_TEST_PRINT("u            Update information for all stale components\n");
-		DR_TEST_PRINT("\n");
+		DR_TEST_ERROR("Error sending rx channel rename message: %s\n",
+			dr_error_message(result, g_test_errbuf));
+		dr_test_request_release(test, request);
+		return result;
 	}
-	if (!filter || filter == 'U')
+	if (token)
 	{
-		DR_TEST_PRINT("U TYPE +     Get and clear rxflow error field TYPE for all flows\n");
-		DR_TEST_PRINT("U TYPE -     Get rxflow error field TYPE for all flows\n"); 
-		DR_TEST_PRINT("U +          Get and clear rxflow error flags for all flows\n");
-		DR_TEST_PRINT("U -          Get rxflow error flags for all flows\n");
-		DR_TEST_PRINT("U N          Print rxflow error information for rx flow N\n");
-		DR_TEST_PRINT("U            Print rxflow error information for all rx flows\n");
-		DR_TEST_PRINT("\n");
+		*token = request->token;
 	}
-	if (!filter || filter == 'x')
+	return AUD_SUCCESS;
+}
+
+// Starts a bulk rename of 'n' rx channels, taking ownership of 'labels'
+static aud_error_t
+dr_test_bulk_rxchannel_set_names
+(
+	dr_test_t * test,
+	dr_batch_rxlabel_t * labels,
+	unsigned int n,
+	uint64_t * token
+) {
+	dr_test_bulk_t * bulk;
+
+	if (!test->device)
 	{
-		DR_TEST_PRINT("x +          Put the device into lockdown\n");
-		DR_TEST_PRINT("x -          Take the device out of lockdown\n");
-		DR_TEST_PRINT("\n");
+		free(labels);
+		return AUD_ERR_INVALIDSTATE;
 	}
-	if (!filter || filter == 'X')
+	bulk = (dr_test_bulk_t *) calloc(1, sizeof(dr_test_bulk_t));
+	if (!bulk)
 	{
-		DR_TEST_PRINT("X            Cancel outstanding requests\n");
-		DR_TEST_PRINT("\n");
+		free(labels);
+		return AUD_ERR_NOMEMORY;
 	}
+	bulk->kind = DR_TEST_BULK_RXLABELS;
+	bulk->num_entries = n;
+	bulk->_.rxlabels = labels;
+
+	DR_TEST_PRINT("Setting %u RX channel names\n", n);
+	*token = dr_test_bulk_start(test, bulk);
+	return AUD_SUCCESS;
 }
 
 static void
-dr_test_usage
+dr_test_batch_rxchannel_set_name
 (
-	const char * bin
-) {
-	printf("Usage: %s OPTIONS [DEVICE]\n", bin);
-	printf("  OPTIONS are\n");
-	printf("    -h=N set num of handles to N\n");
-	printf("    -r=N set num of requests to N\n");
-	printf("    -ii=INDEX use local interface INDEX (specify once per interface to be used)\n");
-	printf("    -i=NAME use local interface NAME (specify once per interface to be used)\n");
-	printf("    -a=ADDRESS use address A instead of name (specify once per interface to be used)\n");
-	printf("    -u=BOOL enable/disable automatic query / updates on state changes\n");
-	printf("    -p=PORT set port for local device connection (for debugging purposes only)\n");
-#if DAPI_HAS_CONFIGURABLE_MDNS_SERVER_PORT == 1
-	printf("    -m=PORT_NO set MDNS server port number to PORT_NO\n");
-#endif
-#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__EMBEDDED
-#ifdef WIN32
-	printf("    -d=PORT_NO set domain handler port number to PORT_NO\n");
-#else
-	printf("    -d=PATH set domain handler socket path to PATH\n");
-#endif
-#endif
-
-#ifdef DANTE_ROUTING_TEST_CUSTOM_USAGE
-	DANTE_ROUTING_TEST_CUSTOM_USAGE();
-#endif
-
-#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
-	printf("    --domain[=<preferred domain>] browse on a domain\n");
-	printf("    --user=<user> browse on a domain with the specified username\n");
-	printf("    --pass=<password> browse on a domain with the specified password\n");
-	printf("    --ddm=<host>:<port> use the specified ddm rather than discovering (--domain must be specified)\n");
-#endif
-	printf("  If no name or addresses specified then connect to the local dante device via localhost\n");
-}
-
-static void
-dr_test_parse_options
-(
-	dr_test_options_t * options,
-	int argc, 
-	char * argv[]
+	dr_test_t * test,
+	const char * filename
 ) {
-#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
 	aud_error_t result;
-#endif
-	int i;
+	dr_batch_rxlabel_t * labels = NULL;
+	unsigned int n = 0, max = 0;
+	uint64_t token;
 
-	// init defaults
-	options->automatic_update_on_state_change = AUD_TRUE;
+	FILE * fp;
 
-	// and parse options
-	for (i = 1; i < argc; i++)
+	DR_TEST_DEBUG("ACTION: Batch Set Rx Channel Names\n");
+
+	if (!filename || !filename[0])
 	{
-#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
-		if (dapi_utils_ddm_config_parse_one(&options->ddm_config, argv[i], &result))
-		{
-			if (result != AUD_SUCCESS)
-			{
-				dr_test_usage(argv[0]);
-				exit(1);
-			}
-		}
-		else
-#endif
-#ifdef DANTE_ROUTING_TEST_CUSTOM_PARSE_OPTIONS
-		if (DANTE_ROUTING_TEST_CUSTOM_PARSE_OPTIONS(test, argc, argv, &i))
-		{}
-		else
-#endif
-		if (!strncmp(argv[i], "-h=", 3))
-		{
-			options->num_handles = atoi(argv[i]+3);
-		}
-		else if (!strncmp(argv[i], "-r=", 3))
-		{
-			options->request_limit = atoi(argv[i]+3);
-		}
-		else if (!strncmp(argv[i], "-ii=", 4))
-		{
-			if (options->num_local_interfaces < DR_TEST_MAX_INTERFACES)
-			{
-				int local_interface_index = atoi(argv[i]+4);
-				if (local_interface_index)
-				{
-					options->local_interfaces[options->num_local_interfaces].index = local_interface_index;
-					options->local_interfaces[options->num_local_interfaces].flags = AUD_INTERFACE_IDENTIFIER_FLAG_INDEX;
-					options->num_local_interfaces++;
-				}
-				else
-				{
-					dr_test_usage(argv[0]);
-					exit(1);
-				}
-			}
-		}
-		else if (!strncmp(argv[i], "-i=", 3))
+		DR_TEST_ERROR("Invalid filename\n");
+		return;
+	}
+
+	fp = fopen(filename, "r");
+	if (!fp)
+	{
+		DR_TEST_ERROR("Error opening filename '%s'\n", filename);
+		return;
+	}
+	while (!feof(fp))
+	{
+		char line[128], name[128];
+		unsigned int c;
+		if (!fgets(line, sizeof(line), fp))
 		{
-			if (options->num_local_interfaces < DR_TEST_MAX_INTERFACES)
-			{
-				const char * intf_name = argv[i]+3;
-				if (intf_name[0])
-				{
-#ifdef WIN32
-					mbstowcs(
-						options->local_interfaces[options->num_local_interfaces].name,
-						intf_name,
-						AUD_INTERFACE_NAME_LENGTH
-					);
-#else
-					aud_strlcpy(
-						options->local_interfaces[options->num_local_interfaces].name,
-						intf_name,
-						AUD_INTERFACE_NAME_LENGTH
-					);
-#endif
-					options->local_interfaces[options->num_local_interfaces].flags = AUD_INTERFACE_IDENTIFIER_FLAG_NAME;
-					options->num_local_interfaces++;
-				}
-				else
-				{
-					dr_test_usage(argv[0]);
-					exit(1);
-				}
-			}
+			break;
 		}
-		else if (!strncmp(argv[i], "-a=", 3))
+		if (n == max)
 		{
-			if (options->num_addresses < DR_TEST_MAX_INTERFACES)
+			dr_batch_rxlabel_t * grown;
+			max = max ? max * 2 : DR_TEST_MAX_BATCH;
+			grown = (dr_batch_rxlabel_t *) realloc(labels, max * sizeof(dr_batch_rxlabel_t));
+			if (!grown)
 			{
-				unsigned int addr = inet_addr(argv[i]+3);
-				options->addresses[options->num_addresses++] = addr;
+				DR_TEST_ERROR("Error reading file \"%s\": out of memory\n", filename);
+				free(labels);
+				fclose(fp);
+				return;
 			}
+			labels = grown;
 		}
-		else if (!strcmp(argv[i], "-u=true"))
-		{
-			options->automatic_update_on_state_change = AUD_TRUE;
-		}
-		else if (!strcmp(argv[i], "-u=false"))
-		{
-			options->automatic_update_on_state_change = AUD_FALSE;
-		}
-		else if (!strncmp(argv[i], "-p=", 3) && strlen(argv[i]) > 3)
-		{
-			options->local_port = (uint16_t) atoi(argv[i]+3);
-		}
-		else if (!strncmp(argv[i], "-target=", 8) && strlen(argv[i]) > 8)
-		{
-			options->domain_device_addr = strtoul(argv[i] + 8, NULL, 0);
-		}
-#if DAPI_HAS_CONFIGURABLE_MDNS_SERVER_PORT == 1
-		else if (!strncmp(argv[i], "-m=", 3))
-		{
-			options->mdns_server_port = (uint16_t) atoi(argv[i] + 3);
-		}
-#endif
-#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__EMBEDDED
-		else if (!strncmp(argv[i], "-d=", 3))
+		if (sscanf(line, "%u %s", &c, name) == 2)
 		{
-#ifdef WIN32
-			options->domain_handler.port_no = (uint16_t)atoi(argv[i] + 3);
-#else
-			options->domain_handler.socket_path = argv[i] + 3;
-#endif
+			labels[n].rxchannel_id = (dante_id_t) c;
+			aud_strlcpy(labels[n].label, name, DANTE_NAME_LENGTH);
+			n++;
 		}
-#endif
-		else if (argv[i][0] == '-')
+		else if (sscanf(line, "%u", &c) == 1)
 		{
-			dr_test_usage(argv[0]);
-			exit(1);
+			labels[n].rxchannel_id = (dante_id_t) c;
+			labels[n].label[0] = '\0';
+			n++;
 		}
 		else
 		{
-			SNPRINTF(options->device_name, sizeof(options->device_name), "%s", argv[i]);
-			break;
+			DR_TEST_ERROR("Invalid line in file \"%s\": \"%s\"\n", filename, line);
+			free(labels);
+			fclose(fp);
+			return;
 		}
 	}
+	fclose(fp);
+	if (!n)
+	{
+		DR_TEST_ERROR("No valid configuration in file \"%s\"\n", filename);
+		free(labels);
+		return;
+	}
+
+	result = dr_test_bulk_rxchannel_set_names(test, labels, n, &token);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error sending batch rx channel rename message: %s\n",
+			dr_error_message(result, g_test_errbuf));
+	}
 }
 
-static aud_error_t
-dr_test_process_line(
+//----------------------------------------------------------
+// Transmit Flows
+//----------------------------------------------------------
+
+static void
+dr_test_add_txflow
+(
 	dr_test_t * test,
-	/*[in]*/ char * buf,
-	/*[out]*/ char*** array,
-	/*[out]*/ int* count
-)
-{
-	char in_name[BUFSIZ];
-	char in_action[BUFSIZ];
-	char in_c;
-	unsigned int in_channel, in_id, in_count, in_fpp, in_latency, in_type, prefix;
-	int in_dbu;
-	int match_count;
+	dante_id_t flow_id,
+	uint16_t num_slots,
+	dante_latency_us_t latency_us,
+	dante_fpp_t fpp
+) {
+	dante_name_t name;
+	uint16_t i;
+	dr_txflow_config_t * config = NULL;
+	aud_error_t result;
+	dr_test_request_t * request;
 
-	// trim beginning and end of string
-	//printf("Before=\"%s\"\n", buf);
-	while(*buf && isspace(*buf)) buf++;
+	DR_TEST_DEBUG("ACTION: Add Tx Flow\n");
+
+	DR_TEST_PRINT("Enter flow name (or simply 'enter' to use default name): ");
+	fgets(g_input_buf, BUFSIZ, stdin);
+	if (sscanf(g_input_buf, "%s", name) < 1)
 	{
-		char * end = buf;
-		while (*end) end++;
-		end--;
-		while (end > buf && isspace(*end)) {*end = '\0'; end--;}
+		name[0] = '\0';
 	}
-	//printf("After=\"%s\"\n", buf);
 
-#ifdef DANTE_ROUTING_TEST_CUSTOM_PROCESS_LINE
-	if (DANTE_ROUTING_TEST_CUSTOM_PROCESS_LINE(test, buf))
+	result = dr_txflow_config_new(test->device, flow_id, num_slots, &config);
+	if (result != AUD_SUCCESS)
 	{
-		return AUD_SUCCESS;
+		DR_TEST_ERROR("Error creating txflow config: %s\n", dr_error_message(result, g_test_errbuf));
+		return;
 	}
-#endif
 
-	switch (buf[0])
+	result = dr_txflow_config_set_name(config, name);
+	if (result != AUD_SUCCESS)
 	{
-	case '?':
-		{
-			dr_test_help(0);
-			break;
-		}
-
-	case 'b':
-		{
-			if (sscanf(buf, "b %u %d", &in_channel, &in_dbu) == 2)
-			{
-				dr_test_txchannel_set_signal_reflevel(test, in_channel, (dante_dbu_t)in_dbu);
-			}
-			else if (sscanf(buf, "b %u -", &in_channel) == 1)
-			{
-				dr_test_txchannel_clear_signal_reflevel(test, in_channel);
-			}
-			else
-			{
-				dr_test_help('b');
-			}
-			break;
-		}
-	case 'C': 
-		{
-			dr_test_close(test);
-			break;
-		}
+		DR_TEST_ERROR("Error setting txflow config name: %s\n", dr_error_message(result, g_test_errbuf));
+		dr_txflow_config_discard(config);
+		return;
+	}
+
+	result = dr_txflow_config_set_latency_us(config, latency_us);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error setting txflow config latency: %s\n", dr_error_message(result, g_test_errbuf));
+		dr_txflow_config_discard(config);
+		return;
+	}
+
+	result = dr_txflow_config_set_fpp(config, fpp);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error setting txflow config fpp: %s\n", dr_error_message(result, g_test_errbuf));
+		dr_txflow_config_discard(config);
+		return;
+	}
+
 	
-	case 'c':
-		{
-			if (sscanf(buf, "c %s", in_action) == 1 && !strcmp(in_action, "+"))
-			{
-				dr_test_store_config(test);
-			}
-			else if (sscanf(buf, "c %s", in_action) == 1 && !strcmp(in_action, "-"))
-			{
-				dr_test_clear_config(test);
-			}
-			else
-			{
-				dr_test_help('c');
-			}
-			break;
-		}
-#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
-	case 'D':
-		{
-			if (sscanf(buf, "D %c", &in_c) == 1 && in_c == '.')
-			{
-				dr_test_set_current_domain_by_uuid(test, DANTE_DOMAIN_UUID_ADHOC);
-			}
-			else if (sscanf(buf, "D %99s", in_name) == 1)
-			{
-				dr_test_set_current_domain_by_name(test, in_name);
-			}
-			else if (sscanf(buf, "D %c", &in_c) == 1)
-			{
-				dr_test_help('D');
-			}
-			else
-			{
-				dapi_utils_print_domain_handler_info(dapi_get_domain_handler(test->dapi));
-			}
-			break;
-		}
-#endif
-	case 'd':
+	// Slots
+	DR_TEST_PRINT("Enter 1-based tx channel index to add to slots (or simply 'enter' to have an empty slot):\n");
+	for (i = 0; i < num_slots; i++)
+	{
+		unsigned int id;
+		DR_TEST_PRINT("slot %d (of %d): ", i, num_slots);
+		fgets(g_input_buf, BUFSIZ, stdin);
+		if (sscanf(g_input_buf, "%u", &id) == 1)
 		{
-			if (sscanf(buf, "d t %u %u", &in_latency, &in_fpp) == 2)
-			{
-				dr_test_set_performance(test, DR_TEST_PERFORMANCE_TX, (dante_latency_us_t) in_latency, (dante_fpp_t) in_fpp);
-			}
-			else if (sscanf(buf, "d r %u %u", &in_latency, &in_fpp) == 2)
-			{
-				dr_test_set_performance(test, DR_TEST_PERFORMANCE_RX, (dante_latency_us_t) in_latency, (dante_fpp_t) in_fpp);
-			}
-			else if (sscanf(buf, "d u %u %u", &in_latency, &in_fpp) == 2)
-			{
-				dr_test_set_performance(test, DR_TEST_PERFORMANCE_UNICAST, (dante_latency_us_t) in_latency, (dante_fpp_t) in_fpp);
-			}
-			else if (sscanf(buf, "d A 0x%x", &prefix) == 1)
-			{
-				dr_test_set_aes67_prefix(test, prefix);
-			}
-			else if (sscanf(buf, "d %s", in_action) == 1)
+			dr_txchannel_t * tx = dr_device_txchannel_with_id(test->device, (dante_id_t) id);
+			if (tx)
 			{
-				if (!strcmp(in_action, "p"))
-				{
-					dr_test_ping(test);
-				}
-				else if (!strcmp(in_action, "!"))
-				{
-					dr_test_mark_stale(test, DR_DEVICE_COMPONENT_PROPERTIES, 0);
-				}
-				else
+				result = dr_txflow_config_add_channel(config, tx, i);
+				if (result != AUD_SUCCESS)
 				{
-					dr_test_help('d');
+					DR_TEST_ERROR("Error setting txflow config slot: %s\n",
+						dr_error_message(result, g_test_errbuf));
+					dr_txflow_config_discard(config);
+					return;
 				}
 			}
-			else
-			{
-				dr_test_print_device_info(test->device);
-			}
-			break;
 		}
+	}
 
-	case 'e':
-		{
-			if (sscanf(buf, "e %u %s", &in_channel, in_action) == 2 && !strcmp(in_action, "+"))
-			{
-				dr_test_txchannel_set_enabled(test, in_channel, AUD_TRUE);
-			}
-			else if (sscanf(buf, "e %u %s", &in_channel, in_action) == 2 && !strcmp(in_action, "-"))
-			{
-				dr_test_txchannel_set_enabled(test, in_channel, AUD_FALSE);
-			}
-			else
-			{
-				dr_test_help('e');
-			}
-			break;
-		}
+	request = dr_test_allocate_request(test, "AddTxFlow");
+	if (!request)
+	{
+		return;
+	}
 
-	// transmit flows
-	case 'f':
+	result = dr_txflow_config_commit(config, dr_test_on_response, &request->id);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error sending txflow create request: %s\n",
+			dr_error_message(result, g_test_errbuf));
+		dr_test_request_release(test, request);
+		return;
+	}
+}
+
+static void
+dr_test_replace_txflow_channels
+(
+	dr_test_t * test,
+	dante_id_t id
+) {
+	uint16_t s, num_slots;
+	dr_txflow_t * flow = NULL;
+	dr_txflow_config_t * config = NULL;
+	aud_error_t result;
+	dr_test_request_t * request;
+
+	DR_TEST_DEBUG("ACTION: Replace Tx Flow Channels\n");
+
+	result = dr_device_txflow_with_id(test->device, id, &flow);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error getting txflow at index %d: %s\n",
+			id, dr_error_message(result, g_test_errbuf));
+		return;
+	}
+	result = dr_txflow_replace_channels(flow, &config);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error creating txflow modify config: %s\n",
+			dr_error_message(result, g_test_errbuf));
+		dr_txflow_release(&flow);
+		return;
+	}
+	dr_txflow_release(&flow);
+	num_slots = dr_txflow_config_num_slots(config);
+
+	DR_TEST_PRINT("Enter 1-based tx channel id to add to slots (or simply 'enter' to have an empty slot):\n");
+	for (s = 0; s < num_slots; s++)
+	{
+		unsigned int  channel_id;
+		DR_TEST_PRINT("Slot %d/%d: ", s, num_slots);
+		fgets(g_input_buf, BUFSIZ, stdin);
+		if (sscanf(g_input_buf, "%u", &channel_id) == 1)
 		{
-			if (sscanf(buf, "f + %u %u %u %u", &in_id, &in_count, &in_latency, &in_fpp) == 4)
-			{
-				dr_test_add_txflow(test, (dante_id_t) in_id, (uint16_t) in_count, (dante_latency_us_t) in_latency, (dante_fpp_t) in_fpp);
-			}
-			else if (sscanf(buf, "f + %u", &in_count) == 1)
-			{
-				dr_test_add_txflow(test, 0, (uint16_t) in_count, 0, 0);
-			}
-			else if (sscanf(buf, "f + A %u %u", &in_id, &in_count) == 2)
-			{
-				dr_test_add_aes67_txflow_multicast(test, (dante_id_t) in_id, (uint16_t) in_count);
-			}
-			else if (sscanf(buf, "f %c %u", &in_c, &in_id) == 2 && in_c == '-')
-			{
-				dr_test_delete_txflow(test, (dante_id_t) in_id);
-			}
-			else if (sscanf(buf, "f %u", &in_id) == 1)
-			{
-				dr_test_replace_txflow_channels(test, (dante_id_t) in_id);
-			}
-			else if (sscanf(buf, "f %s", in_action) == 1)
+			dr_txchannel_t * tx = dr_device_txchannel_with_id(test->device, (dante_id_t) channel_id);
+			if (tx)
 			{
-				if (!strcmp(in_action, "!"))
-				{
-					dr_test_mark_stale(test, DR_DEVICE_COMPONENT_TXFLOWS, 0);
-				}
-				else
+				result = dr_txflow_config_add_channel(config, tx, s);
+				if (result != AUD_SUCCESS)
 				{
-					dr_test_help('f');
+					DR_TEST_ERROR("Error setting txflow config slot: %s\n",
+						dr_error_message(result, g_test_errbuf));
+					dr_txflow_config_discard(config);
+					return;
 				}
 			}
-			else
-			{
-				dr_test_print_device_txflows(test->device);
-			}
-			break;
 		}
+	}
 
-	// receive flows
-	case 'g':
-		{
-			if (sscanf(buf, "g u %d %d", &in_id, &in_count) == 2)
-			{
-				dr_test_add_rxflow_unicast(test, (dante_id_t) in_id, (uint16_t) in_count);
-			}
-			else if (sscanf(buf, "g %c %d", &in_c, &in_id) == 2)
-			{
-				if (in_c == 'm')
-				{
-					dr_test_add_rxflow_multicast(test, in_id);
-				}
-				else if (in_c == '*')
-				{
-					dr_test_replace_rxflow_associations(test, (dante_id_t) in_id);
-				}
-				else if (in_c == '-')
-				{
-					dr_test_delete_rxflow(test, (dante_id_t) in_id);
-				}
-				else
-				{
-					dr_test_help('g');
-				}
-			}
-			else if (sscanf(buf, "g %s", in_action) == 1)
+	request = dr_test_allocate_request(test, "ReplaceTxFlowChannels");
+	if (!request)
+	{
+		return;
+	}
+
+	result = dr_txflow_config_commit(config, dr_test_on_response, &request->id);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error sending modify txflow request: %s\n",
+			dr_error_message(result, g_test_errbuf));
+		dr_test_request_release(test, request);
+		return;
+	}
+}
+
+static void
+dr_test_delete_txflow
+(
+	dr_test_t * test,
+	dante_id_t id
+) {
+	dr_txflow_t * flow = NULL;
+	aud_error_t result;
+	dr_test_request_t * request;
+
+	DR_TEST_DEBUG("ACTION: Delete Tx Flow\n");
+
+
+	result = dr_device_txflow_with_id(test->device, id, &flow);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error getting txflow %d: %s\n",
+			id, dr_error_message(result, g_test_errbuf));
+		return;
+	}
+
+	request = dr_test_allocate_request(test, "DeleteTxFlow");
+	if (!request)
+	{
+		return;
+	}
+	result = dr_txflow_delete(&flow, dr_test_on_response, &request->id);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error sending delete txflow request for flow %d: %s\n",
+			id, dr_error_message(result, g_test_errbuf));
+		dr_txflow_release(&flow);
+		dr_test_request_release(test, request);
+		return;
+	}
+}
+
+static void
+dr_test_add_aes67_txflow_multicast
+(
+	dr_test_t * test,
+	dante_id_t flow_id,
+	uint16_t num_slots
+) {
+	dante_name_t name;
+	uint16_t i;
+	dr_txflow_config_t * config = NULL;
+	aud_error_t result;
+	dr_test_request_t * request;
+
+	DR_TEST_DEBUG("ACTION: Add Tx Flow\n");
+
+	DR_TEST_PRINT("Enter flow name (or simply 'enter' to use default name): ");
+	fgets(g_input_buf, BUFSIZ, stdin);
+	if (sscanf(g_input_buf, "%s", name) < 1)
+	{
+		name[0] = '\0';
+	}
+
+	result = dr_txflow_config_new_aes67_multicast(test->device, flow_id, num_slots, &config);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error creating txflow config: %s\n", dr_error_message(result, g_test_errbuf));
+		return;
+	}
+
+	result = dr_txflow_config_set_name(config, name);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error setting txflow config name: %s\n", dr_error_message(result, g_test_errbuf));
+		dr_txflow_config_discard(config);
+		return;
+	}
+
+	// Slots
+	DR_TEST_PRINT("Enter 1-based tx channel index to add to slots (or simply 'enter' to have an empty slot):\n");
+	for (i = 0; i < num_slots; i++)
+	{
+		unsigned int id;
+		DR_TEST_PRINT("slot %d (of %d): ", i, num_slots);
+		fgets(g_input_buf, BUFSIZ, stdin);
+		if (sscanf(g_input_buf, "%u", &id) == 1)
+		{
+			dr_txchannel_t * tx = dr_device_txchannel_with_id(test->device, (dante_id_t) id);
+			if (tx)
 			{
-				if (!strcmp(in_action, "!"))
-				{
-					dr_test_mark_stale(test, DR_DEVICE_COMPONENT_RXFLOWS, 0);
-				}
-				else
+				result = dr_txflow_config_add_channel(config, tx, i);
+				if (result != AUD_SUCCESS)
 				{
-					dr_test_help('g');
+					DR_TEST_ERROR("Error setting txflow config slot: %s\n",
+						dr_error_message(result, g_test_errbuf));
+					dr_txflow_config_discard(config);
+					return;
 				}
 			}
-			else
-			{
-				dr_test_print_device_rxflows(test->device);
-			}
-			break;
 		}
+	}
 
-	case 'l':
+	request = dr_test_allocate_request(test, "AddTxFlow");
+	if (!request)
+	{
+		return;
+	}
+
+	result = dr_txflow_config_commit(config, dr_test_on_response, &request->id);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error sending txflow create request: %s\n",
+			dr_error_message(result, g_test_errbuf));
+		dr_test_request_release(test, request);
+		return;
+	}
+}
+
+static aud_bool_t
+dr_test_txflow_spec_is_single
+(
+	const dr_test_txflow_spec_t * spec
+) {
+	return spec->num_slots && (spec->latency_us || spec->fpp || spec->encoding);
+}
+
+// AUD_TRUE if 'spec' needs a flow config and replaces an existing flow,
+// which the config cannot do
+static aud_bool_t
+dr_test_txflow_spec_replaces
+(
+	dr_test_t * test,
+	const dr_test_txflow_spec_t * spec
+) {
+	dr_txflow_t * flow;
+
+	return dr_test_txflow_spec_is_single(spec) && spec->id
+		&& dr_device_txflow_with_id(test->device, (dante_id_t) spec->id, &flow) == AUD_SUCCESS;
+}
+
+// Starts a bulk operation creating, replacing or deleting 'n' tx flows.
+// Flows with the device's default latency, fpp and encoding, and deletions, go
+// into dr_device_batch_txflow batches; the others follow, one flow config
+// commit each. An existing flow replaced through a config is deleted first,
+// by leading batch entries that complete before anything else is sent.
+// Entries keep their relative order within each group.
+static aud_error_t
+dr_test_bulk_txflows
+(
+	dr_test_t * test,
+	const dr_test_txflow_spec_t * specs,
+	unsigned int n,
+	uint64_t * token
+) {
+	uint16_t num_tx = dr_device_num_txchannels(test->device);
+	unsigned int i, num_single = 0, num_replaced = 0, r = 0, b, s = 0;
+	dr_test_bulk_t * bulk;
+
+	for (i = 0; i < n; i++)
+	{
+		const dr_test_txflow_spec_t * spec = specs + i;
+		int slot;
+
+		if (spec->id < 0 || spec->id > 0xFFFF
+			|| spec->num_slots < 0 || spec->num_slots > DR_BATCH_TX_FLOW_MAX_SLOTS
+			|| (!spec->num_slots && !spec->id))
 		{
-			if (sscanf(buf, "l %u \"%[^\"\r\n]%c %s", &in_channel, in_name, &in_c, in_action) == 4 && in_c == '\"')
-			{
-				if (!strcmp(in_action, "+"))
-				{
-					dr_test_add_txlabel(test, in_channel, in_name);
-				}
-				else if (!strcmp(in_action, "-"))
-				{
-					dr_test_remove_txlabel_from_channel(test, (dante_id_t) in_channel, in_name);
-				}
-				else
-				{
-					dr_test_help('l');
-				}
-			}
-			else if (sscanf(buf, "l %u %s", &in_channel, in_name) == 2)
-			{
-				if (!strcmp(in_name, "!"))
-				{
-					dr_test_mark_stale(test, DR_DEVICE_COMPONENT_TXLABELS, (dante_id_t)in_channel);
-				}
-				else
-				{
-					dr_test_help('l');
-				}
-			}
-			else if (sscanf(buf, "l %u", &in_channel) == 1)
-			{
-				dr_test_print_channel_txlabels(test->device, (dante_id_t) in_channel, 0, array, count);
-			}
-			else if (sscanf(buf, "l %s", in_name) == 1)
-			{
-				if (!strcmp(in_name, "!"))
-				{
-					dr_test_mark_stale(test, DR_DEVICE_COMPONENT_TXLABELS, 0);
-				}
-				else
-				{
-					dr_test_help('l');
-				}
-			}
-			else
+			DR_TEST_ERROR("Invalid tx flow %d with %d slots\n", spec->id, spec->num_slots);
+			return AUD_ERR_INVALIDPARAMETER;
+		}
+		for (slot = 0; slot < spec->num_slots; slot++)
+		{
+			if (spec->channels[slot] < 0 || spec->channels[slot] > num_tx)
 			{
-				dr_test_print_channel_txlabels(test->device, 0, 0, array, count);
+				DR_TEST_ERROR("Invalid tx channel %d in slot %d of tx flow %d\n",
+					spec->channels[slot], slot, spec->id);
+				return AUD_ERR_INVALIDPARAMETER;
 			}
-			break;
 		}
+		if (dr_test_txflow_spec_is_single(spec))
+		{
+			num_single++;
+			num_replaced += dr_test_txflow_spec_replaces(test, spec) ? 1 : 0;
+		}
+	}
 
-	case 'L':
+	bulk = (dr_test_bulk_t *) calloc(1, sizeof(dr_test_bulk_t));
+	if (!bulk)
+	{
+		return AUD_ERR_NOMEMORY;
+	}
+	bulk->kind = DR_TEST_BULK_TXFLOWS;
+	bulk->num_entries = n + num_replaced;
+	bulk->num_single = num_single;
+	bulk->num_leading = num_replaced;
+	bulk->_.txflows.batched = (dr_batch_txflow_t *) calloc(n + num_replaced - num_single + 1, sizeof(dr_batch_txflow_t));
+	bulk->_.txflows.single = (dr_test_txflow_spec_t *) malloc((num_single + 1) * sizeof(dr_test_txflow_spec_t));
+	if (!bulk->_.txflows.batched || !bulk->_.txflows.single)
+	{
+		dr_test_bulk_free(bulk);
+		return AUD_ERR_NOMEMORY;
+	}
+	for (i = 0, b = num_replaced; i < n; i++)
+	{
+		const dr_test_txflow_spec_t * spec = specs + i;
+
+		if (dr_test_txflow_spec_is_single(spec))
 		{
-			match_count = sscanf(buf, "L %u %s", &in_id, in_action);
-			if (match_count == 2)
-			{
-				if (!strcmp(in_action, "-"))
-				{
-					dr_test_remove_txlabel(test, (dante_id_t) in_id);
-				}
-				else
-				{
-					dr_test_help('L');
-				}
-			}
-			else if (match_count == 1)
+			if (dr_test_txflow_spec_replaces(test, spec))
 			{
-				dr_test_print_device_txlabels(test->device, (dante_id_t) in_id, AUD_FALSE);
+				// zeroed slots delete the flow
+				bulk->_.txflows.batched[r++].txflow_id = (dante_id_t) spec->id;
 			}
-			else
+			bulk->_.txflows.single[s++] = *spec;
+		}
+		else
+		{
+			dr_batch_txflow_t * flow = bulk->_.txflows.batched + b++;
+			int slot;
+
+			flow->txflow_id = (dante_id_t) spec->id;
+			flow->num_slots = (uint16_t) spec->num_slots;
+			for (slot = 0; slot < spec->num_slots; slot++)
 			{
-				match_count = sscanf(buf, "L %s", in_action);
-				if (match_count == 1)
-				{
-					if (!strcmp(in_action, "!"))
-					{
-						dr_test_mark_stale(test, DR_DEVICE_COMPONENT_TXLABELS, 0);
-					}
-					else
-					{
-						dr_test_help('L');
-					}
-				}
-				else
-				{
-					dr_test_print_device_txlabels(test->device, 0, AUD_TRUE);
-				}
+				flow->channels[slot] = (dante_id_t) spec->channels[slot];
 			}
-			break;
 		}
+	}
 
-	case 'n':
-		{
-			if (sscanf(buf, "n %c %s", &in_c, in_name) == 2 && in_c == '+')
-			{
-				dr_test_rename(test, in_name, AUD_FALSE);
-			}
-			else if (sscanf(buf, "n %s", in_name) == 1)
-			{
-				aud_error_t result = AUD_ERR_INVALIDSTATE;
-				if (!strcmp(in_name, "-"))
-				{
-					result = dr_test_rename(test, NULL, AUD_TRUE);
-				}
-				else if (!strcmp(in_name, "?"))
-				{
-					dr_test_help('n');
-				}
-				else
-				{
-					result = dr_test_rename(test, in_name, AUD_TRUE);
-				}
-				if (result == AUD_SUCCESS)
-				{
-					return AUD_ERR_DONE;
-				}
-			}
-			else
-			{
-				dr_test_print_device_names(test->device);
-			}
-			break;
-		}
+	DR_TEST_PRINT("Provisioning %u TX flows, %u of them with their own format, %u replacing a flow\n",
+		n, num_single, num_replaced);
+	*token = dr_test_bulk_start(test, bulk);
+	return AUD_SUCCESS;
+}
 
-	case 'O':
+//----------------------------------------------------------
+// Rx Flows 
+//----------------------------------------------------------
+
+static void 
+dr_test_read_multicast_associations
+(
+	dr_test_t * test,
+	dr_rxflow_config_t * config
+) {
+	aud_error_t result;
+	unsigned int i, n = dr_device_max_rxflow_slots(test->device);
+
+	DR_TEST_PRINT("Multicast template flow associations are configured by choosing transmit channels and\n");
+	DR_TEST_PRINT("Selecting one or more receive channels to be subscribed to each of those channels.\n");
+	DR_TEST_PRINT("A maximum of of %d subscriptions are allowed for this device.\n", n);
+
+	for (i = 0; i < n; i++)
+	{
+		dante_name_t subscribed_channel;
+		unsigned int rxchannel_id;
+		DR_TEST_PRINT("  Enter transmit channel name, slot %u of %u (ENTER to finish):",
+			(i+1), n);
+		fgets(g_input_buf, BUFSIZ, stdin);
+
+		subscribed_channel[0] = '\0';
+		sscanf(g_input_buf, "%[^\r\n]", subscribed_channel);
+		if (subscribed_channel[0] == '\0')
 		{
-			unsigned int a, b, c, d;
-			dante_ipv4_addr_t addr = {0};
-			if (sscanf(buf, "O \"%[^\"\r\n]%c", in_name, &in_c) == 2 && in_c == '\"')
-			{
-				SNPRINTF(test->options.device_name, sizeof(test->options.device_name), "%s", in_name);
-				test->options.domain_device_addr = 0;
-				test->options.num_addresses = 0;
-				dr_test_open(test);
-			}
-			else if (sscanf(buf, "O 0x%u", &in_id) == 1)
-			{
-				test->options.device_name[0] = '\0';
-				test->options.domain_device_addr = in_id;
-				test->options.num_addresses = 0;
-				dr_test_open(test);
-			}
-			else if (sscanf(buf, "O %u.%u.%u.%u", &a,&b,&c,&d) == 4)
-			{
-				addr.addr8[0] = (uint8_t) a;
-				addr.addr8[1] = (uint8_t) b;
-				addr.addr8[2] = (uint8_t) c;
-				addr.addr8[3] = (uint8_t) d;
-				test->options.device_name[0] = '\0';
-				test->options.domain_device_addr = 0;
-				test->options.num_addresses = addr.addr32;
-				dr_test_open(test);
-			}
-			else if (sscanf(buf, "O %c", &in_c) == 1)
-			{
-				dr_test_help('O');
-			}
-			else
-			{
-				test->options.device_name[0] = '\0';
-				test->options.domain_device_addr = 0;
-				test->options.num_addresses = 0;
-				dr_test_open(test);
-			}
 			break;
 		}
 
-	case 'o':
+		// parse ids
+		do 
 		{
-			if (sscanf(buf, "o %s", in_action) == 1 && !strcmp(in_action, "+"))
+			dr_rxchannel_t * rxc = NULL;
+			DR_TEST_PRINT("    Receive channel id (ENTER to finish): ");
+			fgets(g_input_buf, BUFSIZ, stdin);
+			if (sscanf(g_input_buf, "%u", &rxchannel_id) != 1)
 			{
-				dr_test_set_network_loopback(test, AUD_TRUE);
+				break;
 			}
-			else if (sscanf(buf, "o %s", in_action) == 1 && !strcmp(in_action, "-"))
+			if (rxchannel_id == 0 || rxchannel_id > test->nrx)
 			{
-				dr_test_set_network_loopback(test, AUD_FALSE);
+				DR_TEST_PRINT("Invalid rx channel id %u\n", rxchannel_id);
+				continue;
 			}
-			else
+			rxc = test->rx[rxchannel_id-1];
+			result = dr_rxflow_config_add_associated_channel(config, rxc, subscribed_channel);
+			if (result != AUD_SUCCESS)
 			{
-				dr_test_help('o');
+				DR_TEST_PRINT("Error adding template association channel %d subscribed to %s@%s: %s\n",
+					rxchannel_id, subscribed_channel, dr_rxflow_config_get_tx_device_name(config),
+					dr_error_message(result, g_test_errbuf));
+				continue;
 			}
-			break;
-		}
+		} while (rxchannel_id);
+	}
+}
 
-	case 'q':
+static void 
+dr_test_add_rxflow_multicast
+(
+	dr_test_t * test,
+	unsigned int flow_id
+) {
+	dante_name_t tx_device_name;
+	dante_name_t tx_flow_name;
+	aud_error_t result;
+	dr_test_request_t * request;
+	dr_rxflow_config_t * config = NULL;
+
+	DR_TEST_DEBUG("ACTION: Add Multicast Rx Flow Template\n");
+
+	DR_TEST_PRINT("Enter the multicast transmit flow and device name in the form \"flow@device\": ");
+	fgets(g_input_buf, BUFSIZ, stdin);
+	if (sscanf(g_input_buf, "\"%[^@]@%[^\r\n\"]\"", tx_flow_name, tx_device_name) != 2)
+	{
+		printf("Invalid flow name.");
+		return;
+	}
+
+	result = dr_rxflow_config_new_multicast(test->device,
+		(dante_id_t) flow_id, tx_device_name, tx_flow_name,
+		&config);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error creating multicast config object: %s\n", dr_error_message(result, g_test_errbuf));
+		return;
+	}
+
+	dr_test_read_multicast_associations(test, config);
+
+	request = dr_test_allocate_request(test, "AddMulticastRxFlowTemplate");
+	if (!request)
+	{
+		return;
+	}
+	result = dr_rxflow_config_commit(config, dr_test_on_response, &request->id);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error sending multicast template create request: %s\n", dr_error_message(result, g_test_errbuf));
+		dr_test_request_release(test, request);
+		return;
+	}
+}
+
+
+static void
+dr_test_read_unicast_associations
+(
+	dr_test_t * test,
+	dr_rxflow_config_t * config
+) {
+	aud_error_t result;
+	uint16_t i, num_slots = dr_rxflow_config_num_slots(config);
+
+	DR_TEST_PRINT("Unicast template flow associations are configured by choosing a receive channel and\n");
+	DR_TEST_PRINT("setting the transmit channel to which it will subscribe.\n");
+	DR_TEST_PRINT("A maximum of of %d subscriptions are allowed for this device.\n", num_slots);
+	
+	for (i = 0; i < num_slots;)
+	{
+		dante_name_t subscribed_channel;
+		unsigned int rxchannel_id;
+		dr_rxchannel_t * rxc = NULL;
+		
+		DR_TEST_PRINT("Next receive channel id (hit ENTER to finish):");
+		fgets(g_input_buf, BUFSIZ, stdin);
+		if (sscanf(g_input_buf, "%u", &rxchannel_id) != 1)
 		{
-			printf("\n");
-			g_test_running = AUD_FALSE;
 			break;
 		}
-
-	case 'R':
+		if (rxchannel_id == 0 || rxchannel_id > test->nrx)
 		{
-			if (sscanf(buf, "R %s", in_name) == 1)
-			{
-				dr_test_batch_rxchannel_set_name(test, in_name);
-			}
-			else
-			{
-				dr_test_help('R');
-			}
-			break;
+			DR_TEST_PRINT("Invalid rx channel id %u\n", rxchannel_id);
+			continue;
 		}
+		rxc = test->rx[rxchannel_id-1];
 
-	case 'r':
+		DR_TEST_PRINT("Transmit channel for rxchannel %u:", rxchannel_id);
+		fgets(g_input_buf, BUFSIZ, stdin);
+		sscanf(g_input_buf, "%[^\"\r\n]", subscribed_channel);
+		if (subscribed_channel[0] == '\0')
 		{
-			if (sscanf(buf, "r %u m %c", &in_channel, &in_c) == 2 && in_c == '+')
-			{
-				dr_test_rxchannel_set_muted(test, in_channel, AUD_TRUE);
-			}
-			else if (sscanf(buf, "r %u m %c", &in_channel, &in_c) == 2 && in_c == '-')
-			{
-				dr_test_rxchannel_set_muted(test, in_channel, AUD_FALSE);
-			}
-			else if (sscanf(buf, "r %u \"%[^\"\r\n]%c", &in_channel, in_name, &in_c) == 3 && in_c == '\"')
-			{
-				dr_test_rxchannel_set_name(test, in_channel, in_name);
-			}
-			else if (sscanf(buf, "r %u !", &in_channel) == 1)
-			{
-				dr_test_mark_stale(test, DR_DEVICE_COMPONENT_RXCHANNELS, (dante_id_t) in_channel);
-			}
-			else if (sscanf(buf, "r %s", in_action) == 1)
-			{
-				if (!strcmp(in_action, "!"))
-				{
-					dr_test_mark_stale(test, DR_DEVICE_COMPONENT_RXCHANNELS, 0);
-				}
-				else
-				{
-					dr_test_help('r');
-				}
-			}
-			else
-			{
-				dr_test_print_device_rxchannels(test->device, array, count);
-			}
-			break;
+			DR_TEST_PRINT("Invalid transmit channel name\n");
+			continue;
 		}
 
-	case 'S':
+		result = dr_rxflow_config_add_associated_channel(config, rxc, subscribed_channel);
+		if (result != AUD_SUCCESS)
 		{
-			if (sscanf(buf, "S %s", in_name) == 1)
+			DR_TEST_PRINT("Error adding template association channel %d subscribed to %s@%s: %s\n",
+				rxchannel_id, subscribed_channel, dr_rxflow_config_get_tx_device_name(config),
+				dr_error_message(result, g_test_errbuf));
+			continue;
+		}
+
+		// all good, add to counter...
+		i++;
+	}
+}
+
+static void 
+dr_test_add_rxflow_unicast
+(
+	dr_test_t * test,
+	dante_id_t flow_id,
+	uint16_t num_slots
+) {
+	char tx_device_name[BUFSIZ];
+	aud_error_t result;
+	dr_test_request_t * request;
+	dr_rxflow_config_t * config = NULL;
+
+	DR_TEST_DEBUG("ACTION: Add Unicast Rx Flow Template\n");
+
+	DR_TEST_PRINT("Enter the transmit device name for the unicast template:");
+	fgets(g_input_buf, BUFSIZ, stdin);
+	if (sscanf(g_input_buf, "%[^\"\r\n]", tx_device_name) != 1)
+	{
+		printf("Invalid device name.");
+		return;
+	}
+
+	result = dr_rxflow_config_new_unicast(test->device,
+		(dante_id_t) flow_id, tx_device_name, num_slots,
+		&config);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error creating unicast config object: %s\n", dr_error_message(result, g_test_errbuf));
+		return;
+	}
+
+	dr_test_read_unicast_associations(test, config);
+
+	request = dr_test_allocate_request(test, "AddUnicastRxFlowTemplate");
+	if (!request)
+	{
+		return;
+	}
+
+	result = dr_rxflow_config_commit(config, dr_test_on_response, &request->id);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error sending multicast template create request: %s\n", dr_error_message(result, g_test_errbuf));
+		dr_test_request_release(test, request);
+		return;
+	}
+}
+
+static void 
+dr_test_replace_rxflow_associations
+(
+	dr_test_t * test,
+	dante_id_t flow_id
+) {
+	dr_rxflow_t * flow = NULL;
+	dr_rxflow_config_t * config = NULL;
+	aud_error_t result;
+	dr_test_request_t * request;
+
+	DR_TEST_DEBUG("ACTION: Replace Rx Flow Associations\n");
+	
+	result = dr_device_rxflow_with_id(test->device, flow_id, &flow);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error getting flow with id %d: %s\n",
+			flow_id, dr_error_message(result, g_test_errbuf));
+		return;
+	}
+
+	result = dr_rxflow_replace_associations(flow, &config);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error getting config for flow with id %d: %s\n",
+			flow_id, dr_error_message(result, g_test_errbuf));
+		return;
+	}
+
+	if (dr_rxflow_config_is_multicast_template(config))
+	{
+		dr_test_read_multicast_associations(test, config);
+	}
+	else if (dr_rxflow_config_is_unicast_template(config))
+	{
+		dr_test_read_unicast_associations(test, config);
+	}
+
+	request = dr_test_allocate_request(test, "ReplaceRxFlowAssociations");
+	if (!request)
+	{
+		return;
+	}
+
+	result = dr_rxflow_config_commit(config, dr_test_on_response, &request->id);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error sending update template associations request: %s\n", dr_error_message(result, g_test_errbuf));
+		dr_test_request_release(test, request);
+		return;
+	}
+}
+
+static void
+dr_test_delete_rxflow
+(
+	dr_test_t * test,
+	dante_id_t flow_id
+) {
+	aud_error_t result;
+	dr_test_request_t * request;
+	dr_rxflow_t * flow;
+
+	DR_TEST_DEBUG("ACTION: Delete Rx Flow\n");
+
+	result = dr_device_rxflow_with_id(test->device, flow_id, &flow);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error getting flow with id %d: %s\n",
+			flow_id, dr_error_message(result, g_test_errbuf));
+		return;
+	}
+
+	request = dr_test_allocate_request(test, "DeleteRxFlow");
+	if (!request)
+	{
+		return;
+	}
+
+	result = dr_rxflow_delete(&flow, dr_test_on_response, &request->id);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error sending flow delete request: %s\n", dr_error_message(result, g_test_errbuf));
+		dr_test_request_release(test, request);
+		return;
+	}
+}
+
+/*
+static void 
+dr_test_set_one_rxflow_interface_mode
+(
+	dr_test_t * test,
+	dr_rxflow_error_field_t field,
+	dante_id_t flow_id,
+	unsigned int intf,
+	unsigned int window_interval_us
+) {
+	aud_error_t result;
+	dr_test_request_t * request;
+
+	DR_TEST_DEBUG("ACTION: Set One RxFlow Interface Mode\n");
+
+	request = dr_test_allocate_request(test, "SetOneRxFlowInterfaceMode");
+	if (!request)
+	{
+		return;
+	}
+
+	result = dr_device_set_one_flow_interface_mode(test->device, dr_test_on_response, &request->id, field, flow_id, intf, window_interval_us);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error sending set one rxflow interface mode request: %s\n", dr_error_message(result, g_test_errbuf));
+		dr_test_request_release(test, request);
+		return;
+	}
+}
+*/
+
+//----------------------------------------------------------
+// Asynchronous event handlers
+//----------------------------------------------------------
+
+static void
+dr_test_update_channel_generations
+(
+	dr_test_t * test,
+	dr_device_change_flags_t change_flags
+) {
+	static const dr_device_change_flags_t k_rx_flags =
+		DR_DEVICE_CHANGE_FLAG_RXCHANNELS | DR_DEVICE_CHANGE_FLAG_RXFLOWS |
+		DR_DEVICE_CHANGE_FLAG_STALE | DR_DEVICE_CHANGE_FLAG_STATE;
+	static const dr_device_change_flags_t k_tx_flags =
+		DR_DEVICE_CHANGE_FLAG_TXCHANNELS |
+		DR_DEVICE_CHANGE_FLAG_STALE | DR_DEVICE_CHANGE_FLAG_STATE;
+	uint32_t next = test->generation + 1;
+	aud_bool_t changed = AUD_FALSE;
+
+	if (!test->device)
+	{
+		return;
+	}
+	if (change_flags & k_rx_flags)
+	{
+		changed |= dr_test_track_rxchannels(&test->rx_changes, test->device, next);
+	}
+	if (change_flags & k_tx_flags)
+	{
+		changed |= dr_test_track_txchannels(&test->tx_changes, test->device, next);
+	}
+	if (change_flags & DR_DEVICE_CHANGE_FLAG_STATE)
+	{
+		// a state transition concerns every channel even if no field differs
+		dr_test_channel_changes_touch(&test->rx_changes, next);
+		dr_test_channel_changes_touch(&test->tx_changes, next);
+		changed = AUD_TRUE;
+	}
+	if (changed)
+	{
+		test->generation = next;
+	}
+}
+
+// Re-indexes the tx channel names and labels of a session device. Components
+// that are stale contribute nothing until their update arrives.
+static void
+dr_test_index_names
+(
+	dr_test_t * test
+) {
+	dr_test_name_index_t * index = &test->session->names;
+	const char * device_name;
+	aud_error_t result = AUD_SUCCESS;
+	uint16_t i, n;
+
+	dr_test_name_index_remove(index, &test->indexed_names);
+	if (!test->device || dr_device_get_state(test->device) != DR_DEVICE_STATE_ACTIVE)
+	{
+		return;
+	}
+	device_name = dr_device_get_name(test->device);
+	if (!dr_device_is_component_stale(test->device, DR_DEVICE_COMPONENT_TXCHANNELS))
+	{
+		n = dr_device_num_txchannels(test->device);
+		for (i = 0; i < n && result == AUD_SUCCESS; i++)
+		{
+			dr_txchannel_t * tx = dr_device_txchannel_at_index(test->device, i);
+			result = dr_test_name_index_add(index, &test->indexed_names, test, device_name,
+				dr_txchannel_get_canonical_name(tx), dr_txchannel_get_id(tx), AUD_FALSE);
+		}
+	}
+	if (result == AUD_SUCCESS && !dr_device_is_component_stale(test->device, DR_DEVICE_COMPONENT_TXLABELS))
+	{
+		result = dr_test_read_txlabels(test, &n);
+		for (i = 0; i < n && result == AUD_SUCCESS; i++)
+		{
+			const dr_txlabel_t * label = test->txlabels_buf + i;
+			result = dr_test_name_index_add(index, &test->indexed_names, test, device_name,
+				label->name, dr_txchannel_get_id(label->tx), AUD_TRUE);
+		}
+	}
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error indexing channel names of %s: %s\n", device_name, dr_error_message(result, g_test_errbuf));
+	}
+}
+
+static void 
+dr_test_on_device_changed
+(
+	dr_device_t * device,
+	dr_device_change_flags_t change_flags
+) {
+	dr_test_t * test = (dr_test_t *) dr_device_get_context(device);
+	dr_device_change_index_t i;
+
+	(void) device;
+
+	DR_TEST_DEBUG("\nEVENT: device changed:");
+	for (i = 0; i < DR_DEVICE_CHANGE_INDEX_COUNT; i++)
+	{
+		if (change_flags & (1 << i))
+		{
+			DR_TEST_DEBUG(" %s", dr_device_change_index_to_string(i));
+			if (i == DR_DEVICE_CHANGE_INDEX_STATE)
 			{
-				dr_test_batch_rxchannel_subscribe(test, in_name);
+				dr_device_state_t state = dr_device_get_state(device);
+				DR_TEST_DEBUG(" (%s)", dr_device_state_to_string(state));
 			}
-			else
+			else if (i == DR_DEVICE_CHANGE_INDEX_STALE)
 			{
-				dr_test_help('S');
+				unsigned int c;
+				DR_TEST_DEBUG("=");
+				for (c = 0; c < DR_DEVICE_COMPONENT_COUNT; c++)
+				{
+					if (dr_device_is_component_stale(test->device, c))
+					{
+						DR_TEST_DEBUG(" %s", dr_device_component_to_string(c));
+					}
+				}
 			}
-			break;
 		}
-	case 's':
+	}
+	DR_TEST_DEBUG("\n");
+
+	if (change_flags & DR_DEVICE_CHANGE_FLAG_STATE)
+	{
+		dr_test_on_device_state_changed(test);
+	}
+
+	if (change_flags & DR_DEVICE_CHANGE_FLAG_ADDRESSES)
+	{
+		dr_test_on_device_addresses_changed(test);
+	}
+
+	dr_test_update_channel_generations(test, change_flags);
+
+	if (test->session && (change_flags & (DR_DEVICE_CHANGE_FLAG_TXCHANNELS | DR_DEVICE_CHANGE_FLAG_TXLABELS |
+		DR_DEVICE_CHANGE_FLAG_NAME | DR_DEVICE_CHANGE_FLAG_STATE | DR_DEVICE_CHANGE_FLAG_STALE)))
+	{
+		dr_test_index_names(test);
+	}
+
+	printf("Active Requests: %d/%d\n", 
+		dr_devices_num_requests_pending(test->devices),
+		dr_devices_get_request_limit(test->devices));
+
+	dr_test_push_device_event(test, device, change_flags);
+}
+
+//----------------------------------------------------------
+// Application-level functionality
+//----------------------------------------------------------
+
+static void
+dr_test_help(char filter)
+{
+	DR_TEST_PRINT("Usage:\n\n");
+	if (!filter)
+	{
+		DR_TEST_PRINT("?            prints a help message\n");
+		DR_TEST_PRINT("q            Quit\n");
+		DR_TEST_PRINT("\n");
+	}
+	if (!filter || filter == 'b')
+	{
+		DR_TEST_PRINT("b N B        Set tx signal reference level for channel N to B dbu\n");
+		DR_TEST_PRINT("b N -        Clear tx signal reference level for channel N\n");
+		DR_TEST_PRINT("b 0 B        Set tx signal reference level for all channels to B dbu\n");
+		DR_TEST_PRINT("b 0 -        Clear tx signal reference level for all channels N\n");
+		DR_TEST_PRINT("\n");
+	}
+	if (!filter || filter == 'C')
+	{
+		DR_TEST_PRINT("C close current connection\n");
+	}
+	if (!filter || filter == 'c')
+	{
+		DR_TEST_PRINT("c +          Write the current device configuration\n");
+		DR_TEST_PRINT("c -          Clear the current device configuration\n");
+		DR_TEST_PRINT("\n");
+	}
+	if (!filter || filter == 'D')
+	{
+		DR_TEST_PRINT("D .          Switch to the ADHOC domain\n");
+		DR_TEST_PRINT("D N          Switch to domain N\n");
+		DR_TEST_PRINT("D 0          Switch to domain NONE\n");
+		DR_TEST_PRINT("D            List domains\n");
+	}
+	if (!filter || filter == 'd')
+	{
+		DR_TEST_PRINT("d t L F      Set device tx multicast performance properties to L microseconds and F frames per packet\n");
+		DR_TEST_PRINT("d r L F      Set device rx multicast performance properties to L microseconds and F frames per packet\n");
+		DR_TEST_PRINT("d u L F      Set device unicast performance properties to L microseconds and F frames per packet\n");
+		DR_TEST_PRINT("d A P        Set AES67 Multicast Prefix (e.g. d A 0xef450000, must start with 239.x.x.x)\n");
+		DR_TEST_PRINT("d p          'Ping' the device (sends a no-op routing message and waits for a response)\n");
+		DR_TEST_PRINT("d !          Mark properties component as stale\n");
+		DR_TEST_PRINT("d            Display device information (properties,capabilities,status)\n");
+		DR_TEST_PRINT("\n");
+	}
+	if (!filter || filter == 'e')
+	{
+		DR_TEST_PRINT("e N +        Enable tx channel N\n");
+		DR_TEST_PRINT("e N -        Disable tx channel N\n");
+		DR_TEST_PRINT("\n");
+	}
+	if (!filter || filter == 'f')
+	{
+		DR_TEST_PRINT("f + N S L F  Create new transmit flow with id N, S slots, latency L microseconds and F frames per packet\n");
+		DR_TEST_PRINT("f + S        Create new transmit flow with S slots\n");
+		DR_TEST_PRINT("f + A N S    Create new AES67 transmit flow with id N, S slots\n");
+		DR_TEST_PRINT("f N          Modify transmit flow N\n");
+		DR_TEST_PRINT("f - N        Delete transmit flow N\n");
+		DR_TEST_PRINT("f !          Mark transmit flow component as being stale\n");
+		DR_TEST_PRINT("f            Display all transmit flows\n");
+		DR_TEST_PRINT("\n");
+	}
+	if (!filter || filter == 'g')
+	{
+		DR_TEST_PRINT("g m N        Create a new multicast receive template on flow id N\n");
+		DR_TEST_PRINT("g u N S      Create a new unicast receive template on flow id N with S slots\n");
+		DR_TEST_PRINT("g * N        Replace channel associations for template with flow id N\n");
+		DR_TEST_PRINT("g - N        Delete template with flow id N\n");
+		DR_TEST_PRINT("g !          Mark receive flow component as being stale\n");
+		DR_TEST_PRINT("g            Display all receive flows\n");
+		DR_TEST_PRINT("\n");
+	}
+	if (!filter || filter == 'l')
+	{
+		DR_TEST_PRINT("l N \"NAME\" + Add label NAME to tx channel N\n");
+		DR_TEST_PRINT("l N \"NAME\" - Remove label NAME from tx channel N\n");
+		DR_TEST_PRINT("l N          List labels for tx channel N\n");
+		DR_TEST_PRINT("l !          Mark tx labels component as stale\n");
+		DR_TEST_PRINT("l            List labels for all tx channels\n");
+		DR_TEST_PRINT("\n");
+	}
+	if (!filter || filter == 'L')
+	{
+		DR_TEST_PRINT("L N -        Remove label N\n");
+		DR_TEST_PRINT("L N          Display label N\n");
+		DR_TEST_PRINT("L !          Mark tx labels component as stale\n");
+		DR_TEST_PRINT("L            List all labels\n");
+		DR_TEST_PRINT("\n");
+	}
+	if (!filter || filter == 'n')
+	{
+		DR_TEST_PRINT("n NAME       Rename the device to NAME (closes the device handle)\n");
+		DR_TEST_PRINT("n + NAME     Rename the device to NAME (does not close the device handle)\n");
+		DR_TEST_PRINT("n -          Rename the device to its default name (closes the device handle)\n");
+		DR_TEST_PRINT("n            Print the device's name\n");
+		DR_TEST_PRINT("\n");
+	}
+	if (!filter || filter == 'O')
+	{
+		DR_TEST_PRINT("O \"NAME\"     Open connection to device NAME\n");
+		DR_TEST_PRINT("O 0xXXXXXXXX Open connection to device with the given domain routing ID\n");
+		DR_TEST_PRINT("O A.B.C.D    Open connection to device at the given IP address\n");
+		DR_TEST_PRINT("O            Open connection to the local device\n");
+	}
+	if (!filter || filter == 'o')
+	{
+		DR_TEST_PRINT("o +          Enable network loopback\n");
+		DR_TEST_PRINT("o -          Disable network loopback\n");
+		DR_TEST_PRINT("\n");
+	}
+	if (!filter || filter == 'R')
+	{
+		DR_TEST_PRINT("R FILE       Batch rename N rx channels from file FILE, where each line of the file is \"N NAME\" or just \"N\"\n");
+		DR_TEST_PRINT("\n");
+	}
+	if (!filter || filter == 'r')
+	{
+		DR_TEST_PRINT("r !          Mark rx channel component as stale\n");
+		DR_TEST_PRINT("r N m +      Mute rx channel N\n");
+		DR_TEST_PRINT("r N m -      Unute rx channel N\n");
+		DR_TEST_PRINT("r N \"NAME\"   Renamed rx channel N\n");
+		DR_TEST_PRINT("r            Display rx channel information\n");
+		DR_TEST_PRINT("\n");
+	}
+	if (!filter || filter == 'S')
+	{
+		DR_TEST_PRINT("S FILE       Batch subscribe N rx channels from file FILE, where each line of the file is \"N NAME\" or just \"N\"\n");
+		DR_TEST_PRINT("\n");
+	}
+	if (!filter || filter == 's')
+	{
+		DR_TEST_PRINT("s N \"NAME\"   Subscribe rx channel N to network channel NAME\n");
+		DR_TEST_PRINT("s N          Unsubscribe rx channel N\n");
+		DR_TEST_PRINT("\n");
+	}
+	if (!filter || filter == 't')
+	{
+		DR_TEST_PRINT("t !          Mark tx channel component as stale\n");
+		DR_TEST_PRINT("t N m +      Mute tx channel N\n");
+		DR_TEST_PRINT("t N m -      Unute tx channel N\n");
+		DR_TEST_PRINT("t            Display tx channel information\n");
+		DR_TEST_PRINT("\n");
+	}
+	if (!filter || filter == 'u')
+	{
+		DR_TEST_PRINT("u q          Query (or re-query) capabilities\n");
+		DR_TEST_PRINT("u !          Invalidate and update all components\n");
+		DR_TEST_PRINT("u            Update information for all stale components\n");
+		DR_TEST_PRINT("\n");
+	}
+	if (!filter || filter == 'U')
+	{
+		DR_TEST_PRINT("U TYPE +     Get and clear rxflow error field TYPE for all flows\n");
+		DR_TEST_PRINT("U TYPE -     Get rxflow error field TYPE for all flows\n"); 
+		DR_TEST_PRINT("U +          Get and clear rxflow error flags for all flows\n");
+		DR_TEST_PRINT("U -          Get rxflow error flags for all flows\n");
+		DR_TEST_PRINT("U N          Print rxflow error information for rx flow N\n");
+		DR_TEST_PRINT("U            Print rxflow error information for all rx flows\n");
+		DR_TEST_PRINT("\n");
+	}
+	if (!filter || filter == 'x')
+	{
+		DR_TEST_PRINT("x +          Put the device into lockdown\n");
+		DR_TEST_PRINT("x -          Take the device out of lockdown\n");
+		DR_TEST_PRINT("\n");
+	}
+	if (!filter || filter == 'X')
+	{
+		DR_TEST_PRINT("X            Cancel outstanding requests\n");
+		DR_TEST_PRINT("\n");
+	}
+}
+
+static void
+dr_test_usage
+(
+	const char * bin
+) {
+	printf("Usage: %s OPTIONS [DEVICE]\n", bin);
+	printf("  OPTIONS are\n");
+	printf("    -h=N set num of handles to N\n");
+	printf("    -r=N set num of requests to N\n");
+	printf("    -ii=INDEX use local interface INDEX (specify once per interface to be used)\n");
+	printf("    -i=NAME use local interface NAME (specify once per interface to be used)\n");
+	printf("    -a=ADDRESS use address A instead of name (specify once per interface to be used)\n");
+	printf("    -u=BOOL enable/disable automatic query / updates on state changes\n");
+	printf("    -s=MASK components (bit per component) kept up to date, the others are fetched when queried\n");
+	printf("    -ttl=MS refresh subscribed components once their data is MS milliseconds old\n");
+	printf("    -p=PORT set port for local device connection (for debugging purposes only)\n");
+	printf("    -w=MS wait at most MS milliseconds for the device to be ready before running a command\n");
+	printf("    -wc=MASK components (bit per component) that must be up to date before running a command\n");
+#if DAPI_HAS_CONFIGURABLE_MDNS_SERVER_PORT == 1
+	printf("    -m=PORT_NO set MDNS server port number to PORT_NO\n");
+#endif
+#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__EMBEDDED
+#ifdef WIN32
+	printf("    -d=PORT_NO set domain handler port number to PORT_NO\n");
+#else
+	printf("    -d=PATH set domain handler socket path to PATH\n");
+#endif
+#endif
+
+#ifdef DANTE_ROUTING_TEST_CUSTOM_USAGE
+	DANTE_ROUTING_TEST_CUSTOM_USAGE();
+#endif
+
+#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
+	printf("    --domain[=<preferred domain>] browse on a domain\n");
+	printf("    --user=<user> browse on a domain with the specified username\n");
+	printf("    --pass=<password> browse on a domain with the specified password\n");
+	printf("    --ddm=<host>:<port> use the specified ddm rather than discovering (--domain must be specified)\n");
+#endif
+	printf("  If no name or addresses specified then connect to the local dante device via localhost\n");
+}
+
+static void
+dr_test_parse_options
+(
+	dr_test_options_t * options,
+	int argc, 
+	char * argv[]
+) {
+#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
+	aud_error_t result;
+#endif
+	int i;
+
+	// init defaults
+	options->automatic_update_on_state_change = AUD_TRUE;
+	options->ready_timeout_ms = DR_TEST_READY_TIMEOUT_MS;
+	options->ready_components = DR_TEST_ALL_COMPONENTS;
+	options->subscribed_components = DR_TEST_ALL_COMPONENTS;
+
+	// and parse options
+	for (i = 1; i < argc; i++)
+	{
+#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
+		if (dapi_utils_ddm_config_parse_one(&options->ddm_config, argv[i], &result))
+		{
+			if (result != AUD_SUCCESS)
+			{
+				dr_test_usage(argv[0]);
+				exit(1);
+			}
+		}
+		else
+#endif
+#ifdef DANTE_ROUTING_TEST_CUSTOM_PARSE_OPTIONS
+		if (DANTE_ROUTING_TEST_CUSTOM_PARSE_OPTIONS(test, argc, argv, &i))
+		{}
+		else
+#endif
+		if (!strncmp(argv[i], "-h=", 3))
+		{
+			options->num_handles = atoi(argv[i]+3);
+		}
+		else if (!strncmp(argv[i], "-r=", 3))
+		{
+			options->request_limit = atoi(argv[i]+3);
+		}
+		else if (!strncmp(argv[i], "-ii=", 4))
+		{
+			if (options->num_local_interfaces < DR_TEST_MAX_INTERFACES)
+			{
+				int local_interface_index = atoi(argv[i]+4);
+				if (local_interface_index)
+				{
+					options->local_interfaces[options->num_local_interfaces].index = local_interface_index;
+					options->local_interfaces[options->num_local_interfaces].flags = AUD_INTERFACE_IDENTIFIER_FLAG_INDEX;
+					options->num_local_interfaces++;
+				}
+				else
+				{
+					dr_test_usage(argv[0]);
+					exit(1);
+				}
+			}
+		}
+		else if (!strncmp(argv[i], "-i=", 3))
+		{
+			if (options->num_local_interfaces < DR_TEST_MAX_INTERFACES)
+			{
+				const char * intf_name = argv[i]+3;
+				if (intf_name[0])
+				{
+#ifdef WIN32
+					mbstowcs(
+						options->local_interfaces[options->num_local_interfaces].name,
+						intf_name,
+						AUD_INTERFACE_NAME_LENGTH
+					);
+#else
+					aud_strlcpy(
+						options->local_interfaces[options->num_local_interfaces].name,
+						intf_name,
+						AUD_INTERFACE_NAME_LENGTH
+					);
+#endif
+					options->local_interfaces[options->num_local_interfaces].flags = AUD_INTERFACE_IDENTIFIER_FLAG_NAME;
+					options->num_local_interfaces++;
+				}
+				else
+				{
+					dr_test_usage(argv[0]);
+					exit(1);
+				}
+			}
+		}
+		else if (!strncmp(argv[i], "-a=", 3))
+		{
+			if (options->num_addresses < DR_TEST_MAX_INTERFACES)
+			{
+				unsigned int addr = inet_addr(argv[i]+3);
+				options->addresses[options->num_addresses++] = addr;
+			}
+		}
+		else if (!strcmp(argv[i], "-u=true"))
+		{
+			options->automatic_update_on_state_change = AUD_TRUE;
+		}
+		else if (!strcmp(argv[i], "-u=false"))
+		{
+			options->automatic_update_on_state_change = AUD_FALSE;
+		}
+		else if (!strncmp(argv[i], "-p=", 3) && strlen(argv[i]) > 3)
+		{
+			options->local_port = (uint16_t) atoi(argv[i]+3);
+		}
+		else if (!strncmp(argv[i], "-s=", 3))
+		{
+			options->subscribed_components = (uint32_t) strtoul(argv[i] + 3, NULL, 0);
+		}
+		else if (!strncmp(argv[i], "-ttl=", 5))
+		{
+			uint32_t max_age_ms = (uint32_t) strtoul(argv[i] + 5, NULL, 0);
+			dr_device_component_t c;
+			for (c = 0; c < DR_DEVICE_COMPONENT_COUNT; c++)
+			{
+				options->max_age_ms[c] = max_age_ms;
+			}
+		}
+		else if (!strncmp(argv[i], "-w=", 3))
+		{
+			options->ready_timeout_ms = (unsigned int) strtoul(argv[i] + 3, NULL, 0);
+		}
+		else if (!strncmp(argv[i], "-wc=", 4))
+		{
+			options->ready_components = (uint32_t) strtoul(argv[i] + 4, NULL, 0);
+		}
+		else if (!strncmp(argv[i], "-target=", 8) && strlen(argv[i]) > 8)
+		{
+			options->domain_device_addr = strtoul(argv[i] + 8, NULL, 0);
+		}
+#if DAPI_HAS_CONFIGURABLE_MDNS_SERVER_PORT == 1
+		else if (!strncmp(argv[i], "-m=", 3))
+		{
+			options->mdns_server_port = (uint16_t) atoi(argv[i] + 3);
+		}
+#endif
+#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__EMBEDDED
+		else if (!strncmp(argv[i], "-d=", 3))
+		{
+#ifdef WIN32
+			options->domain_handler.port_no = (uint16_t)atoi(argv[i] + 3);
+#else
+			options->domain_handler.socket_path = argv[i] + 3;
+#endif
+		}
+#endif
+		else if (argv[i][0] == '-')
+		{
+			dr_test_usage(argv[0]);
+			exit(1);
+		}
+		else
+		{
+			SNPRINTF(options->device_name, sizeof(options->device_name), "%s", argv[i]);
+			break;
+		}
+	}
+}
+
+static aud_error_t
+dr_test_process_line(
+	dr_test_t * test,
+	/*[in]*/ char * buf,
+	/*[out]*/ char*** array,
+	/*[out]*/ int* count
+)
+{
+	char in_name[BUFSIZ];
+	char in_action[BUFSIZ];
+	char in_c;
+	unsigned int in_channel, in_id, in_count, in_fpp, in_latency, in_type, prefix;
+	int in_dbu;
+	int match_count;
+
+	// trim beginning and end of string
+	//printf("Before=\"%s\"\n", buf);
+	while(*buf && isspace(*buf)) buf++;
+	{
+		char * end = buf;
+		while (*end) end++;
+		end--;
+		while (end > buf && isspace(*end)) {*end = '\0'; end--;}
+	}
+	//printf("After=\"%s\"\n", buf);
+
+#ifdef DANTE_ROUTING_TEST_CUSTOM_PROCESS_LINE
+	if (DANTE_ROUTING_TEST_CUSTOM_PROCESS_LINE(test, buf))
+	{
+		return AUD_SUCCESS;
+	}
+#endif
+
+	switch (buf[0])
+	{
+	case '?':
+		{
+			dr_test_help(0);
+			break;
+		}
+
+	case 'b':
+		{
+			if (sscanf(buf, "b %u %d", &in_channel, &in_dbu) == 2)
+			{
+				dr_test_txchannel_set_signal_reflevel(test, in_channel, (dante_dbu_t)in_dbu);
+			}
+			else if (sscanf(buf, "b %u -", &in_channel) == 1)
+			{
+				dr_test_txchannel_clear_signal_reflevel(test, in_channel);
+			}
+			else
+			{
+				dr_test_help('b');
+			}
+			break;
+		}
+	case 'C': 
+		{
+			dr_test_close(test);
+			break;
+		}
+	
+	case 'c':
+		{
+			if (sscanf(buf, "c %s", in_action) == 1 && !strcmp(in_action, "+"))
+			{
+				dr_test_store_config(test);
+			}
+			else if (sscanf(buf, "c %s", in_action) == 1 && !strcmp(in_action, "-"))
+			{
+				dr_test_clear_config(test);
+			}
+			else
+			{
+				dr_test_help('c');
+			}
+			break;
+		}
+#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
+	case 'D':
+		{
+			if (sscanf(buf, "D %c", &in_c) == 1 && in_c == '.')
+			{
+				dr_test_set_current_domain_by_uuid(test, DANTE_DOMAIN_UUID_ADHOC);
+			}
+			else if (sscanf(buf, "D %99s", in_name) == 1)
+			{
+				dr_test_set_current_domain_by_name(test, in_name);
+			}
+			else if (sscanf(buf, "D %c", &in_c) == 1)
+			{
+				dr_test_help('D');
+			}
+			else
+			{
+				dapi_utils_print_domain_handler_info(dapi_get_domain_handler(test->dapi));
+			}
+			break;
+		}
+#endif
+	case 'd':
+		{
+			if (sscanf(buf, "d t %u %u", &in_latency, &in_fpp) == 2)
+			{
+				dr_test_set_performance(test, DR_TEST_PERFORMANCE_TX, (dante_latency_us_t) in_latency, (dante_fpp_t) in_fpp);
+			}
+			else if (sscanf(buf, "d r %u %u", &in_latency, &in_fpp) == 2)
+			{
+				dr_test_set_performance(test, DR_TEST_PERFORMANCE_RX, (dante_latency_us_t) in_latency, (dante_fpp_t) in_fpp);
+			}
+			else if (sscanf(buf, "d u %u %u", &in_latency, &in_fpp) == 2)
+			{
+				dr_test_set_performance(test, DR_TEST_PERFORMANCE_UNICAST, (dante_latency_us_t) in_latency, (dante_fpp_t) in_fpp);
+			}
+			else if (sscanf(buf, "d A 0x%x", &prefix) == 1)
+			{
+				dr_test_set_aes67_prefix(test, prefix);
+			}
+			else if (sscanf(buf, "d %s", in_action) == 1)
+			{
+				if (!strcmp(in_action, "p"))
+				{
+					dr_test_ping(test);
+				}
+				else if (!strcmp(in_action, "!"))
+				{
+					dr_test_mark_stale(test, DR_DEVICE_COMPONENT_PROPERTIES, 0);
+				}
+				else
+				{
+					dr_test_help('d');
+				}
+			}
+			else
+			{
+				dr_test_print_device_info(test->device);
+			}
+			break;
+		}
+
+	case 'e':
+		{
+			if (sscanf(buf, "e %u %s", &in_channel, in_action) == 2 && !strcmp(in_action, "+"))
+			{
+				dr_test_txchannel_set_enabled(test, in_channel, AUD_TRUE);
+			}
+			else if (sscanf(buf, "e %u %s", &in_channel, in_action) == 2 && !strcmp(in_action, "-"))
+			{
+				dr_test_txchannel_set_enabled(test, in_channel, AUD_FALSE);
+			}
+			else
+			{
+				dr_test_help('e');
+			}
+			break;
+		}
+
+	// transmit flows
+	case 'f':
+		{
+			if (sscanf(buf, "f + %u %u %u %u", &in_id, &in_count, &in_latency, &in_fpp) == 4)
+			{
+				dr_test_add_txflow(test, (dante_id_t) in_id, (uint16_t) in_count, (dante_latency_us_t) in_latency, (dante_fpp_t) in_fpp);
+			}
+			else if (sscanf(buf, "f + %u", &in_count) == 1)
+			{
+				dr_test_add_txflow(test, 0, (uint16_t) in_count, 0, 0);
+			}
+			else if (sscanf(buf, "f + A %u %u", &in_id, &in_count) == 2)
+			{
+				dr_test_add_aes67_txflow_multicast(test, (dante_id_t) in_id, (uint16_t) in_count);
+			}
+			else if (sscanf(buf, "f %c %u", &in_c, &in_id) == 2 && in_c == '-')
+			{
+				dr_test_delete_txflow(test, (dante_id_t) in_id);
+			}
+			else if (sscanf(buf, "f %u", &in_id) == 1)
+			{
+				dr_test_replace_txflow_channels(test, (dante_id_t) in_id);
+			}
+			else if (sscanf(buf, "f %s", in_action) == 1)
+			{
+				if (!strcmp(in_action, "!"))
+				{
+					dr_test_mark_stale(test, DR_DEVICE_COMPONENT_TXFLOWS, 0);
+				}
+				else
+				{
+					dr_test_help('f');
+				}
+			}
+			else
+			{
+				dr_test_print_device_txflows(test->device);
+			}
+			break;
+		}
+
+	// receive flows
+	case 'g':
+		{
+			if (sscanf(buf, "g u %d %d", &in_id, &in_count) == 2)
+			{
+				dr_test_add_rxflow_unicast(test, (dante_id_t) in_id, (uint16_t) in_count);
+			}
+			else if (sscanf(buf, "g %c %d", &in_c, &in_id) == 2)
+			{
+				if (in_c == 'm')
+				{
+					dr_test_add_rxflow_multicast(test, in_id);
+				}
+				else if (in_c == '*')
+				{
+					dr_test_replace_rxflow_associations(test, (dante_id_t) in_id);
+				}
+				else if (in_c == '-')
+				{
+					dr_test_delete_rxflow(test, (dante_id_t) in_id);
+				}
+				else
+				{
+					dr_test_help('g');
+				}
+			}
+			else if (sscanf(buf, "g %s", in_action) == 1)
+			{
+				if (!strcmp(in_action, "!"))
+				{
+					dr_test_mark_stale(test, DR_DEVICE_COMPONENT_RXFLOWS, 0);
+				}
+				else
+				{
+					dr_test_help('g');
+				}
+			}
+			else
+			{
+				dr_test_print_device_rxflows(test->device);
+			}
+			break;
+		}
+
+	case 'l':
+		{
+			if (sscanf(buf, "l %u \"%[^\"\r\n]%c %s", &in_channel, in_name, &in_c, in_action) == 4 && in_c == '\"')
+			{
+				if (!strcmp(in_action, "+"))
+				{
+					dr_test_add_txlabel(test, in_channel, in_name, NULL);
+				}
+				else if (!strcmp(in_action, "-"))
+				{
+					dr_test_remove_txlabel_from_channel(test, (dante_id_t) in_channel, in_name);
+				}
+				else
+				{
+					dr_test_help('l');
+				}
+			}
+			else if (sscanf(buf, "l %u %s", &in_channel, in_name) == 2)
+			{
+				if (!strcmp(in_name, "!"))
+				{
+					dr_test_mark_stale(test, DR_DEVICE_COMPONENT_TXLABELS, (dante_id_t)in_channel);
+				}
+				else
+				{
+					dr_test_help('l');
+				}
+			}
+			else if (sscanf(buf, "l %u", &in_channel) == 1)
+			{
+				dr_test_print_channel_txlabels(test->device, (dante_id_t) in_channel, 0, array, count);
+			}
+			else if (sscanf(buf, "l %s", in_name) == 1)
+			{
+				if (!strcmp(in_name, "!"))
+				{
+					dr_test_mark_stale(test, DR_DEVICE_COMPONENT_TXLABELS, 0);
+				}
+				else
+				{
+					dr_test_help('l');
+				}
+			}
+			else
+			{
+				dr_test_print_channel_txlabels(test->device, 0, 0, array, count);
+			}
+			break;
+		}
+
+	case 'L':
+		{
+			match_count = sscanf(buf, "L %u %s", &in_id, in_action);
+			if (match_count == 2)
+			{
+				if (!strcmp(in_action, "-"))
+				{
+					dr_test_remove_txlabel(test, (dante_id_t) in_id);
+				}
+				else
+				{
+					dr_test_help('L');
+				}
+			}
+			else if (match_count == 1)
+			{
+				dr_test_print_device_txlabels(test->device, (dante_id_t) in_id, AUD_FALSE);
+			}
+			else
+			{
+				match_count = sscanf(buf, "L %s", in_action);
+				if (match_count == 1)
+				{
+					if (!strcmp(in_action, "!"))
+					{
+						dr_test_mark_stale(test, DR_DEVICE_COMPONENT_TXLABELS, 0);
+					}
+					else
+					{
+						dr_test_help('L');
+					}
+				}
+				else
+				{
+					dr_test_print_device_txlabels(test->device, 0, AUD_TRUE);
+				}
+			}
+			break;
+		}
+
+	case 'n':
+		{
+			if (sscanf(buf, "n %c %s", &in_c, in_name) == 2 && in_c == '+')
+			{
+				dr_test_rename(test, in_name, AUD_FALSE);
+			}
+			else if (sscanf(buf, "n %s", in_name) == 1)
+			{
+				aud_error_t result = AUD_ERR_INVALIDSTATE;
+				if (!strcmp(in_name, "-"))
+				{
+					result = dr_test_rename(test, NULL, AUD_TRUE);
+				}
+				else if (!strcmp(in_name, "?"))
+				{
+					dr_test_help('n');
+				}
+				else
+				{
+					result = dr_test_rename(test, in_name, AUD_TRUE);
+				}
+				if (result == AUD_SUCCESS)
+				{
+					return AUD_ERR_DONE;
+				}
+			}
+			else
+			{
+				dr_test_print_device_names(test->device);
+			}
+			break;
+		}
+
+	case 'O':
+		{
+			unsigned int a, b, c, d;
+			dante_ipv4_addr_t addr = {0};
+			if (sscanf(buf, "O \"%[^\"\r\n]%c", in_name, &in_c) == 2 && in_c == '\"')
+			{
+				SNPRINTF(test->options.device_name, sizeof(test->options.device_name), "%s", in_name);
+				test->options.domain_device_addr = 0;
+				test->options.num_addresses = 0;
+				dr_test_open(test);
+			}
+			else if (sscanf(buf, "O 0x%u", &in_id) == 1)
+			{
+				test->options.device_name[0] = '\0';
+				test->options.domain_device_addr = in_id;
+				test->options.num_addresses = 0;
+				dr_test_open(test);
+			}
+			else if (sscanf(buf, "O %u.%u.%u.%u", &a,&b,&c,&d) == 4)
+			{
+				addr.addr8[0] = (uint8_t) a;
+				addr.addr8[1] = (uint8_t) b;
+				addr.addr8[2] = (uint8_t) c;
+				addr.addr8[3] = (uint8_t) d;
+				test->options.device_name[0] = '\0';
+				test->options.domain_device_addr = 0;
+				test->options.num_addresses = addr.addr32;
+				dr_test_open(test);
+			}
+			else if (sscanf(buf, "O %c", &in_c) == 1)
+			{
+				dr_test_help('O');
+			}
+			else
+			{
+				test->options.device_name[0] = '\0';
+				test->options.domain_device_addr = 0;
+				test->options.num_addresses = 0;
+				dr_test_open(test);
+			}
+			break;
+		}
+
+	case 'o':
+		{
+			if (sscanf(buf, "o %s", in_action) == 1 && !strcmp(in_action, "+"))
+			{
+				dr_test_set_network_loopback(test, AUD_TRUE);
+			}
+			else if (sscanf(buf, "o %s", in_action) == 1 && !strcmp(in_action, "-"))
+			{
+				dr_test_set_network_loopback(test, AUD_FALSE);
+			}
+			else
+			{
+				dr_test_help('o');
+			}
+			break;
+		}
+
+	case 'q':
+		{
+			printf("\n");
+			g_test_running = AUD_FALSE;
+			break;
+		}
+
+	case 'R':
+		{
+			if (sscanf(buf, "R %s", in_name) == 1)
+			{
+				dr_test_batch_rxchannel_set_name(test, in_name);
+			}
+			else
+			{
+				dr_test_help('R');
+			}
+			break;
+		}
+
+	case 'r':
+		{
+			if (sscanf(buf, "r %u m %c", &in_channel, &in_c) == 2 && in_c == '+')
+			{
+				dr_test_rxchannel_set_muted(test, in_channel, AUD_TRUE);
+			}
+			else if (sscanf(buf, "r %u m %c", &in_channel, &in_c) == 2 && in_c == '-')
+			{
+				dr_test_rxchannel_set_muted(test, in_channel, AUD_FALSE);
+			}
+			else if (sscanf(buf, "r %u \"%[^\"\r\n]%c", &in_channel, in_name, &in_c) == 3 && in_c == '\"')
+			{
+				dr_test_rxchannel_set_name(test, in_channel, in_name, NULL);
+			}
+			else if (sscanf(buf, "r %u !", &in_channel) == 1)
+			{
+				dr_test_mark_stale(test, DR_DEVICE_COMPONENT_RXCHANNELS, (dante_id_t) in_channel);
+			}
+			else if (sscanf(buf, "r %s", in_action) == 1)
+			{
+				if (!strcmp(in_action, "!"))
+				{
+					dr_test_mark_stale(test, DR_DEVICE_COMPONENT_RXCHANNELS, 0);
+				}
+				else
+				{
+					dr_test_help('r');
+				}
+			}
+			else
+			{
+				dr_test_print_device_rxchannels(test->device, array, count);
+			}
+			break;
+		}
+
+	case 'S':
+		{
+			if (sscanf(buf, "S %s", in_name) == 1)
+			{
+				dr_test_batch_rxchannel_subscribe(test, in_name);
+			}
+			else
+			{
+				dr_test_help('S');
+			}
+			break;
+		}
+	case 's':
+		{
+			if (sscanf(buf, "s %u \"%[^\"\r\n]%c", &in_channel, in_name, &in_c) == 3 && in_c == '"')
+			{
+				dr_test_rxchannel_subscribe(test, in_channel, in_name, NULL);
+			}
+			else if (sscanf(buf, "s %u %s", &in_channel, in_name) == 2)
+			{
+				DR_TEST_PRINT("NAME must be of the form \"channel@device\"\n");
+			}
+			else if (sscanf(buf, "s %u", &in_channel) == 1)
+			{
+				dr_test_rxchannel_subscribe(test, in_channel, NULL, NULL);
+			}
+			else
+			{
+				dr_test_help('s');
+			}
+			break;
+		}
+
+	case 't':
+		{
+			if (sscanf(buf, "t %u m %c", &in_channel, &in_c) == 2 && in_c == '+')
+			{
+				dr_test_txchannel_set_muted(test, in_channel, AUD_TRUE);
+			}
+			else if (sscanf(buf, "t %u m %c", &in_channel, &in_c) == 2 && in_c == '-')
+			{
+				dr_test_txchannel_set_muted(test, in_channel, AUD_FALSE);
+			}
+			else if (sscanf(buf, "t %u !", &in_channel) == 1)
+			{
+				dr_test_mark_stale(test, DR_DEVICE_COMPONENT_TXCHANNELS, (dante_id_t) in_channel);
+			}
+			else if (sscanf(buf, "t %s", in_action) == 1)
+			{
+				if (!strcmp(in_action, "!"))
+				{
+					dr_test_mark_stale(test, DR_DEVICE_COMPONENT_TXCHANNELS, 0);
+				}
+				else
+				{
+					dr_test_help('t');
+				}
+			}
+			else
+			{
+				dr_test_print_device_txchannels(test->device, array, count);
+			}
+			break;
+		}
+
+	case 'u':
+		{
+			if (sscanf(buf, "u %s", in_action) == 1)
+			{
+				if (!strcmp(in_action, "q"))
+				{
+					dr_test_query_capabilities(test);
+				}
+				else if (!strcmp(in_action, "!"))
+				{
+					dr_test_mark_stale(test, DR_DEVICE_COMPONENT_COUNT, 0);
+					dr_test_update(test, DR_TEST_ALL_COMPONENTS);
+				}
+				else
+				{
+					dr_test_help('u');
+				}
+			}
+			else
+			{
+				dr_test_update(test, DR_TEST_ALL_COMPONENTS);
+			}
+			break;
+		}
+
+	case 'U':
+		{
+			if (sscanf(buf, "U %u %c", &in_type, &in_c) == 2 && in_c == '+')
+			{
+				dr_test_update_rxflow_errors(test, (dante_rxflow_error_type_t) in_type, AUD_TRUE);
+			}
+			else if (sscanf(buf, "U %u %c", &in_type, &in_c) == 2 && in_c == '-')
+			{
+				dr_test_update_rxflow_errors(test, (dante_rxflow_error_type_t) in_type, AUD_FALSE);
+			}
+			else if (sscanf(buf, "U %c", &in_c) == 1 && in_c == '+')
+			{
+				dr_test_update_rxflow_errors(test, DANTE_NUM_RXFLOW_ERROR_TYPES, AUD_TRUE);
+			}
+			else if (sscanf(buf, "U %c", &in_c) == 1 && in_c == '-')
+			{
+				dr_test_update_rxflow_errors(test, DANTE_NUM_RXFLOW_ERROR_TYPES, AUD_FALSE);
+			}
+			else if (sscanf(buf, "U %u", &in_id) == 1)
+			{
+				dr_test_print_device_rxflow_errors(test->device, (dante_id_t) in_id);
+			}
+			else
+			{
+				dr_test_print_device_rxflow_errors(test->device, 0);
+			}
+			break;
+		}
+
+	case 'x':
+		{
+			if (sscanf(buf, "x %s", in_action) == 1)
+			{
+				if (!strcmp(in_action, "+"))
+				{
+					dr_test_set_lockdown(test, AUD_TRUE);
+				}
+				else if (!strcmp(in_action, "-"))
+				{
+					dr_test_set_lockdown(test, AUD_FALSE);
+				}
+				else
+				{
+					dr_test_help('x');
+				}
+			}
+			else
+			{
+				dr_test_update(test, DR_TEST_ALL_COMPONENTS);
+			}
+			break;
+		}
+
+	case 'X':
+		{
+			dr_test_cancel(test);
+			break;
+		}
+
+	default:
+		{
+			if (buf[0])
+			{
+				DR_TEST_PRINT("Unknown command '%c'\n", buf[0]);
+			}
+			DR_TEST_PRINT("Type '?' for help\n");
+			break;
+		}
+	}
+	return AUD_SUCCESS;
+}
+
+
+static aud_error_t
+dr_test_main_loop
+(
+	dr_test_t * test,
+	/*[out]*/ char*** array,
+	/*[out]*/ int* count
+) {
+	aud_error_t result;
+	aud_bool_t print_prompt = AUD_TRUE;
+
+#ifdef  _WIN32
+	// set to line buffered mode.
+	SetConsoleMode(GetStdHandle(STD_INPUT_HANDLE),ENABLE_LINE_INPUT|ENABLE_ECHO_INPUT|ENABLE_PROCESSED_INPUT);
+#else
+	dante_sockets_t select_sockets;
+#endif
+
+	DR_TEST_PRINT("\nDante Routing API test program. Type '?' for help\n\n");
+	
+	while(g_test_running)
+	{		
+		char buf[BUFSIZ];
+		
+
+		// print prompt if needed
+		if (print_prompt)
+		{
+			const char * name = dr_device_get_name(test->device);
+			DR_TEST_PRINT("\n'%s'> ", name ? name : "");
+			fflush(stdout);
+			print_prompt = AUD_FALSE;
+		}
+
+#ifdef _WIN32
+		dapi_utils_step(test->runtime, AUD_SOCKET_INVALID, NULL);
+#else
+		dapi_utils_step(test->runtime, 0, &select_sockets);
+#endif
+
+		// and check stdin 
+		buf[0] = '\0';
+#ifdef _WIN32
+		if (_kbhit())
+		{
+			DWORD len = 0;
+			if (!ReadConsoleA(GetStdHandle(STD_INPUT_HANDLE),buf,BUFSIZ-1,&len, 0))
+			{
+				printf("Error reading console: %d\n", GetLastError());
+			}
+			else if (len > 0)
+			{
+				buf[len] = '\0';
+			}
+			print_prompt = AUD_TRUE;
+		}
+#else
+		if (FD_ISSET(0, &select_sockets.read_fds)) // 0 is always stdin
+		{
+			if (fgets(buf, BUFSIZ, stdin) == NULL)
+			{
+				result = aud_error_get_last();
+				if (feof(stdin))
+				{
+					DR_TEST_PRINT("Exiting...\n");
+					return AUD_SUCCESS;
+				}
+				else if (result == AUD_ERR_INTERRUPTED)
+				{
+					clearerr(stdin);
+				}
+				else
+				{
+					DR_TEST_ERROR("Exiting with %s\n", dr_error_message(result, g_test_errbuf));
+					return result;
+				}
+			}
+			print_prompt = AUD_TRUE;
+		}
+#endif
+
+		// if we got some input then process the line
+		if (buf[0])
+		{
+		#ifdef _WIN32
+			DR_TEST_PRINT("\n");
+		#endif
+			result = dr_test_process_line(test, buf, array, count);
+			if (result != AUD_SUCCESS)
+			{
+				break;
+			}
+		}
+	}
+	return AUD_SUCCESS;
+}
+
+//----------------------------------------------------------
+// Entry point
+//----------------------------------------------------------
+
+// Steps a device that has no loop of its own until it is active and none of
+// the components in component_mask is stale, fetching those that are not
+// subscribed. Returns as soon as that holds, on the device error state, when
+// the updates failed and left components stale, or with AUD_ERR_TIMEDOUT once
+// timeout_ms has passed.
+static aud_error_t
+dr_test_wait_ready
+(
+	dr_test_t * test,
+	uint32_t component_mask,
+	unsigned int timeout_ms
+) {
+	aud_utime_t deadline, now, remaining;
+	uint32_t stale, requested = 0;
+	aud_error_t result;
+
+	aud_utime_get(&deadline);
+	deadline.tv_sec += timeout_ms / 1000;
+	deadline.tv_usec += (timeout_ms % 1000) * 1000;
+	if (deadline.tv_usec >= 1000000)
+	{
+		deadline.tv_sec++;
+		deadline.tv_usec -= 1000000;
+	}
+
+	for (;;)
+	{
+		switch (dr_device_get_state(test->device))
+		{
+		case DR_DEVICE_STATE_ACTIVE:
+			stale = dr_test_stale_components(test->device) & component_mask;
+			if (!stale)
+			{
+				return AUD_SUCCESS;
+			}
+			// each component is asked for once, a failed update is not retried
+			dr_test_update(test, stale & ~requested);
+			requested |= stale;
+			if (!(test->updating_components & stale))
+			{
+				return AUD_ERR_INVALIDSTATE;
+			}
+			break;
+		case DR_DEVICE_STATE_ERROR:
+			return dr_device_get_error_state_error(test->device);
+		default:
+			break;
+		}
+
+		aud_utime_get(&now);
+		remaining.tv_sec = deadline.tv_sec - now.tv_sec;
+		remaining.tv_usec = deadline.tv_usec - now.tv_usec;
+		if (remaining.tv_usec < 0)
+		{
+			remaining.tv_sec--;
+			remaining.tv_usec += 1000000;
+		}
+		if (remaining.tv_sec < 0 || (remaining.tv_sec == 0 && remaining.tv_usec == 0))
+		{
+			return AUD_ERR_TIMEDOUT;
+		}
+		result = dapi_utils_step_timeout(test->runtime, AUD_SOCKET_INVALID, NULL, &remaining);
+		if (result != AUD_SUCCESS)
+		{
+			return result;
+		}
+	}
+}
+
+__declspec(dllexport) int RunDll
+(
+	/*[in]*/ int argc,
+	/*[in]*/ char* argv[],
+	/*[in]*/ char* input,
+	/*[out]*/ char*** array,
+	/*[out]*/ int* count
+)
+{
+	dr_test_t test;
+	aud_error_t result = AUD_SUCCESS;
+
+	DR_TEST_PRINT("%s: Routing API version %u.%u.%u\n",
+		argv[0], DR_VERSION_MAJOR, DR_VERSION_MINOR, DR_VERSION_BUGFIX);
+	
+	memset(&test, 0, sizeof(dr_test_t));
+	test.print_requests = AUD_TRUE;
+
+	dr_test_parse_options(&test.options, argc, argv);
+	// the one command only needs what it waits for
+	test.options.subscribed_components &= test.options.ready_components;
+
+	// create an environment
+#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__EMBEDDED
+	dapi_config_t * dapiConfig = dapi_config_new();
+	if (dapiConfig)
+	{
+		dante_domain_handler_config_t * domainHandlerConfig = dapi_config_get_domain_handler_config(dapiConfig);
+
+		if (domainHandlerConfig)
+		{
+#ifdef WIN32
+			dante_domain_handler_config_set_port(domainHandlerConfig, test.options.domain_handler.port_no);
+#else
+			dante_domain_handler_config_set_unix_path(domainHandlerConfig, test.options.domain_handler.socket_path);
+#endif
+		}
+	}
+
+#if DAPI_HAS_CONFIGURABLE_MDNS_SERVER_PORT == 1
+	if (test.options.mdns_server_port > 0)
+	{
+		dapi_config_set_mdns_server_port(dapiConfig, test.options.mdns_server_port);
+	}
+#endif
+
+	result = dapi_new_config(dapiConfig, &test.dapi);
+
+	dapi_config_delete(dapiConfig);
+#else
+	result = dapi_new(&test.dapi);
+#endif
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error initialising environment: %s\n", dr_error_message(result, g_test_errbuf));
+		goto cleanup;
+	}
+
+	test.env = dapi_get_env(test.dapi);
+	test.handler = dapi_get_domain_handler(test.dapi);
+	test.runtime = dapi_get_runtime(test.dapi);
+
+	//aud_log_set_threshold(aud_env_get_log(test.env), AUD_LOGTYPE_STDOUT, AUD_LOG_DEBUG);
+
+	// create a devices structure and set its options
+	result = dr_devices_new_dapi(test.dapi, &test.devices);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error creating device factory: %s\n", dr_error_message(result, g_test_errbuf));
+		goto cleanup;
+	}
+	dr_devices_set_context(test.devices, &test);
+	if (test.options.num_handles)
+	{
+		result = dr_devices_set_num_handles(test.devices, test.options.num_handles);
+		if (result != AUD_SUCCESS)
+		{
+			DR_TEST_ERROR("Error setting num_handles to %d: %s\n", test.options.num_handles, dr_error_message(result, g_test_errbuf));
+			goto cleanup;
+		}
+	}
+	if (test.options.request_limit)
+	{
+		result = dr_devices_set_request_limit(test.devices, test.options.request_limit);
+		if (result != AUD_SUCCESS)
+		{
+			DR_TEST_ERROR("Error setting request_limit to %d: %s\n", test.options.request_limit, dr_error_message(result, g_test_errbuf));
+			goto cleanup;
+		}
+	}
+	result = dr_test_requests_init(&test.requests, dr_devices_get_request_limit(test.devices));
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error allocating request table: %s\n", dr_error_message(result, g_test_errbuf));
+		goto cleanup;
+	}
+
+#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
+	result = dapi_utils_ddm_connect_blocking(&test.options.ddm_config, test.handler, test.runtime, &g_test_running);
+	if (result != AUD_SUCCESS)
+	{
+			DR_TEST_ERROR("Error connecting to DDM: %s\n", dr_error_message(result, g_test_errbuf));
+			goto cleanup;
+	}
+#endif
+
+#ifdef DANTE_ROUTING_TEST_CUSTOM_CONFIG_OPTIONS
+	DANTE_ROUTING_TEST_CUSTOM_CONFIG_OPTIONS(&test);
+#endif
+
+	// Print current domain info before doing anything else
+	printf("Current domain configuration:\n");
+	dapi_utils_print_domain_handler_info(test.handler);
+	dante_domain_handler_set_context(test.handler, &test);
+	dante_domain_handler_set_event_fn(test.handler, dr_test_event_handle_ddh_changes);
+
+#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__EMBEDDED
+	// Some embedded platforms support asynchronous connection to the dante device.
+	// Opening a device is not possible while in the NONE domain,
+	// so wait till domain uuid is available
+	while (IS_NO_DOMAIN_UUID(dr_devices_get_domain_uuid(test.devices)))
+	{
+		dapi_utils_step(test.runtime, AUD_SOCKET_INVALID, NULL);
+	}
+#endif
+
+#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
+	dante_domain_info_t info = dante_domain_handler_get_current_domain(test.handler);
+	aud_bool_t skip_device_open = AUD_FALSE;
+	//Is current domain the one that we want to be on?
+	if (test.options.ddm_config.domain[0] && strcmp(info.name, test.options.ddm_config.domain))
+	{
+		if (IS_ADHOC_DOMAIN_UUID(info.uuid))
+		{
+			printf("WARNING: Current domain set to ADHOC\n\n");
+			printf("WARNING: Unable to open the device as requested domain is not available\n");
+			skip_device_open = AUD_TRUE;
+		}
+	}
+	if (!skip_device_open)
+	{
+		// Now open a device connection
+		result = dr_test_open(&test);
+		if (result != AUD_SUCCESS)
+		{
+			goto cleanup;
+		}
+	}
+
+#else
+	// Now open a device connection
+	result = dr_test_open(&test);
+	if (result != AUD_SUCCESS)
+	{
+		goto cleanup;
+	}
+#endif
+	// and run the main loop
+	//dr_test_main_loop(&test);
+
+	if (test.device)
+	{
+		result = dr_test_wait_ready(&test, test.options.ready_components, test.options.ready_timeout_ms);
+		if (result != AUD_SUCCESS)
+		{
+			DR_TEST_ERROR("Device not ready, stale=0x%08x: %s\n",
+				dr_test_stale_components(test.device), dr_error_message(result, g_test_errbuf));
+		}
+	}
+
+	result = dr_test_process_line(&test, input, array, count);
+
+cleanup:
+	dr_test_bulk_abort_all(&test, AUD_ERR_INTERRUPTED);
+	if (test.device)
+	{
+		dr_device_close(test.device);
+	}
+	if (test.devices)
+	{
+		dr_devices_delete(test.devices);
+	}
+	if (test.dapi)
+	{
+		dapi_delete(test.dapi);
+	}
+	dr_test_requests_free(&test.requests);
+	return result;
+}
+
+//----------------------------------------------------------
+// Sessions
+//----------------------------------------------------------
+
+static void
+dr_test_session_remove
+(
+	dr_test_session_t * session,
+	dr_test_t * test
+) {
+	unsigned int i;
+	for (i = 0; i < session->num_tests; i++)
+	{
+		if (session->tests[i] == test)
+		{
+			session->tests[i] = session->tests[--session->num_tests];
+			session->tests[session->num_tests] = NULL;
+			break;
+		}
+	}
+	test->session = NULL;
+}
+
+// One step of the shared runtime, returning early when a device or the
+// metering has timed work
+static aud_error_t
+dr_test_session_step_once
+(
+	dr_test_session_t * session
+) {
+	aud_utime_t now, timeout = { DAPI_UTILS_WAKE_MAX_TIMEOUT_SECONDS, 0 };
+	aud_error_t result;
+	unsigned int i;
+
+	aud_utime_get(&now);
+	for (i = 0; i < session->num_tests; i++)
+	{
+		dr_test_next_timer(session->tests[i], &now, &timeout);
+	}
+	if (session->metering)
+	{
+		// publishes a meter view frame when one is due
+		int64_t ms = dr_test_metering_tick(session->metering, &now);
+		if (ms >= 0)
+		{
+			dr_test_lower_timeout(&timeout, ms ? ms : 1);
+		}
+	}
+	result = dapi_utils_step_wake_timeout(session->runtime, &session->wake, NULL, &timeout);
+	for (i = 0; i < session->num_tests; i++)
+	{
+		dr_test_run_timers(session->tests[i]);
+	}
+	return result;
+}
+
+// Signals the pending events of every device stepped by the session
+static void
+dr_test_session_signal_events
+(
+	dr_test_session_t * session
+) {
+	unsigned int i;
+
+	for (i = 0; i < session->num_tests; i++)
+	{
+		dr_test_signal_events(session->tests[i]);
+	}
+}
+
+static void
+dr_test_session_run_loop
+(
+	dr_test_session_t * session
+) {
+	// registers this thread as the consumer before any callback can submit
+	dr_test_command_queue_run(&session->commands);
+	while (session->loop_running)
+	{
+		aud_error_t result = dr_test_session_step_once(session);
+		if (result != AUD_SUCCESS && result != AUD_ERR_INTERRUPTED)
+		{
+			DR_TEST_ERROR("Session loop stopped: %s\n", dr_error_message(result, g_test_errbuf));
+			session->loop_result = result;
+			break;
+		}
+		if (dr_test_command_queue_run(&session->commands))
+		{
+			dapi_utils_wake_signal(&session->wake);
+		}
+		dr_test_session_signal_events(session);
+	}
+	session->loop_running = AUD_FALSE;
+}
+
+#ifdef WIN32
+static DWORD WINAPI
+dr_test_session_loop_thread
+(
+	LPVOID arg
+) {
+	dr_test_session_run_loop((dr_test_session_t *) arg);
+	return 0;
+}
+#else
+static void *
+dr_test_session_loop_thread
+(
+	void * arg
+) {
+	dr_test_session_run_loop((dr_test_session_t *) arg);
+	return NULL;
+}
+#endif
+
+static aud_error_t
+dr_test_session_stop_loop
+(
+	dr_test_session_t * session
+) {
+	if (!session->loop_started)
+	{
+		return AUD_SUCCESS;
+	}
+	session->loop_running = AUD_FALSE;
+	dapi_utils_wake_signal(&session->wake);
+#ifdef WIN32
+	WaitForSingleObject(session->loop_thread, INFINITE);
+	CloseHandle(session->loop_thread);
+#else
+	pthread_join(session->loop_thread, NULL);
+#endif
+	session->loop_started = AUD_FALSE;
+
+	// anything submitted while the loop was shutting down runs here
+	dr_test_command_queue_detach(&session->commands);
+	return session->loop_result;
+}
+
+static aud_error_t
+dr_test_close_device_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_t * test = (dr_test_t *) target;
+	(void) args;
+
+	// no callbacks into the owner while tearing down
+	test->event_callback = NULL;
+	test->event_context = NULL;
+
+	dr_test_bulk_abort_all(test, AUD_ERR_INTERRUPTED);
+	if (test->device)
+	{
+		dr_device_close(test->device);
+		test->device = NULL;
+	}
+	if (test->session)
+	{
+		// requests the closed device still held no longer count against the session
+		test->session->requests_in_use -= test->requests.num_in_use;
+		dr_test_name_index_remove(&test->session->names, &test->indexed_names);
+		dr_test_session_remove(test->session, test);
+	}
+	else
+	{
+		if (test->devices)
+		{
+			dr_devices_delete(test->devices);
+		}
+		dapi_utils_wake_cleanup(&test->wake, test->runtime);
+		if (test->dapi)
+		{
+			dapi_delete(test->dapi);
+		}
+	}
+	test->devices = NULL;
+	test->dapi = NULL;
+	if (test->channel_text)
+	{
+		free(test->channel_text);
+		test->channel_text = NULL;
+		test->channel_text_len = 0;
+	}
+	free(test->txlabels_buf);
+	test->txlabels_buf = NULL;
+	test->txlabels_buflen = 0;
+	dr_test_requests_free(&test->requests);
+	dr_test_snapshot_builder_free(&test->snapshot_builder);
+	dr_test_channel_changes_free(&test->rx_changes);
+	dr_test_channel_changes_free(&test->tx_changes);
+	dr_test_rxstats_free(&test->rxstats);
+	return AUD_SUCCESS;
+}
+
+// Session devices are closed on the session loop, if it runs. A standalone
+// device must no longer be stepped; calls it still had queued run first.
+__declspec(dllexport) void close_device
+(
+	/*[in/out]*/ dr_test_t** test
+)
+{
+	dr_test_session_t * session = (*test)->session;
+	if (session)
+	{
+		dr_test_submit_to(&session->commands, &session->wake, dr_test_close_device_command, *test, NULL);
+	}
+	else
+	{
+		dr_test_command_queue_detach(&(*test)->commands);
+		dr_test_close_device_command(*test, NULL);
+	}
+}
+
+__declspec(dllexport) int open_device
+(
+	/*[in]*/ int argc,
+	/*[in]*/ char* argv[],
+	/*[out]*/ dr_test_t** test
+)
+{
+	*test = (dr_test_t*)CoTaskMemAlloc(sizeof(dr_test_t));
+	memset(*test, 0, sizeof(dr_test_t));
+	dr_test_command_queue_init(&(*test)->commands);
+
+	DR_TEST_PRINT("%s: Routing API version %u.%u.%u\n",
+		argv[0], DR_VERSION_MAJOR, DR_VERSION_MINOR, DR_VERSION_BUGFIX);
+
+	aud_error_t result = AUD_SUCCESS;
+
+	dr_test_parse_options(&(*test)->options, argc, argv);
+
+	// create an environment
+#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__EMBEDDED
+	dapi_config_t* dapiConfig = dapi_config_new();
+	if (dapiConfig)
+	{
+		dante_domain_handler_config_t* domainHandlerConfig = dapi_config_get_domain_handler_config(dapiConfig);
+
+		if (domainHandlerConfig)
+		{
+#ifdef WIN32
+			dante_domain_handler_config_set_port(domainHandlerConfig, test.options.domain_handler.port_no);
+#else
+			dante_domain_handler_config_set_unix_path(domainHandlerConfig, test.options.domain_handler.socket_path);
+#endif
+		}
+	}
+
+#if DAPI_HAS_CONFIGURABLE_MDNS_SERVER_PORT == 1
+	if (test.options.mdns_server_port > 0)
+	{
+		dapi_config_set_mdns_server_port(dapiConfig, test.options.mdns_server_port);
+	}
+#endif
+
+	result = dapi_new_config(dapiConfig, &test.dapi);
+
+	dapi_config_delete(dapiConfig);
+#else
+	result = dapi_new(&(*test)->dapi);
+#endif
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error initialising environment: %s\n", dr_error_message(result, g_test_errbuf));
+		goto cleanup;
+	}
+
+	(*test)->env = dapi_get_env((*test)->dapi);
+	(*test)->handler = dapi_get_domain_handler((*test)->dapi);
+	(*test)->runtime = dapi_get_runtime((*test)->dapi);
+
+	result = dapi_utils_wake_init(&(*test)->wake, (*test)->runtime);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error creating wake socket: %s\n", dr_error_message(result, g_test_errbuf));
+		goto cleanup;
+	}
+
+	//aud_log_set_threshold(aud_env_get_log(test.env), AUD_LOGTYPE_STDOUT, AUD_LOG_DEBUG);
+
+	// create a devices structure and set its options
+	result = dr_devices_new_dapi((*test)->dapi, &(*test)->devices);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error creating device factory: %s\n", dr_error_message(result, g_test_errbuf));
+		goto cleanup;
+	}
+	dr_devices_set_context((*test)->devices, *test);
+	dr_devices_set_sockets_changed_callback((*test)->devices, dr_test_on_sockets_changed);
+	if ((*test)->options.num_handles)
+	{
+		result = dr_devices_set_num_handles((*test)->devices, (*test)->options.num_handles);
+		if (result != AUD_SUCCESS)
+		{
+			DR_TEST_ERROR("Error setting num_handles to %d: %s\n", (*test)->options.num_handles, dr_error_message(result, g_test_errbuf));
+			goto cleanup;
+		}
+	}
+	if ((*test)->options.request_limit)
+	{
+		result = dr_devices_set_request_limit((*test)->devices, (*test)->options.request_limit);
+		if (result != AUD_SUCCESS)
+		{
+			DR_TEST_ERROR("Error setting request_limit to %d: %s\n", (*test)->options.request_limit, dr_error_message(result, g_test_errbuf));
+			goto cleanup;
+		}
+	}
+	result = dr_test_requests_init(&(*test)->requests, dr_devices_get_request_limit((*test)->devices));
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error allocating request table: %s\n", dr_error_message(result, g_test_errbuf));
+		goto cleanup;
+	}
+
+#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
+	result = dapi_utils_ddm_connect_blocking(&(*test)->options.ddm_config, (*test)->handler, (*test)->runtime, &g_test_running);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error connecting to DDM: %s\n", dr_error_message(result, g_test_errbuf));
+		goto cleanup;
+	}
+#endif
+
+#ifdef DANTE_ROUTING_TEST_CUSTOM_CONFIG_OPTIONS
+	DANTE_ROUTING_TEST_CUSTOM_CONFIG_OPTIONS(&test);
+#endif
+
+	// Print current domain info before doing anything else
+	printf("Current domain configuration:\n");
+	dapi_utils_print_domain_handler_info((*test)->handler);
+	dante_domain_handler_set_context((*test)->handler, *test);
+	dante_domain_handler_set_event_fn((*test)->handler, dr_test_event_handle_ddh_changes);
+
+#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__EMBEDDED
+	// Some embedded platforms support asynchronous connection to the dante device.
+	// Opening a device is not possible while in the NONE domain,
+	// so wait till domain uuid is available
+	while (IS_NO_DOMAIN_UUID(dr_devices_get_domain_uuid((*test)->devices)))
+	{
+		dapi_utils_step((*test)->runtime, AUD_SOCKET_INVALID, NULL);
+	}
+#endif
+
+#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
+	dante_domain_info_t info = dante_domain_handler_get_current_domain((*test)->handler);
+	aud_bool_t skip_device_open = AUD_FALSE;
+	//Is current domain the one that we want to be on?
+	if ((*test)->options.ddm_config.domain[0] && strcmp(info.name, (*test)->options.ddm_config.domain))
+	{
+		if (IS_ADHOC_DOMAIN_UUID(info.uuid))
+		{
+			printf("WARNING: Current domain set to ADHOC\n\n");
+			printf("WARNING: Unable to open the device as requested domain is not available\n");
+			skip_device_open = AUD_TRUE;
+		}
+	}
+	if (!skip_device_open)
+	{
+		// Now open a device connection
+		result = dr_test_open(*test);
+		if (result != AUD_SUCCESS)
+		{
+			goto cleanup;
+		}
+	}
+
+#else
+	// Now open a device connection
+	result = dr_test_open(*test);
+	if (result != AUD_SUCCESS)
+	{
+		goto cleanup;
+	}
+#endif
+
+	return result;
+
+cleanup:
+	close_device(test);
+
+	return result;
+}
+
+// Waits for network activity, the next runtime timeout or a call to wake,
+// then processes whatever is ready and the calls submitted from other threads.
+// From the first step on, those calls wait for the stepping thread.
+__declspec(dllexport) int step
+(
+	/*[in/out]*/ dr_test_t** test
+)
+{
+	dr_test_command_queue_t * commands = &(*test)->commands;
+	aud_utime_t now, timeout = { DAPI_UTILS_WAKE_MAX_TIMEOUT_SECONDS, 0 };
+	aud_error_t result;
+
+	if (!commands->attached)
+	{
+		dr_test_command_queue_attach(commands);
+	}
+	dr_test_command_queue_run(commands);
+	aud_utime_get(&now);
+	dr_test_next_timer(*test, &now, &timeout);
+	result = dapi_utils_step_wake_timeout((*test)->runtime, &(*test)->wake, NULL, &timeout);
+	dr_test_run_timers(*test);
+	if (dr_test_command_queue_run(commands))
+	{
+		dapi_utils_wake_signal(&(*test)->wake);
+	}
+	dr_test_signal_events(*test);
+	return result;
+}
+
+// Makes a step blocked on this handle (or its session) return immediately.
+// Safe to call from any thread.
+__declspec(dllexport) int wake
+(
+	/*[in/out]*/ dr_test_t** test
+)
+{
+	dr_test_wake(*test);
+	return AUD_SUCCESS;
+}
+
+// Closes the connections of any devices still open under the session and
+// releases the shared environment. Their handles stay valid for close_device.
+__declspec(dllexport) void session_close
+(
+	/*[in/out]*/ dr_test_session_t** session
+)
+{
+	dr_test_session_stop_loop(*session);
+
+	while ((*session)->num_tests)
+	{
+		dr_test_t * test = (*session)->tests[(*session)->num_tests - 1];
+		dr_test_close(test);
+		dr_test_name_index_remove(&(*session)->names, &test->indexed_names);
+		dr_test_session_remove(*session, test);
+		test->dapi = NULL;
+		test->env = NULL;
+		test->handler = NULL;
+		test->runtime = NULL;
+		test->devices = NULL;
+	}
+
+	if ((*session)->devices)
+	{
+		dr_devices_delete((*session)->devices);
+		(*session)->devices = NULL;
+	}
+	if ((*session)->metering)
+	{
+		dr_test_metering_delete((*session)->metering);
+		(*session)->metering = NULL;
+	}
+	dapi_utils_wake_cleanup(&(*session)->wake, (*session)->runtime);
+	if ((*session)->dapi)
+	{
+		dapi_delete((*session)->dapi);
+		(*session)->dapi = NULL;
+	}
+	free((*session)->tests);
+	(*session)->tests = NULL;
+	(*session)->max_tests = 0;
+	dr_test_name_index_free(&(*session)->names);
+}
+
+// Creates one environment, device factory and DDM connection for up to
+// 'max_devices' devices opened with session_open_device. argv takes the
+// same environment options as open_device (-h=, -r=, DDM options) and no device name.
+// The session is freed by the caller with CoTaskMemFree after session_close.
+__declspec(dllexport) int session_open
+(
+	/*[in]*/ int argc,
+	/*[in]*/ char* argv[],
+	/*[in]*/ int max_devices,
+	/*[out]*/ dr_test_session_t** session
+)
+{
+	aud_error_t result = AUD_SUCCESS;
+	unsigned int num_handles;
+
+	*session = (dr_test_session_t*)CoTaskMemAlloc(sizeof(dr_test_session_t));
+	memset(*session, 0, sizeof(dr_test_session_t));
+	dr_test_command_queue_init(&(*session)->commands);
+
+	if (max_devices < 1)
+	{
+		result = AUD_ERR_INVALIDPARAMETER;
+		goto cleanup;
+	}
+
+	dr_test_parse_options(&(*session)->options, argc, argv);
+
+	(*session)->tests = (dr_test_t **) calloc(max_devices, sizeof(dr_test_t *));
+	if (!(*session)->tests)
+	{
+		result = AUD_ERR_NOMEMORY;
+		goto cleanup;
+	}
+	(*session)->max_tests = (unsigned int) max_devices;
+
+	// create an environment
+#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__EMBEDDED
+	dapi_config_t* dapiConfig = dapi_config_new();
+	if (dapiConfig)
+	{
+		dante_domain_handler_config_t* domainHandlerConfig = dapi_config_get_domain_handler_config(dapiConfig);
+
+		if (domainHandlerConfig)
+		{
+#ifdef WIN32
+			dante_domain_handler_config_set_port(domainHandlerConfig, (*session)->options.domain_handler.port_no);
+#else
+			dante_domain_handler_config_set_unix_path(domainHandlerConfig, (*session)->options.domain_handler.socket_path);
+#endif
+		}
+	}
+
+#if DAPI_HAS_CONFIGURABLE_MDNS_SERVER_PORT == 1
+	if ((*session)->options.mdns_server_port > 0)
+	{
+		dapi_config_set_mdns_server_port(dapiConfig, (*session)->options.mdns_server_port);
+	}
+#endif
+
+	result = dapi_new_config(dapiConfig, &(*session)->dapi);
+
+	dapi_config_delete(dapiConfig);
+#else
+	result = dapi_new(&(*session)->dapi);
+#endif
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error initialising environment: %s\n", dr_error_message(result, g_test_errbuf));
+		goto cleanup;
+	}
+
+	(*session)->env = dapi_get_env((*session)->dapi);
+	(*session)->handler = dapi_get_domain_handler((*session)->dapi);
+	(*session)->runtime = dapi_get_runtime((*session)->dapi);
+
+	result = dapi_utils_wake_init(&(*session)->wake, (*session)->runtime);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error creating wake socket: %s\n", dr_error_message(result, g_test_errbuf));
+		goto cleanup;
+	}
+
+	result = dr_devices_new_dapi((*session)->dapi, &(*session)->devices);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error creating device factory: %s\n", dr_error_message(result, g_test_errbuf));
+		goto cleanup;
+	}
+	dr_devices_set_context((*session)->devices, *session);
+	dr_devices_set_sockets_changed_callback((*session)->devices, dr_test_session_on_sockets_changed);
+
+	// one handle per device unless told otherwise
+	num_handles = (*session)->options.num_handles ? (*session)->options.num_handles : (*session)->max_tests;
+	result = dr_devices_set_num_handles((*session)->devices, num_handles);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error setting num_handles to %u: %s\n", num_handles, dr_error_message(result, g_test_errbuf));
+		goto cleanup;
+	}
+	if ((*session)->options.request_limit)
+	{
+		result = dr_devices_set_request_limit((*session)->devices, (*session)->options.request_limit);
+		if (result != AUD_SUCCESS)
 		{
-			if (sscanf(buf, "s %u \"%[^\"\r\n]%c", &in_channel, in_name, &in_c) == 3 && in_c == '"')
-			{
-				dr_test_rxchannel_subscribe(test, in_channel, in_name);
-			}
-			else if (sscanf(buf, "s %u %s", &in_channel, in_name) == 2)
-			{
-				DR_TEST_PRINT("NAME must be of the form \"channel@device\"\n");
-			}
-			else if (sscanf(buf, "s %u", &in_channel) == 1)
-			{
-				dr_test_rxchannel_subscribe(test, in_channel, NULL);
-			}
-			else
-			{
-				dr_test_help('s');
-			}
-			break;
+			DR_TEST_ERROR("Error setting request_limit to %d: %s\n", (*session)->options.request_limit, dr_error_message(result, g_test_errbuf));
+			goto cleanup;
 		}
+	}
+	(*session)->request_limit = dr_devices_get_request_limit((*session)->devices);
+	if (!(*session)->request_limit)
+	{
+		(*session)->request_limit = DR_TEST_DEFAULT_REQUEST_LIMIT;
+	}
+	(*session)->bulk_budget = ((*session)->request_limit > DR_TEST_BULK_RESERVED_REQUESTS) ?
+		(*session)->request_limit - DR_TEST_BULK_RESERVED_REQUESTS : 1;
 
-	case 't':
+#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
+	result = dapi_utils_ddm_connect_blocking(&(*session)->options.ddm_config, (*session)->handler, (*session)->runtime, &g_test_running);
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error connecting to DDM: %s\n", dr_error_message(result, g_test_errbuf));
+		goto cleanup;
+	}
+#endif
+
+	printf("Current domain configuration:\n");
+	dapi_utils_print_domain_handler_info((*session)->handler);
+	dante_domain_handler_set_context((*session)->handler, *session);
+	dante_domain_handler_set_event_fn((*session)->handler, dr_test_session_handle_ddh_changes);
+
+#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__EMBEDDED
+	// Opening a device is not possible while in the NONE domain
+	while (IS_NO_DOMAIN_UUID(dr_devices_get_domain_uuid((*session)->devices)))
+	{
+		dapi_utils_step((*session)->runtime, AUD_SOCKET_INVALID, NULL);
+	}
+#endif
+
+	return result;
+
+cleanup:
+	session_close(session);
+
+	return result;
+}
+
+typedef struct dr_test_session_open_device_args
+{
+	dr_test_session_t * session;
+	int argc;
+	char ** argv;
+} dr_test_session_open_device_args_t;
+
+static aud_error_t
+dr_test_session_open_device_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_t * test = (dr_test_t *) target;
+	dr_test_session_open_device_args_t * a = (dr_test_session_open_device_args_t *) args;
+	dr_test_session_t * session = a->session;
+	aud_error_t result;
+
+	if (session->num_tests >= session->max_tests)
+	{
+		DR_TEST_ERROR("Error opening device: session is full (%u devices)\n", session->max_tests);
+		return AUD_ERR_NOBUFS;
+	}
+
+	dr_test_parse_options(&test->options, a->argc, a->argv);
+
+	test->dapi = session->dapi;
+	test->env = session->env;
+	test->handler = session->handler;
+	test->runtime = session->runtime;
+	test->devices = session->devices;
+
+	result = dr_test_requests_init(&test->requests, dr_devices_get_request_limit(session->devices));
+	if (result != AUD_SUCCESS)
+	{
+		DR_TEST_ERROR("Error allocating request table: %s\n", dr_error_message(result, g_test_errbuf));
+		test->dapi = NULL;
+		test->devices = NULL;
+		return result;
+	}
+
+	test->session = session;
+	test->indexed_names = DR_TEST_NAME_NONE;
+	session->tests[session->num_tests++] = test;
+	dr_test_rxstats_configure(&test->rxstats,
+		session->rxstats_interval_ms, session->rxstats_fields, session->rxstats_history);
+
+#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
+	{
+		// the session handler opens the device once the requested domain shows up
+		dante_domain_info_t info = dante_domain_handler_get_current_domain(session->handler);
+		if (session->options.ddm_config.domain[0] && strcmp(info.name, session->options.ddm_config.domain))
 		{
-			if (sscanf(buf, "t %u m %c", &in_channel, &in_c) == 2 && in_c == '+')
-			{
-				dr_test_txchannel_set_muted(test, in_channel, AUD_TRUE);
-			}
-			else if (sscanf(buf, "t %u m %c", &in_channel, &in_c) == 2 && in_c == '-')
-			{
-				dr_test_txchannel_set_muted(test, in_channel, AUD_FALSE);
-			}
-			else if (sscanf(buf, "t %u !", &in_channel) == 1)
-			{
-				dr_test_mark_stale(test, DR_DEVICE_COMPONENT_TXCHANNELS, (dante_id_t) in_channel);
-			}
-			else if (sscanf(buf, "t %s", in_action) == 1)
-			{
-				if (!strcmp(in_action, "!"))
-				{
-					dr_test_mark_stale(test, DR_DEVICE_COMPONENT_TXCHANNELS, 0);
-				}
-				else
-				{
-					dr_test_help('t');
-				}
-			}
-			else
-			{
-				dr_test_print_device_txchannels(test->device, array, count);
-			}
-			break;
+			printf("WARNING: Requested domain is not available yet, deferring device open\n");
+			return AUD_SUCCESS;
 		}
+	}
+#endif
+
+	result = dr_test_open(test);
+	if (result != AUD_SUCCESS)
+	{
+		dr_test_close_device_command(test, NULL);
+	}
+	return result;
+}
+
+// Opens one more device under the session. argv takes the per-device options
+// of open_device (device name, -a=, -p=, -i=, ...). The handle is used with
+// every per-device export and released with close_device.
+// Runs on the session loop if it was started, while the other devices keep running.
+__declspec(dllexport) int session_open_device
+(
+	/*[in/out]*/ dr_test_session_t** session,
+	/*[in]*/ int argc,
+	/*[in]*/ char* argv[],
+	/*[out]*/ dr_test_t** test
+)
+{
+	dr_test_session_open_device_args_t args = { *session, argc, argv };
+
+	*test = (dr_test_t*)CoTaskMemAlloc(sizeof(dr_test_t));
+	memset(*test, 0, sizeof(dr_test_t));
+	dr_test_command_queue_init(&(*test)->commands);
+
+	return dr_test_submit_to(&(*session)->commands, &(*session)->wake,
+		dr_test_session_open_device_command, *test, &args);
+}
+
+__declspec(dllexport) int session_step
+(
+	/*[in/out]*/ dr_test_session_t** session
+)
+{
+	aud_error_t result = dr_test_session_step_once(*session);
+
+	dr_test_session_signal_events(*session);
+	return result;
+}
+
+// Starts one native thread stepping the session until session_stop_loop or
+// session_close, so the number of threads does not grow with the number of
+// devices. Events reach the callbacks registered with set_event_callback on
+// that thread. session_step must not be used while the loop is running.
+__declspec(dllexport) int session_start_loop
+(
+	/*[in/out]*/ dr_test_session_t** session
+)
+{
+	if ((*session)->loop_started)
+	{
+		return AUD_ERR_ALREADY;
+	}
+	if (!(*session)->runtime)
+	{
+		return AUD_ERR_INVALIDSTATE;
+	}
+
+	(*session)->loop_result = AUD_SUCCESS;
+	(*session)->loop_running = AUD_TRUE;
+	dr_test_command_queue_attach(&(*session)->commands);
+#ifdef WIN32
+	(*session)->loop_thread = CreateThread(NULL, 0, dr_test_session_loop_thread, *session, 0, NULL);
+	if (!(*session)->loop_thread)
+	{
+		(*session)->loop_running = AUD_FALSE;
+		dr_test_command_queue_detach(&(*session)->commands);
+		return aud_error_from_system_error(GetLastError());
+	}
+#else
+	if (pthread_create(&(*session)->loop_thread, NULL, dr_test_session_loop_thread, *session))
+	{
+		(*session)->loop_running = AUD_FALSE;
+		dr_test_command_queue_detach(&(*session)->commands);
+		return AUD_ERR_SYSTEM;
+	}
+#endif
+	(*session)->loop_started = AUD_TRUE;
+	return AUD_SUCCESS;
+}
+
+static aud_error_t
+dr_test_session_set_bulk_budget_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_session_t * session = (dr_test_session_t *) target;
+	unsigned int budget = *(const unsigned int *) args;
+
+	session->bulk_budget = budget;
+	// a larger budget applies right away, a smaller one as chunks complete
+	dr_test_session_pump_bulks(session);
+	return AUD_SUCCESS;
+}
+
+// Limits how many bulk chunks all devices of the session have in flight
+// together. The default leaves DR_TEST_BULK_RESERVED_REQUESTS of the request
+// limit to single requests; the request limit itself is never exceeded.
+// Each device with pending bulk operations keeps at least one chunk in
+// flight, so the slowest device bounds an apply across many devices.
+__declspec(dllexport) int session_set_bulk_budget
+(
+	/*[in/out]*/ dr_test_session_t** session,
+	/*[in]*/ int max_in_flight
+)
+{
+	unsigned int budget = (unsigned int) max_in_flight;
+
+	if (max_in_flight < 1)
+	{
+		return AUD_ERR_INVALIDPARAMETER;
+	}
+	return dr_test_submit_to(&(*session)->commands, &(*session)->wake,
+		dr_test_session_set_bulk_budget_command, *session, &budget);
+}
+
+typedef struct dr_test_rxstats_args
+{
+	uint32_t interval_ms;
+	uint32_t fields;
+	uint32_t history;
+} dr_test_rxstats_args_t;
+
+static aud_error_t
+dr_test_session_start_rxstats_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_session_t * session = (dr_test_session_t *) target;
+	const dr_test_rxstats_args_t * a = (const dr_test_rxstats_args_t *) args;
+	unsigned int i;
+
+	session->rxstats_interval_ms = a->interval_ms;
+	session->rxstats_fields = a->fields;
+	session->rxstats_history = a->history;
+	for (i = 0; i < session->num_tests; i++)
+	{
+		dr_test_rxstats_configure(&session->tests[i]->rxstats, a->interval_ms, a->fields, a->history);
+	}
+	return AUD_SUCCESS;
+}
+
+// start_rxflow_error_stats for every device of the session, including the
+// devices opened later
+__declspec(dllexport) int session_start_rxflow_error_stats
+(
+	/*[in/out]*/ dr_test_session_t** session,
+	/*[in]*/ uint32_t interval_ms,
+	/*[in]*/ uint32_t fields,
+	/*[in]*/ uint32_t history
+)
+{
+	dr_test_rxstats_args_t args = { interval_ms, fields, history };
+	return dr_test_submit_to(&(*session)->commands, &(*session)->wake,
+		dr_test_session_start_rxstats_command, *session, &args);
+}
+
+typedef struct dr_test_metering_args
+{
+	uint16_t port;
+	uint16_t max_devices;
+	uint16_t max_channels;
+	uint32_t capacity;
+	void ** ring;
+} dr_test_metering_args_t;
+
+static aud_error_t
+dr_test_session_start_metering_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_session_t * session = (dr_test_session_t *) target;
+	dr_test_metering_args_t * a = (dr_test_metering_args_t *) args;
+	aud_error_t result;
+
+	if (session->metering)
+	{
+		return AUD_ERR_INVALIDSTATE;
+	}
+	result = dr_test_metering_new(session->dapi, a->port, a->max_devices, a->max_channels, a->capacity, &session->metering);
+	if (result != AUD_SUCCESS)
+	{
+		return result;
+	}
+	*a->ring = dr_test_metering_ring(session->metering);
+	return AUD_SUCCESS;
+}
 
-	case 'u':
-		{
-			if (sscanf(buf, "u %s", in_action) == 1)
-			{
-				if (!strcmp(in_action, "q"))
-				{
-					dr_test_query_capabilities(test);
-				}
-				else if (!strcmp(in_action, "!"))
-				{
-					dr_test_mark_stale(test, DR_DEVICE_COMPONENT_COUNT, 0);
-					dr_test_update(test);
-				}
-				else
-				{
-					dr_test_help('u');
-				}
-			}
-			else
-			{
-				dr_test_update(test);
-			}
-			break;
-		}
+// Starts a conmon client receiving the metering channel of the devices added
+// with session_subscribe_metering. Every metering message becomes a frame of
+// float dBFS peaks in 'ring', a dr_test_meter_ring_t read in place by the
+// caller. The ring stays valid until session_stop_metering or session_close
+// and is not freed by the caller. 'port' 0 uses the conmon default.
+__declspec(dllexport) int session_start_metering
+(
+	/*[in/out]*/ dr_test_session_t** session,
+	/*[in]*/ int port,
+	/*[in]*/ int max_devices,
+	/*[in]*/ int max_channels,
+	/*[in]*/ int capacity,
+	/*[out]*/ void** ring
+)
+{
+	dr_test_metering_args_t args;
 
-	case 'U':
-		{
-			if (sscanf(buf, "U %u %c", &in_type, &in_c) == 2 && in_c == '+')
-			{
-				dr_test_update_rxflow_errors(test, (dante_rxflow_error_type_t) in_type, AUD_TRUE);
-			}
-			else if (sscanf(buf, "U %u %c", &in_type, &in_c) == 2 && in_c == '-')
-			{
-				dr_test_update_rxflow_errors(test, (dante_rxflow_error_type_t) in_type, AUD_FALSE);
-			}
-			else if (sscanf(buf, "U %c", &in_c) == 1 && in_c == '+')
-			{
-				dr_test_update_rxflow_errors(test, DANTE_NUM_RXFLOW_ERROR_TYPES, AUD_TRUE);
-			}
-			else if (sscanf(buf, "U %c", &in_c) == 1 && in_c == '-')
-			{
-				dr_test_update_rxflow_errors(test, DANTE_NUM_RXFLOW_ERROR_TYPES, AUD_FALSE);
-			}
-			else if (sscanf(buf, "U %u", &in_id) == 1)
-			{
-				dr_test_print_device_rxflow_errors(test->device, (dante_id_t) in_id);
-			}
-			else
-			{
-				dr_test_print_device_rxflow_errors(test->device, 0);
-			}
-			break;
-		}
+	*ring = NULL;
+	if (port < 0 || port > 0xFFFF || max_devices < 1 || max_devices > 0xFFFF
+		|| max_channels < 1 || max_channels > 0xFFFF || capacity < 0)
+	{
+		return AUD_ERR_INVALIDPARAMETER;
+	}
+	args.port = (uint16_t) port;
+	args.max_devices = (uint16_t) max_devices;
+	args.max_channels = (uint16_t) max_channels;
+	args.capacity = (uint32_t) capacity;
+	args.ring = ring;
+	return dr_test_submit_to(&(*session)->commands, &(*session)->wake,
+		dr_test_session_start_metering_command, *session, &args);
+}
 
-	case 'x':
-		{
-			if (sscanf(buf, "x %s", in_action) == 1)
-			{
-				if (!strcmp(in_action, "+"))
-				{
-					dr_test_set_lockdown(test, AUD_TRUE);
-				}
-				else if (!strcmp(in_action, "-"))
-				{
-					dr_test_set_lockdown(test, AUD_FALSE);
-				}
-				else
-				{
-					dr_test_help('x');
-				}
-			}
-			else
-			{
-				dr_test_update(test);
-			}
-			break;
-		}
+typedef struct dr_test_meter_ballistics_args
+{
+	const dr_test_meter_ballistics_t * ballistics;
+	void ** view;
+} dr_test_meter_ballistics_args_t;
 
-	case 'X':
-		{
-			dr_test_cancel(test);
-			break;
-		}
+static aud_error_t
+dr_test_session_set_meter_ballistics_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_session_t * session = (dr_test_session_t *) target;
+	dr_test_meter_ballistics_args_t * a = (dr_test_meter_ballistics_args_t *) args;
+	dr_test_meter_view_t * view;
+	aud_error_t result;
 
-	default:
-		{
-			if (buf[0])
-			{
-				DR_TEST_PRINT("Unknown command '%c'\n", buf[0]);
-			}
-			DR_TEST_PRINT("Type '?' for help\n");
-			break;
-		}
+	if (!session->metering)
+	{
+		return AUD_ERR_INVALIDSTATE;
+	}
+	result = dr_test_metering_set_ballistics(session->metering, a->ballistics, &view);
+	if (result == AUD_SUCCESS)
+	{
+		*a->view = view;
+	}
+	return result;
+}
+
+// Runs the metering of the session through attack/release ballistics,
+// peak hold and clip latching, and publishes one dr_test_meter_view_t frame
+// per channel set at ballistics->rate_hz instead of a frame per message.
+// Call again to change the settings; rate_hz 0 stops publishing. The view
+// has the lifetime of the ring and is not freed by the caller.
+__declspec(dllexport) int session_set_meter_ballistics
+(
+	/*[in/out]*/ dr_test_session_t** session,
+	/*[in]*/ const dr_test_meter_ballistics_t* ballistics,
+	/*[out]*/ void** view
+)
+{
+	dr_test_meter_ballistics_args_t args = { ballistics, view };
+	*view = NULL;
+	return dr_test_submit_to(&(*session)->commands, &(*session)->wake,
+		dr_test_session_set_meter_ballistics_command, *session, &args);
+}
+
+static aud_error_t
+dr_test_session_clear_meter_clips_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_session_t * session = (dr_test_session_t *) target;
+
+	if (!session->metering)
+	{
+		return AUD_ERR_INVALIDSTATE;
 	}
+	dr_test_metering_clear_clips(session->metering, *(const int *) args);
 	return AUD_SUCCESS;
 }
 
+// Clears the latched clips of the device in 'slot', or of every device for -1
+__declspec(dllexport) int session_clear_meter_clips
+(
+	/*[in/out]*/ dr_test_session_t** session,
+	/*[in]*/ int slot
+)
+{
+	return dr_test_submit_to(&(*session)->commands, &(*session)->wake,
+		dr_test_session_clear_meter_clips_command, *session, &slot);
+}
+
+typedef struct dr_test_metering_device_args
+{
+	const char * device;
+	int * slot;
+} dr_test_metering_device_args_t;
 
 static aud_error_t
-dr_test_main_loop
+dr_test_session_subscribe_metering_command
 (
-	dr_test_t * test,
-	/*[out]*/ char*** array,
-	/*[out]*/ int* count
+	void * target,
+	void * args
 ) {
+	dr_test_session_t * session = (dr_test_session_t *) target;
+	dr_test_metering_device_args_t * a = (dr_test_metering_device_args_t *) args;
+	uint16_t slot;
 	aud_error_t result;
-	aud_bool_t print_prompt = AUD_TRUE;
 
-#ifdef  _WIN32
-	// set to line buffered mode.
-	SetConsoleMode(GetStdHandle(STD_INPUT_HANDLE),ENABLE_LINE_INPUT|ENABLE_ECHO_INPUT|ENABLE_PROCESSED_INPUT);
-#else
-	dante_sockets_t select_sockets;
-#endif
+	if (!session->metering)
+	{
+		return AUD_ERR_INVALIDSTATE;
+	}
+	result = dr_test_metering_subscribe(session->metering, a->device, &slot);
+	if (result == AUD_SUCCESS)
+	{
+		*a->slot = slot;
+	}
+	return result;
+}
 
-	DR_TEST_PRINT("\nDante Routing API test program. Type '?' for help\n\n");
-	
-	while(g_test_running)
-	{		
-		char buf[BUFSIZ];
-		
+// Subscribes to the metering of 'device' and returns its slot in the device
+// table of the ring. Subscribing twice returns the same slot.
+__declspec(dllexport) int session_subscribe_metering
+(
+	/*[in/out]*/ dr_test_session_t** session,
+	/*[in]*/ const char* device,
+	/*[out]*/ int* slot
+)
+{
+	dr_test_metering_device_args_t args = { device, slot };
+	*slot = -1;
+	return dr_test_submit_to(&(*session)->commands, &(*session)->wake,
+		dr_test_session_subscribe_metering_command, *session, &args);
+}
 
-		// print prompt if needed
-		if (print_prompt)
-		{
-			const char * name = dr_device_get_name(test->device);
-			DR_TEST_PRINT("\n'%s'> ", name ? name : "");
-			fflush(stdout);
-			print_prompt = AUD_FALSE;
-		}
+static aud_error_t
+dr_test_session_unsubscribe_metering_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_session_t * session = (dr_test_session_t *) target;
+	int slot = *(const int *) args;
 
-#ifdef _WIN32
-		dapi_utils_step(test->runtime, AUD_SOCKET_INVALID, NULL);
-#else
-		dapi_utils_step(test->runtime, 0, &select_sockets);
-#endif
+	if (!session->metering)
+	{
+		return AUD_ERR_INVALIDSTATE;
+	}
+	if (slot < 0 || slot > 0xFFFF)
+	{
+		return AUD_ERR_INVALIDPARAMETER;
+	}
+	return dr_test_metering_unsubscribe(session->metering, (uint16_t) slot);
+}
 
-		// and check stdin 
-		buf[0] = '\0';
-#ifdef _WIN32
-		if (_kbhit())
-		{
-			DWORD len = 0;
-			if (!ReadConsoleA(GetStdHandle(STD_INPUT_HANDLE),buf,BUFSIZ-1,&len, 0))
-			{
-				printf("Error reading console: %d\n", GetLastError());
-			}
-			else if (len > 0)
-			{
-				buf[len] = '\0';
-			}
-			print_prompt = AUD_TRUE;
-		}
-#else
-		if (FD_ISSET(0, &select_sockets.read_fds)) // 0 is always stdin
+// Frees the slot; frames already in the ring may still name it
+__declspec(dllexport) int session_unsubscribe_metering
+(
+	/*[in/out]*/ dr_test_session_t** session,
+	/*[in]*/ int slot
+)
+{
+	return dr_test_submit_to(&(*session)->commands, &(*session)->wake,
+		dr_test_session_unsubscribe_metering_command, *session, &slot);
+}
+
+static aud_error_t
+dr_test_session_stop_metering_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_session_t * session = (dr_test_session_t *) target;
+
+	(void) args;
+	dr_test_metering_delete(session->metering);
+	session->metering = NULL;
+	return AUD_SUCCESS;
+}
+
+// Deletes the metering client and its ring; stop reading the ring first
+__declspec(dllexport) int session_stop_metering
+(
+	/*[in/out]*/ dr_test_session_t** session
+)
+{
+	return dr_test_submit_to(&(*session)->commands, &(*session)->wake,
+		dr_test_session_stop_metering_command, *session, NULL);
+}
+
+typedef struct dr_test_resolve_channels_args
+{
+	const char ** targets;
+	int count;
+	uint64_t * handles;
+	int * channel_ids;
+	int * is_label;
+} dr_test_resolve_channels_args_t;
+
+static aud_error_t
+dr_test_session_resolve_channels_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_session_t * session = (dr_test_session_t *) target;
+	dr_test_resolve_channels_args_t * a = (dr_test_resolve_channels_args_t *) args;
+	int i;
+
+	for (i = 0; i < a->count; i++)
+	{
+		const char * text = a->targets[i];
+		const char * at = text ? strchr(text, '@') : NULL;
+		const dr_test_name_entry_t * entry = NULL;
+
+		if (at && at - text < DANTE_NAME_LENGTH)
 		{
-			if (fgets(buf, BUFSIZ, stdin) == NULL)
-			{
-				result = aud_error_get_last();
-				if (feof(stdin))
-				{
-					DR_TEST_PRINT("Exiting...\n");
-					return AUD_SUCCESS;
-				}
-				else if (result == AUD_ERR_INTERRUPTED)
-				{
-					clearerr(stdin);
-				}
-				else
-				{
-					DR_TEST_ERROR("Exiting with %s\n", dr_error_message(result, g_test_errbuf));
-					return result;
-				}
-			}
-			print_prompt = AUD_TRUE;
+			dante_name_t channel;
+			memcpy(channel, text, at - text);
+			channel[at - text] = '\0';
+			entry = dr_test_name_index_find(&session->names, at + 1, channel);
 		}
-#endif
+		a->handles[i] = entry ? (uint64_t) (uintptr_t) entry->owner : 0;
+		a->channel_ids[i] = entry ? entry->channel_id : 0;
+		a->is_label[i] = entry ? entry->is_label : AUD_FALSE;
+	}
+	return AUD_SUCCESS;
+}
+
+// Resolves 'count' subscription targets "channel@device" against the tx
+// channel names and labels of every device open in the session, without any
+// network traffic. A canonical name wins over a label, as for a subscription.
+// For each target, handles[i] receives the device handle (0 if unresolved),
+// channel_ids[i] the tx channel id and is_label[i] whether a label matched.
+// The index follows routing change callbacks; devices whose tx channels or
+// labels are still stale resolve nothing from them.
+__declspec(dllexport) int session_resolve_channels
+(
+	/*[in/out]*/ dr_test_session_t** session,
+	/*[in]*/ const char** targets,
+	/*[in]*/ int count,
+	/*[out]*/ uint64_t* handles,
+	/*[out]*/ int* channel_ids,
+	/*[out]*/ int* is_label
+)
+{
+	dr_test_resolve_channels_args_t args = { targets, count, handles, channel_ids, is_label };
+
+	if (count < 1 || !targets || !handles || !channel_ids || !is_label)
+	{
+		return AUD_ERR_INVALIDPARAMETER;
+	}
+	return dr_test_submit_to(&(*session)->commands, &(*session)->wake,
+		dr_test_session_resolve_channels_command, *session, &args);
+}
+
+// Stops the loop and waits for its thread. Returns the error that ended the
+// loop early, if any.
+__declspec(dllexport) int session_stop_loop
+(
+	/*[in/out]*/ dr_test_session_t** session
+)
+{
+	return dr_test_session_stop_loop(*session);
+}
+
+typedef struct dr_test_refresh_policy_args
+{
+	uint32_t subscribed;
+	const uint32_t * max_age_ms;
+	int count;
+} dr_test_refresh_policy_args_t;
+
+static aud_error_t
+dr_test_set_refresh_policy_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_t * test = (dr_test_t *) target;
+	dr_test_refresh_policy_args_t * a = (dr_test_refresh_policy_args_t *) args;
+	int c;
+
+	test->options.subscribed_components = a->subscribed & DR_TEST_ALL_COMPONENTS;
+	for (c = 0; c < DR_DEVICE_COMPONENT_COUNT; c++)
+	{
+		test->options.max_age_ms[c] = (c < a->count) ? a->max_age_ms[c] : 0;
+	}
+	// newly subscribed components are fetched right away
+	dr_test_refresh(test, test->options.subscribed_components);
+	return AUD_SUCCESS;
+}
 
-		// if we got some input then process the line
-		if (buf[0])
-		{
-		#ifdef _WIN32
-			DR_TEST_PRINT("\n");
-		#endif
-			result = dr_test_process_line(test, buf, array, count);
-			if (result != AUD_SUCCESS)
-			{
-				break;
-			}
-		}
+// Chooses which components (bit per dr_device_component_t) are kept up to date
+// from the moment the device becomes active; the others are fetched the first
+// time they are queried. max_age_ms holds up to one max age per component,
+// 0 for never, and re-fetches subscribed and queried components once their
+// data is older. Set it right after opening to avoid the initial updates.
+__declspec(dllexport) int set_refresh_policy
+(
+	/*[in/out]*/ dr_test_t** test,
+	/*[in]*/ uint32_t subscribed,
+	/*[in]*/ const uint32_t* max_age_ms,
+	/*[in]*/ int count
+)
+{
+	dr_test_refresh_policy_args_t args = { subscribed, max_age_ms, count };
+
+	if (count < 0 || (count && !max_age_ms))
+	{
+		return AUD_ERR_INVALIDPARAMETER;
 	}
+	return dr_test_submit(*test, dr_test_set_refresh_policy_command, &args);
+}
+
+typedef struct dr_test_event_callback_args
+{
+	DR_TEST_EVENT_CALLBACK callback;
+	void * context;
+} dr_test_event_callback_args_t;
+
+static aud_error_t
+dr_test_set_event_callback_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_t * test = (dr_test_t *) target;
+	dr_test_event_callback_args_t * a = (dr_test_event_callback_args_t *) args;
+
+	test->event_callback = a->callback;
+	test->event_context = a->context;
+
+	// events queued before, e.g. while opening the device, are signalled by the next step
+	test->signalled_head = test->events.tail;
 	return AUD_SUCCESS;
 }
 
-//----------------------------------------------------------
-// Entry point
-//----------------------------------------------------------
+// Registers a callback told with 'context' that events of this handle wait for
+// drain_events. It is called on the stepping thread at the end of each step that
+// queued events, so draining from it is safe. Takes effect between two steps.
+__declspec(dllexport) int set_event_callback
+(
+	/*[in/out]*/ dr_test_t** test,
+	/*[in]*/ DR_TEST_EVENT_CALLBACK callback,
+	/*[in]*/ void* context
+)
+{
+	dr_test_event_callback_args_t args = { callback, context };
+	return dr_test_submit(*test, dr_test_set_event_callback_command, &args);
+}
 
-__declspec(dllexport) int RunDll
+// Copies up to 'capacity' pending events of this handle into 'events'.
+// 'dropped' receives the total number of events lost to a full ring so far.
+// Must be called from one thread at a time per handle.
+__declspec(dllexport) int drain_events
 (
-	/*[in]*/ int argc,
-	/*[in]*/ char* argv[],
+	/*[in/out]*/ dr_test_t** test,
+	/*[out]*/ dr_test_event_t* events,
+	/*[in]*/ int capacity,
+	/*[out]*/ int* written,
+	/*[out]*/ uint32_t* dropped
+)
+{
+	*written = (int) dr_test_event_ring_drain(&(*test)->events, events, capacity > 0 ? (unsigned int) capacity : 0);
+	*dropped = (*test)->events.dropped;
+	return AUD_SUCCESS;
+}
+
+typedef struct dr_test_process_line_args
+{
+	char * input;
+	char *** array;
+	int * count;
+} dr_test_process_line_args_t;
+
+static aud_error_t
+dr_test_process_line_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_process_line_args_t * a = (dr_test_process_line_args_t *) args;
+	return dr_test_process_line((dr_test_t *) target, a->input, a->array, a->count);
+}
+
+__declspec(dllexport) int process_line
+(
+	/*[in/out]*/ dr_test_t** test,
 	/*[in]*/ char* input,
 	/*[out]*/ char*** array,
 	/*[out]*/ int* count
 )
 {
-	dr_test_t test;
-	aud_error_t result = AUD_SUCCESS;
+	dr_test_process_line_args_t args = { input, array, count };
+	return dr_test_submit(*test, dr_test_process_line_command, &args);
+}
 
-	DR_TEST_PRINT("%s: Routing API version %u.%u.%u\n",
-		argv[0], DR_VERSION_MAJOR, DR_VERSION_MINOR, DR_VERSION_BUGFIX);
-	
-	memset(&test, 0, sizeof(dr_test_t));
+//----------------------------------------------------------
+// Mutating requests
+//----------------------------------------------------------
 
-	dr_test_parse_options(&test.options, argc, argv);
+// Each call sends one request and returns its token. The completion is
+// reported as a DR_TEST_EVENT_REQUEST_COMPLETED event carrying the same token.
 
-	// create an environment
-#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__EMBEDDED
-	dapi_config_t * dapiConfig = dapi_config_new();
-	if (dapiConfig)
-	{
-		dante_domain_handler_config_t * domainHandlerConfig = dapi_config_get_domain_handler_config(dapiConfig);
+typedef struct dr_test_channel_request_args
+{
+	unsigned int channel;
+	const char * text;
+	uint64_t * token;
+} dr_test_channel_request_args_t;
 
-		if (domainHandlerConfig)
-		{
-#ifdef WIN32
-			dante_domain_handler_config_set_port(domainHandlerConfig, test.options.domain_handler.port_no);
-#else
-			dante_domain_handler_config_set_unix_path(domainHandlerConfig, test.options.domain_handler.socket_path);
-#endif
-		}
+static aud_error_t
+dr_test_set_rxchannel_name_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_channel_request_args_t * a = (dr_test_channel_request_args_t *) args;
+	return dr_test_rxchannel_set_name((dr_test_t *) target, a->channel, a->text, a->token);
+}
+
+static aud_error_t
+dr_test_subscribe_rxchannel_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_channel_request_args_t * a = (dr_test_channel_request_args_t *) args;
+	char buf[BUFSIZ];
+
+	if (!a->text)
+	{
+		return dr_test_rxchannel_subscribe((dr_test_t *) target, a->channel, NULL, a->token);
 	}
+	aud_strlcpy(buf, a->text, sizeof(buf));
+	return dr_test_rxchannel_subscribe((dr_test_t *) target, a->channel, buf, a->token);
+}
 
-#if DAPI_HAS_CONFIGURABLE_MDNS_SERVER_PORT == 1
-	if (test.options.mdns_server_port > 0)
+static aud_error_t
+dr_test_add_txlabel_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_channel_request_args_t * a = (dr_test_channel_request_args_t *) args;
+	char buf[DANTE_NAME_LENGTH];
+
+	aud_strlcpy(buf, a->text, sizeof(buf));
+	return dr_test_add_txlabel((dr_test_t *) target, a->channel, buf, a->token);
+}
+
+__declspec(dllexport) int set_rxchannel_name
+(
+	/*[in/out]*/ dr_test_t** test,
+	/*[in]*/ int channel,
+	/*[in]*/ const char* name,
+	/*[out]*/ uint64_t* token
+)
+{
+	dr_test_channel_request_args_t args = { (unsigned int) channel, name, token };
+
+	*token = 0;
+	return dr_test_submit(*test, dr_test_set_rxchannel_name_command, &args);
+}
+
+__declspec(dllexport) int subscribe_rxchannel
+(
+	/*[in/out]*/ dr_test_t** test,
+	/*[in]*/ int channel,
+	/*[in]*/ const char* subscription, // "channel@device", or NULL to unsubscribe
+	/*[out]*/ uint64_t* token
+)
+{
+	dr_test_channel_request_args_t args = { (unsigned int) channel, subscription, token };
+
+	*token = 0;
+	return dr_test_submit(*test, dr_test_subscribe_rxchannel_command, &args);
+}
+
+__declspec(dllexport) int add_txlabel
+(
+	/*[in/out]*/ dr_test_t** test,
+	/*[in]*/ int channel,
+	/*[in]*/ const char* label,
+	/*[out]*/ uint64_t* token
+)
+{
+	dr_test_channel_request_args_t args = { (unsigned int) channel, label, token };
+
+	*token = 0;
+	return dr_test_submit(*test, dr_test_add_txlabel_command, &args);
+}
+
+typedef struct dr_test_txlabels_args
+{
+	const int * channels;
+	const char ** labels;
+	int count;
+	int * num_changes;
+	uint64_t * token;
+} dr_test_txlabels_args_t;
+
+static aud_error_t
+dr_test_set_txlabels_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_t * test = (dr_test_t *) target;
+	dr_test_txlabels_args_t * a = (dr_test_txlabels_args_t *) args;
+	dr_batch_txlabel_t * entries;
+	unsigned int n, num_removals;
+	aud_error_t result;
+
+	if (!test->device)
 	{
-		dapi_config_set_mdns_server_port(dapiConfig, test.options.mdns_server_port);
+		return AUD_ERR_INVALIDSTATE;
 	}
-#endif
+	result = dr_test_diff_txlabels(test, a->channels, a->labels, (unsigned int) a->count, &entries, &n, &num_removals);
+	if (result != AUD_SUCCESS || !n)
+	{
+		return result;
+	}
+	*a->num_changes = (int) n;
+	return dr_test_bulk_txlabels(test, entries, n, num_removals, a->token);
+}
 
-	result = dapi_new_config(dapiConfig, &test.dapi);
+// Gives every tx channel in 'channels' exactly the labels paired with it;
+// a NULL or empty label only lists the channel, so a channel listed that way
+// alone loses all its labels. Channels not listed keep theirs. Only the
+// differences to the device's current labels are sent, as add, move and
+// remove entries of dr_device_batch_txlabel batches pipelined like
+// set_rxchannel_names, except that the removals complete before the other
+// entries are sent. 'num_changes' receives the number of entries sent;
+// when it is 0 the labels were already in place, 'token' is 0 and no
+// completion event follows. Fails with AUD_ERR_INVALIDSTATE while the
+// device's labels are stale.
+__declspec(dllexport) int set_txlabels
+(
+	/*[in/out]*/ dr_test_t** test,
+	/*[in]*/ const int* channels,
+	/*[in]*/ const char** labels,
+	/*[in]*/ int count,
+	/*[out]*/ int* num_changes,
+	/*[out]*/ uint64_t* token
+)
+{
+	dr_test_txlabels_args_t args = { channels, labels, count, num_changes, token };
 
-	dapi_config_delete(dapiConfig);
-#else
-	result = dapi_new(&test.dapi);
-#endif
-	if (result != AUD_SUCCESS)
+	*num_changes = 0;
+	*token = 0;
+	if (count < 1 || !channels || !labels)
 	{
-		DR_TEST_ERROR("Error initialising environment: %s\n", dr_error_message(result, g_test_errbuf));
-		goto cleanup;
+		return AUD_ERR_INVALIDPARAMETER;
 	}
+	return dr_test_submit(*test, dr_test_set_txlabels_command, &args);
+}
 
-	test.env = dapi_get_env(test.dapi);
-	test.handler = dapi_get_domain_handler(test.dapi);
-	test.runtime = dapi_get_runtime(test.dapi);
+typedef struct dr_test_txflows_args
+{
+	const dr_test_txflow_spec_t * flows;
+	int count;
+	uint64_t * token;
+} dr_test_txflows_args_t;
 
-	//aud_log_set_threshold(aud_env_get_log(test.env), AUD_LOGTYPE_STDOUT, AUD_LOG_DEBUG);
+static aud_error_t
+dr_test_provision_txflows_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_t * test = (dr_test_t *) target;
+	dr_test_txflows_args_t * a = (dr_test_txflows_args_t *) args;
 
-	// create a devices structure and set its options
-	result = dr_devices_new_dapi(test.dapi, &test.devices);
-	if (result != AUD_SUCCESS)
+	if (!test->device)
 	{
-		DR_TEST_ERROR("Error creating device factory: %s\n", dr_error_message(result, g_test_errbuf));
-		goto cleanup;
+		return AUD_ERR_INVALIDSTATE;
 	}
-	dr_devices_set_context(test.devices, &test);
-	if (test.options.num_handles)
+	return dr_test_bulk_txflows(test, a->flows, (unsigned int) a->count, a->token);
+}
+
+// Creates, replaces or deletes 'count' tx flows. Flows left at the device's
+// default latency, fpp and encoding are sent DR_TEST_MAX_BATCH per
+// dr_device_batch_txflow request, pipelined like set_rxchannel_names; the
+// batch command cannot carry those settings, so the other flows follow with
+// one flow config commit each. A config cannot replace a flow, so an existing
+// flow replaced that way is deleted by a leading batch that completes first.
+// Chunk events number the entries in that order: those deletions, batched
+// flows, then flow configs. Fails with AUD_ERR_INVALIDPARAMETER, sending nothing,
+// if a flow has more than DR_BATCH_TX_FLOW_MAX_SLOTS slots or an unknown channel.
+__declspec(dllexport) int provision_txflows
+(
+	/*[in/out]*/ dr_test_t** test,
+	/*[in]*/ const dr_test_txflow_spec_t* flows,
+	/*[in]*/ int count,
+	/*[out]*/ uint64_t* token
+)
+{
+	dr_test_txflows_args_t args = { flows, count, token };
+
+	*token = 0;
+	if (count < 1 || !flows)
 	{
-		result = dr_devices_set_num_handles(test.devices, test.options.num_handles);
-		if (result != AUD_SUCCESS)
-		{
-			DR_TEST_ERROR("Error setting num_handles to %d: %s\n", test.options.num_handles, dr_error_message(result, g_test_errbuf));
-			goto cleanup;
-		}
+		return AUD_ERR_INVALIDPARAMETER;
 	}
-	if (test.options.request_limit)
+	return dr_test_submit(*test, dr_test_provision_txflows_command, &args);
+}
+
+typedef struct dr_test_rxchannel_names_args
+{
+	const int * channels;
+	const char ** names;
+	int count;
+	uint64_t * token;
+} dr_test_rxchannel_names_args_t;
+
+static aud_error_t
+dr_test_set_rxchannel_names_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_rxchannel_names_args_t * a = (dr_test_rxchannel_names_args_t *) args;
+	dr_batch_rxlabel_t * labels;
+	int i;
+
+	labels = (dr_batch_rxlabel_t *) malloc(a->count * sizeof(dr_batch_rxlabel_t));
+	if (!labels)
 	{
-		result = dr_devices_set_request_limit(test.devices, test.options.request_limit);
-		if (result != AUD_SUCCESS)
-		{
-			DR_TEST_ERROR("Error setting request_limit to %d: %s\n", test.options.request_limit, dr_error_message(result, g_test_errbuf));
-			goto cleanup;
-		}
+		return AUD_ERR_NOMEMORY;
+	}
+	for (i = 0; i < a->count; i++)
+	{
+		labels[i].rxchannel_id = (dante_id_t) a->channels[i];
+		aud_strlcpy(labels[i].label, a->names[i] ? a->names[i] : "", DANTE_NAME_LENGTH);
 	}
+	return dr_test_bulk_rxchannel_set_names((dr_test_t *) target, labels, (unsigned int) a->count, a->token);
+}
 
-#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
-	result = dapi_utils_ddm_connect_blocking(&test.options.ddm_config, test.handler, test.runtime, &g_test_running);
-	if (result != AUD_SUCCESS)
+// Renames 'count' rx channels, channels[i] to names[i] (NULL or "" clears the name).
+// The names are sent in batches of DR_TEST_MAX_BATCH with as many batches in
+// flight as the request limit allows. One completion event carrying the
+// returned token reports the first failure, if any.
+__declspec(dllexport) int set_rxchannel_names
+(
+	/*[in/out]*/ dr_test_t** test,
+	/*[in]*/ const int* channels,
+	/*[in]*/ const char** names,
+	/*[in]*/ int count,
+	/*[out]*/ uint64_t* token
+)
+{
+	dr_test_rxchannel_names_args_t args = { channels, names, count, token };
+
+	*token = 0;
+	if (count < 1 || !channels || !names)
 	{
-			DR_TEST_ERROR("Error connecting to DDM: %s\n", dr_error_message(result, g_test_errbuf));
-			goto cleanup;
+		return AUD_ERR_INVALIDPARAMETER;
 	}
-#endif
+	return dr_test_submit(*test, dr_test_set_rxchannel_names_command, &args);
+}
 
-#ifdef DANTE_ROUTING_TEST_CUSTOM_CONFIG_OPTIONS
-	DANTE_ROUTING_TEST_CUSTOM_CONFIG_OPTIONS(&test);
-#endif
+typedef struct dr_test_subscriptions_args
+{
+	const int * channels;
+	const char ** tx_channels;
+	const char ** tx_devices;
+	int count;
+	uint64_t * token;
+} dr_test_subscriptions_args_t;
 
-	// Print current domain info before doing anything else
-	printf("Current domain configuration:\n");
-	dapi_utils_print_domain_handler_info(test.handler);
-	dante_domain_handler_set_context(test.handler, &test);
-	dante_domain_handler_set_event_fn(test.handler, dr_test_event_handle_ddh_changes);
+static aud_error_t
+dr_test_subscribe_rxchannels_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_subscriptions_args_t * a = (dr_test_subscriptions_args_t *) args;
+	dr_batch_subscription_t * subscriptions;
+	int i;
 
-#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__EMBEDDED
-	// Some embedded platforms support asynchronous connection to the dante device.
-	// Opening a device is not possible while in the NONE domain,
-	// so wait till domain uuid is available
-	while (IS_NO_DOMAIN_UUID(dr_devices_get_domain_uuid(test.devices)))
+	subscriptions = (dr_batch_subscription_t *) malloc(a->count * sizeof(dr_batch_subscription_t));
+	if (!subscriptions)
 	{
-		dapi_utils_step(test.runtime, AUD_SOCKET_INVALID, NULL);
+		return AUD_ERR_NOMEMORY;
 	}
-#endif
-
-#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
-	dante_domain_info_t info = dante_domain_handler_get_current_domain(test.handler);
-	aud_bool_t skip_device_open = AUD_FALSE;
-	//Is current domain the one that we want to be on?
-	if (test.options.ddm_config.domain[0] && strcmp(info.name, test.options.ddm_config.domain))
+	for (i = 0; i < a->count; i++)
 	{
-		if (IS_ADHOC_DOMAIN_UUID(info.uuid))
+		const char * channel = a->tx_channels[i];
+		const char * device = a->tx_devices[i];
+
+		subscriptions[i].rxchannel_id = (dante_id_t) a->channels[i];
+		if (channel && channel[0] && device && device[0])
 		{
-			printf("WARNING: Current domain set to ADHOC\n\n");
-			printf("WARNING: Unable to open the device as requested domain is not available\n");
-			skip_device_open = AUD_TRUE;
+			aud_strlcpy(subscriptions[i].channel, channel, DANTE_NAME_LENGTH);
+			aud_strlcpy(subscriptions[i].device, device, DANTE_NAME_LENGTH);
 		}
-	}
-	if (!skip_device_open)
-	{
-		// Now open a device connection
-		result = dr_test_open(&test);
-		if (result != AUD_SUCCESS)
+		else
 		{
-			goto cleanup;
+			subscriptions[i].channel[0] = '\0';
+			subscriptions[i].device[0] = '\0';
 		}
 	}
+	return dr_test_bulk_rxchannel_subscribe((dr_test_t *) target, subscriptions, (unsigned int) a->count, a->token);
+}
+
+// Subscribes 'count' rx channels, channels[i] to "tx_channels[i]@tx_devices[i]".
+// A NULL or empty tx channel or device unsubscribes the rx channel.
+// Sent like set_rxchannel_names; in addition every batch reports a
+// DR_TEST_EVENT_BULK_CHUNK_COMPLETED event with the first entry it covers.
+__declspec(dllexport) int subscribe_rxchannels
+(
+	/*[in/out]*/ dr_test_t** test,
+	/*[in]*/ const int* channels,
+	/*[in]*/ const char** tx_channels,
+	/*[in]*/ const char** tx_devices,
+	/*[in]*/ int count,
+	/*[out]*/ uint64_t* token
+)
+{
+	dr_test_subscriptions_args_t args = { channels, tx_channels, tx_devices, count, token };
 
-#else
-	// Now open a device connection
-	result = dr_test_open(&test);
-	if (result != AUD_SUCCESS)
-	{
-		goto cleanup;
-	}
-#endif
-	// and run the main loop
-	//dr_test_main_loop(&test);
-
-	for (size_t i = 0; i < 15; i++)
+	*token = 0;
+	if (count < 1 || !channels || !tx_channels || !tx_devices)
 	{
-		dapi_utils_step(test.runtime, AUD_SOCKET_INVALID, NULL);
+		return AUD_ERR_INVALIDPARAMETER;
 	}
+	return dr_test_submit(*test, dr_test_subscribe_rxchannels_command, &args);
+}
 
-	result = dr_test_process_line(&test, input, array, count);
+typedef struct dr_test_subscriptions_diff_args
+{
+	dr_test_subscriptions_args_t subscriptions;
+	int * changed;
+	int * num_changed;
+} dr_test_subscriptions_diff_args_t;
 
-cleanup:
-	if (test.device)
-	{
-		dr_device_close(test.device);
-	}
-	if (test.devices)
+static aud_error_t
+dr_test_diff_subscriptions_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_t * test = (dr_test_t *) target;
+	dr_test_subscriptions_diff_args_t * a = (dr_test_subscriptions_diff_args_t *) args;
+	const dr_test_subscriptions_args_t * desired = &a->subscriptions;
+	int i, n = 0;
+
+	if (!test->device)
 	{
-		dr_devices_delete(test.devices);
+		return AUD_ERR_INVALIDSTATE;
 	}
-	if (test.dapi)
+	dr_test_refresh(test, 1u << DR_DEVICE_COMPONENT_RXCHANNELS);
+	for (i = 0; i < desired->count; i++)
 	{
-		dapi_delete(test.dapi);
+		if (dr_test_rxchannel_subscription_differs(test, (unsigned int) desired->channels[i],
+			desired->tx_channels[i], desired->tx_devices[i]))
+		{
+			a->changed[n++] = i;
+		}
 	}
-	return result;
+	*a->num_changed = n;
+	return AUD_SUCCESS;
 }
 
-__declspec(dllexport) void close_device
+// Compares the subscriptions subscribe_rxchannels would make against the
+// device's current rx channels. Writes the indices of the entries that would
+// change something to 'changed', which holds 'count' entries, and their number
+// to 'num_changed'. Channels whose state is stale are reported as changed.
+__declspec(dllexport) int diff_subscriptions
 (
-	/*[in/out]*/ dr_test_t** test
+	/*[in/out]*/ dr_test_t** test,
+	/*[in]*/ const int* channels,
+	/*[in]*/ const char** tx_channels,
+	/*[in]*/ const char** tx_devices,
+	/*[in]*/ int count,
+	/*[out]*/ int* changed,
+	/*[out]*/ int* num_changed
 )
 {
-	if ((*test)->device)
+	dr_test_subscriptions_diff_args_t args = { { channels, tx_channels, tx_devices, count, NULL }, changed, num_changed };
+
+	*num_changed = 0;
+	if (count < 0 || (count && (!channels || !tx_channels || !tx_devices || !changed)))
 	{
-		dr_device_close((*test)->device);
+		return AUD_ERR_INVALIDPARAMETER;
 	}
-	if ((*test)->devices)
+	return dr_test_submit(*test, dr_test_diff_subscriptions_command, &args);
+}
+
+static aud_error_t
+dr_test_reserve_channel_text
+(
+	dr_test_t * test,
+	unsigned int n
+) {
+	dr_test_channel_text_t * text;
+	if (n <= test->channel_text_len)
 	{
-		dr_devices_delete((*test)->devices);
+		return AUD_SUCCESS;
 	}
-	if ((*test)->dapi)
+	text = (dr_test_channel_text_t *) realloc(test->channel_text, n * sizeof(dr_test_channel_text_t));
+	if (!text)
 	{
-		dapi_delete((*test)->dapi);
+		return AUD_ERR_NOMEMORY;
 	}
+	test->channel_text = text;
+	test->channel_text_len = n;
+	return AUD_SUCCESS;
 }
 
-__declspec(dllexport) int open_device
-(
-	/*[in]*/ int argc,
-	/*[in]*/ char* argv[],
-	/*[out]*/ dr_test_t** test
-)
+typedef struct dr_test_get_channels_args
 {
-	*test = (dr_test_t*)CoTaskMemAlloc(sizeof(dr_test_t));
-	memset(*test, 0, sizeof(dr_test_t));
-
-	DR_TEST_PRINT("%s: Routing API version %u.%u.%u\n",
-		argv[0], DR_VERSION_MAJOR, DR_VERSION_MINOR, DR_VERSION_BUGFIX);
-
-	aud_error_t result = AUD_SUCCESS;
+	void * channels; // rx_channel_info_t or tx_channel_info_t
+	int capacity;
+	int * written;
+} dr_test_get_channels_args_t;
 
-	dr_test_parse_options(&(*test)->options, argc, argv);
+static aud_error_t
+dr_test_get_rxchannels_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_t * test = (dr_test_t *) target;
+	dr_test_get_channels_args_t * a = (dr_test_get_channels_args_t *) args;
+	rx_channel_info_t * channels = (rx_channel_info_t *) a->channels;
+	dr_device_t * device = test->device;
+	aud_error_t result;
+	unsigned int i, n;
 
-	// create an environment
-#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__EMBEDDED
-	dapi_config_t* dapiConfig = dapi_config_new();
-	if (dapiConfig)
+	*a->written = 0;
+	if (!device)
 	{
-		dante_domain_handler_config_t* domainHandlerConfig = dapi_config_get_domain_handler_config(dapiConfig);
-
-		if (domainHandlerConfig)
-		{
-#ifdef WIN32
-			dante_domain_handler_config_set_port(domainHandlerConfig, test.options.domain_handler.port_no);
-#else
-			dante_domain_handler_config_set_unix_path(domainHandlerConfig, test.options.domain_handler.socket_path);
-#endif
-		}
+		return AUD_ERR_INVALIDSTATE;
 	}
+	dr_test_refresh(test, 1u << DR_DEVICE_COMPONENT_RXCHANNELS);
 
-#if DAPI_HAS_CONFIGURABLE_MDNS_SERVER_PORT == 1
-	if (test.options.mdns_server_port > 0)
+	n = dr_device_num_rxchannels(device);
+	*a->written = (int) n;
+	if (a->capacity < (int) n)
 	{
-		dapi_config_set_mdns_server_port(dapiConfig, test.options.mdns_server_port);
+		return AUD_ERR_NOBUFS;
 	}
-#endif
-
-	result = dapi_new_config(dapiConfig, &test.dapi);
 
-	dapi_config_delete(dapiConfig);
-#else
-	result = dapi_new(&(*test)->dapi);
-#endif
+	result = dr_test_reserve_channel_text(test, n);
 	if (result != AUD_SUCCESS)
 	{
-		DR_TEST_ERROR("Error initialising environment: %s\n", dr_error_message(result, g_test_errbuf));
-		goto cleanup;
+		*a->written = 0;
+		return result;
 	}
+	for (i = 0; i < n; i++)
+	{
+		dr_test_get_rxchannel_info(device, dr_device_rxchannel_at_index(device, i),
+			&channels[i], &test->channel_text[i]);
+	}
+	return AUD_SUCCESS;
+}
 
-	(*test)->env = dapi_get_env((*test)->dapi);
-	(*test)->handler = dapi_get_domain_handler((*test)->dapi);
-	(*test)->runtime = dapi_get_runtime((*test)->dapi);
+static aud_error_t
+dr_test_get_txchannels_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_t * test = (dr_test_t *) target;
+	dr_test_get_channels_args_t * a = (dr_test_get_channels_args_t *) args;
+	tx_channel_info_t * channels = (tx_channel_info_t *) a->channels;
+	dr_device_t * device = test->device;
+	aud_error_t result;
+	unsigned int i, n;
 
-	//aud_log_set_threshold(aud_env_get_log(test.env), AUD_LOGTYPE_STDOUT, AUD_LOG_DEBUG);
+	*a->written = 0;
+	if (!device)
+	{
+		return AUD_ERR_INVALIDSTATE;
+	}
+	dr_test_refresh(test, 1u << DR_DEVICE_COMPONENT_TXCHANNELS);
 
-	// create a devices structure and set its options
-	result = dr_devices_new_dapi((*test)->dapi, &(*test)->devices);
-	if (result != AUD_SUCCESS)
+	n = dr_device_num_txchannels(device);
+	*a->written = (int) n;
+	if (a->capacity < (int) n)
 	{
-		DR_TEST_ERROR("Error creating device factory: %s\n", dr_error_message(result, g_test_errbuf));
-		goto cleanup;
+		return AUD_ERR_NOBUFS;
 	}
-	dr_devices_set_context((*test)->devices, test);
-	if ((*test)->options.num_handles)
+
+	result = dr_test_reserve_channel_text(test, n);
+	if (result != AUD_SUCCESS)
 	{
-		result = dr_devices_set_num_handles((*test)->devices, (*test)->options.num_handles);
-		if (result != AUD_SUCCESS)
-		{
-			DR_TEST_ERROR("Error setting num_handles to %d: %s\n", (*test)->options.num_handles, dr_error_message(result, g_test_errbuf));
-			goto cleanup;
-		}
+		*a->written = 0;
+		return result;
 	}
-	if ((*test)->options.request_limit)
+	for (i = 0; i < n; i++)
 	{
-		result = dr_devices_set_request_limit((*test)->devices, (*test)->options.request_limit);
-		if (result != AUD_SUCCESS)
-		{
-			DR_TEST_ERROR("Error setting request_limit to %d: %s\n", (*test)->options.request_limit, dr_error_message(result, g_test_errbuf));
-			goto cleanup;
-		}
+		dr_test_get_txchannel_info(dr_device_txchannel_at_index(device, i),
+			&channels[i], &test->channel_text[i]);
 	}
+	return AUD_SUCCESS;
+}
 
-#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
-	result = dapi_utils_ddm_connect_blocking(&(*test)->options.ddm_config, (*test)->handler, (*test)->runtime, &g_test_running);
-	if (result != AUD_SUCCESS)
+// Fills a caller-allocated array without parsing or printing.
+// If capacity is too small, 'written' is set to the required count and AUD_ERR_NOBUFS is returned.
+// String fields stay valid until the next channel query or step on this handle.
+__declspec(dllexport) int get_rxchannels
+(
+	/*[in/out]*/ dr_test_t** test,
+	/*[out]*/ rx_channel_info_t* channels,
+	/*[in]*/ int capacity,
+	/*[out]*/ int* written
+)
+{
+	dr_test_get_channels_args_t args = { channels, capacity, written };
+	return dr_test_submit(*test, dr_test_get_rxchannels_command, &args);
+}
+
+__declspec(dllexport) int get_txchannels
+(
+	/*[in/out]*/ dr_test_t** test,
+	/*[out]*/ tx_channel_info_t* channels,
+	/*[in]*/ int capacity,
+	/*[out]*/ int* written
+)
+{
+	dr_test_get_channels_args_t args = { channels, capacity, written };
+	return dr_test_submit(*test, dr_test_get_txchannels_command, &args);
+}
+
+typedef enum dr_test_snapshot_kind
+{
+	DR_TEST_SNAPSHOT_RXCHANNELS,
+	DR_TEST_SNAPSHOT_TXCHANNELS,
+	DR_TEST_SNAPSHOT_TXLABELS
+} dr_test_snapshot_kind_t;
+
+typedef struct dr_test_snapshot_args
+{
+	dr_test_snapshot_kind_t kind;
+	void ** snapshot;
+} dr_test_snapshot_args_t;
+
+static aud_error_t
+dr_test_snapshot_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_t * test = (dr_test_t *) target;
+	dr_test_snapshot_args_t * a = (dr_test_snapshot_args_t *) args;
+
+	*a->snapshot = NULL;
+	if (!test->device)
 	{
-		DR_TEST_ERROR("Error connecting to DDM: %s\n", dr_error_message(result, g_test_errbuf));
-		goto cleanup;
+		return AUD_ERR_INVALIDSTATE;
 	}
-#endif
+	switch (a->kind)
+	{
+	case DR_TEST_SNAPSHOT_RXCHANNELS:
+		dr_test_refresh(test, 1u << DR_DEVICE_COMPONENT_RXCHANNELS);
+		return dr_test_snapshot_rxchannels(&test->snapshot_builder, test->device, NULL, 0, a->snapshot);
+	case DR_TEST_SNAPSHOT_TXCHANNELS:
+		dr_test_refresh(test, 1u << DR_DEVICE_COMPONENT_TXCHANNELS);
+		return dr_test_snapshot_txchannels(&test->snapshot_builder, test->device, NULL, 0, a->snapshot);
+	case DR_TEST_SNAPSHOT_TXLABELS:
+		dr_test_refresh(test, 1u << DR_DEVICE_COMPONENT_TXLABELS);
+		return dr_test_snapshot_txlabels(&test->snapshot_builder, test->device, a->snapshot);
+	}
+	return AUD_ERR_INVALIDPARAMETER;
+}
 
-#ifdef DANTE_ROUTING_TEST_CUSTOM_CONFIG_OPTIONS
-	DANTE_ROUTING_TEST_CUSTOM_CONFIG_OPTIONS(&test);
-#endif
+// Snapshots are single CoTaskMemAlloc'd blobs (see dante_routing_test.h),
+// released by the caller with one CoTaskMemFree.
+__declspec(dllexport) int get_rxchannels_snapshot
+(
+	/*[in/out]*/ dr_test_t** test,
+	/*[out]*/ void** snapshot
+)
+{
+	dr_test_snapshot_args_t args = { DR_TEST_SNAPSHOT_RXCHANNELS, snapshot };
+	return dr_test_submit(*test, dr_test_snapshot_command, &args);
+}
 
-	// Print current domain info before doing anything else
-	printf("Current domain configuration:\n");
-	dapi_utils_print_domain_handler_info((*test)->handler);
-	dante_domain_handler_set_context((*test)->handler, *test);
-	dante_domain_handler_set_event_fn((*test)->handler, dr_test_event_handle_ddh_changes);
+__declspec(dllexport) int get_txchannels_snapshot
+(
+	/*[in/out]*/ dr_test_t** test,
+	/*[out]*/ void** snapshot
+)
+{
+	dr_test_snapshot_args_t args = { DR_TEST_SNAPSHOT_TXCHANNELS, snapshot };
+	return dr_test_submit(*test, dr_test_snapshot_command, &args);
+}
 
-#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__EMBEDDED
-	// Some embedded platforms support asynchronous connection to the dante device.
-	// Opening a device is not possible while in the NONE domain,
-	// so wait till domain uuid is available
-	while (IS_NO_DOMAIN_UUID(dr_devices_get_domain_uuid((*test)->devices)))
+__declspec(dllexport) int get_txlabels_snapshot
+(
+	/*[in/out]*/ dr_test_t** test,
+	/*[out]*/ void** snapshot
+)
+{
+	dr_test_snapshot_args_t args = { DR_TEST_SNAPSHOT_TXLABELS, snapshot };
+	return dr_test_submit(*test, dr_test_snapshot_command, &args);
+}
+
+typedef struct dr_test_channel_changes_args
+{
+	uint32_t since_generation;
+	uint32_t * generation;
+	int * resync;
+	void ** rx_snapshot;
+	void ** tx_snapshot;
+} dr_test_channel_changes_args_t;
+
+static aud_error_t
+dr_test_channel_changes_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_t * test = (dr_test_t *) target;
+	dr_test_channel_changes_args_t * a = (dr_test_channel_changes_args_t *) args;
+	dr_device_t * device = test->device;
+	uint32_t since_generation = a->since_generation;
+	const uint32_t * generations;
+	aud_bool_t resync;
+	aud_error_t result;
+
+	*a->generation = test->generation;
+	*a->resync = 0;
+	*a->rx_snapshot = NULL;
+	*a->tx_snapshot = NULL;
+	if (!device)
 	{
-		dapi_utils_step((*test)->runtime, AUD_SOCKET_INVALID, NULL);
+		return AUD_ERR_INVALIDSTATE;
+	}
+	dr_test_refresh(test, (1u << DR_DEVICE_COMPONENT_RXCHANNELS) | (1u << DR_DEVICE_COMPONENT_TXCHANNELS));
+	if (since_generation >= test->generation)
+	{
+		return AUD_SUCCESS;
 	}
-#endif
 
-#if DAPI_ENVIRONMENT == DAPI_ENVIRONMENT__STANDALONE
-	dante_domain_info_t info = dante_domain_handler_get_current_domain((*test)->handler);
-	aud_bool_t skip_device_open = AUD_FALSE;
-	//Is current domain the one that we want to be on?
-	if ((*test)->options.ddm_config.domain[0] && strcmp(info.name, (*test)->options.ddm_config.domain))
+	// channels were removed or tracking failed since the caller last looked:
+	// send both directions in full so the caller can replace what it has
+	resync = since_generation &&
+		(since_generation < test->rx_changes.resync || since_generation < test->tx_changes.resync);
+	*a->resync = resync;
+	if (resync || dr_test_channel_changes_since(&test->rx_changes, since_generation))
 	{
-		if (IS_ADHOC_DOMAIN_UUID(info.uuid))
+		// the channel count can only differ before tracking caught up; send everything then
+		generations = (!resync && test->rx_changes.n == dr_device_num_rxchannels(device)) ?
+			test->rx_changes.generations : NULL;
+		result = dr_test_snapshot_rxchannels(&test->snapshot_builder, device,
+			generations, since_generation, a->rx_snapshot);
+		if (result != AUD_SUCCESS)
 		{
-			printf("WARNING: Current domain set to ADHOC\n\n");
-			printf("WARNING: Unable to open the device as requested domain is not available\n");
-			skip_device_open = AUD_TRUE;
+			return result;
 		}
 	}
-	if (!skip_device_open)
+	if (resync || dr_test_channel_changes_since(&test->tx_changes, since_generation))
 	{
-		// Now open a device connection
-		result = dr_test_open(*test);
+		generations = (!resync && test->tx_changes.n == dr_device_num_txchannels(device)) ?
+			test->tx_changes.generations : NULL;
+		result = dr_test_snapshot_txchannels(&test->snapshot_builder, device,
+			generations, since_generation, a->tx_snapshot);
 		if (result != AUD_SUCCESS)
 		{
-			goto cleanup;
+			CoTaskMemFree(*a->rx_snapshot);
+			*a->rx_snapshot = NULL;
+			return result;
 		}
 	}
+	return AUD_SUCCESS;
+}
 
-#else
-	// Now open a device connection
-	result = dr_test_open(*test);
-	if (result != AUD_SUCCESS)
-	{
-		goto cleanup;
-	}
-#endif
-
-	return result;
+// Returns the rx/tx channels that changed after 'since_generation' as
+// snapshots (NULL when nothing changed) along with the current generation.
+// Pass the returned generation back in on the next call; 0 returns everything.
+// A non-zero 'resync' means channels were removed or could not be tracked:
+// the snapshots then hold every channel and replace the caller's copy.
+__declspec(dllexport) int get_channel_changes
+(
+	/*[in/out]*/ dr_test_t** test,
+	/*[in]*/ uint32_t since_generation,
+	/*[out]*/ uint32_t* generation,
+	/*[out]*/ int* resync,
+	/*[out]*/ void** rx_snapshot,
+	/*[out]*/ void** tx_snapshot
+)
+{
+	dr_test_channel_changes_args_t args = { since_generation, generation, resync, rx_snapshot, tx_snapshot };
+	return dr_test_submit(*test, dr_test_channel_changes_command, &args);
+}
 
-cleanup:
-	close_device(test);
+static aud_error_t
+dr_test_start_rxstats_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_t * test = (dr_test_t *) target;
+	const dr_test_rxstats_args_t * a = (const dr_test_rxstats_args_t *) args;
 
-	return result;
+	dr_test_rxstats_configure(&test->rxstats, a->interval_ms, a->fields, a->history);
+	return AUD_SUCCESS;
 }
 
-__declspec(dllexport) int step
+// Polls the rx flow error fields in 'fields' (bit per dante_rxflow_error_type_t)
+// of every rx flow every interval_ms, keeping the last 'history' samples per
+// flow (0 for DR_TEST_RXSTATS_DEFAULT_HISTORY). Polls clear the fields on the
+// device. An interval of 0 stops polling and drops the samples.
+__declspec(dllexport) int start_rxflow_error_stats
 (
-	/*[in/out]*/ dr_test_t** test
+	/*[in/out]*/ dr_test_t** test,
+	/*[in]*/ uint32_t interval_ms,
+	/*[in]*/ uint32_t fields,
+	/*[in]*/ uint32_t history
 )
 {
-	//(*domain_event_callback)(*test, "domain event");
-	//(*device_event_callback)(*test, "DESKTOP-VSC", "device event");
-
-	return dapi_utils_step((*test)->runtime, AUD_SOCKET_INVALID, NULL);
+	dr_test_rxstats_args_t args = { interval_ms, fields, history };
+	return dr_test_submit(*test, dr_test_start_rxstats_command, &args);
 }
 
-__declspec(dllexport) void set_domain_event_callback(ON_DOMAIN_EVENT_CALLBACK callback) {
-	domain_event_callback = callback;
-}
+typedef struct dr_test_rxstats_snapshot_args
+{
+	uint32_t since_sequence;
+	aud_bool_t skip_zero;
+	uint32_t * sequence;
+	void ** snapshot;
+} dr_test_rxstats_snapshot_args_t;
+
+static aud_error_t
+dr_test_rxstats_snapshot_command
+(
+	void * target,
+	void * args
+) {
+	dr_test_t * test = (dr_test_t *) target;
+	dr_test_rxstats_snapshot_args_t * a = (dr_test_rxstats_snapshot_args_t *) args;
 
-__declspec(dllexport) void set_device_event_callback(ON_DEVICE_EVENT_CALLBACK callback) {
-	device_event_callback = callback;
+	*a->sequence = test->rxstats.sequence;
+	*a->snapshot = NULL;
+	if (!test->device)
+	{
+		return AUD_ERR_INVALIDSTATE;
+	}
+	return dr_test_snapshot_rxstats(&test->snapshot_builder, &test->rxstats, test->device,
+		a->since_sequence, a->skip_zero, a->snapshot);
 }
 
-__declspec(dllexport) int process_line
+// Returns the samples taken after 'since_sequence' as a snapshot of
+// rxflow_stats_record_t, one record per flow interface and sample, grouped by
+// flow. Pass the returned sequence back in on the next call; samples older
+// than the history are gone. With 'skip_zero' quiet records are left out.
+__declspec(dllexport) int get_rxflow_error_stats
 (
 	/*[in/out]*/ dr_test_t** test,
-	/*[in]*/ char* input,
-	/*[out]*/ char*** array,
-	/*[out]*/ int* count
+	/*[in]*/ uint32_t since_sequence,
+	/*[in]*/ int skip_zero,
+	/*[out]*/ uint32_t* sequence,
+	/*[out]*/ void** snapshot
 )
 {
-	return dr_test_process_line(*test, input, array, count);
-}
\ No newline at end of file
+	dr_test_rxstats_snapshot_args_t args = { since_sequence, skip_zero ? AUD_TRUE : AUD_FALSE, sequence, snapshot };
+	return dr_test_submit(*test, dr_test_rxstats_snapshot_command, &args);
+}
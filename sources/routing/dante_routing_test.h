@@ -12,6 +12,7 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <pthread.h>
 #define SNPRINTF snprintf
 #endif
 #include <ctype.h>
@@ -27,8 +28,20 @@
 
 #define DR_TEST_PRINT_LEGACY_FORMATS 0
 
+// per-channel text buffers for the typed channel queries
+#define DR_TEST_FORMAT_LENGTH 512
+#define DR_TEST_FLOW_LENGTH 32
 
-extern aud_errbuf_t g_test_errbuf;
+
+// Scratch buffers shared by the helpers of one thread. Thread-local because
+// sessions and standalone devices each step on their own thread.
+#ifdef WIN32
+#define DR_TEST_THREAD_LOCAL __declspec(thread)
+#else
+#define DR_TEST_THREAD_LOCAL __thread
+#endif
+
+extern DR_TEST_THREAD_LOCAL aud_errbuf_t g_test_errbuf;
 
 //----------------------------------------------------------
 // Print functions
@@ -220,5 +233,842 @@ typedef struct tx_label_info
 	char**            labels;
 } tx_label_info_t;
 
+//----------------------------------------------------------
+// Channel queries (no console output)
+//----------------------------------------------------------
+
+// Backing storage for the generated strings of a channel info structure.
+// 'format' and 'flow' in the info point into this buffer.
+typedef struct dr_test_channel_text
+{
+	char format[DR_TEST_FORMAT_LENGTH];
+	char flow[DR_TEST_FLOW_LENGTH];
+} dr_test_channel_text_t;
+
+void
+dr_test_get_txchannel_info
+(
+	dr_txchannel_t * txc,
+	/*[out]*/ tx_channel_info_t * info,
+	/*[out]*/ dr_test_channel_text_t * text
+);
+
+void
+dr_test_get_rxchannel_info
+(
+	dr_device_t * device,
+	dr_rxchannel_t * rxc,
+	/*[out]*/ rx_channel_info_t * info,
+	/*[out]*/ dr_test_channel_text_t * text
+);
+
+//----------------------------------------------------------
+// Snapshots for .Net Wrapper
+//----------------------------------------------------------
+
+// A snapshot is a single CoTaskMemAlloc'd blob:
+//   header | fixed-size records | uint32 index table | string pool
+// All string fields are byte offsets into the string pool, identical
+// strings are stored once and DR_TEST_SNAPSHOT_NO_STRING stands for NULL.
+// The caller releases the whole snapshot with one CoTaskMemFree.
+
+#define DR_TEST_SNAPSHOT_NO_STRING 0xFFFFFFFFu
+
+typedef struct dr_test_snapshot_header
+{
+	uint32_t size;
+	uint32_t record_count;
+	uint32_t record_size;
+	uint32_t records_offset;
+	uint32_t indices_count;
+	uint32_t indices_offset;
+	uint32_t strings_size;
+	uint32_t strings_offset;
+} dr_test_snapshot_header_t;
+
+typedef struct rx_channel_record
+{
+	dante_id_t           id;
+	dante_rxstatus_t     status;
+	uint8_t              reserved;
+	aud_bool_t           stale;
+	uint32_t             name;
+	uint32_t             format;
+	dante_latency_us_t   latency;
+	aud_bool_t           muted;
+	dante_dbu_t          dbu;
+	uint16_t             reserved2;
+	uint32_t             sub;
+	uint32_t             flow;
+} rx_channel_record_t;
+
+typedef struct tx_channel_record
+{
+	dante_id_t     id;
+	dante_dbu_t    dbu;
+	aud_bool_t     stale;
+	uint32_t       name;
+	uint32_t       format;
+	aud_bool_t     enabled;
+	aud_bool_t     muted;
+} tx_channel_record_t;
+
+// labels_count entries of the index table, starting at first_label,
+// each holding a string offset
+typedef struct tx_label_record
+{
+	dante_id_t     id;
+	uint16_t       reserved;
+	aud_bool_t     is_empty;
+	uint32_t       name;
+	uint32_t       first_label;
+	uint32_t       labels_count;
+} tx_label_record_t;
+
+// Scratch space for building snapshots, kept per handle so that
+// steady-state refreshes do not allocate anything but the result.
+typedef struct dr_test_snapshot_builder
+{
+	uint32_t record_size;
+	uint32_t record_count;
+
+	uint8_t * records;
+	uint32_t records_len;
+	uint32_t records_cap;
+
+	uint32_t * indices;
+	uint32_t indices_len;
+	uint32_t indices_cap;
+
+	char * strings;
+	uint32_t strings_len;
+	uint32_t strings_cap;
+
+	// open addressing, entries are string offset + 1, 0 == empty
+	uint32_t * hash;
+	uint32_t hash_cap;
+	uint32_t hash_len;
+} dr_test_snapshot_builder_t;
+
+void
+dr_test_snapshot_builder_free
+(
+	dr_test_snapshot_builder_t * builder
+);
+
+void
+dr_test_snapshot_begin
+(
+	dr_test_snapshot_builder_t * builder,
+	uint32_t record_size
+);
+
+aud_error_t
+dr_test_snapshot_add_string
+(
+	dr_test_snapshot_builder_t * builder,
+	const char * value,
+	/*[out]*/ uint32_t * offset
+);
+
+aud_error_t
+dr_test_snapshot_add_index
+(
+	dr_test_snapshot_builder_t * builder,
+	uint32_t value
+);
+
+aud_error_t
+dr_test_snapshot_add_record
+(
+	dr_test_snapshot_builder_t * builder,
+	const void * record
+);
+
+aud_error_t
+dr_test_snapshot_finish
+(
+	dr_test_snapshot_builder_t * builder,
+	/*[out]*/ void ** snapshot
+);
+
+// 'generations' may be NULL to take every channel, otherwise only channels
+// whose generation is newer than 'since' are added
+aud_error_t
+dr_test_snapshot_rxchannels
+(
+	dr_test_snapshot_builder_t * builder,
+	dr_device_t * device,
+	const uint32_t * generations,
+	uint32_t since,
+	/*[out]*/ void ** snapshot
+);
+
+aud_error_t
+dr_test_snapshot_txchannels
+(
+	dr_test_snapshot_builder_t * builder,
+	dr_device_t * device,
+	const uint32_t * generations,
+	uint32_t since,
+	/*[out]*/ void ** snapshot
+);
+
+aud_error_t
+dr_test_snapshot_txlabels
+(
+	dr_test_snapshot_builder_t * builder,
+	dr_device_t * device,
+	/*[out]*/ void ** snapshot
+);
+
+//----------------------------------------------------------
+// Channel change tracking
+//----------------------------------------------------------
+
+// The compared fields of every channel, serialized; channel i occupies
+// bytes[offsets[i]] up to bytes[offsets[i + 1]]
+typedef struct dr_test_channel_fields
+{
+	unsigned int n;
+	uint8_t * bytes;
+	uint32_t len;
+	uint32_t cap;
+	uint32_t * offsets;
+	uint32_t offsets_cap;
+	aud_error_t error;  // first failure while adding fields
+} dr_test_channel_fields_t;
+
+// Per-channel fingerprint, fields and the generation at which the channel
+// last changed, indexed like dr_device_rxchannel_at_index /
+// dr_device_txchannel_at_index. A differing fingerprint proves a change,
+// a matching one is confirmed by comparing the fields.
+typedef struct dr_test_channel_changes
+{
+	unsigned int n;
+	uint32_t * fingerprints;
+	uint32_t * generations;
+	dr_test_channel_fields_t fields;  // of the last pass
+	dr_test_channel_fields_t next;    // being built by the current pass
+
+	// generation at which channels were removed or tracking ran out of
+	// memory; a consumer that saw an older generation has to start over
+	uint32_t resync;
+} dr_test_channel_changes_t;
+
+void
+dr_test_channel_changes_free
+(
+	dr_test_channel_changes_t * changes
+);
+
+// Recomputes fingerprints and stamps changed channels with 'generation'.
+// Returns AUD_TRUE if any channel changed or a resync became necessary.
+aud_bool_t
+dr_test_track_rxchannels
+(
+	dr_test_channel_changes_t * changes,
+	dr_device_t * device,
+	uint32_t generation
+);
+
+aud_bool_t
+dr_test_track_txchannels
+(
+	dr_test_channel_changes_t * changes,
+	dr_device_t * device,
+	uint32_t generation
+);
+
+// Stamps every channel with 'generation', e.g. when the device state changed
+void
+dr_test_channel_changes_touch
+(
+	dr_test_channel_changes_t * changes,
+	uint32_t generation
+);
+
+aud_bool_t
+dr_test_channel_changes_since
+(
+	const dr_test_channel_changes_t * changes,
+	uint32_t since
+);
+
+//----------------------------------------------------------
+// Channel name index
+//----------------------------------------------------------
+
+#define DR_TEST_NAME_NONE 0xFFFFFFFFu
+#define DR_TEST_NAME_INDEX_MIN_CAPACITY 256
+
+// A tx channel name or tx label, chained per hash bucket and per owner
+typedef struct dr_test_name_entry
+{
+	uint32_t hash;
+	uint32_t next;        // next entry in the same bucket, or next free entry
+	uint32_t next_owned;  // next entry of the same owner
+	void * owner;         // NULL while free
+	dante_id_t channel_id;
+	aud_bool_t is_label;
+	dante_name_t device;
+	dante_name_t name;
+} dr_test_name_entry_t;
+
+// Hash of "channel@device" names over the devices of a session. Each owner
+// keeps the head of its own entries, so a device is re-indexed or dropped
+// without touching the others. Names compare case-insensitively.
+typedef struct dr_test_name_index
+{
+	uint32_t capacity;
+	uint32_t num_in_use;
+	dr_test_name_entry_t * entries;
+	uint32_t free_head;
+
+	uint32_t num_buckets; // power of two, equal to capacity
+	uint32_t * buckets;   // first entry per bucket, DR_TEST_NAME_NONE if empty
+} dr_test_name_index_t;
+
+void
+dr_test_name_index_free
+(
+	dr_test_name_index_t * index
+);
+
+// Adds 'name' of tx channel 'channel_id' on 'device' to the entries of 'owner',
+// whose head is '*owned'. Empty names are skipped.
+aud_error_t
+dr_test_name_index_add
+(
+	dr_test_name_index_t * index,
+	uint32_t * owned,
+	void * owner,
+	const char * device,
+	const char * name,
+	dante_id_t channel_id,
+	aud_bool_t is_label
+);
+
+// Removes every entry on the list headed by '*owned' and empties it
+void
+dr_test_name_index_remove
+(
+	dr_test_name_index_t * index,
+	uint32_t * owned
+);
+
+// Resolves 'name' on 'device' like a subscription: a canonical channel name
+// before a label. Returns NULL if neither is known.
+const dr_test_name_entry_t *
+dr_test_name_index_find
+(
+	const dr_test_name_index_t * index,
+	const char * device,
+	const char * name
+);
+
+//----------------------------------------------------------
+// Rx flow error statistics
+//----------------------------------------------------------
+
+// Fields kept per sample, the first DR_TEST_RXSTATS_MAX_FIELDS dante_rxflow_error_type_t
+#define DR_TEST_RXSTATS_MAX_FIELDS 8
+#define DR_TEST_RXSTATS_DEFAULT_HISTORY 60
+#define DR_TEST_RXSTATS_NO_FIELD (-1)
+
+// One poll of a device: every rx flow error field of every flow and interface
+typedef struct dr_test_rxstats_sample
+{
+	uint32_t sequence;     // 1 for the first poll
+	uint32_t fields;       // fields read, bit per dante_rxflow_error_type_t
+	uint32_t interval_ms;  // local time since the previous poll
+	uint32_t timestamp_seconds;    // device time of the first field read
+	uint32_t timestamp_subseconds;
+} dr_test_rxstats_sample_t;
+
+// Polls clear the fields on the device, so each sample holds what was counted
+// during one interval. All flows are sampled together and share one ring of
+// 'history' samples (plus the one being gathered):
+//   deltas[slot][(interface * max_rxflows + flow_index) * DR_TEST_RXSTATS_MAX_FIELDS + field]
+typedef struct dr_test_rxstats
+{
+	uint32_t interval_ms;  // 0 while stopped
+	uint32_t fields;       // requested fields
+	uint32_t history;
+
+	uint16_t num_interfaces;
+	uint16_t max_rxflows;
+	uint32_t sequence;     // last complete sample
+	dr_test_rxstats_sample_t * samples;
+	uint32_t * deltas;
+
+	// the poll in progress
+	uint32_t pending;      // fields with a request in flight
+	aud_utime_t last_poll;
+	aud_utime_t next_poll;
+} dr_test_rxstats_t;
+
+// Snapshot record: one flow interface in one sample
+typedef struct rxflow_stats_record
+{
+	uint32_t    sequence;
+	uint32_t    interval_ms;
+	uint32_t    timestamp_seconds;
+	uint32_t    timestamp_subseconds;
+	dante_id_t  flow_id;
+	uint16_t    interface_index;
+	uint32_t    name;      // flow name
+	uint32_t    fields;    // valid entries of deltas and rates
+	uint32_t    deltas[DR_TEST_RXSTATS_MAX_FIELDS];
+	float       rates[DR_TEST_RXSTATS_MAX_FIELDS]; // per second
+} rxflow_stats_record_t;
+
+// Sets the schedule; history and the ring layout take effect with the next
+// dr_test_rxstats_resize. An interval of 0 stops polling and frees the rings.
+void
+dr_test_rxstats_configure
+(
+	dr_test_rxstats_t * stats,
+	uint32_t interval_ms,
+	uint32_t fields,
+	uint32_t history
+);
+
+// (Re)allocates the rings for the device's current dimensions. Samples are
+// dropped if anything changed.
+aud_error_t
+dr_test_rxstats_resize
+(
+	dr_test_rxstats_t * stats,
+	uint16_t num_interfaces,
+	uint16_t max_rxflows
+);
+
+void
+dr_test_rxstats_free
+(
+	dr_test_rxstats_t * stats
+);
+
+// Starts gathering the next sample from the requests sent for 'fields'
+void
+dr_test_rxstats_begin_poll
+(
+	dr_test_rxstats_t * stats,
+	const aud_utime_t * now,
+	uint32_t fields
+);
+
+// Ends the request for 'field': stores 'values' (num_interfaces * max_rxflows,
+// as returned by dr_device_get_rxflow_error_fields) or, if NULL, drops the field.
+// The sample is complete after the last field; one without any field is dropped.
+void
+dr_test_rxstats_end_field
+(
+	dr_test_rxstats_t * stats,
+	dante_rxflow_error_type_t field,
+	const uint32_t * values,
+	const dante_rxflow_error_timestamp_t * timestamp
+);
+
+// Adds a record per flow interface of every kept sample newer than 'since'.
+// With 'skip_zero' only records with a non-zero delta are added.
+aud_error_t
+dr_test_snapshot_rxstats
+(
+	dr_test_snapshot_builder_t * builder,
+	const dr_test_rxstats_t * stats,
+	dr_device_t * device,
+	uint32_t since,
+	aud_bool_t skip_zero,
+	/*[out]*/ void ** snapshot
+);
+
+//----------------------------------------------------------
+// Conmon metering
+//----------------------------------------------------------
+
+// Peak levels in dBFS. Conmon sends 0..-126 dB in 0.5 dB steps and two markers
+#define DR_TEST_METER_CLIP_DB 0.5f     // above full scale: the device reported clipping
+#define DR_TEST_METER_MUTE_DB -127.0f  // muted or no signal
+#define DR_TEST_METER_DEFAULT_CAPACITY 256
+
+// Fixed-layout metering ring shared with the .Net wrapper, read in place by
+// managed code. One block holds this header, a slot per metered device and
+// 'capacity' frames of 'frame_size' bytes. Frames are overwritten oldest
+// first and carry the head value they were written at, so a reader can tell
+// a complete frame from one being rewritten:
+//   n = devices[d].last_frame, frame (n - 1) & (capacity - 1)
+//   copy the frame; it is valid if its sequence is still n after the copy
+typedef struct dr_test_meter_ring
+{
+	uint32_t size;             // bytes of the whole block
+	uint32_t capacity;         // frames, a power of two
+	uint32_t frame_size;
+	uint32_t frames_offset;
+	uint32_t devices_offset;
+	uint16_t max_devices;
+	uint16_t max_channels;     // peaks per direction in a frame
+	volatile uint32_t head;    // frames written so far
+	volatile uint32_t truncated; // messages with more than max_channels peaks
+} dr_test_meter_ring_t;
+
+typedef struct dr_test_meter_device
+{
+	volatile uint32_t last_frame;  // head value of the device's latest frame, 0 for none
+	volatile uint16_t rxstatus;    // conmon_rxstatus_t of the subscription
+	volatile uint16_t in_use;
+	char name[DANTE_NAME_LENGTH];
+} dr_test_meter_device_t;
+
+// Followed by max_channels tx peaks, then max_channels rx peaks, as float dBFS
+typedef struct dr_test_meter_frame
+{
+	volatile uint32_t sequence;  // head value of the frame, 0 while it's written
+	uint16_t device;             // slot in the device table
+	uint16_t seqnum;             // conmon message sequence number
+	uint16_t num_tx;
+	uint16_t num_rx;
+	uint32_t timestamp_ms;       // local clock, wraps
+} dr_test_meter_frame_t;
+
+// Meter ballistics, shared with the .Net wrapper. Levels rise with the
+// attack time constant and fall linearly; the hold value keeps the highest
+// peak for hold_ms, then falls towards the level.
+typedef struct dr_test_meter_ballistics
+{
+	uint32_t rate_hz;             // view frames per second, 0 stops publishing
+	float attack_ms;              // 0 for instant
+	float release_db_per_s;
+	float hold_ms;
+	float hold_decay_db_per_s;
+	float clip_hold_ms;           // 0 latches clips until cleared
+} dr_test_meter_ballistics_t;
+
+#define DR_TEST_METER_MAX_RATE_HZ 1000
+#define DR_TEST_METER_VIEW_FRAMES 3
+// a device without metering messages for this long reads as muted
+#define DR_TEST_METER_STALE_MS 1000
+
+// View levels are attenuations in 0.5 dB steps: 0 is full scale, 252 is -126 dB
+#define DR_TEST_METER_VIEW_MUTE 254
+#define DR_TEST_METER_VIEW_CLIP 0x01          // clipped during the frame
+#define DR_TEST_METER_VIEW_CLIP_LATCHED 0x02  // clipped since cleared or within clip_hold_ms
+
+// Fixed-layout view shared with the .Net wrapper: DR_TEST_METER_VIEW_FRAMES
+// frames published round robin at the ballistics rate, each followed by
+//   channels[max_devices][2 (tx, rx)][max_channels]
+// Same sequence check as the ring: copy frame (n - 1) % DR_TEST_METER_VIEW_FRAMES
+// for n = head, it is valid if its sequence is still n after the copy.
+typedef struct dr_test_meter_view
+{
+	uint32_t size;
+	uint32_t frame_size;
+	uint32_t frames_offset;
+	uint16_t max_devices;
+	uint16_t max_channels;
+	volatile uint32_t rate_hz;
+	volatile uint32_t head;       // frames published so far
+} dr_test_meter_view_t;
+
+typedef struct dr_test_meter_view_frame
+{
+	volatile uint32_t sequence;   // head value of the frame, 0 while it's written
+	uint32_t timestamp_ms;        // local clock, wraps
+	uint32_t interval_ms;         // since the previous frame
+	uint32_t reserved;
+} dr_test_meter_view_frame_t;
+
+typedef struct dr_test_meter_view_channel
+{
+	uint8_t level;
+	uint8_t hold;
+	uint8_t flags;
+	uint8_t reserved;
+} dr_test_meter_view_channel_t;
+
+// Conmon client receiving the metering channel of the subscribed devices,
+// stepped by the runtime of the dapi it was created from
+typedef struct dr_test_metering dr_test_metering_t;
+
+aud_error_t
+dr_test_metering_new
+(
+	dapi_t * dapi,
+	uint16_t port,           // 0 for the conmon default
+	uint16_t max_devices,
+	uint16_t max_channels,
+	uint32_t capacity,       // rounded up to a power of two, 0 for DR_TEST_METER_DEFAULT_CAPACITY
+	dr_test_metering_t ** metering
+);
+
+void
+dr_test_metering_delete
+(
+	dr_test_metering_t * metering
+);
+
+dr_test_meter_ring_t *
+dr_test_metering_ring
+(
+	dr_test_metering_t * metering
+);
+
+// Returns the slot of the device in the ring, subscribing once conmon is ready
+aud_error_t
+dr_test_metering_subscribe
+(
+	dr_test_metering_t * metering,
+	const char * device,
+	uint16_t * slot
+);
+
+aud_error_t
+dr_test_metering_unsubscribe
+(
+	dr_test_metering_t * metering,
+	uint16_t slot
+);
+
+// Starts or changes the ballistics stage and returns its view, valid as long
+// as the metering client
+aud_error_t
+dr_test_metering_set_ballistics
+(
+	dr_test_metering_t * metering,
+	const dr_test_meter_ballistics_t * ballistics,
+	dr_test_meter_view_t ** view
+);
+
+// Clears the latched clips of one slot, or of every slot for -1
+void
+dr_test_metering_clear_clips
+(
+	dr_test_metering_t * metering,
+	int slot
+);
+
+// Publishes a view frame when one is due. Returns the ms until the next
+// frame, or -1 while not publishing
+int64_t
+dr_test_metering_tick
+(
+	dr_test_metering_t * metering,
+	const aud_utime_t * now
+);
+
+// Converts conmon peak values to dBFS, see DR_TEST_METER_CLIP_DB and DR_TEST_METER_MUTE_DB
+void
+dr_test_meter_decode_peaks
+(
+	const uint8_t * peaks,
+	float * levels,
+	unsigned int count
+);
+
+//----------------------------------------------------------
+// Event ring
+//----------------------------------------------------------
+
+#ifdef WIN32
+#define DR_TEST_MEMORY_BARRIER() MemoryBarrier()
+#else
+#define DR_TEST_MEMORY_BARRIER() __sync_synchronize()
+#endif
+
+// must be a power of two
+#define DR_TEST_EVENT_RING_CAPACITY 1024
+
+typedef enum dr_test_event_kind
+{
+	DR_TEST_EVENT_DEVICE_CHANGED = 1,
+	DR_TEST_EVENT_REQUEST_COMPLETED,
+	DR_TEST_EVENT_DOMAIN_CHANGED,
+	DR_TEST_EVENT_BULK_CHUNK_COMPLETED
+} dr_test_event_kind_t;
+
+#define DR_TEST_EVENT_NO_COMPONENT (-1)
+
+// Fixed-layout event record shared with the .Net wrapper.
+// Pointers are widened to 64 bits so the layout is the same for x86 and x64.
+typedef struct dr_test_event
+{
+	uint32_t kind;              // dr_test_event_kind_t
+	uint32_t change_flags;      // dr_device_change_flags_t or ddh_change_flags_t
+	uint32_t stale_components;  // bit per dr_device_component_t that is stale
+	int32_t  component;         // component of an update request or DR_TEST_EVENT_NO_COMPONENT
+	int32_t  state;             // dr_device_state_t or ddh_state_t
+	int32_t  result;            // request result or domain handler error
+	uint32_t first;             // first entry of a bulk chunk
+	uint32_t count;             // number of entries of a bulk chunk
+	uint64_t handle;            // the dr_test_t the event belongs to
+	uint64_t request_id;        // dante_request_id_t for completed requests
+	uint64_t token;             // token returned when the request was issued, 0 if unknown
+} dr_test_event_t;
+
+// Lock-free single-producer / single-consumer ring. The producer is the
+// thread running the dante runtime (step), the consumer drains in bulk.
+// When the ring is full new events are dropped and counted.
+typedef struct dr_test_event_ring
+{
+	volatile uint32_t head;     // written by the producer only
+	volatile uint32_t tail;     // written by the consumer only
+	volatile uint32_t dropped;  // written by the producer only
+	dr_test_event_t events[DR_TEST_EVENT_RING_CAPACITY];
+} dr_test_event_ring_t;
+
+// Per-handle callback, registered with set_event_callback. Called on the thread
+// running step once a step has queued events; the events are read with drain_events.
+typedef void (CALLBACK* DR_TEST_EVENT_CALLBACK)(void* context);
+
+void
+dr_test_event_ring_push
+(
+	dr_test_event_ring_t * ring,
+	const dr_test_event_t * event
+);
+
+// Copies up to 'capacity' events into 'events' and returns the number copied
+unsigned int
+dr_test_event_ring_drain
+(
+	dr_test_event_ring_t * ring,
+	dr_test_event_t * events,
+	unsigned int capacity
+);
+
+//----------------------------------------------------------
+// Tx flow provisioning
+//----------------------------------------------------------
+
+// Fixed-layout tx flow description shared with the .Net wrapper, see provision_txflows
+typedef struct dr_test_txflow_spec
+{
+	int32_t  id;                // 0 lets the device choose
+	int32_t  num_slots;         // 0 deletes flow 'id'
+	int32_t  channels[DR_BATCH_TX_FLOW_MAX_SLOTS]; // tx channel id per slot, 0 for an empty slot
+	uint32_t latency_us;        // 0 for the device default
+	uint16_t fpp;               // 0 for the device default
+	uint16_t encoding;          // 0 for the device default
+} dr_test_txflow_spec_t;
+
+//----------------------------------------------------------
+// Command queue
+//----------------------------------------------------------
+
+#ifdef WIN32
+typedef DWORD dr_test_thread_id_t;
+#define DR_TEST_CURRENT_THREAD_ID() GetCurrentThreadId()
+#define DR_TEST_SAME_THREAD(A, B) ((A) == (B))
+#else
+typedef pthread_t dr_test_thread_id_t;
+#define DR_TEST_CURRENT_THREAD_ID() pthread_self()
+#define DR_TEST_SAME_THREAD(A, B) pthread_equal(A, B)
+#endif
+
+// commands executed per dr_test_command_queue_run, so a burst of submissions
+// cannot hold off network processing
+#define DR_TEST_COMMAND_RUN_LIMIT 256
+
+typedef aud_error_t (*dr_test_command_fn)(void * target, void * args);
+
+// One call marshalled onto the thread stepping the runtime. It lives on the
+// stack of the submitting thread, which blocks until it has been executed.
+typedef struct dr_test_command dr_test_command_t;
+struct dr_test_command
+{
+	dr_test_command_t * volatile next;
+	dr_test_command_fn fn;
+	void * target;
+	void * args;
+	aud_error_t result;
+	volatile aud_bool_t done;
+#ifdef WIN32
+	SRWLOCK lock;
+	CONDITION_VARIABLE cond;
+#else
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+#endif
+};
+
+// Lock-free intrusive multi-producer / single-consumer queue. Any thread
+// pushes; only the attached consumer, the thread stepping the runtime, pops
+// and executes between calls to dante_runtime_process_with_sockets.
+// While no consumer is attached commands run on the submitting thread.
+typedef struct dr_test_command_queue
+{
+	dr_test_command_t * volatile head; // most recently pushed, swapped by producers
+	dr_test_command_t * tail;          // oldest, consumer only
+	dr_test_command_t stub;
+
+	volatile aud_bool_t attached;
+	volatile aud_bool_t consumer_known;
+	dr_test_thread_id_t consumer;
+
+	volatile long draining; // held while a detached queue is emptied
+} dr_test_command_queue_t;
+
+void
+dr_test_command_queue_init
+(
+	dr_test_command_queue_t * queue
+);
+
+// Routes submissions to the queue from now on. The consumer identifies
+// itself on its first dr_test_command_queue_run.
+void
+dr_test_command_queue_attach
+(
+	dr_test_command_queue_t * queue
+);
+
+// Executes whatever is still queued on the calling thread. The consumer
+// must have stopped running.
+void
+dr_test_command_queue_detach
+(
+	dr_test_command_queue_t * queue
+);
+
+// AUD_TRUE if a command submitted from the calling thread has to be pushed
+// rather than executed directly
+aud_bool_t
+dr_test_command_queue_is_remote
+(
+	const dr_test_command_queue_t * queue
+);
+
+// Called by the consumer. Returns AUD_TRUE if commands are left over.
+aud_bool_t
+dr_test_command_queue_run
+(
+	dr_test_command_queue_t * queue
+);
+
+void
+dr_test_command_init
+(
+	dr_test_command_t * command,
+	dr_test_command_fn fn,
+	void * target,
+	void * args
+);
+
+void
+dr_test_command_queue_push
+(
+	dr_test_command_queue_t * queue,
+	dr_test_command_t * command
+);
+
+// Blocks until 'command' has been executed and returns its result
+aud_error_t
+dr_test_command_wait
+(
+	dr_test_command_queue_t * queue,
+	dr_test_command_t * command
+);
+
 #endif
 
@@ -10,9 +10,40 @@
  */
 #include "dapi_utils.h"
 #include <stdio.h>
+#include <string.h>
+#ifndef WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sched.h>
+#endif
+#ifdef DAPI_UTILS_HAS_EPOLL
+#include <sys/epoll.h>
+#endif
+
+#define DAPI_UTILS_WAKE_OPEN 0x40000000L
+
+#ifdef WIN32
+#define DAPI_UTILS_ATOMIC_INCREMENT(P) InterlockedIncrement(P)
+#define DAPI_UTILS_ATOMIC_DECREMENT(P) InterlockedDecrement(P)
+#define DAPI_UTILS_ATOMIC_FETCH_AND(P, V) InterlockedAnd((P), (V))
+#define DAPI_UTILS_YIELD() SwitchToThread()
+#else
+#define DAPI_UTILS_ATOMIC_INCREMENT(P) __sync_add_and_fetch((P), 1)
+#define DAPI_UTILS_ATOMIC_DECREMENT(P) __sync_sub_and_fetch((P), 1)
+#define DAPI_UTILS_ATOMIC_FETCH_AND(P, V) __sync_fetch_and_and((P), (V))
+#define DAPI_UTILS_YIELD() sched_yield()
+#endif
 
 aud_error_t 
 dapi_utils_step(dante_runtime_t * runtime, aud_socket_t in_sock, dante_sockets_t * out_sockets)
+{
+	const aud_utime_t max_timeout = {1, 0};
+	return dapi_utils_step_timeout(runtime, in_sock, out_sockets, &max_timeout);
+}
+
+aud_error_t 
+dapi_utils_step_timeout(dante_runtime_t * runtime, aud_socket_t in_sock, dante_sockets_t * out_sockets, const aud_utime_t * max_timeout)
 {
 	dante_sockets_t step_sockets;
 	if (out_sockets == NULL)
@@ -20,7 +51,7 @@ dapi_utils_step(dante_runtime_t * runtime, aud_socket_t in_sock, dante_sockets_t
 		out_sockets = &step_sockets;
 	}
 	dante_sockets_clear(out_sockets);
-	aud_utime_t my_timeout = {1, 0};
+	aud_utime_t my_timeout = *max_timeout;
 	
 	aud_error_t result = dante_runtime_get_sockets_and_timeout(runtime, out_sockets, &my_timeout);
 	if (result != AUD_SUCCESS)
@@ -32,10 +63,10 @@ dapi_utils_step(dante_runtime_t * runtime, aud_socket_t in_sock, dante_sockets_t
 		// Add input stream to our list of sockets
 		dante_sockets_add_read(out_sockets, in_sock);
 	}
-	if (my_timeout.tv_sec >= 1)
+	if (my_timeout.tv_sec > max_timeout->tv_sec
+		|| (my_timeout.tv_sec == max_timeout->tv_sec && my_timeout.tv_usec > max_timeout->tv_usec))
 	{
-		my_timeout.tv_sec = 1;
-		my_timeout.tv_usec = 0;
+		my_timeout = *max_timeout;
 	}
 	else if (my_timeout.tv_sec == 0 && my_timeout.tv_usec == 0)
 	{
@@ -79,6 +110,355 @@ dapi_utils_step(dante_runtime_t * runtime, aud_socket_t in_sock, dante_sockets_t
 	return dante_runtime_process_with_sockets(runtime, out_sockets);
 }
 
+static void
+dapi_utils_wake_on_async_change(const dante_runtime_t * runtime, void * context)
+{
+	(void) runtime;
+	dapi_utils_wake_signal((dapi_utils_wake_t *) context);
+}
+
+aud_error_t
+dapi_utils_wake_init(dapi_utils_wake_t * wake, dante_runtime_t * runtime)
+{
+	aud_error_t result;
+#ifdef WIN32
+	struct sockaddr_in addr;
+	int addr_len = sizeof(addr);
+	u_long non_blocking = 1;
+
+	memset(wake, 0, sizeof(dapi_utils_wake_t));
+	wake->recv_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (wake->recv_sock == INVALID_SOCKET)
+	{
+		return aud_error_from_system_error(WSAGetLastError());
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	if (bind(wake->recv_sock, (struct sockaddr *) &addr, sizeof(addr))
+		|| getsockname(wake->recv_sock, (struct sockaddr *) &addr, &addr_len)
+		|| connect(wake->recv_sock, (struct sockaddr *) &addr, sizeof(addr))
+		|| ioctlsocket(wake->recv_sock, FIONBIO, &non_blocking))
+	{
+		result = aud_error_from_system_error(WSAGetLastError());
+		closesocket(wake->recv_sock);
+		return result;
+	}
+#else
+	int fds[2];
+
+	memset(wake, 0, sizeof(dapi_utils_wake_t));
+	if (pipe(fds))
+	{
+		return aud_error_get_last();
+	}
+	fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+	fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+	wake->recv_sock = fds[0];
+	wake->send_fd = fds[1];
+#endif
+#ifdef DAPI_UTILS_HAS_EPOLL
+	{
+		struct epoll_event event;
+		wake->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.fd = wake->recv_sock;
+		if (wake->epoll_fd < 0 || epoll_ctl(wake->epoll_fd, EPOLL_CTL_ADD, wake->recv_sock, &event))
+		{
+			result = aud_error_get_last();
+			if (wake->epoll_fd >= 0)
+			{
+				close(wake->epoll_fd);
+			}
+			close(wake->recv_sock);
+			close(wake->send_fd);
+			return result;
+		}
+	}
+#endif
+	wake->state = DAPI_UTILS_WAKE_OPEN;
+
+	// not every platform reports asynchronous changes, explicit signals still work then
+	result = dante_runtime_set_async_change_event(runtime, dapi_utils_wake_on_async_change, wake);
+	if (result == AUD_SUCCESS)
+	{
+		dante_runtime_enable_async_change_event(runtime, AUD_TRUE);
+	}
+	else if (result != AUD_ERR_NOTSUPPORTED)
+	{
+		printf("Error registering for async change events: %s (%d)\n"
+			, aud_error_get_name(result)
+			, result
+		);
+	}
+	return AUD_SUCCESS;
+}
+
+void
+dapi_utils_wake_cleanup(dapi_utils_wake_t * wake, dante_runtime_t * runtime)
+{
+	// refuse new signals, then wait for the ones already sending
+	if (!(DAPI_UTILS_ATOMIC_FETCH_AND(&wake->state, ~DAPI_UTILS_WAKE_OPEN) & DAPI_UTILS_WAKE_OPEN))
+	{
+		return;
+	}
+	if (runtime)
+	{
+		dante_runtime_enable_async_change_event(runtime, AUD_FALSE);
+		dante_runtime_set_async_change_event(runtime, NULL, NULL);
+	}
+	while (wake->state)
+	{
+		DAPI_UTILS_YIELD();
+	}
+#ifdef WIN32
+	closesocket(wake->recv_sock);
+#else
+	close(wake->recv_sock);
+	close(wake->send_fd);
+#endif
+#ifdef DAPI_UTILS_HAS_EPOLL
+	close(wake->epoll_fd);
+	wake->registered_valid = AUD_FALSE;
+#endif
+}
+
+void
+dapi_utils_wake_signal(dapi_utils_wake_t * wake)
+{
+	char c = 0;
+	if (!(DAPI_UTILS_ATOMIC_INCREMENT(&wake->state) & DAPI_UTILS_WAKE_OPEN))
+	{
+		DAPI_UTILS_ATOMIC_DECREMENT(&wake->state);
+		return;
+	}
+	// a full buffer already guarantees a wakeup, so failures are ignored
+#ifdef WIN32
+	send(wake->recv_sock, &c, 1, 0);
+#else
+	if (write(wake->send_fd, &c, 1) < 0)
+	{
+		// ignored, see above
+	}
+#endif
+	DAPI_UTILS_ATOMIC_DECREMENT(&wake->state);
+}
+
+void
+dapi_utils_wake_sockets_changed(dapi_utils_wake_t * wake)
+{
+#ifdef DAPI_UTILS_HAS_EPOLL
+	wake->sockets_changed = AUD_TRUE;
+#endif
+	dapi_utils_wake_signal(wake);
+}
+
+static void
+dapi_utils_wake_drain(dapi_utils_wake_t * wake)
+{
+	char buf[64];
+#ifdef WIN32
+	while (recv(wake->recv_sock, buf, sizeof(buf), 0) > 0)
+	{
+	}
+#else
+	while (read(wake->recv_sock, buf, sizeof(buf)) > 0)
+	{
+	}
+#endif
+}
+
+#ifdef DAPI_UTILS_HAS_EPOLL
+
+static uint32_t
+dapi_utils_epoll_interest(const dante_sockets_t * sockets, int fd)
+{
+	uint32_t events = 0;
+	if (fd < sockets->n)
+	{
+		if (FD_ISSET(fd, &sockets->read_fds))
+		{
+			events |= EPOLLIN;
+		}
+		if (FD_ISSET(fd, &sockets->write_fds))
+		{
+			events |= EPOLLOUT;
+		}
+	}
+	return events;
+}
+
+// Brings the epoll interest set in line with 'sockets'. A closed fd drops out of
+// epoll by itself and its number may come back as a new socket, so every wanted
+// fd is (re-)registered rather than only the ones that differ.
+static void
+dapi_utils_epoll_sync(dapi_utils_wake_t * wake, const dante_sockets_t * sockets)
+{
+	int fd, n = (sockets->n > wake->registered.n) ? sockets->n : wake->registered.n;
+
+	for (fd = 0; fd < n; fd++)
+	{
+		struct epoll_event event;
+		uint32_t was = wake->registered_valid ? dapi_utils_epoll_interest(&wake->registered, fd) : 0;
+		uint32_t now = dapi_utils_epoll_interest(sockets, fd);
+
+		if (fd == wake->recv_sock)
+		{
+			continue;
+		}
+		memset(&event, 0, sizeof(event));
+		event.events = now;
+		event.data.fd = fd;
+		if (now)
+		{
+			if (epoll_ctl(wake->epoll_fd, EPOLL_CTL_MOD, fd, &event) && errno == ENOENT)
+			{
+				epoll_ctl(wake->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+			}
+		}
+		else if (was)
+		{
+			epoll_ctl(wake->epoll_fd, EPOLL_CTL_DEL, fd, &event);
+		}
+	}
+	dante_sockets_copy(sockets, &wake->registered);
+	wake->registered_valid = AUD_TRUE;
+}
+
+static aud_error_t
+dapi_utils_step_epoll(dante_runtime_t * runtime, dapi_utils_wake_t * wake, dante_sockets_t * out_sockets, const aud_utime_t * max_timeout)
+{
+	struct epoll_event events[DAPI_UTILS_EPOLL_MAX_EVENTS];
+	aud_utime_t my_timeout = *max_timeout;
+	aud_error_t result;
+	int i, count, timeout_ms;
+
+	if (!wake->registered_valid || wake->sockets_changed || dante_runtime_sockets_have_changed(runtime))
+	{
+		wake->sockets_changed = AUD_FALSE;
+		dante_sockets_clear(out_sockets);
+		result = dante_runtime_get_sockets_and_timeout(runtime, out_sockets, &my_timeout);
+		if (result != AUD_SUCCESS)
+		{
+			return result;
+		}
+		dapi_utils_epoll_sync(wake, out_sockets);
+	}
+	else
+	{
+		// the interest set is still current, only the timeout is needed
+		result = dante_runtime_get_sockets_and_timeout(runtime, NULL, &my_timeout);
+		if (result != AUD_SUCCESS)
+		{
+			return result;
+		}
+	}
+	if (my_timeout.tv_sec > max_timeout->tv_sec
+		|| (my_timeout.tv_sec == max_timeout->tv_sec && my_timeout.tv_usec > max_timeout->tv_usec))
+	{
+		my_timeout = *max_timeout;
+	}
+	timeout_ms = (int) ((my_timeout.tv_sec * 1000) + ((my_timeout.tv_usec + 999) / 1000));
+
+	count = epoll_wait(wake->epoll_fd, events, DAPI_UTILS_EPOLL_MAX_EVENTS, timeout_ms);
+	if (count < 0)
+	{
+		if (errno != EINTR)
+		{
+			result = aud_error_get_last();
+			printf("Error processing sockets: %s (%d)\n"
+				, aud_error_get_name(result)
+				, result
+			);
+			return result;
+		}
+		count = 0;
+	}
+
+	// hand only the ready sockets to the runtime
+	dante_sockets_clear(out_sockets);
+	for (i = 0; i < count; i++)
+	{
+		int fd = events[i].data.fd;
+		if (fd == wake->recv_sock)
+		{
+			dapi_utils_wake_drain(wake);
+			continue;
+		}
+		// select() reports errors and hangups as readable
+		if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+		{
+			dante_sockets_add_read(out_sockets, fd);
+		}
+		if (events[i].events & EPOLLOUT)
+		{
+			dante_sockets_add_write(out_sockets, fd);
+		}
+	}
+	return dante_runtime_process_with_sockets(runtime, out_sockets);
+}
+
+#endif
+
+aud_error_t
+dapi_utils_step_wake(dante_runtime_t * runtime, dapi_utils_wake_t * wake, dante_sockets_t * out_sockets)
+{
+	const aud_utime_t max_timeout = {DAPI_UTILS_WAKE_MAX_TIMEOUT_SECONDS, 0};
+	return dapi_utils_step_wake_timeout(runtime, wake, out_sockets, &max_timeout);
+}
+
+aud_error_t
+dapi_utils_step_wake_timeout(dante_runtime_t * runtime, dapi_utils_wake_t * wake, dante_sockets_t * out_sockets, const aud_utime_t * max_timeout)
+{
+	dante_sockets_t step_sockets;
+#ifndef DAPI_UTILS_HAS_EPOLL
+	aud_utime_t my_timeout = *max_timeout;
+	aud_error_t result;
+	int select_result;
+#endif
+
+	if (out_sockets == NULL)
+	{
+		out_sockets = &step_sockets;
+	}
+#ifdef DAPI_UTILS_HAS_EPOLL
+	return dapi_utils_step_epoll(runtime, wake, out_sockets, max_timeout);
+#else
+	dante_sockets_clear(out_sockets);
+
+	result = dante_runtime_get_sockets_and_timeout(runtime, out_sockets, &my_timeout);
+	if (result != AUD_SUCCESS)
+	{
+		return result;
+	}
+	if (my_timeout.tv_sec > max_timeout->tv_sec
+		|| (my_timeout.tv_sec == max_timeout->tv_sec && my_timeout.tv_usec > max_timeout->tv_usec))
+	{
+		my_timeout = *max_timeout;
+	}
+	dante_sockets_add_read(out_sockets, wake->recv_sock);
+
+	select_result = select(out_sockets->n, &out_sockets->read_fds, &out_sockets->write_fds, NULL, &my_timeout);
+	if (select_result < 0)
+	{
+		result = aud_error_get_last();
+		printf("Error processing sockets: %s (%d)\n"
+			, aud_error_get_name(result)
+			, result
+		);
+		return result;
+	}
+	if (FD_ISSET(wake->recv_sock, &out_sockets->read_fds))
+	{
+		dapi_utils_wake_drain(wake);
+		FD_CLR(wake->recv_sock, &out_sockets->read_fds);
+	}
+	return dante_runtime_process_with_sockets(runtime, out_sockets);
+#endif
+}
+
 #ifdef WIN32
 
 void dapi_utils_check_quick_edit_mode(aud_bool_t disable)
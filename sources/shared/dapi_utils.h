@@ -45,6 +45,89 @@ extern "C" {
 aud_error_t 
 dapi_utils_step(dante_runtime_t * runtime, aud_socket_t in_sock, dante_sockets_t * out_sockets);
 
+/**
+ * Like dapi_utils_step, but waits at most max_timeout instead of at most one second.
+ */
+aud_error_t 
+dapi_utils_step_timeout(dante_runtime_t * runtime, aud_socket_t in_sock, dante_sockets_t * out_sockets, const aud_utime_t * max_timeout);
+
+/**
+ * On Linux dapi_utils_step_wake waits with epoll on a persistent interest set instead of select()
+ */
+#if defined(__linux__)
+#define DAPI_UTILS_HAS_EPOLL 1
+#define DAPI_UTILS_EPOLL_MAX_EVENTS 64
+#endif
+
+/**
+ * Upper bound for a single wait in dapi_utils_step_wake when the runtime has nothing scheduled sooner.
+ */
+#define DAPI_UTILS_WAKE_MAX_TIMEOUT_SECONDS 30
+
+/**
+ * A socket that can be made readable from any thread to interrupt a blocked dapi_utils_step_wake.
+ * On Windows this is a loopback UDP socket sending to itself, elsewhere the read end of a pipe.
+ * With epoll it also holds the interest set, which is only updated after the runtime's sockets changed.
+ */
+typedef struct dapi_utils_wake
+{
+	// DAPI_UTILS_WAKE_OPEN while the socket is open plus the number of signals
+	// being sent, so cleanup can wait for them before closing; changed atomically
+	volatile long state;
+	aud_socket_t recv_sock;
+#ifndef WIN32
+	int send_fd;
+#endif
+#ifdef DAPI_UTILS_HAS_EPOLL
+	int epoll_fd;
+	aud_bool_t registered_valid;
+	dante_sockets_t registered;
+	volatile aud_bool_t sockets_changed;
+#endif
+} dapi_utils_wake_t;
+
+/**
+ * Creates the wake socket and registers it for the runtime's asynchronous change events,
+ * so a change to the runtime's sockets or timeouts made from another thread also wakes the step.
+ */
+aud_error_t
+dapi_utils_wake_init(dapi_utils_wake_t * wake, dante_runtime_t * runtime);
+
+/**
+ * Unregisters from the runtime and closes the wake socket. Safe to call on a zeroed or closed wake.
+ * Must be called from the thread that called dapi_utils_wake_init; signals racing with it are
+ * either sent before the socket closes or dropped.
+ */
+void
+dapi_utils_wake_cleanup(dapi_utils_wake_t * wake, dante_runtime_t * runtime);
+
+/**
+ * Wakes the thread blocked in dapi_utils_step_wake, or makes its next wait return immediately.
+ * Safe to call from any thread, also on a zeroed or closed wake, where it does nothing.
+ */
+void
+dapi_utils_wake_signal(dapi_utils_wake_t * wake);
+
+/**
+ * Forces the next dapi_utils_step_wake to re-read the runtime's sockets and wakes it.
+ * Meant for the dr_devices / db_browse sockets changed callbacks.
+ */
+void
+dapi_utils_wake_sockets_changed(dapi_utils_wake_t * wake);
+
+/**
+ * Like dapi_utils_step, but waits for the full timeout requested by the runtime instead of at
+ * most one second, and returns early when the wake socket is signalled.
+ */
+aud_error_t
+dapi_utils_step_wake(dante_runtime_t * runtime, dapi_utils_wake_t * wake, dante_sockets_t * out_sockets);
+
+/**
+ * Like dapi_utils_step_wake, but waits at most max_timeout, for callers with deadlines of their own.
+ */
+aud_error_t
+dapi_utils_step_wake_timeout(dante_runtime_t * runtime, dapi_utils_wake_t * wake, dante_sockets_t * out_sockets, const aud_utime_t * max_timeout);
+
 #ifdef WIN32
 
 /**